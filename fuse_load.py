@@ -0,0 +1,470 @@
+#!/usr/bin/env python3
+"""
+Synthetic cmg-cli load generator and end-to-end benchmark for `thermo-cli fuse`.
+
+`produce` stands in for `cmg-cli get --json`: it prints POWER, ACTUATOR and
+CONTROL blocks as NDJSON at a chosen rate, line size and burstiness. Every
+line carries a LOADGEN block with a sequence number and its CLOCK_MONOTONIC
+send time, which fuse passes through untouched.
+
+`run` starts `thermo-cli fuse` against the producer for each requested rate
+and reports the lines/s that came out, how many were lost, per-line latency
+percentiles (producer write to harness read) and the CPU used by fuse and
+the producer. The boards (or a stand-in libdaqhats) are still read for every
+line, so use a config whose sources exist.
+
+Usage:
+    python3 fuse_load.py produce --rate 200 --power --control
+    python3 fuse_load.py run -C thermo_config.yaml --rates 100,1000,10000,max
+    python3 fuse_load.py run -C thermo_config.yaml --via stdin --line-size 2048 --burst 50
+    python3 fuse_load.py run -C thermo_config.yaml -- --output-policy drop-oldest
+"""
+
+import argparse
+import math
+import os
+import random
+import re
+import select
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+from typing import Optional
+
+# ANSI color codes
+COLOR_RESET = "\033[0m"
+COLOR_RED = "\033[31m"
+COLOR_GREEN = "\033[32m"
+COLOR_YELLOW = "\033[33m"
+COLOR_BLUE = "\033[34m"
+COLOR_BOLD = "\033[1m"
+
+SCRIPT_PATH = Path(__file__).resolve()
+
+# Matches the LOADGEN block however fuse re-serializes the line
+LOADGEN_RE = re.compile(rb'"SEQ":\s*(\d+),\s*"SENT_NS":\s*(\d+)')
+
+# fuse keeps the producer command in a fixed-size buffer
+MAX_COMMAND_LENGTH = 255
+
+# Achieved below this fraction of the offered rate counts as saturated
+SATURATION_FRACTION = 0.95
+
+CLOCK_TICKS = os.sysconf("SC_CLK_TCK")
+
+
+# ============================================================================
+# Producer
+# ============================================================================
+
+def make_blocks(rng: random.Random, power: bool, actuator: bool, control: bool) -> str:
+    """One line's worth of cmg-cli blocks, already serialized."""
+    parts = []
+    if power:
+        parts.append(
+            '"POWER":{"VIN":%.3f,"IIN":%.4f,"P":%.3f,"TMP1":%.2f,"TMP2":%.2f,"TMP3":%.2f}'
+            % (
+                rng.gauss(24.0, 0.05),
+                rng.gauss(1.25, 0.02),
+                rng.gauss(30.0, 0.5),
+                rng.gauss(31.0, 0.1),
+                rng.gauss(38.0, 0.1),
+                rng.gauss(41.0, 0.1),
+            )
+        )
+    if actuator:
+        parts.append(
+            '"ACTUATOR":{"WHEEL_SPEED":%.2f,"WHEEL_CURRENT":%.4f,"GIMBAL_ANGLE":%.3f,'
+            '"GIMBAL_RATE":%.4f,"GIMBAL_CURRENT":%.4f}'
+            % (
+                rng.gauss(100.0, 0.2),
+                rng.gauss(0.82, 0.01),
+                rng.gauss(45.0, 0.01),
+                rng.gauss(0.0, 0.002),
+                rng.gauss(0.11, 0.005),
+            )
+        )
+    if control:
+        parts.append(
+            '"CONTROL":{"MODE":"RUN","SETPOINT":100.0,"ERROR":%.4f,"OUTPUT":%.4f,"LOOP_US":%d}'
+            % (rng.gauss(0.0, 0.05), rng.gauss(0.6, 0.01), rng.randint(180, 260))
+        )
+    return ",".join(parts)
+
+
+def make_templates(args) -> list[str]:
+    """Pre-render line variants so the producer is never the bottleneck.
+
+    Each template takes (timestamp, seq, sent_ns) and is padded so a line
+    comes out at --line-size bytes.
+    """
+    rng = random.Random(args.seed)
+    power, actuator, control = args.power, args.actuator, args.control
+    if not (power or actuator or control):
+        power = actuator = control = True
+
+    # Width of the variable fields at their largest: timestamp, seq, ns
+    sample = '{"TIMESTAMP":"2026-01-01T00:00:00.000000",%s,"LOADGEN":{"SEQ":%d,"SENT_NS":%d,"PAD":"%s"}}\n'
+    templates = []
+    for _ in range(64):
+        blocks = make_blocks(rng, power, actuator, control)
+        fixed = len(sample % (blocks, 10**9, 10**15, ""))
+        pad = "x" * max(0, args.line_size - fixed)
+        templates.append(
+            ('{"TIMESTAMP":"%%s",%s,"LOADGEN":{"SEQ":%%d,"SENT_NS":%%d,"PAD":"%s"}}\n' % (blocks, pad))
+        )
+    return templates
+
+
+def produce(args) -> int:
+    templates = make_templates(args)
+    out = sys.stdout.buffer
+    burst = max(1, args.burst)
+    interval = burst / args.rate if args.rate > 0 else 0.0
+
+    seq = 0
+    start = time.monotonic()
+    next_burst = start
+    try:
+        while args.count == 0 or seq < args.count:
+            if args.duration > 0 and time.monotonic() - start >= args.duration:
+                break
+            if interval > 0:
+                delay = next_burst - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+                next_burst += interval
+
+            now = time.time()
+            stamp = time.strftime("%Y-%m-%dT%H:%M:%S", time.localtime(now)) + ".%06d" % int(now % 1 * 1e6)
+            chunk = []
+            for _ in range(burst):
+                if args.count and seq >= args.count:
+                    break
+                template = templates[seq % len(templates)]
+                chunk.append(template % (stamp, seq, time.monotonic_ns()))
+                seq += 1
+            out.write("".join(chunk).encode())
+            out.flush()
+    except (OSError, KeyboardInterrupt):
+        # Reader went away (EPIPE, or EIO once fuse closes its pty) or we
+        # were told to stop; don't complain on the way out
+        try:
+            sys.stdout = None
+            os.dup2(os.open(os.devnull, os.O_WRONLY), 1)
+        except OSError:
+            pass
+    return 0
+
+
+# ============================================================================
+# Harness
+# ============================================================================
+
+def cpu_seconds(pid: int) -> float:
+    """User + system CPU of one process (its children not included)."""
+    try:
+        with open(f"/proc/{pid}/stat", "rb") as f:
+            fields = f.read().rsplit(b")", 1)[1].split()
+        return (int(fields[11]) + int(fields[12])) / CLOCK_TICKS
+    except (OSError, IndexError, ValueError):
+        return math.nan
+
+
+def child_pid(pid: int) -> Optional[int]:
+    """The producer fuse spawned (its only child), if it can be found."""
+    try:
+        with open(f"/proc/{pid}/task/{pid}/children") as f:
+            children = f.read().split()
+        if children:
+            return int(children[0])
+    except OSError:
+        pass
+    for entry in os.listdir("/proc"):
+        if not entry.isdigit():
+            continue
+        try:
+            with open(f"/proc/{entry}/stat", "rb") as f:
+                fields = f.read().rsplit(b")", 1)[1].split()
+            if int(fields[1]) == pid:
+                return int(entry)
+        except (OSError, IndexError, ValueError):
+            continue
+    return None
+
+
+def percentile(sorted_values: list[int], pct: float) -> float:
+    if not sorted_values:
+        return math.nan
+    index = min(len(sorted_values) - 1, int(math.ceil(pct / 100.0 * len(sorted_values))) - 1)
+    return sorted_values[max(0, index)]
+
+
+def parse_rates(text: str) -> list[float]:
+    rates = []
+    for item in text.split(","):
+        item = item.strip().lower()
+        if item in ("max", "0"):
+            rates.append(0.0)
+        else:
+            rate = float(item)
+            if rate <= 0:
+                raise argparse.ArgumentTypeError("rates must be positive (or 'max')")
+            rates.append(rate)
+    return rates
+
+
+def producer_command(args, rate: float) -> list[str]:
+    command = [
+        sys.executable, str(SCRIPT_PATH), "produce",
+        "--rate", "%g" % rate,
+        "--burst", str(args.burst),
+        "--line-size", str(args.line_size),
+        "--seed", str(args.seed),
+    ]
+    for block in ("power", "actuator", "control"):
+        if getattr(args, block):
+            command.append(f"--{block}")
+    return command
+
+
+def stop(proc: subprocess.Popen) -> None:
+    if proc.poll() is None:
+        proc.send_signal(signal.SIGINT)
+        try:
+            proc.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            proc.wait()
+
+
+def run_once(args, rate: float) -> dict:
+    fuse = [args.thermo_cli, "fuse", "-C", args.config]
+    prod = producer_command(args, rate)
+    producer = None
+    # fuse's stderr would interleave with the table; shown only if it fails
+    errors = tempfile.TemporaryFile()
+
+    if args.via == "stdin":
+        producer = subprocess.Popen(prod, stdout=subprocess.PIPE)
+        proc = subprocess.Popen(
+            fuse + ["--stdin"] + args.fuse_args,
+            stdin=producer.stdout, stdout=subprocess.PIPE, stderr=errors,
+        )
+        producer.stdout.close()
+    else:
+        command = " ".join(prod)
+        if len(command) > MAX_COMMAND_LENGTH:
+            raise SystemExit(
+                f"{COLOR_RED}[ERROR]{COLOR_RESET} Producer command is too long for --command "
+                f"({len(command)} > {MAX_COMMAND_LENGTH}); use --via stdin"
+            )
+        extra = ["--pipe"] if args.via == "pipe" else []
+        proc = subprocess.Popen(
+            fuse + ["-x", command] + extra + args.fuse_args, stdout=subprocess.PIPE, stderr=errors,
+        )
+
+    fd = proc.stdout.fileno()
+    started = time.monotonic()
+    window_start = started + args.warmup
+    window_end = window_start + args.duration
+
+    in_window = False
+    cpu_start = {}
+    latencies = []
+    received = 0
+    first_seq = last_seq = None
+    pending = b""
+    producer_pid = producer.pid if producer else None
+
+    while True:
+        now = time.monotonic()
+        if now >= window_end:
+            break
+        if not in_window and now >= window_start:
+            in_window = True
+            if producer_pid is None:
+                producer_pid = child_pid(proc.pid)
+            cpu_start = {"fuse": cpu_seconds(proc.pid)}
+            if producer_pid:
+                cpu_start["producer"] = cpu_seconds(producer_pid)
+            window_start = now
+            window_end = now + args.duration
+
+        ready, _, _ = select.select([fd], [], [], min(0.1, max(0.0, window_end - now)))
+        if not ready:
+            continue
+        data = os.read(fd, 1 << 20)
+        if not data:
+            break
+        received_ns = time.monotonic_ns()
+        data = pending + data
+        cut = data.rfind(b"\n") + 1
+        pending = data[cut:]
+        if not in_window:
+            continue
+        for seq, sent_ns in LOADGEN_RE.findall(data[:cut]):
+            seq = int(seq)
+            if first_seq is None:
+                first_seq = seq
+            last_seq = seq
+            received += 1
+            latencies.append(received_ns - int(sent_ns))
+
+    elapsed = time.monotonic() - window_start
+    cpu = {}
+    if in_window:
+        cpu["fuse"] = cpu_seconds(proc.pid) - cpu_start["fuse"]
+        if "producer" in cpu_start:
+            cpu["producer"] = cpu_seconds(producer_pid) - cpu_start["producer"]
+
+    stop(proc)
+    if producer:
+        stop(producer)
+    if not in_window:
+        errors.seek(0)
+        sys.stderr.write(errors.read().decode(errors="replace"))
+        raise SystemExit(
+            f"{COLOR_RED}[ERROR]{COLOR_RESET} thermo-cli fuse exited during warm-up (exit code {proc.returncode})"
+        )
+
+    latencies.sort()
+    expected = (last_seq - first_seq + 1) if first_seq is not None else 0
+    return {
+        "offered": rate,
+        "achieved": received / elapsed if elapsed > 0 else 0.0,
+        "received": received,
+        "lost": max(0, expected - received),
+        "p50": percentile(latencies, 50) / 1e6,
+        "p90": percentile(latencies, 90) / 1e6,
+        "p99": percentile(latencies, 99) / 1e6,
+        "max": latencies[-1] / 1e6 if latencies else math.nan,
+        "fuse_cpu": 100.0 * cpu.get("fuse", math.nan) / elapsed,
+        "producer_cpu": 100.0 * cpu.get("producer", math.nan) / elapsed,
+    }
+
+
+def print_header() -> None:
+    print(
+        f"{'offered/s':>10} {'achieved/s':>11} {'lost':>8} {'p50 ms':>9} {'p90 ms':>9} "
+        f"{'p99 ms':>9} {'max ms':>9} {'fuse CPU':>9} {'prod CPU':>9}"
+    )
+
+
+def print_row(result: dict, saturated: bool) -> None:
+    offered = "max" if result["offered"] == 0 else "%.0f" % result["offered"]
+    line = (
+        f"{offered:>10} {result['achieved']:>11.0f} {result['lost']:>8d} {result['p50']:>9.3f} "
+        f"{result['p90']:>9.3f} {result['p99']:>9.3f} {result['max']:>9.3f} "
+        f"{result['fuse_cpu']:>8.1f}% {result['producer_cpu']:>8.1f}%"
+    )
+    if saturated:
+        line += f"  {COLOR_YELLOW}saturated{COLOR_RESET}"
+    print(line, flush=True)
+
+
+def run(args) -> int:
+    if not Path(args.config).exists():
+        print(f"{COLOR_RED}[ERROR]{COLOR_RESET} Config not found: {args.config}")
+        return 1
+
+    blocks = [b.upper() for b in ("power", "actuator", "control") if getattr(args, b)] or ["POWER", "ACTUATOR", "CONTROL"]
+    print(f"{COLOR_BOLD}{COLOR_BLUE}=== thermo-cli fuse load test ==={COLOR_RESET}")
+    print(
+        f"{COLOR_BLUE}[INFO]{COLOR_RESET} via {args.via}, {args.line_size}-byte lines, bursts of {args.burst}, "
+        f"{'/'.join(blocks)}, {args.warmup:g}s warm-up + {args.duration:g}s per rate"
+    )
+    print_header()
+
+    best = None
+    saturation = None
+    for rate in args.rates:
+        result = run_once(args, rate)
+        saturated = rate == 0 or result["achieved"] < SATURATION_FRACTION * rate
+        print_row(result, saturated and rate > 0)
+        if best is None or result["achieved"] > best:
+            best = result["achieved"]
+        if saturated and saturation is None:
+            saturation = result["achieved"]
+
+    if saturation is not None:
+        print(f"\n{COLOR_GREEN}[RESULT]{COLOR_RESET} fuse saturates at ~{saturation:.0f} lines/s "
+              f"(best seen {best:.0f} lines/s)")
+    else:
+        print(f"\n{COLOR_GREEN}[RESULT]{COLOR_RESET} fuse kept up with every rate (best {best:.0f} lines/s); "
+              f"add a higher rate or 'max' to find saturation")
+    return 0
+
+
+# ============================================================================
+# Entry point
+# ============================================================================
+
+def add_shape_arguments(parser: argparse.ArgumentParser) -> None:
+    parser.add_argument("--line-size", type=int, default=512,
+                        help="Target bytes per line, padded in LOADGEN.PAD (default: 512)")
+    parser.add_argument("--burst", type=int, default=1,
+                        help="Lines written back to back per burst; bursts keep the average rate (default: 1)")
+    parser.add_argument("--seed", type=int, default=0, help="Seed for the generated values (default: 0)")
+    parser.add_argument("--power", action="store_true", help="Emit the POWER block")
+    parser.add_argument("--actuator", action="store_true", help="Emit the ACTUATOR block")
+    parser.add_argument("--control", action="store_true", help="Emit the CONTROL block")
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Synthetic cmg-cli producer and thermo-cli fuse throughput benchmark",
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        epilog="""
+Examples:
+  %(prog)s produce --rate 200 --power --control | thermo-cli fuse -C thermo_config.yaml --stdin
+  %(prog)s run -C thermo_config.yaml --rates 100,1000,10000,max
+  %(prog)s run -C thermo_config.yaml --via stdin --line-size 4096 --burst 100
+  %(prog)s run -C thermo_config.yaml --thermo-cli ./thermo-cli/thermo-cli -- --output-policy coalesce
+
+With no block flags, all of POWER, ACTUATOR and CONTROL are emitted.
+Arguments after '--' are passed to thermo-cli fuse.
+        """,
+    )
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    p = commands.add_parser("produce", help="Print synthetic cmg-cli JSON lines")
+    p.add_argument("--rate", type=float, default=10.0, help="Lines per second, 0 = as fast as possible (default: 10)")
+    p.add_argument("--count", type=int, default=0, help="Stop after this many lines (default: run until stopped)")
+    p.add_argument("--duration", type=float, default=0.0, help="Stop after this many seconds (default: run until stopped)")
+    p.add_argument("-j", "--json", action="store_true", help="Accepted for cmg-cli compatibility (output is always JSON)")
+    add_shape_arguments(p)
+
+    r = commands.add_parser("run", help="Benchmark thermo-cli fuse against the producer")
+    r.add_argument("-C", "--config", required=True, help="thermo-cli config whose sources fuse reads")
+    r.add_argument("--rates", type=parse_rates, default=parse_rates("100,1000,10000,max"),
+                   help="Comma-separated offered rates in lines/s, 'max' = unthrottled (default: 100,1000,10000,max)")
+    r.add_argument("--duration", type=float, default=10.0, help="Measured seconds per rate (default: 10)")
+    r.add_argument("--warmup", type=float, default=2.0, help="Seconds discarded before measuring (default: 2)")
+    r.add_argument("--via", choices=("pty", "pipe", "stdin"), default="pty",
+                   help="Producer transport: fuse's pty (as on the rig), --pipe, or --stdin (default: pty)")
+    r.add_argument("--thermo-cli", default="thermo-cli", help="thermo-cli binary (default: thermo-cli on PATH)")
+    add_shape_arguments(r)
+
+    argv = sys.argv[1:]
+    fuse_args = []
+    if "--" in argv:
+        split = argv.index("--")
+        argv, fuse_args = argv[:split], argv[split + 1:]
+    args = parser.parse_args(argv)
+    args.fuse_args = fuse_args
+
+    try:
+        if args.command == "produce":
+            sys.exit(produce(args))
+        sys.exit(run(args))
+    except KeyboardInterrupt:
+        print(f"\n{COLOR_YELLOW}[INTERRUPTED]{COLOR_RESET} Load test cancelled")
+        sys.exit(130)
+
+
+if __name__ == "__main__":
+    main()
@@ -86,6 +86,7 @@ class Reader:
     def __init__(self):
         self.columns = None
         self.lines = 0
+        self.last_thermo = {}
 
     def __timestamp_to_seconds(self, ts: str) -> float:
         # Format: YEAR-MONTH-DAYTHOUR:MINUTE:SECOND.MICROSECOND
@@ -112,6 +113,11 @@ class Reader:
 
         thermo = data["THERMOCOUPLE"]
         for pos, data in thermo.items():
+            # Within its deadband a source only says it is unchanged
+            if data.get("UNCHANGED"):
+                data = self.last_thermo.get(pos, {})
+            else:
+                self.last_thermo[pos] = data
             for key, value in data.items():
                 row[f"THERMO_{pos}_{key}"] = value
 
@@ -227,7 +233,8 @@ class Device:
             has_checked = True
             
             data = [e.value for e in history]
-            filtered = gaussian_filter1d(data, sigma=self.steady_sigma)
+            # Without a sigma the data is used as streamed (filter it in the thermo-cli config)
+            filtered = gaussian_filter1d(data, sigma=self.steady_sigma) if self.steady_sigma else np.asarray(data)
             std = np.std(filtered)
             print(f"Steady check for {key}: std = {std:.4f} °C over last {last_entry.time - first_entry.time:.2f} seconds", end="")
 
@@ -326,8 +333,8 @@ def run_experiment(
         motor_activated = False
 
         for i, row in reader.read():
-            # Check abnormal temperatures (negative values)
-            if any(row[key] < 0.0 for key in KEYS_TO_CHECK_THRESHOLD):
+            # Skip faulted readings (thermo-cli reports them as null with a STATUS)
+            if any(row.get(key) is None for key in KEYS_TO_CHECK_THRESHOLD):
                 continue
             
             if i == 0:
@@ -417,7 +424,7 @@ def main(
         None, help="Time window to check for steadiness in seconds"
     ),
     steady_sigma: Optional[float] = typer.Option(
-        None, help="Sigma for Gaussian smoothing when checking for steadiness"
+        None, help="Sigma for Gaussian smoothing when checking for steadiness (omit if the sources are filtered by thermo-cli)"
     ),
     steady_threshold: Optional[float] = typer.Option(
         None, help="Maximum allowed variation in temperature for steadiness (°C)"
@@ -0,0 +1,391 @@
+/*
+ * Hot-path microbenchmarks (make bench).
+ * Each case is calibrated so one repetition runs for a fixed time, then
+ * timed over several repetitions; the median ns/op is reported with the
+ * interquartile spread across repetitions so a noisy run is visible. Allocations are
+ * counted by interposing malloc/calloc/realloc (glibc), which includes
+ * those made inside libc and libyaml. No board is needed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "utils.h"
+#include "json_utils.h"
+#include "bridge.h"
+#include "cJSON.h"
+
+#define BENCH_DEFAULT_REPS 9
+#define BENCH_DEFAULT_REP_MS 50
+#define BENCH_MAX_REPS 101
+#define BENCH_SOURCES 8             /* Readings per record */
+#define BENCH_CONFIG_SOURCES 32     /* Every channel of 8 boards */
+#define BENCH_MAX_LINES 256
+
+/* ============================================================================
+ * Allocation counting
+ * ============================================================================ */
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static uint64_t g_allocs = 0;
+
+void *malloc(size_t size) {
+    g_allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    g_allocs++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    g_allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+/* ============================================================================
+ * Fixtures
+ * ============================================================================ */
+
+/* Lines in the shape cmg-cli get --json prints; -l replaces them with a recording */
+static const char *DEFAULT_LINES[] = {
+    "{\"POWER\":{\"VOLTAGE\":27.982,\"CURRENT\":1.204,\"POWER\":33.69},\"STATUS\":\"OK\"}",
+    "{\"ACTUATOR\":{\"GIMBAL_RATE\":[0.0012,-0.0031,0.0004],\"WHEEL_SPEED\":[1502.5,1498.0,1500.2,1499.9],"
+        "\"MOTOR_CURRENT\":[0.412,0.398,0.405,0.401]},\"MODE\":\"TRACK\",\"SEQ\":104233}",
+    "{\"POWER\":{\"VOLTAGE\":27.978,\"CURRENT\":1.211,\"POWER\":33.88},\"STATUS\":\"OK\",\"FAULTS\":[]}",
+};
+
+static ThermalSource g_sources[BENCH_SOURCES];
+static ChannelReading g_readings[BENCH_SOURCES];
+static cJSON *g_thermal_data = NULL;
+static char *g_lines[BENCH_MAX_LINES];
+static int g_line_count = 0;
+static char g_yaml_path[64] = "";
+static char g_json_path[64] = "";
+
+static void fixtures_init_sources(void) {
+    for (int i = 0; i < BENCH_SOURCES; i++) {
+        ThermalSource *src = &g_sources[i];
+        memset(src, 0, sizeof(*src));
+        snprintf(src->key, sizeof(src->key), "THERMOCOUPLE_%d", i);
+        src->address = (uint8_t)(i / MCC134_NUM_CHANNELS);
+        src->channel = (uint8_t)(i % MCC134_NUM_CHANNELS);
+        strcpy(src->tc_type, "K");
+        src->cal_coeffs.slope = DEFAULT_CALIBRATION_SLOPE;
+        src->cal_coeffs.offset = DEFAULT_CALIBRATION_OFFSET;
+        src->update_interval = DEFAULT_UPDATE_INTERVAL;
+    
+        ChannelReading *r = &g_readings[i];
+        channel_reading_init(r, src->address, src->channel);
+        r->temperature = 21.5 + i * 3.217;
+        r->adc_voltage = 0.000861 + i * 0.000129;
+        r->cjc_temp = 23.5;
+        r->status = READING_OK;
+        r->has_temp = 1;
+        r->has_adc = 1;
+        r->has_cjc = 1;
+    }
+    
+    /* What get_thermal_data() hands to the injector for three sources */
+    g_thermal_data = cJSON_CreateObject();
+    for (int i = 0; i < 3; i++) {
+        cJSON *source_data = cJSON_CreateObject();
+        cJSON_AddNumberToObject(source_data, "TEMP", g_readings[i].temperature);
+        cJSON_AddStringToObject(source_data, "STATUS", "OK");
+        cJSON_AddNumberToObject(source_data, "ADC", g_readings[i].adc_voltage);
+        cJSON_AddNumberToObject(source_data, "CJC", g_readings[i].cjc_temp);
+        cJSON_AddItemToObject(g_thermal_data, g_sources[i].key, source_data);
+    }
+}
+
+static int fixtures_load_lines(const char *path) {
+    if (!path) {
+        for (int i = 0; i < (int)(sizeof(DEFAULT_LINES) / sizeof(DEFAULT_LINES[0])); i++) {
+            g_lines[g_line_count++] = strdup(DEFAULT_LINES[i]);
+        }
+        return THERMO_SUCCESS;
+    }
+    
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open %s\n", path);
+        return THERMO_IO_ERROR;
+    }
+    char line[4096];
+    while (g_line_count < BENCH_MAX_LINES && fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '{') {
+            g_lines[g_line_count++] = strdup(line);
+        }
+    }
+    fclose(fp);
+    
+    if (g_line_count == 0) {
+        fprintf(stderr, "Error: No JSON lines in %s\n", path);
+        return THERMO_INVALID_PARAM;
+    }
+    return THERMO_SUCCESS;
+}
+
+/* A full 8-board config, once as YAML and once as JSON (config_load picks
+ * the parser by extension) */
+static int fixtures_write_configs(void) {
+    strcpy(g_yaml_path, "/tmp/thermo-bench-XXXXXX.yaml");
+    strcpy(g_json_path, "/tmp/thermo-bench-XXXXXX.json");
+    int yaml_fd = mkstemps(g_yaml_path, 5);
+    int json_fd = mkstemps(g_json_path, 5);
+    FILE *yaml = yaml_fd == -1 ? NULL : fdopen(yaml_fd, "w");
+    FILE *json = json_fd == -1 ? NULL : fdopen(json_fd, "w");
+    if (!yaml || !json) {
+        fprintf(stderr, "Error: Cannot create config fixtures in /tmp\n");
+        return THERMO_IO_ERROR;
+    }
+    
+    fprintf(yaml, "# Benchmark fixture\nsources:\n");
+    fprintf(json, "{\n  \"sources\": [\n");
+    for (int i = 0; i < BENCH_CONFIG_SOURCES; i++) {
+        int address = i / MCC134_NUM_CHANNELS;
+        int channel = i % MCC134_NUM_CHANNELS;
+        fprintf(yaml, "- key: PROBE_%02d\n  address: %d\n  channel: %d\n  tc_type: %c\n"
+                      "  cal_slope: 1.000412\n  cal_offset: %.3f\n  update_interval: 1\n"
+                      "  filter: median:5,ema:0.2\n  deadband: 0.1/60\n",
+                i, address, channel, "JKT"[i % 3], -12.5 + i);
+        fprintf(json, "    {\"key\": \"PROBE_%02d\", \"address\": %d, \"channel\": %d, \"tc_type\": \"%c\", "
+                      "\"cal_slope\": 1.000412, \"cal_offset\": %.3f, \"update_interval\": 1, "
+                      "\"filter\": \"median:5,ema:0.2\", \"deadband\": \"0.1/60\"}%s\n",
+                i, address, channel, "JKT"[i % 3], -12.5 + i, i + 1 < BENCH_CONFIG_SOURCES ? "," : "");
+    }
+    fprintf(json, "  ]\n}\n");
+    fclose(yaml);
+    fclose(json);
+    return THERMO_SUCCESS;
+}
+
+static void fixtures_free(void) {
+    if (g_yaml_path[0]) unlink(g_yaml_path);
+    if (g_json_path[0]) unlink(g_json_path);
+    for (int i = 0; i < g_line_count; i++) {
+        free(g_lines[i]);
+    }
+    cJSON_Delete(g_thermal_data);
+}
+
+/* ============================================================================
+ * Cases (one operation per call)
+ * ============================================================================ */
+
+static volatile size_t g_sink;  /* Keeps results observable */
+
+/* get --stream -j: build the record and serialize it */
+static void bench_json_record(uint64_t i) {
+    (void)i;
+    cJSON *root = readings_to_json_array(g_readings, NULL, g_sources, BENCH_SOURCES, 0, 0, 0, 0);
+    char *str = cJSON_PrintUnformatted(root);
+    g_sink += strlen(str);
+    free(str);
+    cJSON_Delete(root);
+}
+
+static void bench_format_timestamp(uint64_t i) {
+    char buf[64];
+    struct timeval tv = {.tv_sec = 1768487445 + (time_t)(i & 1023), .tv_usec = (suseconds_t)(i % 1000000)};
+    bridge_format_timestamp(buf, sizeof(buf), &tv, "%Y-%m-%dT%H:%M:%S.%f");
+    g_sink += (size_t)buf[18];
+}
+
+/* fuse: parse a producer line, inject thermal data, serialize */
+static void bench_fuse_line(uint64_t i) {
+    struct timeval tv = {.tv_sec = 1768487445, .tv_usec = (suseconds_t)(i % 1000000)};
+    cJSON *json = cJSON_Parse(g_lines[i % g_line_count]);
+    bridge_inject_json(json, g_thermal_data, &tv, "%Y-%m-%dT%H:%M:%S.%f");
+    char *str = cJSON_PrintUnformatted(json);
+    g_sink += strlen(str);
+    free(str);
+    cJSON_Delete(json);
+}
+
+/* A fixture that fails to load would time the error path instead */
+static void bench_config_load(const char *path) {
+    Config config = {0};
+    if (config_load(path, &config) != THERMO_SUCCESS || config.source_count != BENCH_CONFIG_SOURCES) {
+        fprintf(stderr, "Error: Config fixture %s does not load\n", path);
+        fixtures_free();
+        exit(1);
+    }
+    g_sink += (size_t)config.source_count;
+    config_free(&config);
+}
+
+static void bench_config_yaml(uint64_t i) {
+    (void)i;
+    bench_config_load(g_yaml_path);
+}
+
+static void bench_config_json(uint64_t i) {
+    (void)i;
+    bench_config_load(g_json_path);
+}
+
+/* get --stream table output for every source (stdout goes to /dev/null) */
+static void bench_table(uint64_t i) {
+    (void)i;
+    int key_width = 0, value_width = 0, unit_width = 0;
+    reading_format_calculate_max_width(g_readings, NULL, g_sources, BENCH_SOURCES,
+                                       &key_width, &value_width, &unit_width);
+    for (int s = 0; s < BENCH_SOURCES; s++) {
+        printf("%s (Address: %d, Channel: %d):\n", g_sources[s].key,
+               g_readings[s].address, g_readings[s].channel);
+        reading_format_output(&g_readings[s], NULL, &g_sources[s], 4, key_width, value_width, unit_width,
+                              0, 0, 0, 0);
+    }
+    printf("----------------------------------------\n");
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(uint64_t i);
+    int quiet_stdout;           /* Case prints; send stdout to /dev/null while timing */
+} BenchCase;
+
+static const BenchCase CASES[] = {
+    {"json_record",      bench_json_record,      0},
+    {"format_timestamp", bench_format_timestamp, 0},
+    {"fuse_line",        bench_fuse_line,        0},
+    {"config_load_yaml", bench_config_yaml,      0},
+    {"config_load_json", bench_config_json,      0},
+    {"table_output",     bench_table,            1},
+};
+
+/* ============================================================================
+ * Runner
+ * ============================================================================ */
+
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t bench_time(const BenchCase *c, uint64_t ops) {
+    uint64_t start = bench_now_ns();
+    for (uint64_t i = 0; i < ops; i++) {
+        c->run(i);
+    }
+    return bench_now_ns() - start;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_case(const BenchCase *c, int reps, uint64_t rep_ns) {
+    int saved_stdout = -1;
+    if (c->quiet_stdout) {
+        fflush(stdout);
+        saved_stdout = dup(STDOUT_FILENO);
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        close(devnull);
+    }
+    
+    /* Calibrate (and warm up): grow ops until one repetition takes rep_ns */
+    uint64_t ops = 1;
+    for (;;) {
+        uint64_t elapsed = bench_time(c, ops);
+        if (elapsed >= rep_ns / 4 || ops >= (1ull << 32)) {
+            ops = elapsed > 0 ? (uint64_t)((double)ops * (double)rep_ns / (double)elapsed) : ops * 2;
+            if (ops < 1) ops = 1;
+            break;
+        }
+        ops *= 2;
+    }
+    
+    double ns_per_op[BENCH_MAX_REPS];
+    uint64_t allocs_before = g_allocs;
+    for (int r = 0; r < reps; r++) {
+        ns_per_op[r] = (double)bench_time(c, ops) / (double)ops;
+    }
+    double allocs_per_op = (double)(g_allocs - allocs_before) / ((double)ops * reps);
+    
+    if (c->quiet_stdout) {
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+    }
+    
+    qsort(ns_per_op, reps, sizeof(double), compare_double);
+    double median = ns_per_op[reps / 2];
+    double iqr = ns_per_op[(reps * 3) / 4] - ns_per_op[reps / 4];
+    double spread = median > 0 ? iqr / median * 100.0 : 0;
+    printf("%-18s %12.1f %12.1f %8.1f%% %10.2f %12llu\n", c->name, median, ns_per_op[0], spread,
+           allocs_per_op, (unsigned long long)ops);
+    fflush(stdout);
+}
+
+static void bench_usage(void) {
+    fprintf(stderr, "Usage: thermo-bench [OPTIONS] [FILTER]\n\n");
+    fprintf(stderr, "Runs the cases whose name contains FILTER (all by default).\n\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -r, --reps N         Timed repetitions per case [default: %d]\n", BENCH_DEFAULT_REPS);
+    fprintf(stderr, "  -t, --time MS        Duration of one repetition [default: %d]\n", BENCH_DEFAULT_REP_MS);
+    fprintf(stderr, "  -l, --lines FILE     Producer NDJSON for fuse_line (e.g. a cmg-cli recording)\n");
+    fprintf(stderr, "  -h, --help           Show this help\n");
+}
+
+int main(int argc, char **argv) {
+    int reps = BENCH_DEFAULT_REPS;
+    int rep_ms = BENCH_DEFAULT_REP_MS;
+    const char *lines_path = NULL;
+    
+    static struct option long_options[] = {
+        {"reps", required_argument, 0, 'r'},
+        {"time", required_argument, 0, 't'},
+        {"lines", required_argument, 0, 'l'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    
+    int opt;
+    while ((opt = getopt_long(argc, argv, "r:t:l:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'r': reps = atoi(optarg); break;
+            case 't': rep_ms = atoi(optarg); break;
+            case 'l': lines_path = optarg; break;
+            case 'h': bench_usage(); return 0;
+            default: bench_usage(); return 1;
+        }
+    }
+    const char *filter = optind < argc ? argv[optind] : NULL;
+    
+    if (reps < 1 || reps > BENCH_MAX_REPS || rep_ms < 1) {
+        fprintf(stderr, "Error: --reps must be 1-%d and --time at least 1 ms\n", BENCH_MAX_REPS);
+        return 1;
+    }
+    
+    fixtures_init_sources();
+    if (fixtures_load_lines(lines_path) != THERMO_SUCCESS || fixtures_write_configs() != THERMO_SUCCESS) {
+        fixtures_free();
+        return 1;
+    }
+    
+    printf("%-18s %12s %12s %9s %10s %12s\n", "case", "ns/op", "min ns/op", "iqr", "allocs/op", "ops/rep");
+    for (int i = 0; i < (int)(sizeof(CASES) / sizeof(CASES[0])); i++) {
+        if (filter && !strstr(CASES[i].name, filter)) continue;
+        bench_case(&CASES[i], reps, (uint64_t)rep_ms * 1000000ull);
+    }
+    
+    fixtures_free();
+    return 0;
+}
@@ -8,24 +8,95 @@
 
 #include "common.h"
 #include "hardware.h"
+#include "inventory.h"
 
 #define MAX_BOARDS 8
 
+/* A channel faulting this many ticks in a row is read less often: after
+ * each failed probe the skipped ticks double, up to FAULT_BACKOFF_MAX_TICKS.
+ * A tick is one record, however many samples it is oversampled from. */
+#define FAULT_BACKOFF_AFTER 3
+#define FAULT_BACKOFF_MAX_TICKS 64
+
+/* Readiness polling after TC types change: a board is given its update
+ * interval plus this margin to deliver a fresh conversion */
+#define BOARD_READY_POLL_US 5000
+#define BOARD_READY_MARGIN_US 250000
+
+/* Fault history of one channel */
+typedef struct {
+    uint8_t status;         /* ReadingStatus of the last read */
+    uint8_t due;            /* Read this tick (set by board_manager_read_cjc) */
+    uint8_t reported;       /* Read this tick: status is counted at the next one */
+    uint16_t fault_streak;  /* Consecutive faulted ticks */
+    uint16_t backoff;       /* Ticks skipped after the last failed probe (0 = healthy) */
+    uint16_t skip;          /* Ticks left before the next probe */
+} ChannelHealth;
+
 typedef struct {
+    Inventory inventory;          /* Boards present; cached serials and calibration dates */
     uint8_t opened[MAX_BOARDS];   /* Track which boards are open */
     ThermalSource *sources;       /* Reference to sources (not owned) */
     int source_count;
+    
+    /* Channels on one board share its CJC sensors, so CJC is read once per
+     * board per acquisition tick and fanned out to that board's channels */
+    uint8_t cjc_channel[MAX_BOARDS];  /* Lowest configured channel, read for the board */
+    uint8_t cjc_due[MAX_BOARDS];      /* Board has a channel due this tick */
+    uint8_t cjc_valid[MAX_BOARDS];    /* Set by board_manager_read_cjc for this tick */
+    double cjc[MAX_BOARDS];
+    
+    /* A channel whose TC type was just changed has no valid conversion until
+     * the board's next update; board_manager_wait_ready() waits for it */
+    uint8_t settling[MAX_BOARDS];         /* Bitmask of changed channels per board */
+    
+    /* Persistently faulted channels are only probed now and then, so an open
+     * thermocouple stops costing bus time every tick */
+    ChannelHealth health[MAX_BOARDS][MCC134_NUM_CHANNELS];
 } BoardManager;
 
-/* Initialize manager and open all required boards for the given sources */
+/* Initialize manager, check the sources against the board inventory and open
+ * all required boards */
 int board_manager_init(BoardManager *mgr, ThermalSource *sources, int source_count);
 
+/* Initialize manager and check the sources without opening any board (for
+ * static info the inventory already holds) */
+int board_manager_init_static(BoardManager *mgr, ThermalSource *sources, int source_count);
+
 /* Apply calibration coefficients and TC type settings for all sources */
 int board_manager_configure(BoardManager *mgr);
 
 /* Apply only TC type settings (useful when calibration already set) */
 int board_manager_set_tc_types(BoardManager *mgr);
 
+/* Wait until every board whose TC types changed has converted with the new
+ * settings. All boards are polled together, so this takes as long as the
+ * slowest board, bounded by its update interval plus BOARD_READY_MARGIN_US.
+ * Returns THERMO_ERROR if a board timed out (a warning names it). */
+int board_manager_wait_ready(BoardManager *mgr);
+
+/* Start an acquisition tick: count the last tick's outcomes toward the
+ * fault backoff, decide which channels are due and read CJC once for every
+ * open board with a channel due */
+int board_manager_read_cjc(BoardManager *mgr);
+
+/* Read CJC again for the same boards, for a further sample of the tick
+ * (oversampling); which channels are due doesn't change */
+int board_manager_reread_cjc(BoardManager *mgr);
+
+/* CJC read for a board this tick (THERMO_NOT_FOUND if not read or failed) */
+int board_manager_get_cjc(const BoardManager *mgr, uint8_t address, double *cjc);
+
+/* Whether a channel should be read this tick (0 while it is backed off) */
+int board_manager_read_due(const BoardManager *mgr, uint8_t address, uint8_t channel);
+
+/* Record the outcome of a temperature read; the tick's last one enters or
+ * leaves backoff when the next tick starts */
+void board_manager_report(BoardManager *mgr, uint8_t address, uint8_t channel, ReadingStatus status);
+
+/* Status of a channel's last read */
+ReadingStatus board_manager_status(const BoardManager *mgr, uint8_t address, uint8_t channel);
+
 /* Close all open boards */
 void board_manager_close(BoardManager *mgr);
 
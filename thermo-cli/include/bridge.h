@@ -6,14 +6,48 @@
 #ifndef BRIDGE_H
 #define BRIDGE_H
 
+#include <sys/time.h>
+
+#include "cJSON.h"
 #include "common.h"
+#include "output_queue.h"
+#include "sink.h"
+
+/* Default producer command (arguments after '--' are appended) */
+#define BRIDGE_DEFAULT_COMMAND "cmg-cli get"
+
+/* Bridge options (from CLI) */
+typedef struct {
+    const char *time_format;    /* Timestamp format, %f = microseconds */
+    int use_pty;                /* Run producer on a pseudo-terminal so it line-buffers */
+    const char *input_path;     /* Read existing stream: "-" = stdin, FIFO or Unix socket (NULL = spawn producer) */
+    OutputPolicy output_policy; /* Behaviour when stdout cannot keep up */
+    int queue_depth;            /* Records buffered between acquisition and writer */
+    const SinkSpec *sinks;      /* Output destinations (copied) */
+    int sink_count;
+} BridgeOptions;
 
 /* Opaque bridge structure */
 typedef struct FuseBridge FuseBridge;
 
-/* Bridge functions */
-FuseBridge* bridge_create(ThermalSource *sources, int source_count, char **args, int arg_count, const char *time_format);
+/* Bridge functions (argv/argc ignored when opts->input_path is set) */
+FuseBridge* bridge_create(ThermalSource *sources, int source_count, char **argv, int argc,
+                          const BridgeOptions *opts);
 int bridge_run(FuseBridge *bridge);
 void bridge_free(FuseBridge *bridge);
 
+/* Per-line steps of the fuse path (public for replay and the benchmarks) */
+void bridge_format_timestamp(char *buf, size_t buf_size, const struct timeval *tv, const char *format);
+void bridge_inject_json(cJSON *json_obj, cJSON *thermal_data, const struct timeval *tv, const char *time_format);
+
+/* Filter one source's reading, apply its deadband and add its entry to a
+ * THERMOCOUPLE object (ADC/CJC are null without has_voltage) */
+void bridge_add_source(cJSON *data, const ThermalSource *src, SourceFilter *filter,
+                       DeadbandState *deadband, double temp, int has_voltage,
+                       double adc, double cjc, int64_t now_us);
+
+/* Inverse of bridge_format_timestamp(). Fields the format lacks (e.g. the
+ * date of "%H:%M:%S.%f") are kept from *tv on input. */
+int bridge_parse_timestamp(const char *str, const char *format, struct timeval *tv);
+
 #endif /* BRIDGE_H */
@@ -0,0 +1,11 @@
+/*
+ * Calibrate command header.
+ * Fits calibration coefficients from reference temperatures.
+ */
+
+#ifndef COMMANDS_CALIBRATE_H
+#define COMMANDS_CALIBRATE_H
+
+int cmd_calibrate(int argc, char **argv);
+
+#endif /* COMMANDS_CALIBRATE_H */
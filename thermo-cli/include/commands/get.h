@@ -7,6 +7,7 @@
 #define COMMANDS_GET_H
 
 #include "common.h"
+#include "board_manager.h"
 
 int cmd_get(int argc, char **argv);
 
@@ -14,12 +15,16 @@ int cmd_get(int argc, char **argv);
  * NEW API using ChannelReading and BoardInfo
  * ============================================================================ */
 
-/* Collect dynamic readings from a channel (board must be open, TC type set) */
-int channel_reading_collect(ChannelReading *reading, uint8_t address, uint8_t channel,
+/* Collect dynamic readings from a channel (board must be open, TC type set).
+ * mgr may be NULL; otherwise the board CJC cached by board_manager_read_cjc() is used
+ * and the channel's fault backoff applies. */
+int channel_reading_collect(ChannelReading *reading, BoardManager *mgr,
+                           uint8_t address, uint8_t channel, uint8_t tc_type,
                            int get_temp, int get_adc, int get_cjc);
 
-/* Collect board info (board must be open) */
-int board_info_collect(BoardInfo *info, uint8_t address, uint8_t channel,
+/* Collect board info (board must be open for coefficients and interval).
+ * With inv, serial and calibration date come from the inventory cache. */
+int board_info_collect(BoardInfo *info, Inventory *inv, uint8_t address, uint8_t channel,
                       int get_serial, int get_cal_date, int get_cal_coeffs, int get_interval);
 
 #endif /* COMMANDS_GET_H */
@@ -0,0 +1,11 @@
+/*
+ * Linearize command header.
+ * Recomputes temperatures from recorded ADC voltage and CJC columns.
+ */
+
+#ifndef COMMANDS_LINEARIZE_H
+#define COMMANDS_LINEARIZE_H
+
+int cmd_linearize(int argc, char **argv);
+
+#endif /* COMMANDS_LINEARIZE_H */
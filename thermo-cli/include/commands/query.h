@@ -0,0 +1,12 @@
+/*
+ * Query command header.
+ * Aggregates the recorded values in a time range, per interval, reading
+ * only the chunks the recordings' time index places in that range.
+ */
+
+#ifndef COMMANDS_QUERY_H
+#define COMMANDS_QUERY_H
+
+int cmd_query(int argc, char **argv);
+
+#endif /* COMMANDS_QUERY_H */
@@ -0,0 +1,12 @@
+/*
+ * Replay command header.
+ * Feeds recorded thermal streams (and optionally a recorded cmg-cli stream)
+ * through the filter, fusion and output stages at a chosen speed.
+ */
+
+#ifndef COMMANDS_REPLAY_H
+#define COMMANDS_REPLAY_H
+
+int cmd_replay(int argc, char **argv);
+
+#endif /* COMMANDS_REPLAY_H */
@@ -8,6 +8,8 @@
 
 #include <stdint.h>
 #include "hardware.h"
+#include "filter.h"
+#include "deadband.h"
 
 
 #define DEFAULT_CALIBRATION_SLOPE 0.999560
@@ -43,11 +45,13 @@ typedef struct {
     double temperature;
     double adc_voltage;
     double cjc_temp;
+    uint8_t status;             /* ReadingStatus of temperature (faults keep their sentinel value) */
     
     /* Availability flags (bitfields for compact storage) */
     unsigned has_temp : 1;
     unsigned has_adc : 1;
     unsigned has_cjc : 1;
+    unsigned unchanged : 1;     /* Within its deadband: values left out of the record */
 } ChannelReading;
 
 /* ============================================================================
@@ -59,9 +63,11 @@ typedef struct {
     char key[64];
     uint8_t address;
     uint8_t channel;
-    char tc_type[8];
+    char tc_type[16];
     CalibrationInfo cal_coeffs;
     int update_interval;
+    FilterSpec filter;          /* Applied per output period (empty = period mean) */
+    DeadbandSpec deadband;      /* Change-only emission after the filter (disabled = every period) */
 } ThermalSource;
 
 /* Configuration structure */
@@ -101,6 +107,9 @@ typedef struct {
 /* Initialize a ChannelReading structure */
 void channel_reading_init(ChannelReading *reading, uint8_t address, uint8_t channel);
 
+/* Value a source's deadband follows: its temperature, else its ADC voltage, else its CJC */
+ReadingStatus channel_reading_deadband_input(const ChannelReading *reading, double *value);
+
 /* Initialize a BoardInfo structure */
 void board_info_init(BoardInfo *info, uint8_t address);
 
@@ -118,4 +127,9 @@ int config_load(const char *path, Config *config);
 void config_free(Config *config);
 int config_create_example(const char *output_path);
 
+/* Rewrite cal_slope/cal_offset of the sources matching each update's key
+ * (YAML is edited line by line so comments and layout survive). Returns
+ * THERMO_NOT_FOUND if a key is not in the file; nothing is written then. */
+int config_update_calibration(const char *path, const ThermalSource *updates, int count);
+
 #endif /* COMMON_H */
@@ -0,0 +1,43 @@
+/*
+ * Per-source deadband (change-only emission) header.
+ * A source's value is emitted only when it moves by more than its band
+ * since the last emitted value, when its fault status changes, or when it
+ * has been silent for the heartbeat interval. Records mark the sources they
+ * skip as unchanged.
+ */
+
+#ifndef DEADBAND_H
+#define DEADBAND_H
+
+#include <stdint.h>
+
+#include "hardware.h"
+
+#define DEADBAND_DEFAULT_HEARTBEAT_S 60.0
+
+/* Parsed from "BAND[%][/HEARTBEAT]": an absolute band in the value's unit
+ * (0.1) or relative to the last emitted value (0.5%), and the longest
+ * silence in seconds (0 = none). An empty string or "none" disables it. */
+typedef struct {
+    int enabled;
+    int relative;               /* band is a fraction of |last| */
+    double band;
+    double heartbeat_s;
+} DeadbandSpec;
+
+/* Zero-initialized state emits the first value */
+typedef struct {
+    double last;                /* Last emitted value */
+    ReadingStatus last_status;
+    int64_t last_emit_us;
+    int has_last;
+} DeadbandState;
+
+int deadband_spec_parse(const char *str, DeadbandSpec *spec);
+
+/* Whether this value should be emitted; records it as the last emitted if so.
+ * Always true for a disabled spec. */
+int deadband_update(DeadbandState *state, const DeadbandSpec *spec, double value,
+                    ReadingStatus status, int64_t now_us);
+
+#endif /* DEADBAND_H */
@@ -0,0 +1,79 @@
+/*
+ * Per-source filter stage header.
+ * Smooths and decimates oversampled temperature readings so each output
+ * record carries one cleaned value: boxcar average, exponential (EMA),
+ * median-of-N spike rejection and CIC-style decimation.
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdint.h>
+
+#define FILTER_MAX_STAGES 4
+#define FILTER_MAX_WINDOW 64
+#define FILTER_MAX_CIC_ORDER 4
+#define FILTER_MAX_OVERSAMPLE 256   /* Keeps CIC gain (R^order) within 64-bit integers */
+
+typedef enum {
+    FILTER_BOXCAR,      /* Moving average over the last N samples */
+    FILTER_EMA,         /* y += alpha * (x - y) */
+    FILTER_MEDIAN,      /* Median of the last N samples */
+    FILTER_CIC          /* Integrator/comb decimator over each output period (last stage only) */
+} FilterKind;
+
+typedef struct {
+    FilterKind kind;
+    int window;         /* boxcar/median: samples; cic: order */
+    double alpha;       /* ema: smoothing factor (0, 1] */
+} FilterStage;
+
+/* Filter chain, parsed from "STAGE[,STAGE...]" where STAGE is
+ * boxcar:N, ema:ALPHA, median:N or cic[:ORDER]. An empty chain averages
+ * the samples of each output period. */
+typedef struct {
+    FilterStage stages[FILTER_MAX_STAGES];
+    int count;
+} FilterSpec;
+
+typedef struct {
+    double ring[FILTER_MAX_WINDOW];
+    int head;
+    int filled;
+    double sum;                 /* boxcar running sum */
+    double ema;
+    int ema_ready;
+    uint64_t integrators[FILTER_MAX_CIC_ORDER];  /* cic: fixed point, wrap-around arithmetic */
+    uint64_t combs[FILTER_MAX_CIC_ORDER];
+    double cic_sum;             /* cic: inputs this period (output until primed) */
+    int cic_count;
+    int cic_last_count;
+    int cic_primed;             /* Periods with a steady count; combs need order of them */
+} FilterStageState;
+
+/* Running filter for one source */
+typedef struct {
+    FilterSpec spec;
+    FilterStageState states[FILTER_MAX_STAGES];
+    double value;               /* Output of the chain after the last valid sample */
+    double period_sum;          /* Valid samples in the current output period */
+    int period_valid;
+    int period_samples;
+    double last_fault;          /* Last fault code / NaN seen in the period */
+    double hold;                /* Last valid input, substituted for faults in CIC periods */
+    int has_hold;
+} SourceFilter;
+
+/* Parse a filter chain; an empty string or "none" gives the empty chain */
+int filter_spec_parse(const char *str, FilterSpec *spec);
+
+void source_filter_init(SourceFilter *filter, const FilterSpec *spec);
+
+/* Feed one sample at the internal rate; fault codes and NaN are not filtered */
+void source_filter_push(SourceFilter *filter, double sample);
+
+/* Close the output period and return its value (the period's last fault if it had
+ * no valid samples) */
+double source_filter_emit(SourceFilter *filter);
+
+#endif /* FILTER_H */
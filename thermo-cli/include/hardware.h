@@ -17,6 +17,9 @@
 #define THERMO_NOT_FOUND -3
 #define THERMO_IO_ERROR -4
 
+/* HAT addresses 0-7 */
+#define THERMO_MAX_ADDRESSES 8
+
 /* Thermocouple type constants */
 #define TC_TYPE_J 0
 #define TC_TYPE_K 1
@@ -33,6 +36,22 @@
 #define OVERRANGE_TC_VALUE (-8888.0)
 #define COMMON_MODE_TC_VALUE (-7777.0)
 
+/* Classification of a temperature reading */
+typedef enum {
+    READING_OK,
+    READING_OPEN,           /* OPEN_TC_VALUE: thermocouple disconnected */
+    READING_OVERRANGE,      /* OVERRANGE_TC_VALUE: outside the type's range */
+    READING_COMMON_MODE,    /* COMMON_MODE_TC_VALUE: input outside common-mode range */
+    READING_READ_ERROR      /* Library call failed (value is NaN) */
+} ReadingStatus;
+
+/* MCC 134 input range (V); readings at the rails are faults, not temperatures */
+#define MCC134_FULL_SCALE_V 0.078125
+
+/* One ADC count (V). Calibration is applied to raw counts as
+ * count * slope + offset, so the offset is in counts, not volts. */
+#define MCC134_LSB_V (MCC134_FULL_SCALE_V / 8388608.0)
+
 /* Calibration info structure */
 typedef struct {
     double slope;
@@ -53,12 +72,23 @@ int thermo_set_calibration_coeffs(uint8_t address, uint8_t channel, double slope
 int thermo_get_update_interval(uint8_t address, uint8_t *interval);
 int thermo_set_update_interval(uint8_t address, uint8_t interval);
 int thermo_set_tc_type(uint8_t address, uint8_t channel, const char *tc_type_str);
+int thermo_get_tc_type(uint8_t address, uint8_t channel, uint8_t *tc_type);
 uint8_t thermo_tc_type_from_string(const char *tc_type_str);
+const char* thermo_tc_type_to_string(uint8_t tc_type);
 
 /* Reading functions (board must be open, tc_type must be set for temp/adc) */
 int thermo_read_temp(uint8_t address, uint8_t channel, double *value);
 int thermo_read_adc(uint8_t address, uint8_t channel, double *value);
+int thermo_read_adc_raw(uint8_t address, uint8_t channel, double *value);  /* Uncalibrated */
 int thermo_read_cjc(uint8_t address, uint8_t channel, double *value);
-void thermo_wait_for_readings(void);
+int thermo_read_linearized(uint8_t address, uint8_t channel, uint8_t tc_type,
+                           double *temp, double *adc, double *cjc);
+int thermo_linearize_reading(uint8_t address, uint8_t channel, uint8_t tc_type, double cjc,
+                             double *temp, double *adc);
+
+/* Fault classification: sentinel values and NaN map to their status */
+ReadingStatus thermo_classify_temp(double temp);
+const char* thermo_status_name(ReadingStatus status);     /* "OK", "OPEN", ... */
+double thermo_status_value(ReadingStatus status);         /* Sentinel (NaN for read errors) */
 
 #endif /* HARDWARE_H */
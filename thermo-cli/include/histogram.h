@@ -0,0 +1,54 @@
+/*
+ * Log-linear histogram header.
+ * Fixed-size HDR-style histogram of unsigned values (nanoseconds in
+ * practice), shared by the latency statistics and the sample-period jitter
+ * analyzer. A histogram has a single writer; other threads may read it at
+ * any time and see a slightly stale but never torn snapshot.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define HISTOGRAM_SUB_BITS 6
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_LINEAR_LIMIT (2 * HISTOGRAM_SUB_COUNT)    /* Values below are their own bucket */
+#define HISTOGRAM_MAX_MSB 39                                /* Largest value kept: 2^40 - 1 */
+#define HISTOGRAM_BUCKET_COUNT (HISTOGRAM_LINEAR_LIMIT + \
+                                (HISTOGRAM_MAX_MSB - HISTOGRAM_SUB_BITS) * HISTOGRAM_SUB_COUNT)
+
+#define HISTOGRAM_MAX_PERCENTILES 8
+
+typedef struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum;
+    _Atomic uint64_t min;
+    _Atomic uint64_t max;
+    _Atomic uint32_t buckets[HISTOGRAM_BUCKET_COUNT];
+} Histogram;
+
+/* Snapshot of a histogram, in the recorded unit */
+typedef struct {
+    uint64_t count;
+    double min, mean, max;
+    double pct[HISTOGRAM_MAX_PERCENTILES];
+} HistogramSummary;
+
+/* Allocate an empty histogram (NULL on failure; release with free()) */
+Histogram* histogram_create(void);
+
+/* Add one value; only ever call from the histogram's one writer thread */
+void histogram_record(Histogram *hist, uint64_t value);
+
+/* Empty the histogram, from its writer thread (a concurrent reader may see
+ * it partly emptied) */
+void histogram_reset(Histogram *hist);
+
+/* Summarize with the given percentiles (0-100, ascending, at most
+ * HISTOGRAM_MAX_PERCENTILES). Returns 0 if the histogram is empty. */
+int histogram_summarize(const Histogram *hist, const double *percentiles, int count,
+                        HistogramSummary *sum);
+
+#endif /* HISTOGRAM_H */
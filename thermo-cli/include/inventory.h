@@ -0,0 +1,55 @@
+/*
+ * Board inventory cache.
+ * Persists what hat_list() and the boards' EEPROMs report (address, product,
+ * serial, calibration date) so list, get --serial/--cali-date and config
+ * validation don't rescan or open boards on every run. The cache is checked
+ * against a cheap probe (stat of the daqhats EEPROM images) and rebuilt only
+ * when that changes.
+ */
+
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include <stdint.h>
+#include "common.h"
+
+#define INVENTORY_MAX_BOARDS 8
+#define INVENTORY_EEPROM_DIR "/etc/mcc/hats"     /* Written by daqhats_read_eeproms */
+#define INVENTORY_CACHE_NAME "thermo-cli/inventory.json"
+
+typedef struct {
+    uint8_t address;
+    uint16_t id;
+    uint16_t version;
+    char product_name[256];
+    char serial[16];            /* Empty until first read from the board */
+    char cal_date[16];
+    uint64_t probe;             /* Fingerprint of this address's EEPROM image */
+} InventoryBoard;
+
+typedef struct {
+    uint64_t probe;             /* Fingerprint of all addresses */
+    int count;
+    InventoryBoard boards[INVENTORY_MAX_BOARDS];
+    int scanned;                /* Rebuilt from hat_list() during this run */
+} Inventory;
+
+/* Load the cached inventory, rescanning if the probe no longer matches or
+ * refresh is set. Entries whose own EEPROM image is unchanged keep their
+ * serial and calibration date. Without the EEPROM directory there is nothing
+ * to validate against, so the cache is neither trusted nor written. */
+int inventory_load(Inventory *inv, int refresh);
+
+/* Board at an address, or NULL if none */
+InventoryBoard* inventory_find(Inventory *inv, uint8_t address);
+
+/* Serial / calibration date of a board, read from the board (opening it briefly
+ * if needed) only when not cached yet */
+int inventory_get_serial(Inventory *inv, uint8_t address, char *buffer, size_t len);
+int inventory_get_cal_date(Inventory *inv, uint8_t address, char *buffer, size_t len);
+
+/* Check that every source names a valid channel on a board that is present
+ * (a board missing from a cached inventory triggers one rescan) */
+int inventory_validate_sources(Inventory *inv, const ThermalSource *sources, int count);
+
+#endif /* INVENTORY_H */
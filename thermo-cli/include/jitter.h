@@ -0,0 +1,42 @@
+/*
+ * Sample-period jitter analyzer header.
+ * Records the actual interval between consecutive samples of a stream (each
+ * acquisition period of get --stream, each producer line of fuse) and
+ * reports how far it strays from the nominal period: min/mean/p50/p99/max,
+ * missed deadlines and a coarse histogram, as a JSON record on stderr every
+ * few seconds and a table on exit. Enabled at runtime with --jitter.
+ */
+
+#ifndef JITTER_H
+#define JITTER_H
+
+#include <stdio.h>
+
+#define JITTER_DEFAULT_INTERVAL_S 10.0
+
+/* An interval longer than this many nominal periods is a missed deadline */
+#define JITTER_MISSED_FACTOR 1.5
+
+extern volatile int g_jitter_enabled;
+
+/* Parse "--jitter[=SECONDS]"'s argument (NULL gives the default interval; 0 = exit summary only) */
+int jitter_parse_interval(const char *str, double *interval_s);
+
+/* Start recording. period_ns is the nominal sample period; 0 takes the
+ * median interval instead (a producer sets fuse's pace). */
+void jitter_enable(double interval_s, long period_ns);
+
+/* Mark the start of a sample now; only ever call from one thread */
+void jitter_mark_now(void);
+
+/* Write a JSON jitter record to stderr if the interval has passed */
+void jitter_report_due(void);
+
+/* Write the summary table */
+void jitter_print_summary(FILE *fp);
+
+static inline void jitter_mark(void) {
+    if (__builtin_expect(g_jitter_enabled, 0)) jitter_mark_now();
+}
+
+#endif /* JITTER_H */
@@ -0,0 +1,50 @@
+/*
+ * Metrics exporter header.
+ * Serves run health in Prometheus text format over HTTP on a Unix socket or
+ * a local TCP port, so a long run can be scraped without parsing the data
+ * stream. The acquisition loop, bridge pump and output writer update plain
+ * atomic counters; a server thread reads them per scrape.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+#include "common.h"
+#include "hardware.h"
+
+/* Process-wide counters */
+typedef enum {
+    METRIC_TICKS,               /* Acquisition periods (get --stream) */
+    METRIC_OVERRUNS,            /* Periods whose deadline had already passed */
+    METRIC_RECORDS_IN,          /* Producer lines read (fuse) */
+    METRIC_RECORDS_WRITTEN,     /* Records handed to the sinks */
+    METRIC_RECORDS_DROPPED,     /* Records dropped by the output policy */
+    METRIC_COUNTER_COUNT
+} MetricCounter;
+
+extern volatile int g_metrics_enabled;
+
+/* Start serving on "unix:PATH" or "tcp:[HOST:]PORT" (HOST defaults to
+ * 127.0.0.1). Per-source metrics are labelled from sources, which must
+ * outlive metrics_stop(). */
+int metrics_start(const char *endpoint, const ThermalSource *sources, int source_count);
+
+/* Stop the server thread and remove a Unix socket it created */
+void metrics_stop(void);
+
+void metrics_add_counter(MetricCounter counter, uint64_t n);
+
+/* A read of source index (status READING_OK updates its latest temperature) */
+void metrics_source_read(int index, double temp, ReadingStatus status);
+
+static inline void metrics_add(MetricCounter counter, uint64_t n) {
+    if (__builtin_expect(g_metrics_enabled, 0)) metrics_add_counter(counter, n);
+}
+
+static inline void metrics_sample(int index, double temp, ReadingStatus status) {
+    if (__builtin_expect(g_metrics_enabled, 0)) metrics_source_read(index, temp, status);
+}
+
+#endif /* METRICS_H */
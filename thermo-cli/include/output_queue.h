@@ -0,0 +1,48 @@
+/*
+ * Output queue header.
+ * Bounded queue between acquisition and a writer thread, so a slow or
+ * stalled stdout consumer never stalls acquisition.
+ */
+
+#ifndef OUTPUT_QUEUE_H
+#define OUTPUT_QUEUE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "cJSON.h"
+#include "sink.h"
+
+#define OUTPUT_QUEUE_DEFAULT_DEPTH 64
+
+/* What push does when the queue is full */
+typedef enum {
+    OUTPUT_POLICY_BLOCK,        /* Wait for the writer (acquisition stalls, nothing lost) */
+    OUTPUT_POLICY_DROP_OLDEST,  /* Evict the oldest pending record */
+    OUTPUT_POLICY_COALESCE      /* Collapse all pending records to the newest one */
+} OutputPolicy;
+
+/* Opaque queue structure */
+typedef struct OutputQueue OutputQueue;
+
+/* Parse "block", "drop-oldest" or "coalesce" */
+int output_policy_from_string(const char *str, OutputPolicy *policy);
+const char* output_policy_to_string(OutputPolicy policy);
+
+/* Create queue and start its writer thread (records are written to sinks, not owned) */
+OutputQueue* output_queue_create(int depth, OutputPolicy policy, SinkSet *sinks);
+
+/* Queue a JSON record captured at timestamp_us (wall clock); takes ownership of json */
+void output_queue_push_json(OutputQueue *queue, cJSON *json, int64_t timestamp_us);
+
+/* Queue a raw text line (without newline); the text is copied */
+void output_queue_push_line(OutputQueue *queue, const char *line);
+
+/* Counters (safe to call from any thread) */
+uint64_t output_queue_written(OutputQueue *queue);
+uint64_t output_queue_dropped(OutputQueue *queue);
+
+/* Drain pending records, stop the writer thread and free the queue */
+void output_queue_close(OutputQueue *queue);
+
+#endif /* OUTPUT_QUEUE_H */
@@ -0,0 +1,51 @@
+/*
+ * Real-time scheduling for the acquisition thread.
+ * Opt-in SCHED_FIFO priority, locked memory, CPU pinning and pre-faulted
+ * stack/heap, plus absolute-deadline pacing so the sampling period does not
+ * drift with the time spent reading.
+ */
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <time.h>
+
+#define REALTIME_DEFAULT_PRIORITY 80
+#define REALTIME_PREFAULT_STACK (256 * 1024)
+#define REALTIME_PREFAULT_HEAP (4 * 1024 * 1024)
+
+typedef struct {
+    int enabled;
+    int priority;       /* SCHED_FIFO priority, 1-99 */
+    int cpu;            /* CPU to pin to; -1 = last online CPU */
+} RealtimeConfig;
+
+/* What realtime_enter() was granted */
+typedef struct {
+    int fifo;           /* Running under SCHED_FIFO */
+    int locked;         /* mlockall() succeeded */
+    int pinned_cpu;     /* CPU pinned to, -1 if pinning failed */
+    int prefaulted;     /* Stack and heap pre-faulted */
+} RealtimeStatus;
+
+/* Parse "--realtime[=PRIO]"'s argument (NULL gives the default priority) */
+int realtime_parse_priority(const char *str, int *priority);
+
+/* Parse "--cpu N"'s argument: a CPU number below the configured CPU count */
+int realtime_parse_cpu(const char *str, int *cpu);
+
+/* Apply the config to the calling thread and report each step on stderr.
+ * Threads created afterwards inherit the policy and affinity, so start
+ * helper threads first. Denied steps are reported, not fatal. */
+void realtime_enter(const RealtimeConfig *config, RealtimeStatus *status);
+
+/* Start pacing at the current time */
+void realtime_deadline_init(struct timespec *deadline);
+
+/* Advance the deadline by one period and sleep until it (CLOCK_MONOTONIC,
+ * TIMER_ABSTIME). A deadline more than a period in the past restarts from
+ * now instead of bursting to catch up. Returns 1 if the deadline had
+ * already passed (an overrun), else 0. */
+int realtime_sleep_until_next(struct timespec *deadline, long period_ns);
+
+#endif /* REALTIME_H */
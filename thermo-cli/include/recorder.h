@@ -0,0 +1,73 @@
+/*
+ * Recorder header.
+ * Append-only file writer with size/time based rotation, a configurable
+ * sync cadence, torn-tail recovery when an existing file is reopened and
+ * an optional sparse time index (see timeindex.h) that follows each file.
+ * Other files kept beside a recording (sidecars) can follow it as well.
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Rotation and durability policy (0 = disabled; no sync = page cache only) */
+typedef struct {
+    long long rotate_bytes;     /* Rotate before a write would exceed this size */
+    int rotate_seconds;         /* Rotate once the active file is this old */
+    int fsync_records;          /* Sync after this many committed records */
+    int fsync_ms;               /* Sync once the oldest unsynced record is this old */
+    long long index_chunk;      /* Bytes per time index chunk (0 = no index) */
+} RecorderPolicy;
+
+/* Return the length of the intact prefix of an existing file (size bytes),
+ * or -1 if the file is not in the expected format */
+typedef long long (*RecorderScanFn)(int fd, long long size);
+
+#define RECORDER_MAX_SIDECARS 8
+
+/* Result flags from recorder_begin() */
+#define RECORDER_SEGMENT_START 0x1  /* File was (re)opened: write per-session headers */
+#define RECORDER_SEGMENT_EMPTY 0x2  /* File is empty: write per-file headers */
+#define RECORDER_SEGMENT_ROTATED 0x4    /* The previous file (and its sidecars) were renamed */
+
+/* Opaque recorder structure */
+typedef struct Recorder Recorder;
+
+/* Open (append) the active file at path. If scan is given, an existing file is
+ * truncated to its intact prefix first, dropping a record torn by a crash. */
+Recorder* recorder_open(const char *path, const RecorderPolicy *policy, RecorderScanFn scan);
+
+/* Rename <path><suffix> along with the file when it rotates. Its writer
+ * sees RECORDER_SEGMENT_ROTATED afterwards; until it reopens the name, its
+ * open descriptor still refers to the rotated segment's sidecar. */
+int recorder_add_sidecar(Recorder *rec, const char *suffix);
+
+/* Prepare for a write of len bytes, rotating if needed. Returns RECORDER_* flags or -1 on error. */
+int recorder_begin(Recorder *rec, size_t len);
+
+/* Append bytes to the active file */
+int recorder_write(Recorder *rec, const void *data, size_t len);
+
+/* The next write is a header later records are decoded with (CSV header, TCR schema) */
+void recorder_mark_header(Recorder *rec);
+
+/* The next write is a record of this time; indexed if it starts a new chunk */
+void recorder_index(Recorder *rec, int64_t timestamp_us);
+
+/* Mark the end of a record; syncs when the policy's cadence is due */
+void recorder_commit(Recorder *rec);
+
+/* Sync if the oldest unsynced record has reached the policy's age at now_us
+ * (time_mono_us). Returns when it will, or -1 if nothing is waiting for it. */
+int64_t recorder_sync_due(Recorder *rec, int64_t now_us);
+
+/* Scanner for newline-terminated records (JSON lines, CSV) */
+long long recorder_scan_lines(int fd, long long size);
+
+/* Close the active file (synced first unless the policy never syncs) */
+void recorder_close(Recorder *rec);
+
+#endif /* RECORDER_H */
@@ -0,0 +1,52 @@
+/*
+ * Recording reader header.
+ * Reads back the records of CSV and binary recordings written by the file
+ * sinks, through several files (rotated segments) in order, and can start
+ * at any record given its offset and that of the header it is decoded
+ * with, as kept by the time index.
+ */
+
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "serialize.h"
+
+typedef struct {
+    char **paths;
+    int path_count;
+    int path_index;
+    const char *path;               /* File being read */
+    FILE *fp;
+    int binary;
+    TcrReader tcr;
+    RecordSchema csv_schema;        /* CSV: columns after TIME */
+    FlatRecord csv_record;
+    int csv_columns[TCR_MAX_COLUMNS];   /* Schema column of each CSV field after TIME */
+    int csv_field_count;
+    char *csv_fields[TCR_MAX_COLUMNS + 1];
+    uint8_t csv_quoted[TCR_MAX_COLUMNS + 1];
+    long long csv_offset;           /* File offset of the next line */
+    char *line;
+    size_t line_cap;
+    const RecordSchema *schema;     /* Columns of the last record */
+    const FlatRecord *record;       /* Last record read (CSV strings point into the line) */
+    long long record_offset;        /* File offset of the last record */
+    int schema_changed;             /* The columns may differ from the previous record's */
+} RecordingReader;
+
+/* Read paths in order; nothing is opened before the first read */
+void recording_reader_init(RecordingReader *rd, char **paths, int path_count);
+
+/* Next record across all files: 1 = record, 0 = end of the last file, or an error */
+int recording_reader_next(RecordingReader *rd);
+
+/* Open the next file (unless one is open) and continue from the record at
+ * offset, decoding the header at header_offset first */
+int recording_reader_seek(RecordingReader *rd, long long header_offset, long long offset);
+
+void recording_reader_free(RecordingReader *rd);
+
+#endif /* RECORDING_H */
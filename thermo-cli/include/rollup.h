@@ -0,0 +1,71 @@
+/*
+ * Rollup header.
+ * A downsampling pyramid kept beside a CSV or binary recording while it is
+ * written: for each level (1 s, 10 s, 1 min and 10 min by default) one CSV
+ * row per interval, in <FILE>.rollup-<LEVEL>, with the record count and
+ * the mean, min, max and count of every numeric value column:
+ *
+ *   TIME,RECORDS,<COL>_MEAN,<COL>_MIN,<COL>_MAX,<COL>_COUNT,...
+ *
+ * TIME is the interval start; intervals are aligned to the epoch. Only
+ * the finest level sees records; each coarser level adds up the rows of
+ * the level below as they close, so the cost per record does not grow
+ * with the levels. A row is written once its interval has passed, also
+ * while no record arrives (see rollup_tick()), and a partial one when the
+ * recording closes or rotates, so an interval may have several rows (even
+ * in consecutive segments), which combine by their counts. Rows are in
+ * time order.
+ */
+
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "recorder.h"
+#include "serialize.h"
+
+#define ROLLUP_SUFFIX ".rollup-"
+#define ROLLUP_MAX_LEVELS 8
+#define ROLLUP_DEFAULT_LEVELS "1s:10s:1m:10m"
+
+typedef struct {
+    int count;
+    int64_t width_us[ROLLUP_MAX_LEVELS];    /* Ascending, each a multiple of the one before */
+} RollupLevels;
+
+/* Level widths as N[ms|s|m|h|d] (whole numbers), as used in file names */
+int rollup_parse_width(const char *str, int64_t *width_us);
+void rollup_format_width(int64_t width_us, char *out, size_t out_len);
+
+/* Widths separated by colons (1s:10s:1m), or "off" for none */
+int rollup_levels_parse(const char *str, RollupLevels *levels);
+
+/* ".rollup-<LEVEL>", and the level's file beside path */
+void rollup_suffix(char *out, size_t out_len, int64_t width_us);
+void rollup_path(char *out, size_t out_len, const char *path, int64_t width_us);
+
+/* Opaque rollup structure */
+typedef struct Rollup Rollup;
+
+/* Rollups of the recording at path; level files are opened (appending,
+ * synced per policy) with their first row */
+Rollup* rollup_open(const char *path, const RollupLevels *levels, const RecorderPolicy *policy);
+
+/* Add a record; the columns are chosen from the first record's schema */
+void rollup_add(Rollup *rollup, const RecordSchema *schema, const FlatRecord *rec);
+
+/* Write the rows of intervals that have passed by now_us (time_mono_us)
+ * and sync level files whose records have reached the policy's age.
+ * Returns when to call again, or -1 if nothing is pending. */
+int64_t rollup_tick(Rollup *rollup, int64_t now_us);
+
+/* Write the open intervals as partial rows and close the level files,
+ * which are reopened by name with the next row (after a rotation) */
+void rollup_flush(Rollup *rollup);
+
+/* Flush and free */
+void rollup_close(Rollup *rollup);
+
+#endif /* ROLLUP_H */
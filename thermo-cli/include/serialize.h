@@ -0,0 +1,183 @@
+/*
+ * Record serialization header.
+ * Flattens JSON records into named numeric/string columns and encodes
+ * them as CSV rows or binary recording frames.
+ */
+
+#ifndef SERIALIZE_H
+#define SERIALIZE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "cJSON.h"
+
+/* Binary recording layout (little-endian):
+ *   file:  "TCR1" then frames
+ *   frame: u8 type, u32 payload_len, payload, u32 crc32(type..payload)
+ *   'S' schema: u16 ncols, ncols x (u8 len, name)
+ *   'D' data:   i64 timestamp_us, u16 ncols, presence bitmap, f64 per present column
+ *   'C' compressed block of records: u16 ncols, u16 nrecords, then a bit
+ *               stream (MSB first), per record:
+ *       timestamp: the first raw (64 bits), then the delta-of-delta:
+ *                  '0' = 0, '10' + 7 bits, '110' + 12 bits, '1110' + 20 bits,
+ *                  '1111' + 64 bits (two's complement)
+ *       each column, XOR with its previous value in the block (initially 0):
+ *                  '0' = same value, '10' + bits within the previous window,
+ *                  '110' + 5 bits leading zeros + 6 bits length (0 = 64) + bits,
+ *                  '111' = absent
+ *     Blocks are self-contained, so a reader can start at any of them.
+ */
+#define TCR_MAGIC "TCR1"
+#define TCR_MAGIC_LEN 4
+#define TCR_FRAME_SCHEMA 'S'
+#define TCR_FRAME_DATA 'D'
+#define TCR_FRAME_COMPRESSED 'C'
+#define TCR_FRAME_OVERHEAD 9      /* type + length + crc */
+#define TCR_MAX_COLUMNS 1024
+#define TCR_MAX_PAYLOAD (2 + TCR_MAX_COLUMNS * 256)  /* Largest schema frame */
+#define TCR_BLOCK_MAX_RECORDS 65535
+
+/* Growable byte buffer */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} ByteBuffer;
+
+void byte_buffer_reset(ByteBuffer *buf);
+void byte_buffer_reserve(ByteBuffer *buf, size_t extra);
+void byte_buffer_append(ByteBuffer *buf, const void *data, size_t len);
+void byte_buffer_printf(ByteBuffer *buf, const char *fmt, ...);
+void byte_buffer_free(ByteBuffer *buf);
+
+/* Column layout shared by all CSV/binary outputs of a stream */
+typedef struct {
+    char **names;
+    uint8_t *is_string;     /* 1 = string column (CSV only, skipped in binary) */
+    int count;
+} RecordSchema;
+
+/* One flattened record, indexed like the schema */
+typedef struct {
+    int64_t timestamp_us;
+    double *values;
+    const char **strings;   /* Borrowed from the source cJSON */
+    uint8_t *present;       /* 0 = field absent from this record */
+    int count;
+} FlatRecord;
+
+/* Build schema from a record's leaves ("TIME" column first). Nested keys are joined with '_',
+ * array elements use their "KEY" string when present, else their index. */
+int record_schema_build(RecordSchema *schema, const cJSON *json);
+/* Append the record's leaves the schema lacks; returns the number of columns added */
+int record_schema_extend(RecordSchema *schema, const cJSON *json);
+int record_schema_add(RecordSchema *schema, const char *name, int is_string);  /* Returns column index */
+void record_schema_free(RecordSchema *schema);
+
+/* Column names ending in _ADDRESS, _CHANNEL or _UNCHANGED identify a reading
+ * rather than measure anything; _TEMP/_TEMPERATURE columns may hold fault codes */
+int record_column_is_value(const char *name);
+int record_column_is_temperature(const char *name);
+
+/* Flatten json into rec (allocated for schema->count columns); unknown leaves are
+ * skipped, and the fill returns how many there were */
+int flat_record_init(FlatRecord *rec, const RecordSchema *schema);
+int flat_record_fill(FlatRecord *rec, const RecordSchema *schema, const cJSON *json, int64_t timestamp_us);
+void flat_record_free(FlatRecord *rec);
+
+/* CSV encoding (lines end with '\n') */
+void csv_encode_header(ByteBuffer *out, const RecordSchema *schema);
+void csv_encode_row(ByteBuffer *out, const FlatRecord *rec);
+
+/* Shortest of %.15g and %.17g that reads back as the same double (as cJSON
+ * prints numbers), so wide counters survive a CSV round trip. Returns the length. */
+int csv_format_number(char *out, size_t out_len, double value);
+
+/* Binary recording encoding */
+void tcr_encode_schema(ByteBuffer *out, const RecordSchema *schema);
+void tcr_encode_data(ByteBuffer *out, const RecordSchema *schema, const FlatRecord *rec);
+
+/* Compressed block encoder: records are added one at a time and the block
+ * is written out as one 'C' frame */
+typedef struct {
+    ByteBuffer bits;            /* Whole bytes of the bit stream */
+    uint64_t acc;               /* Bits not yet in a whole byte */
+    int acc_bits;
+    int columns;                /* Numeric columns of the schema */
+    int records;
+    int64_t first_timestamp_us;
+    int64_t prev_timestamp_us;
+    int64_t prev_delta_us;
+    uint64_t *prev;             /* Per column: last value's bits, XOR window */
+    uint8_t *leading;
+    uint8_t *length;
+} TcrBlockEncoder;
+
+int tcr_block_encoder_init(TcrBlockEncoder *enc, const RecordSchema *schema);
+void tcr_block_encoder_add(TcrBlockEncoder *enc, const RecordSchema *schema, const FlatRecord *rec);
+
+/* Could one more record of any values still be added? */
+int tcr_block_encoder_has_room(const TcrBlockEncoder *enc);
+
+/* Append the block as a 'C' frame (nothing if it is empty) and start a new one */
+void tcr_block_encoder_finish(TcrBlockEncoder *enc, ByteBuffer *out);
+void tcr_block_encoder_free(TcrBlockEncoder *enc);
+
+/* Streaming decoder over one 'C' payload, a record at a time */
+typedef struct {
+    const uint8_t *data;        /* Bit stream, owned by the caller */
+    size_t bit_len;
+    size_t bit_pos;
+    int columns;
+    int remaining;              /* Records not yet decoded */
+    int started;
+    int64_t prev_timestamp_us;
+    int64_t prev_delta_us;
+    uint64_t *prev;
+    uint8_t *leading;
+    uint8_t *length;
+    int capacity;               /* Columns the arrays hold */
+} TcrBlockDecoder;
+
+/* Start on a payload whose records have columns columns */
+int tcr_block_decoder_start(TcrBlockDecoder *dec, const uint8_t *payload, uint32_t len, int columns);
+
+/* Decode the next record into rec (columns indexed like the schema) */
+int tcr_block_decoder_next(TcrBlockDecoder *dec, FlatRecord *rec);
+void tcr_block_decoder_free(TcrBlockDecoder *dec);
+
+/* Sequential reader for binary recordings; a file may hold several sessions,
+ * each starting with its own schema frame */
+typedef struct {
+    FILE *fp;
+    RecordSchema schema;        /* Columns of the current session (all numeric) */
+    int schema_ready;
+    int schema_changed;         /* A schema frame preceded the last record */
+    FlatRecord record;          /* Last record read */
+    long long record_offset;    /* File offset of the last record's frame */
+    long long offset;           /* File offset of the next frame */
+    ByteBuffer frame;
+    TcrBlockDecoder block;      /* Records left in the last compressed frame */
+} TcrReader;
+
+/* Check the magic; fp is not owned */
+int tcr_reader_open(TcrReader *reader, FILE *fp);
+
+/* Continue reading at the frame starting at offset (the current schema is kept) */
+int tcr_reader_seek(TcrReader *reader, long long offset);
+
+/* Read the next data record: 1 = record, 0 = end of file (a torn final frame
+ * counts as the end), THERMO_IO_ERROR on a damaged frame */
+int tcr_reader_next(TcrReader *reader);
+
+void tcr_reader_close(TcrReader *reader);
+
+/* Length of the intact prefix of a binary recording (magic + whole frames with valid CRC),
+ * or -1 if the file is not a binary recording. Matches RecorderScanFn. */
+long long tcr_scan_valid_length(int fd, long long size);
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+#endif /* SERIALIZE_H */
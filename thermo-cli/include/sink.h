@@ -0,0 +1,77 @@
+/*
+ * Output sinks header.
+ * Fans each record out to several destinations (stdout, rotating files,
+ * sockets), each with its own format, serializing once per format.
+ */
+
+#ifndef SINK_H
+#define SINK_H
+
+#include <stdint.h>
+
+#include "cJSON.h"
+#include "recorder.h"
+#include "rollup.h"
+
+#define MAX_SINKS 8
+
+typedef enum {
+    SINK_STDOUT,
+    SINK_FILE,
+    SINK_UNIX,      /* Connect to a Unix stream socket */
+    SINK_TCP        /* Connect to host:port */
+} SinkKind;
+
+typedef enum {
+    SINK_FORMAT_JSON,   /* One JSON object per line (text lines pass through) */
+    SINK_FORMAT_CSV,    /* Flattened columns with TIME first, header per file */
+    SINK_FORMAT_BINARY,     /* TCR frames, see serialize.h */
+    SINK_FORMAT_COMPRESSED  /* TCR compressed blocks of records (file sinks only) */
+} SinkFormat;
+
+#define SINK_DEFAULT_BLOCK_RECORDS 1024
+
+/* Sink description, parsed from
+ * "KIND[:TARGET][,format=F][,rotate-size=N[K|M|G]][,rotate-time=N[s|m|h|d]][,fsync=N|Tms|Ts|never]
+ *  [,index=N[K|M|G]|off][,block=N][,rollup=W[:W...]|off]" */
+typedef struct {
+    SinkKind kind;
+    SinkFormat format;
+    char target[256];           /* File/socket path or host:port */
+    RecorderPolicy rotate;      /* File sinks only: rotation, sync cadence and time index */
+    int block_records;          /* Compressed sinks: records per block */
+    RollupLevels rollup;        /* File sinks (not JSON): rollup levels kept beside the file */
+} SinkSpec;
+
+/* Opaque sink set */
+typedef struct SinkSet SinkSet;
+
+/* Parse a --sink argument; format defaults from the file extension (.csv, .tcr/.bin, .tcz, else JSON) */
+int sink_spec_parse(const char *str, SinkSpec *spec);
+
+/* Default when no --sink is given: JSON to stdout */
+void sink_spec_default(SinkSpec *spec);
+
+/* Open all sinks (socket sinks connect lazily and reconnect on failure) */
+SinkSet* sink_set_open(const SinkSpec *specs, int count);
+
+/* Does any sink write to stdout? */
+int sink_set_uses_stdout(const SinkSet *set);
+
+/* Write one JSON record (timestamp_us: capture time, wall clock) */
+void sink_set_write_json(SinkSet *set, const cJSON *json, int64_t timestamp_us);
+
+/* Write a raw text line (JSON sinks only) */
+void sink_set_write_line(SinkSet *set, const char *line);
+
+/* Do what is due while records may not be arriving: write compressed
+ * blocks that have spanned their time, sync files whose records have
+ * reached the fsync age and write rollup rows of intervals that have
+ * passed. Returns the time_mono_us() to call again at, or -1
+ * if nothing is pending (the next write may start something). */
+int64_t sink_set_tick(SinkSet *set);
+
+/* Flush and close all sinks */
+void sink_set_close(SinkSet *set);
+
+#endif /* SINK_H */
@@ -0,0 +1,64 @@
+/*
+ * Latency statistics header.
+ * HDR-style histograms of how long each hardware call, serialization and
+ * sink write takes, kept per board/channel (or per format/sink). Enabled at
+ * runtime with --stats; a summary is printed on exit and a JSON stats record
+ * periodically. While disabled, a measurement costs one predictable branch.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define STATS_DEFAULT_INTERVAL_S 10.0
+
+/* Measured operations */
+typedef enum {
+    STAT_T_IN_READ,     /* mcc134_t_in_read, per address/channel */
+    STAT_A_IN_READ,     /* mcc134_a_in_read, per address/channel */
+    STAT_CJC_READ,      /* mcc134_cjc_read, per address/channel */
+    STAT_SERIALIZE,     /* Encoding one record, per format */
+    STAT_SINK_WRITE,    /* Writing one record, per sink */
+    STAT_OP_COUNT
+} StatOp;
+
+/* Slots per operation: every channel of every address */
+#define STATS_MAX_SLOTS 32
+#define STATS_SLOT(address, channel) ((address) * 4 + (channel))
+
+extern volatile int g_stats_enabled;
+
+/* Parse "--stats[=SECONDS]"'s argument (NULL gives the default interval; 0 = exit summary only) */
+int stats_parse_interval(const char *str, double *interval_s);
+
+/* Start measuring; the summary is printed to stderr at exit */
+void stats_enable(double interval_s);
+
+/* Name a slot of a per-format or per-sink operation (hardware slots are
+ * named by address and channel) */
+void stats_label(StatOp op, int slot, const char *label);
+
+/* Record the time since start_ns (from stats_start) into op's slot. Each
+ * slot must only be recorded from one thread. */
+void stats_record_since(StatOp op, int slot, uint64_t start_ns);
+
+/* Write a JSON stats record to stderr if the interval has passed */
+void stats_report_due(void);
+
+/* Write the summary table */
+void stats_print_summary(FILE *fp);
+
+uint64_t stats_now_ns(void);
+
+/* Start a measurement (0 while disabled) */
+static inline uint64_t stats_start(void) {
+    return __builtin_expect(g_stats_enabled, 0) ? stats_now_ns() : 0;
+}
+
+static inline void stats_record(StatOp op, int slot, uint64_t start_ns) {
+    if (start_ns) stats_record_since(op, slot, start_ns);
+}
+
+#endif /* STATS_H */
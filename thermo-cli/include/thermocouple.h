@@ -0,0 +1,31 @@
+/*
+ * Thermocouple linearization header.
+ * NIST ITS-90 reference functions for types J, K, T, E, R, S, B and N:
+ * converts a measured thermocouple voltage plus cold-junction temperature
+ * to temperature without a round trip through the board library.
+ */
+
+#ifndef THERMOCOUPLE_H
+#define THERMOCOUPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hardware.h"
+
+/* Reference voltage (mV) at temp_c for tc_type (NIST forward polynomial) */
+double tc_temp_to_mv(uint8_t tc_type, double temp_c);
+
+/* Temperature (degC) for a reference voltage in mV (NIST inverse polynomial).
+ * Returns OVERRANGE_TC_VALUE outside the type's table range. */
+double tc_mv_to_temp(uint8_t tc_type, double mv);
+
+/* Temperature from a measured voltage (V) and cold-junction temperature (degC) */
+double tc_linearize(uint8_t tc_type, double tc_volts, double cjc_c);
+
+/* Batch form of tc_linearize over n samples of one type; loops are branch-free
+ * so the compiler can vectorize them */
+void tc_linearize_batch(uint8_t tc_type, const double *tc_volts, const double *cjc_c,
+                        double *temp_c, size_t n);
+
+#endif /* THERMOCOUPLE_H */
@@ -0,0 +1,42 @@
+/*
+ * Time index header.
+ * A sparse index kept beside a CSV or binary recording as <FILE>.idx: one
+ * entry per chunk (every few tens of kilobytes) with the time and offset of
+ * the chunk's first record, so a time range is read without scanning the
+ * whole file. Entries are fixed-size and appended as records are written.
+ * The index is never synced: after a crash it may lack its last entries
+ * (the final chunk just reads longer) or point past a recovered tail
+ * (such entries are dropped).
+ */
+
+#ifndef TIMEINDEX_H
+#define TIMEINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TIME_INDEX_MAGIC "TCX1"
+#define TIME_INDEX_MAGIC_LEN 4
+#define TIME_INDEX_SUFFIX ".idx"
+#define TIME_INDEX_DEFAULT_CHUNK (64 * 1024)
+
+/* One chunk, in native byte order like the binary recording it indexes */
+typedef struct {
+    int64_t timestamp_us;       /* First record of the chunk */
+    int64_t offset;             /* File offset of that record */
+    int64_t header_offset;      /* Header it is decoded with (CSV header row, TCR schema frame) */
+} TimeIndexEntry;
+
+void time_index_path(char *out, size_t out_len, const char *path);
+
+/* Load the entries of path's index that start within its first data_size
+ * bytes. Returns the count (0 with *entries NULL if there is no usable
+ * index) or -1 if out of memory. */
+int time_index_load(const char *path, long long data_size, TimeIndexEntry **entries);
+
+/* Cut an existing index back to the entries within data_size bytes, before
+ * appending to a recovered recording. Returns 1 with the last kept entry,
+ * 0 if none was kept (or there is no index), or an error. */
+int time_index_trim(const char *path, long long data_size, TimeIndexEntry *last);
+
+#endif /* TIMEINDEX_H */
@@ -0,0 +1,54 @@
+/*
+ * Hot-path tracing header.
+ * Compiled into every build and enabled at runtime (--trace FILE). Each
+ * thread records begin/end events into its own ring buffer without locks;
+ * the rings are written out as Chrome trace JSON (chrome://tracing,
+ * ui.perfetto.dev) when the process exits. While disabled, a trace point
+ * costs one predictable branch.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_RING_EVENTS 65536     /* Per thread; the oldest events are overwritten */
+
+extern volatile int g_trace_enabled;
+
+/* Start recording; the trace is written to path at exit (or trace_stop) */
+int trace_start(const char *path);
+
+/* Stop recording and write the trace file (idempotent) */
+void trace_stop(void);
+
+/* Name the calling thread in the trace and allocate its ring up front, so a
+ * real-time loop does not allocate on its first event */
+void trace_thread_register(const char *name);
+
+/* Record an event; name must be a string literal (only the pointer is kept) */
+void trace_event(const char *name, char phase);
+
+static inline void trace_begin(const char *name) {
+    if (__builtin_expect(g_trace_enabled, 0)) trace_event(name, 'B');
+}
+
+static inline void trace_end(const char *name) {
+    if (__builtin_expect(g_trace_enabled, 0)) trace_event(name, 'E');
+}
+
+/* Scope cleanup: only scopes that recorded a begin record an end */
+static inline void trace_scope_end(const char **name) {
+    if (*name) trace_event(*name, 'E');
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+/* TRACE_SCOPE(name) - begin now, end when the enclosing scope exits */
+#define TRACE_SCOPE(name) \
+    const char *TRACE_CONCAT(trace_scope_, __LINE__) \
+    __attribute__((cleanup(trace_scope_end), unused)) = \
+        __builtin_expect(g_trace_enabled, 0) ? (trace_event(name, 'B'), (name)) : NULL
+
+#endif /* TRACE_H */
@@ -7,6 +7,7 @@
 #define UTILS_H
 
 #include "common.h"
+#include "trace.h"
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
@@ -20,7 +21,8 @@
 #define DEBUG_PRINT(fmt, ...) do {} while(0)
 #endif
 
-/* Scope profiler for performance measurement */
+/* Scope profiler for performance measurement. Scopes are always trace
+ * points (see trace.h); DEBUG builds also print each one to stderr. */
 #ifdef DEBUG
 #include <time.h>
 
@@ -40,9 +42,10 @@ void __scope_timer_cleanup(ScopeTimer *timer);
  *       // ... code to profile ...
  *   }  // Automatically prints elapsed time when scope exits
  *
- * Only active when compiled with DEBUG=1
+ * Printing is only active when compiled with DEBUG=1
  */
 #define PROFILE_SCOPE(name) \
+    TRACE_SCOPE(name); \
     ScopeTimer __scope_timer_##__LINE__ \
     __attribute__((cleanup(__scope_timer_cleanup))) = { \
         .scope_name = name, \
@@ -52,7 +55,7 @@ void __scope_timer_cleanup(ScopeTimer *timer);
     clock_gettime(CLOCK_MONOTONIC, &__scope_timer_##__LINE__.start)
 
 #else
-#define PROFILE_SCOPE(name) do {} while(0)
+#define PROFILE_SCOPE(name) TRACE_SCOPE(name)
 #endif
 
 /* Data formatting structure */
@@ -104,6 +107,12 @@ void table_add_row(Table *table, char **row_data);
 void table_print(Table *table, const char *title);
 void table_free(Table *table);
 
+/* Wall-clock time in microseconds since the epoch */
+int64_t time_now_us(void);
+
+/* CLOCK_MONOTONIC time in microseconds, for deadlines */
+int64_t time_mono_us(void);
+
 /* Formatting functions */
 char* format_temperature(double temp);
 void print_colored(const char *color, const char *text);
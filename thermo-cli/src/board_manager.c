@@ -5,16 +5,41 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "board_manager.h"
 #include "utils.h"
 
-/* Initialize manager and open all required boards */
-int board_manager_init(BoardManager *mgr, ThermalSource *sources, int source_count) {
+/* Initialize manager without opening boards */
+int board_manager_init_static(BoardManager *mgr, ThermalSource *sources, int source_count) {
     memset(mgr->opened, 0, sizeof(mgr->opened));
+    memset(mgr->cjc_valid, 0, sizeof(mgr->cjc_valid));
+    memset(mgr->settling, 0, sizeof(mgr->settling));
+    memset(mgr->health, 0, sizeof(mgr->health));
+    for (int a = 0; a < MAX_BOARDS; a++) {
+        for (int c = 0; c < MCC134_NUM_CHANNELS; c++) {
+            mgr->health[a][c].due = 1;
+        }
+    }
     mgr->sources = sources;
     mgr->source_count = source_count;
     
+    if (inventory_load(&mgr->inventory, 0) != THERMO_SUCCESS) {
+        fprintf(stderr, "Error: Failed to list boards\n");
+        return THERMO_ERROR;
+    }
+    return inventory_validate_sources(&mgr->inventory, sources, source_count);
+}
+
+/* Initialize manager and open all required boards */
+int board_manager_init(BoardManager *mgr, ThermalSource *sources, int source_count) {
+    int result = board_manager_init_static(mgr, sources, source_count);
+    if (result != THERMO_SUCCESS) {
+        return result;
+    }
+    
     /* Open all unique boards and apply update intervals */
     for (int i = 0; i < source_count; i++) {
         uint8_t addr = sources[i].address;
@@ -28,6 +53,7 @@ int board_manager_init(BoardManager *mgr, ThermalSource *sources, int source_cou
                 return THERMO_ERROR;
             }
             mgr->opened[addr] = 1;
+            mgr->cjc_channel[addr] = sources[i].channel;
             
             /* Apply update interval if it differs from default */
             if (sources[i].update_interval > 0 && 
@@ -38,12 +64,30 @@ int board_manager_init(BoardManager *mgr, ThermalSource *sources, int source_cou
                     fprintf(stderr, "Warning: Failed to set update interval for address %d\n", addr);
                 }
             }
+        } else if (sources[i].channel < mgr->cjc_channel[addr]) {
+            mgr->cjc_channel[addr] = sources[i].channel;
         }
     }
     
     return THERMO_SUCCESS;
 }
 
+/* Set a source's TC type, marking its board as settling if the type changed */
+static void apply_tc_type(BoardManager *mgr, const ThermalSource *src) {
+    uint8_t current;
+    if (thermo_get_tc_type(src->address, src->channel, &current) == THERMO_SUCCESS &&
+        current == thermo_tc_type_from_string(src->tc_type)) {
+        return;
+    }
+    
+    if (thermo_set_tc_type(src->address, src->channel, src->tc_type) != THERMO_SUCCESS) {
+        fprintf(stderr, "Warning: Failed to set TC type for address %d, channel %d\n",
+                src->address, src->channel);
+        return;
+    }
+    mgr->settling[src->address] |= (uint8_t)(1u << src->channel);
+}
+
 /* Apply calibration coefficients and TC type settings for all sources */
 int board_manager_configure(BoardManager *mgr) {
     for (int i = 0; i < mgr->source_count; i++) {
@@ -64,10 +108,7 @@ int board_manager_configure(BoardManager *mgr) {
         }
         
         /* Set TC type */
-        if (thermo_set_tc_type(src->address, src->channel, src->tc_type) != THERMO_SUCCESS) {
-            fprintf(stderr, "Warning: Failed to set TC type for address %d, channel %d\n",
-                    src->address, src->channel);
-        }
+        apply_tc_type(mgr, src);
     }
     
     return THERMO_SUCCESS;
@@ -76,17 +117,184 @@ int board_manager_configure(BoardManager *mgr) {
 /* Apply only TC type settings */
 int board_manager_set_tc_types(BoardManager *mgr) {
     for (int i = 0; i < mgr->source_count; i++) {
-        ThermalSource *src = &mgr->sources[i];
+        apply_tc_type(mgr, &mgr->sources[i]);
+    }
+    
+    return THERMO_SUCCESS;
+}
+
+static int64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* A conversion landed once either value moves (read failures don't count) */
+static int reading_changed(double before, double now) {
+    return !isnan(before) && !isnan(now) && before != now;
+}
+
+/* Poll the changed channels of every settling board until one's ADC or CJC value moves
+ * (one conversion cycle covers all channels of a board) */
+int board_manager_wait_ready(BoardManager *mgr) {
+    double adc0[MAX_BOARDS][MCC134_NUM_CHANNELS], cjc0[MAX_BOARDS][MCC134_NUM_CHANNELS];
+    int64_t deadline[MAX_BOARDS];
+    int64_t start = monotonic_us();
+    int pending = 0;
+    int result = THERMO_SUCCESS;
+    
+    for (int i = 0; i < MAX_BOARDS; i++) {
+        if (!mgr->opened[i] || !mgr->settling[i]) continue;
+        
+        uint8_t interval = DEFAULT_UPDATE_INTERVAL;
+        thermo_get_update_interval(i, &interval);
+        deadline[i] = start + (int64_t)interval * 1000000 + BOARD_READY_MARGIN_US;
         
-        if (thermo_set_tc_type(src->address, src->channel, src->tc_type) != THERMO_SUCCESS) {
-            fprintf(stderr, "Warning: Failed to set TC type for address %d, channel %d\n",
-                    src->address, src->channel);
+        for (int ch = 0; ch < MCC134_NUM_CHANNELS; ch++) {
+            if (!(mgr->settling[i] & (1u << ch))) continue;
+            if (thermo_read_adc(i, ch, &adc0[i][ch]) != THERMO_SUCCESS) adc0[i][ch] = NAN;
+            if (thermo_read_cjc(i, ch, &cjc0[i][ch]) != THERMO_SUCCESS) cjc0[i][ch] = NAN;
         }
+        pending++;
     }
     
+    while (pending > 0) {
+        usleep(BOARD_READY_POLL_US);
+        int64_t now = monotonic_us();
+        
+        for (int i = 0; i < MAX_BOARDS; i++) {
+            if (!mgr->opened[i] || !mgr->settling[i]) continue;
+            
+            int fresh = 0;
+            for (int ch = 0; ch < MCC134_NUM_CHANNELS && !fresh; ch++) {
+                if (!(mgr->settling[i] & (1u << ch))) continue;
+                double adc, cjc;
+                if (thermo_read_adc(i, ch, &adc) != THERMO_SUCCESS) adc = NAN;
+                if (thermo_read_cjc(i, ch, &cjc) != THERMO_SUCCESS) cjc = NAN;
+                fresh = reading_changed(adc0[i][ch], adc) || reading_changed(cjc0[i][ch], cjc);
+            }
+            
+            if (fresh) {
+                DEBUG_PRINT("Board %d ready after %lld ms", i, (long long)((now - start) / 1000));
+            } else if (now >= deadline[i]) {
+                fprintf(stderr, "Warning: No fresh reading from address %d within %lld ms\n",
+                        i, (long long)((deadline[i] - start) / 1000));
+                result = THERMO_ERROR;
+            } else {
+                continue;
+            }
+            mgr->settling[i] = 0;
+            pending--;
+        }
+    }
+    
+    return result;
+}
+
+static void channel_health_count(ChannelHealth *h, uint8_t address, uint8_t channel);
+
+/* Count the last tick's outcomes, advance backoff counters and read CJC once
+ * for every open board that has a channel due */
+int board_manager_read_cjc(BoardManager *mgr) {
+    for (int a = 0; a < MAX_BOARDS; a++) {
+        for (int c = 0; c < MCC134_NUM_CHANNELS; c++) {
+            ChannelHealth *h = &mgr->health[a][c];
+            if (h->reported) {
+                channel_health_count(h, (uint8_t)a, (uint8_t)c);
+                h->reported = 0;
+            }
+            h->due = (h->skip == 0);
+            if (h->skip > 0) h->skip--;
+        }
+        mgr->cjc_due[a] = 0;
+    }
+    for (int i = 0; i < mgr->source_count; i++) {
+        const ThermalSource *src = &mgr->sources[i];
+        if (src->channel < MCC134_NUM_CHANNELS && mgr->health[src->address][src->channel].due) {
+            mgr->cjc_due[src->address] = 1;
+        }
+    }
+    
+    return board_manager_reread_cjc(mgr);
+}
+
+/* Read CJC for the boards board_manager_read_cjc found due */
+int board_manager_reread_cjc(BoardManager *mgr) {
+    TRACE_SCOPE("read_cjc");
+    int result = THERMO_SUCCESS;
+    
+    for (int i = 0; i < MAX_BOARDS; i++) {
+        mgr->cjc_valid[i] = 0;
+        if (!mgr->opened[i] || !mgr->cjc_due[i]) continue;
+        
+        if (thermo_read_cjc(i, mgr->cjc_channel[i], &mgr->cjc[i]) == THERMO_SUCCESS) {
+            mgr->cjc_valid[i] = 1;
+        } else {
+            result = THERMO_ERROR;
+        }
+    }
+    
+    return result;
+}
+
+/* CJC read for a board this tick */
+int board_manager_get_cjc(const BoardManager *mgr, uint8_t address, double *cjc) {
+    if (address >= MAX_BOARDS || !mgr->cjc_valid[address]) {
+        return THERMO_NOT_FOUND;
+    }
+    *cjc = mgr->cjc[address];
     return THERMO_SUCCESS;
 }
 
+/* ============================================================================
+ * Fault backoff
+ * ============================================================================ */
+
+/* Whether a channel should be read this tick */
+int board_manager_read_due(const BoardManager *mgr, uint8_t address, uint8_t channel) {
+    if (address >= MAX_BOARDS || channel >= MCC134_NUM_CHANNELS) return 1;
+    return mgr->health[address][channel].due;
+}
+
+/* Record a temperature read outcome; an oversampled tick reports each sample */
+void board_manager_report(BoardManager *mgr, uint8_t address, uint8_t channel, ReadingStatus status) {
+    if (address >= MAX_BOARDS || channel >= MCC134_NUM_CHANNELS) return;
+    ChannelHealth *h = &mgr->health[address][channel];
+    h->status = status;
+    h->reported = 1;
+}
+
+/* Count a read tick's outcome (its last status) toward the channel's backoff */
+static void channel_health_count(ChannelHealth *h, uint8_t address, uint8_t channel) {
+    if (h->status == READING_OK) {
+        if (h->backoff > 0) {
+            fprintf(stderr, "Address %d channel %d recovered, reading every tick\n", address, channel);
+        }
+        h->fault_streak = 0;
+        h->backoff = 0;
+        h->skip = 0;
+        return;
+    }
+    
+    if (h->fault_streak < UINT16_MAX) h->fault_streak++;
+    if (h->fault_streak < FAULT_BACKOFF_AFTER) return;
+    
+    if (h->backoff == 0) {
+        h->backoff = 1;
+        fprintf(stderr, "Address %d channel %d reports %s, backing off reads\n",
+                address, channel, thermo_status_name((ReadingStatus)h->status));
+    } else if (h->backoff < FAULT_BACKOFF_MAX_TICKS) {
+        h->backoff *= 2;
+    }
+    h->skip = h->backoff;
+}
+
+/* Status of a channel's last read */
+ReadingStatus board_manager_status(const BoardManager *mgr, uint8_t address, uint8_t channel) {
+    if (address >= MAX_BOARDS || channel >= MCC134_NUM_CHANNELS) return READING_OK;
+    return (ReadingStatus)mgr->health[address][channel].status;
+}
+
 /* Close all open boards */
 void board_manager_close(BoardManager *mgr) {
     for (int i = 0; i < MAX_BOARDS; i++) {
@@ -94,6 +302,7 @@ void board_manager_close(BoardManager *mgr) {
             DEBUG_PRINT("Closing board at address %d", i);
             thermo_close(i);
             mgr->opened[i] = 0;
+            mgr->cjc_valid[i] = 0;
         }
     }
     mgr->sources = NULL;
@@ -1,15 +1,25 @@
 /*
  * Data fusion bridge for fusing thermal data into cmg-cli output.
- * Spawns cmg-cli as subprocess and injects thermal readings.
+ * Spawns cmg-cli (or any NDJSON producer) as subprocess, or reads an existing
+ * NDJSON stream (stdin, FIFO, Unix socket), and injects thermal readings.
  */
 
+#define _GNU_SOURCE  /* posix_openpt, ptsname, cfmakeraw, strptime */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
 #include <sys/wait.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <time.h>
+#include <math.h>
 #include <getopt.h>
 #include <daqhats/daqhats.h>
 
@@ -18,34 +28,62 @@
 #include "common.h"
 #include "signals.h"
 #include "board_manager.h"
+#include "utils.h"
+#include "output_queue.h"
+#include "stats.h"
+#include "jitter.h"
+#include "metrics.h"
 
 #include "cJSON.h"
 
 struct FuseBridge {
     ThermalSource *sources;
     int source_count;
-    char **args;
-    int arg_count;
+    SourceFilter *filters;       /* Per source, one sample per record */
+    DeadbandState *deadbands;    /* Per source, after the filter */
+    char **argv;                 /* Producer command line (NULL-terminated) */
+    int argc;
     BoardManager board_mgr;
     int boards_initialized;
+    int use_pty;
+    char *input_path;            /* Existing NDJSON stream instead of producer (NULL = spawn) */
+    OutputPolicy output_policy;
+    int queue_depth;
+    SinkSpec sinks[MAX_SINKS];   /* Output destinations */
+    int sink_count;
+    OutputQueue *output;         /* Writer thread feeding the sinks (valid during bridge_run) */
     char time_format[64];
 };
 
-/* Create a new bridge instance */
-FuseBridge* bridge_create(ThermalSource *sources, int source_count, char **args, int arg_count, const char *time_format) {
+/* Create a new bridge instance (argv is the full producer command line) */
+FuseBridge* bridge_create(ThermalSource *sources, int source_count, char **argv, int argc,
+                          const BridgeOptions *opts) {
     FuseBridge *bridge = (FuseBridge*)malloc(sizeof(FuseBridge));
     
     bridge->sources = (ThermalSource*)malloc(source_count * sizeof(ThermalSource));
     memcpy(bridge->sources, sources, source_count * sizeof(ThermalSource));
     bridge->source_count = source_count;
+    bridge->filters = (SourceFilter*)malloc(source_count * sizeof(SourceFilter));
+    for (int i = 0; i < source_count; i++) {
+        source_filter_init(&bridge->filters[i], &sources[i].filter);
+    }
+    bridge->deadbands = (DeadbandState*)calloc(source_count, sizeof(DeadbandState));
     
-    bridge->args = (char**)malloc(arg_count * sizeof(char*));
-    for (int i = 0; i < arg_count; i++) {
-        bridge->args[i] = strdup(args[i]);
+    bridge->argv = (char**)malloc((argc + 1) * sizeof(char*));
+    for (int i = 0; i < argc; i++) {
+        bridge->argv[i] = strdup(argv[i]);
     }
-    bridge->arg_count = arg_count;
+    bridge->argv[argc] = NULL;
+    bridge->argc = argc;
     bridge->boards_initialized = 0;
-    strncpy(bridge->time_format, time_format, sizeof(bridge->time_format) - 1);
+    bridge->use_pty = opts->use_pty;
+    bridge->input_path = opts->input_path ? strdup(opts->input_path) : NULL;
+    bridge->output_policy = opts->output_policy;
+    bridge->queue_depth = opts->queue_depth;
+    bridge->output = NULL;
+    memcpy(bridge->sinks, opts->sinks, opts->sink_count * sizeof(SinkSpec));
+    bridge->sink_count = opts->sink_count;
+    strncpy(bridge->time_format, opts->time_format, sizeof(bridge->time_format) - 1);
     bridge->time_format[sizeof(bridge->time_format) - 1] = '\0';
     
     return bridge;
@@ -61,11 +99,14 @@ void bridge_free(FuseBridge *bridge) {
     }
     
     if (bridge->sources) free(bridge->sources);
+    free(bridge->filters);
+    free(bridge->deadbands);
     
-    for (int i = 0; i < bridge->arg_count; i++) {
-        free(bridge->args[i]);
+    for (int i = 0; i < bridge->argc; i++) {
+        free(bridge->argv[i]);
     }
-    free(bridge->args);
+    free(bridge->argv);
+    free(bridge->input_path);
     free(bridge);
 }
 
@@ -81,58 +122,93 @@ static int bridge_init_boards(FuseBridge *bridge) {
     
     bridge->boards_initialized = 1;
     
-    thermo_wait_for_readings();
+    /* Channels just enabled have no conversion yet */
+    board_manager_wait_ready(&bridge->board_mgr);
     
     return 0;
 }
 
 /* Get thermal data from all configured sources (boards must be initialized) */
 static cJSON* get_thermal_data(FuseBridge *bridge) {
+    TRACE_SCOPE("thermal_data");
     cJSON *data = cJSON_CreateObject();
+    int64_t now_us = time_now_us();
+    
+    /* Channels on a board share its CJC: read it once per board for this record */
+    board_manager_read_cjc(&bridge->board_mgr);
     
     for (int i = 0; i < bridge->source_count; i++) {
         ThermalSource *src = &bridge->sources[i];
-        double temp, adc, cjc;
-        
-        /* Create a sub-object for each source */
-        cJSON *source_data = cJSON_CreateObject();
-        
-        /* Read temperature (board is already open with TC type set) */
-        int temp_result = mcc134_t_in_read(src->address, src->channel, &temp);
-        if (temp_result == RESULT_SUCCESS) {
-            cJSON_AddNumberToObject(source_data, "TEMP", temp);
-        } else {
-            cJSON_AddNumberToObject(source_data, "TEMP", 0.0/0.0);
-        }
-        
-        /* Read ADC voltage */
-        int adc_result = mcc134_a_in_read(src->address, src->channel, OPTS_DEFAULT, &adc);
-        if (adc_result == RESULT_SUCCESS) {
-            cJSON_AddNumberToObject(source_data, "ADC", adc);
-        } else {
-            cJSON_AddNumberToObject(source_data, "ADC", 0.0/0.0);
-        }
+        double temp, adc = NAN, cjc = NAN;
         
-        /* Read CJC temperature */
-        int cjc_result = mcc134_cjc_read(src->address, src->channel, &cjc);
-        if (cjc_result == RESULT_SUCCESS) {
-            cJSON_AddNumberToObject(source_data, "CJC", cjc);
+        /* One voltage read, linearized locally (board is already open with TC type set).
+         * A backed-off channel repeats its last fault without a read. */
+        ReadingStatus status;
+        int result = THERMO_ERROR;
+        if (!board_manager_read_due(&bridge->board_mgr, src->address, src->channel)) {
+            status = board_manager_status(&bridge->board_mgr, src->address, src->channel);
+            temp = thermo_status_value(status);
         } else {
-            cJSON_AddNumberToObject(source_data, "CJC", 0.0/0.0);
+            if (board_manager_get_cjc(&bridge->board_mgr, src->address, &cjc) == THERMO_SUCCESS) {
+                result = thermo_linearize_reading(src->address, src->channel,
+                                                  thermo_tc_type_from_string(src->tc_type),
+                                                  cjc, &temp, &adc);
+            }
+            if (result != THERMO_SUCCESS) {
+                temp = NAN;
+            }
+            status = thermo_classify_temp(temp);
+            board_manager_report(&bridge->board_mgr, src->address, src->channel, status);
+            metrics_sample(i, temp, status);
         }
         
-        /* Add the source data object to the main data object */
-        cJSON_AddItemToObject(data, src->key, source_data);
+        bridge_add_source(data, src, &bridge->filters[i], &bridge->deadbands[i],
+                          temp, result == THERMO_SUCCESS, adc, cjc, now_us);
     }
     
     return data;
 }
 
+void bridge_add_source(cJSON *data, const ThermalSource *src, SourceFilter *filter,
+                       DeadbandState *deadband, double temp, int has_voltage,
+                       double adc, double cjc, int64_t now_us) {
+    cJSON *source_data = cJSON_CreateObject();
+    
+    /* Records are paced by the producer, so filters run at the record rate */
+    source_filter_push(filter, temp);
+    temp = source_filter_emit(filter);
+    ReadingStatus status = thermo_classify_temp(temp);
+    
+    /* Within the deadband the producer's line still goes out, with the source marked unchanged */
+    if (!deadband_update(deadband, &src->deadband, temp, status, now_us)) {
+        cJSON_AddTrueToObject(source_data, "UNCHANGED");
+        cJSON_AddItemToObject(data, src->key, source_data);
+        return;
+    }
+    
+    /* Faults are reported as null with the reason, never as a sentinel number */
+    if (status == READING_OK) {
+        cJSON_AddNumberToObject(source_data, "TEMP", temp);
+    } else {
+        cJSON_AddNullToObject(source_data, "TEMP");
+    }
+    cJSON_AddStringToObject(source_data, "STATUS", thermo_status_name(status));
+    if (has_voltage) {
+        cJSON_AddNumberToObject(source_data, "ADC", adc);
+        cJSON_AddNumberToObject(source_data, "CJC", cjc);
+    } else {
+        cJSON_AddNullToObject(source_data, "ADC");
+        cJSON_AddNullToObject(source_data, "CJC");
+    }
+    
+    cJSON_AddItemToObject(data, src->key, source_data);
+}
+
 /*
  * Format timestamp with microsecond support.
  * Use %f in format string for 6-digit microseconds.
  */
-static void format_timestamp(char *buf, size_t buf_size, const struct timeval *tv, const char *format) {
+void bridge_format_timestamp(char *buf, size_t buf_size, const struct timeval *tv, const char *format) {
     struct tm *tm_info = localtime(&tv->tv_sec);
     
     /* First pass: replace %f with microseconds placeholder */
@@ -157,11 +233,52 @@ static void format_timestamp(char *buf, size_t buf_size, const struct timeval *t
     strftime(buf, buf_size, temp_format, tm_info);
 }
 
+int bridge_parse_timestamp(const char *str, const char *format, struct timeval *tv) {
+    struct tm tm;
+    localtime_r(&tv->tv_sec, &tm);
+    tm.tm_isdst = -1;
+    long usec = 0;
+    
+    /* strptime() each run of the format between %f fields; %f takes 1-6 digits */
+    const char *s = str;
+    const char *f = format;
+    while (*f) {
+        const char *usec_field = strstr(f, "%f");
+        size_t run = usec_field ? (size_t)(usec_field - f) : strlen(f);
+        if (run > 0) {
+            char run_format[128];
+            if (run >= sizeof(run_format)) return THERMO_INVALID_PARAM;
+            memcpy(run_format, f, run);
+            run_format[run] = '\0';
+            s = strptime(s, run_format, &tm);
+            if (!s) return THERMO_INVALID_PARAM;
+        }
+        if (!usec_field) break;
+        
+        int digits = 0;
+        usec = 0;
+        while (*s >= '0' && *s <= '9' && digits < 6) {
+            usec = usec * 10 + (*s++ - '0');
+            digits++;
+        }
+        if (digits == 0) return THERMO_INVALID_PARAM;
+        while (digits++ < 6) usec *= 10;
+        f = usec_field + 2;
+    }
+    if (*s != '\0') return THERMO_INVALID_PARAM;
+    
+    time_t sec = mktime(&tm);
+    if (sec == (time_t)-1) return THERMO_INVALID_PARAM;
+    tv->tv_sec = sec;
+    tv->tv_usec = usec;
+    return THERMO_SUCCESS;
+}
+
 /* Inject thermal data into JSON object */
-static void inject_json(cJSON *json_obj, cJSON *thermal_data, const struct timeval *tv, const char *time_format) {
+void bridge_inject_json(cJSON *json_obj, cJSON *thermal_data, const struct timeval *tv, const char *time_format) {
     /* Add timestamp */
     char timestamp[64];
-    format_timestamp(timestamp, sizeof(timestamp), tv, time_format);
+    bridge_format_timestamp(timestamp, sizeof(timestamp), tv, time_format);
     cJSON_AddStringToObject(json_obj, "TIMESTAMP", timestamp);
     
     cJSON *sub_obj = cJSON_CreateObject();
@@ -175,118 +292,355 @@ static void inject_json(cJSON *json_obj, cJSON *thermal_data, const struct timev
     }
 }
 
-/* Run the bridge - spawn cmg-cli and inject thermal data */
-int bridge_run(FuseBridge *bridge) {
-    /* Initialize boards first (before forking) */
-    if (bridge_init_boards(bridge) != 0) {
-        fprintf(stderr, "Error: Failed to initialize thermal boards\n");
-        return 1;
+/*
+ * Open a pseudo-terminal for the producer's stdout.
+ * A child writing to a tty line-buffers natively, so no stdbuf/LD_PRELOAD
+ * shim is needed. The slave is put in raw mode to avoid "\n" -> "\r\n".
+ */
+static int open_producer_pty(int *master_fd, int *slave_fd) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master == -1) {
+        perror("posix_openpt");
+        return -1;
     }
     
-    int pipefd[2];
-    if (pipe(pipefd) == -1) {
-        perror("pipe");
-        return 1;
+    if (grantpt(master) == -1 || unlockpt(master) == -1) {
+        perror("grantpt/unlockpt");
+        close(master);
+        return -1;
+    }
+    
+    const char *slave_name = ptsname(master);
+    int slave = slave_name ? open(slave_name, O_RDWR | O_NOCTTY) : -1;
+    if (slave == -1) {
+        perror("open pty slave");
+        close(master);
+        return -1;
+    }
+    
+    struct termios tio;
+    if (tcgetattr(slave, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
     }
     
+    *master_fd = master;
+    *slave_fd = slave;
+    return 0;
+}
+
+/* Spawn the producer with stdout on a pty/pipe; returns read stream or NULL */
+static FILE* spawn_producer(FuseBridge *bridge, pid_t *pid_out) {
+    /* read_fd: parent end, write_fd: child's stdout */
+    int read_fd, write_fd;
+    if (bridge->use_pty) {
+        if (open_producer_pty(&read_fd, &write_fd) != 0) {
+            return NULL;
+        }
+    } else {
+        int pipefd[2];
+        if (pipe(pipefd) == -1) {
+            perror("pipe");
+            return NULL;
+        }
+        read_fd = pipefd[0];
+        write_fd = pipefd[1];
+    }
+    
+    DEBUG_PRINT("Spawning producer '%s' (%s)", bridge->argv[0], bridge->use_pty ? "pty" : "pipe");
+    
     pid_t pid = fork();
     if (pid == -1) {
         perror("fork");
-        return 1;
+        close(read_fd);
+        close(write_fd);
+        return NULL;
     }
     
     if (pid == 0) {
-        /* Child process - execute cmg-cli */
-        close(pipefd[0]); /* Close read end */
-        dup2(pipefd[1], STDOUT_FILENO); /* Redirect stdout to pipe */
-        close(pipefd[1]);
-        
-        /* Build command: stdbuf -oL -eL cmg-cli get <args> */
-        char **cmd_args = (char**)malloc((bridge->arg_count + 6) * sizeof(char*));
-        cmd_args[0] = "stdbuf";
-        cmd_args[1] = "-oL";
-        cmd_args[2] = "-eL";
-        cmd_args[3] = "cmg-cli";
-        cmd_args[4] = "get";
-        
-        for (int i = 0; i < bridge->arg_count; i++) {
-            cmd_args[5 + i] = bridge->args[i];
-        }
-        cmd_args[5 + bridge->arg_count] = NULL;
+        /* Child process - execute producer */
+        close(read_fd);
+        dup2(write_fd, STDOUT_FILENO); /* Redirect stdout to pipe/pty */
+        close(write_fd);
         
-        execvp("stdbuf", cmd_args);
+        execvp(bridge->argv[0], bridge->argv);
         perror("execvp");
         exit(1);
-    } else {
-        /* Parent process - read JSON lines and inject thermal data */
-        close(pipefd[1]); /* Close write end */
+    }
+    
+    /* Parent: child holds the only writer; EOF (or EIO on a pty) when it exits */
+    close(write_fd);
+    
+    FILE *fp = fdopen(read_fd, "r");
+    if (!fp) {
+        perror("fdopen");
+        close(read_fd);
+    }
+    *pid_out = pid;
+    return fp;
+}
+
+/* Open an existing NDJSON stream: "-" = stdin, Unix socket (connect), or FIFO/file */
+static FILE* open_input(const char *path) {
+    if (strcmp(path, "-") == 0) {
+        return stdin;
+    }
+    
+    struct stat st;
+    if (stat(path, &st) == -1) {
+        fprintf(stderr, "Error: Cannot access input '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+    
+    if (S_ISSOCK(st.st_mode)) {
+        struct sockaddr_un addr;
+        if (strlen(path) >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "Error: Socket path too long: %s\n", path);
+            return NULL;
+        }
         
-        FILE *fp = fdopen(pipefd[0], "r");
-        if (!fp) {
-            perror("fdopen");
-            return 1;
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd == -1) {
+            perror("socket");
+            return NULL;
         }
         
-        /* Install signal handlers for graceful shutdown */
-        signals_install_handlers();
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+            fprintf(stderr, "Error: Cannot connect to '%s': %s\n", path, strerror(errno));
+            close(fd);
+            return NULL;
+        }
         
-        char line[4096];
+        DEBUG_PRINT("Connected to input socket %s", path);
+        return fdopen(fd, "r");
+    }
+    
+    /* FIFO or regular file (open blocks until a FIFO has a writer) */
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open input '%s': %s\n", path, strerror(errno));
+    }
+    return fp;
+}
+
+/* Read JSON lines from fp, inject thermal data, queue for the stdout writer */
+static void bridge_pump(FuseBridge *bridge, FILE *fp) {
+    char line[4096];
+    trace_thread_register("pump");
+    
+    for (;;) {
+        /* Time spent waiting on the producer, then one span per line */
+        trace_begin("wait_line");
+        char *got = g_running ? fgets(line, sizeof(line), fp) : NULL;
+        trace_end("wait_line");
+        if (!got) break;
+        jitter_mark();
+        TRACE_SCOPE("record");
+        metrics_add(METRIC_RECORDS_IN, 1);
         
-        while (g_running && fgets(line, sizeof(line), fp)) {
-            /* Remove trailing newline */
-            size_t len = strlen(line);
-            if (len > 0 && line[len - 1] == '\n') {
-                line[len - 1] = '\0';
-            }
-            
-            /* Skip empty lines */
-            if (strlen(line) == 0) {
-                printf("\n");
-                fflush(stdout);
-                continue;
-            }
-            
-            /* Capture timestamp when data arrives */
-            struct timeval tv;
-            gettimeofday(&tv, NULL);
-            
-            /* Try to parse as JSON */
-            cJSON *json_obj = cJSON_Parse(line);
-            if (json_obj) {
-                /* Get thermal data and inject */
-                cJSON *thermal_data = get_thermal_data(bridge);
-                inject_json(json_obj, thermal_data, &tv, bridge->time_format);
-                
-                char *output = cJSON_PrintUnformatted(json_obj);
-                printf("%s\n", output);
-                fflush(stdout);
-                
-                free(output);
-                cJSON_Delete(json_obj);
-                cJSON_Delete(thermal_data);
-            } else {
-                /* Not JSON - pass through unchanged */
-                printf("%s\n", line);
-                fflush(stdout);
-            }
+        /* Remove trailing newline */
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] == '\n') {
+            line[len - 1] = '\0';
         }
         
-        fclose(fp);
+        /* Skip empty lines */
+        if (strlen(line) == 0) {
+            output_queue_push_line(bridge->output, "");
+            continue;
+        }
         
-        /* Wait for child process */
-        int status;
-        waitpid(pid, &status, 0);
+        /* Capture timestamp when data arrives */
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
         
-        if (WIFEXITED(status)) {
-            return WEXITSTATUS(status);
+        /* Try to parse as JSON */
+        trace_begin("parse");
+        cJSON *json_obj = cJSON_Parse(line);
+        trace_end("parse");
+        if (json_obj) {
+            /* Get thermal data and inject */
+            cJSON *thermal_data = get_thermal_data(bridge);
+            bridge_inject_json(json_obj, thermal_data, &tv, bridge->time_format);
+            cJSON_Delete(thermal_data);
+            
+            /* Serialized and written by the writer thread; never blocks reading */
+            trace_begin("push");
+            output_queue_push_json(bridge->output, json_obj,
+                                   (int64_t)tv.tv_sec * 1000000 + tv.tv_usec);
+            trace_end("push");
         } else {
-            return 1;
+            /* Not JSON - pass through unchanged */
+            output_queue_push_line(bridge->output, line);
         }
+        stats_report_due();
+        jitter_report_due();
+    }
+}
+
+/* Run the line pump with the sink writer thread attached */
+static int bridge_pump_with_queue(FuseBridge *bridge, FILE *fp, SinkSet *sinks) {
+    bridge->output = output_queue_create(bridge->queue_depth, bridge->output_policy, sinks);
+    if (!bridge->output) {
+        return -1;
     }
     
+    bridge_pump(bridge, fp);
+    
+    output_queue_close(bridge->output);
+    bridge->output = NULL;
     return 0;
 }
 
+/* Run the bridge - read producer/input lines and inject thermal data */
+int bridge_run(FuseBridge *bridge) {
+    /* Initialize boards first (before forking) */
+    if (bridge_init_boards(bridge) != 0) {
+        fprintf(stderr, "Error: Failed to initialize thermal boards\n");
+        return 1;
+    }
+    
+    /* Open outputs before starting anything that produces data */
+    SinkSet *sinks = sink_set_open(bridge->sinks, bridge->sink_count);
+    if (!sinks) {
+        return 1;
+    }
+    
+    /* Existing stream: no child to manage */
+    if (bridge->input_path) {
+        FILE *fp = open_input(bridge->input_path);
+        if (!fp) {
+            sink_set_close(sinks);
+            return 1;
+        }
+        
+        signals_install_handlers();
+        int result = bridge_pump_with_queue(bridge, fp, sinks) == 0 ? 0 : 1;
+        
+        if (fp != stdin) {
+            fclose(fp);
+        }
+        sink_set_close(sinks);
+        return result;
+    }
+    
+    pid_t pid;
+    FILE *fp = spawn_producer(bridge, &pid);
+    if (!fp) {
+        sink_set_close(sinks);
+        return 1;
+    }
+    
+    /* Install signal handlers for graceful shutdown */
+    signals_install_handlers();
+    
+    bridge_pump_with_queue(bridge, fp, sinks);
+    
+    fclose(fp);
+    sink_set_close(sinks);
+    
+    /* Wait for child process */
+    int status;
+    waitpid(pid, &status, 0);
+    
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    } else {
+        return 1;
+    }
+}
+
+/* Long-only option codes */
+enum {
+    OPT_OUTPUT_POLICY = 256,
+    OPT_QUEUE_DEPTH,
+    OPT_SINK,
+    OPT_FILTER,
+    OPT_DEADBAND,
+    OPT_TRACE,
+    OPT_STATS,
+    OPT_METRICS,
+    OPT_JITTER
+};
+
+/* Split a command string into argv in place: words are separated by spaces
+ * or tabs, and '...' or "..." keep them in a word (no escapes). Returns the
+ * word count, or -1 if there are more than max_words or a quote is left open. */
+static int split_command(char *command, char **words, int max_words) {
+    int count = 0;
+    char *in = command;
+    char *out = command;
+    for (;;) {
+        while (*in == ' ' || *in == '\t') in++;
+        if (*in == '\0') return count;
+        if (count == max_words) {
+            fprintf(stderr, "Error: --command has more than %d words\n", max_words);
+            return -1;
+        }
+        
+        words[count++] = out;
+        char quote = 0;
+        while (*in != '\0' && (quote || (*in != ' ' && *in != '\t'))) {
+            if (quote ? *in == quote : (*in == '\'' || *in == '"')) {
+                quote = quote ? 0 : *in;
+                in++;
+            } else {
+                *out++ = *in++;
+            }
+        }
+        if (quote) {
+            fprintf(stderr, "Error: Unterminated %c in --command\n", quote);
+            return -1;
+        }
+        if (*in != '\0') in++;
+        *out++ = '\0';
+    }
+}
+
+/* Print fuse usage to stderr */
+static void fuse_usage(void) {
+    fprintf(stderr, "Usage: thermo-cli fuse [OPTIONS] -- [producer arguments...]\n");
+    fprintf(stderr, "\nOptions:\n");
+    fprintf(stderr, "  -C, --config FILE      Path to YAML/JSON config file\n");
+    fprintf(stderr, "  -a, --address NUM      Single mode: Board address\n");
+    fprintf(stderr, "  -c, --channel NUM      Single mode: Channel index\n");
+    fprintf(stderr, "  -k, --key NAME         Single mode: JSON key to inject [default: TEMP_FUSED]\n\n");
+    fprintf(stderr, "  -t, --tc-type TYPE     Thermocouple type (default: K)\n");
+    fprintf(stderr, "  -T, --time-format FMT  Timestamp format (default: %%Y-%%m-%%dT%%H:%%M:%%S.%%f)\n");
+    fprintf(stderr, "                         Use %%f for 6-digit microseconds\n");
+    fprintf(stderr, "  -x, --command CMD      Producer command [default: '%s']\n", BRIDGE_DEFAULT_COMMAND);
+    fprintf(stderr, "  -p, --pipe             Read producer over a plain pipe instead of a pty\n");
+    fprintf(stderr, "  -s, --stdin            Fuse NDJSON read from stdin (no producer is spawned)\n");
+    fprintf(stderr, "  -i, --input PATH       Fuse NDJSON read from a FIFO, file or Unix socket\n");
+    fprintf(stderr, "      --output-policy P  When stdout falls behind: block, drop-oldest, coalesce [default: block]\n");
+    fprintf(stderr, "      --queue-depth N    Records buffered ahead of stdout [default: %d]\n", OUTPUT_QUEUE_DEFAULT_DEPTH);
+    fprintf(stderr, "      --sink SPEC        Output destination, repeatable [default: stdout]\n");
+    fprintf(stderr, "                         KIND[:TARGET][,format=json|csv|binary][,rotate-size=N][,rotate-time=T][,fsync=C]\n");
+    fprintf(stderr, "      --filter SPEC      Filter for sources without one in the config, applied per record\n");
+    fprintf(stderr, "                         boxcar:N, ema:ALPHA, median:N, comma-chained\n");
+    fprintf(stderr, "      --deadband SPEC    Change-only TEMP for sources without one in the config:\n");
+    fprintf(stderr, "                         BAND (degC) or BAND%% (relative), optional /HEARTBEAT seconds\n");
+    fprintf(stderr, "      --trace FILE       Record a Chrome/Perfetto trace of the run into FILE\n");
+    fprintf(stderr, "      --stats[=SECS]     Latency histograms of board reads and writes: a JSON stats\n");
+    fprintf(stderr, "                         record on stderr every SECS [default: %.0f], summary on exit\n", STATS_DEFAULT_INTERVAL_S);
+    fprintf(stderr, "      --metrics ADDR     Serve Prometheus metrics on unix:PATH or tcp:[HOST:]PORT\n");
+    fprintf(stderr, "                         (HOST defaults to 127.0.0.1)\n");
+    fprintf(stderr, "      --jitter[=SECS]    Producer line intervals vs. their median: a JSON jitter\n");
+    fprintf(stderr, "                         record on stderr every SECS [default: %.0f], summary on exit\n", JITTER_DEFAULT_INTERVAL_S);
+    fprintf(stderr, "\nNote: Data fusion only works with JSON output from the producer.\n");
+    fprintf(stderr, "      For cmg-cli, the --json flag will be added automatically if not specified.\n");
+    fprintf(stderr, "\nExamples:\n");
+    fprintf(stderr, "  thermo-cli fuse --address 0 --channel 1 --key MY_TEMP -- --power\n");
+    fprintf(stderr, "  thermo-cli fuse --config config.yaml -- --actuator --stream 5\n");
+    fprintf(stderr, "  thermo-cli fuse -a 0 -c 0 -T '%%H:%%M:%%S.%%f' -- --power\n");
+    fprintf(stderr, "  thermo-cli fuse -C config.yaml -x 'imu-logger --ndjson'\n");
+    fprintf(stderr, "  cmg-cli get --power --json | thermo-cli fuse -C config.yaml --stdin\n");
+    fprintf(stderr, "  thermo-cli fuse -C config.yaml --sink stdout --sink file:run.csv,rotate-size=100M -- --power\n");
+}
+
 /* Command: fuse - Fuse thermal data into cmg-cli output */
 int cmd_fuse(int argc, char **argv) {
     char *config_path = NULL;
@@ -295,9 +649,25 @@ int cmd_fuse(int argc, char **argv) {
     char key[64] = "TEMP_FUSED";
     char tc_type[8] = "K";
     char time_format[64] = "%Y-%m-%dT%H:%M:%S.%f";  /* Default with microseconds */
-    
-    /* Find '--' separator */
-    int separator_idx = -1;
+    char command[256] = BRIDGE_DEFAULT_COMMAND;
+    int custom_command = 0;
+    int use_pty = 1;
+    const char *input_path = NULL;
+    OutputPolicy output_policy = OUTPUT_POLICY_BLOCK;
+    int queue_depth = OUTPUT_QUEUE_DEFAULT_DEPTH;
+    SinkSpec sinks[MAX_SINKS];
+    int sink_count = 0;
+    FilterSpec cli_filter = {0};
+    DeadbandSpec cli_deadband = {0};
+    const char *trace_path = NULL;
+    int stats_enabled = 0;
+    double stats_interval = 0;
+    const char *metrics_endpoint = NULL;
+    int jitter_enabled = 0;
+    double jitter_interval = 0;
+    
+    /* Find '--' separator (options after it belong to the producer) */
+    int separator_idx = argc;
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--") == 0) {
             separator_idx = i;
@@ -305,26 +675,6 @@ int cmd_fuse(int argc, char **argv) {
         }
     }
     
-    if (separator_idx == -1) {
-        fprintf(stderr, "Error: No '--' separator found\n");
-        fprintf(stderr, "Usage: thermo-cli fuse [OPTIONS] -- [cmg-cli arguments...]\n");
-        fprintf(stderr, "\nOptions:\n");
-        fprintf(stderr, "  -C, --config FILE      Path to YAML/JSON config file\n");
-        fprintf(stderr, "  -a, --address NUM      Single mode: Board address\n");
-        fprintf(stderr, "  -c, --channel NUM      Single mode: Channel index\n");
-        fprintf(stderr, "  -k, --key NAME         Single mode: JSON key to inject [default: TEMP_FUSED]\n\n");
-        fprintf(stderr, "  -t, --tc-type TYPE     Thermocouple type (default: K)\n");
-        fprintf(stderr, "  -T, --time-format FMT  Timestamp format (default: %%Y-%%m-%%dT%%H:%%M:%%S.%%f)\n");
-        fprintf(stderr, "                         Use %%f for 6-digit microseconds\n");
-        fprintf(stderr, "\nNote: Data fusion only works with JSON output from cmg-cli.\n");
-        fprintf(stderr, "      The --json flag will be added automatically if not specified.\n");
-        fprintf(stderr, "\nExamples:\n");
-        fprintf(stderr, "  thermo-cli fuse --address 0 --channel 1 --key MY_TEMP -- --power\n");
-        fprintf(stderr, "  thermo-cli fuse --config config.yaml -- --actuator --stream 5\n");
-        fprintf(stderr, "  thermo-cli fuse -a 0 -c 0 -T '%%H:%%M:%%S.%%f' -- --power\n");
-        return 1;
-    }
-    
     /* Parse options before '--' */
     optind = 1; /* Reset getopt */
     static struct option long_options[] = {
@@ -334,12 +684,25 @@ int cmd_fuse(int argc, char **argv) {
         {"key", required_argument, 0, 'k'},
         {"tc-type", required_argument, 0, 't'},
         {"time-format", required_argument, 0, 'T'},
+        {"command", required_argument, 0, 'x'},
+        {"pipe", no_argument, 0, 'p'},
+        {"stdin", no_argument, 0, 's'},
+        {"input", required_argument, 0, 'i'},
+        {"output-policy", required_argument, 0, OPT_OUTPUT_POLICY},
+        {"queue-depth", required_argument, 0, OPT_QUEUE_DEPTH},
+        {"sink", required_argument, 0, OPT_SINK},
+        {"filter", required_argument, 0, OPT_FILTER},
+        {"deadband", required_argument, 0, OPT_DEADBAND},
+        {"trace", required_argument, 0, OPT_TRACE},
+        {"stats", optional_argument, 0, OPT_STATS},
+        {"metrics", required_argument, 0, OPT_METRICS},
+        {"jitter", optional_argument, 0, OPT_JITTER},
         {0, 0, 0, 0}
     };
     
     int opt;
     while (optind < separator_idx && 
-           (opt = getopt_long(separator_idx, argv, "C:a:c:k:t:T:", long_options, NULL)) != -1) {
+           (opt = getopt_long(separator_idx, argv, "C:a:c:k:t:T:x:psi:", long_options, NULL)) != -1) {
         switch (opt) {
             case 'C': config_path = optarg; break;
             case 'a': address = atoi(optarg); break;
@@ -347,12 +710,110 @@ int cmd_fuse(int argc, char **argv) {
             case 'k': strncpy(key, optarg, sizeof(key) - 1); break;
             case 't': strncpy(tc_type, optarg, sizeof(tc_type) - 1); break;
             case 'T': strncpy(time_format, optarg, sizeof(time_format) - 1); break;
+            case 'x':
+                if (strlen(optarg) >= sizeof(command)) {
+                    fprintf(stderr, "Error: --command is longer than %zu characters\n", sizeof(command) - 1);
+                    return 1;
+                }
+                strcpy(command, optarg);
+                custom_command = 1;
+                break;
+            case 'p': use_pty = 0; break;
+            case 's': input_path = "-"; break;
+            case 'i': input_path = optarg; break;
+            case OPT_OUTPUT_POLICY:
+                if (output_policy_from_string(optarg, &output_policy) != THERMO_SUCCESS) {
+                    fprintf(stderr, "Error: Invalid --output-policy '%s' (block, drop-oldest, coalesce)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_QUEUE_DEPTH: queue_depth = atoi(optarg); break;
+            case OPT_SINK:
+                if (sink_count >= MAX_SINKS) {
+                    fprintf(stderr, "Error: At most %d --sink options\n", MAX_SINKS);
+                    return 1;
+                }
+                if (sink_spec_parse(optarg, &sinks[sink_count]) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                sink_count++;
+                break;
+            case OPT_FILTER:
+                if (filter_spec_parse(optarg, &cli_filter) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                break;
+            case OPT_DEADBAND:
+                if (deadband_spec_parse(optarg, &cli_deadband) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                break;
+            case OPT_TRACE: trace_path = optarg; break;
+            case OPT_STATS:
+                if (stats_parse_interval(optarg, &stats_interval) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                stats_enabled = 1;
+                break;
+            case OPT_METRICS: metrics_endpoint = optarg; break;
+            case OPT_JITTER:
+                if (jitter_parse_interval(optarg, &jitter_interval) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                jitter_enabled = 1;
+                break;
             default:
-                fprintf(stderr, "Usage: thermo-cli fuse [OPTIONS] -- [cmg-cli arguments...]\n");
+                fuse_usage();
                 return 1;
         }
     }
     
+    if (trace_path && trace_start(trace_path) != THERMO_SUCCESS) {
+        return 1;
+    }
+    if (stats_enabled) {
+        stats_enable(stats_interval);
+    }
+    if (jitter_enabled) {
+        jitter_enable(jitter_interval, 0);
+    }
+    
+    if (input_path && (custom_command || separator_idx < argc)) {
+        fprintf(stderr, "Error: --stdin/--input cannot be combined with --command or '--' arguments\n");
+        return 1;
+    }
+    
+    /* Default cmg-cli producer needs its arguments after '--' */
+    if (!input_path && !custom_command && separator_idx == argc) {
+        fprintf(stderr, "Error: No '--' separator found\n");
+        fuse_usage();
+        return 1;
+    }
+    
+    /* Extract arguments after '--' */
+    char **fuse_args = separator_idx < argc ? &argv[separator_idx + 1] : NULL;
+    int fuse_arg_count = separator_idx < argc ? argc - separator_idx - 1 : 0;
+    
+    if (!input_path && !custom_command && fuse_arg_count == 0) {
+        fprintf(stderr, "Error: No arguments provided after '--'\n");
+        return 1;
+    }
+    
+    if (sink_count == 0) {
+        sink_spec_default(&sinks[sink_count++]);
+    }
+    
+    /* Split producer command into words */
+    char *command_words[32];
+    int command_word_count = split_command(command, command_words, 32);
+    if (command_word_count < 0) {
+        return 1;
+    }
+    if (command_word_count == 0) {
+        fprintf(stderr, "Error: Empty --command\n");
+        return 1;
+    }
+    
     /* Prepare sources */
     Config config = {0};
     ThermalSource single_source = {0};
@@ -384,49 +845,70 @@ int cmd_fuse(int argc, char **argv) {
         return 1;
     }
     
-    /* Extract arguments after '--' */
-    char **fuse_args = &argv[separator_idx + 1];
-    int fuse_arg_count = argc - separator_idx - 1;
+    /* --filter covers sources without a filter of their own */
+    for (int i = 0; i < source_count && cli_filter.count > 0; i++) {
+        if (sources[i].filter.count == 0) {
+            sources[i].filter = cli_filter;
+        }
+    }
+    for (int i = 0; i < source_count && cli_deadband.enabled; i++) {
+        if (!sources[i].deadband.enabled) {
+            sources[i].deadband = cli_deadband;
+        }
+    }
     
-    if (fuse_arg_count == 0) {
-        fprintf(stderr, "Error: No arguments provided after '--'\n");
+    if (metrics_endpoint && metrics_start(metrics_endpoint, sources, source_count) != THERMO_SUCCESS) {
+        if (config_path) {
+            config_free(&config);
+        }
         return 1;
     }
     
-    /* Check if --json or -j is already present */
-    int has_json_flag = 0;
-    for (int i = 0; i < fuse_arg_count; i++) {
+    /* cmg-cli (by any path, default or --command) only emits JSON with --json or -j */
+    const char *program = strrchr(command_words[0], '/');
+    program = program ? program + 1 : command_words[0];
+    int has_json_flag = input_path || strcmp(program, "cmg-cli") != 0;
+    for (int i = 1; i < command_word_count && !has_json_flag; i++) {
+        if (strcmp(command_words[i], "--json") == 0 || strcmp(command_words[i], "-j") == 0) {
+            has_json_flag = 1;
+        }
+    }
+    for (int i = 0; i < fuse_arg_count && !has_json_flag; i++) {
         if (strcmp(fuse_args[i], "--json") == 0 || strcmp(fuse_args[i], "-j") == 0) {
             has_json_flag = 1;
-            break;
         }
     }
     
-    /* Build final args, adding --json if needed */
-    char **final_args = NULL;
-    int final_arg_count = fuse_arg_count;
-    
+    /* Build producer command line: command words + args (+ --json) */
+    int final_arg_count = command_word_count + fuse_arg_count + (has_json_flag ? 0 : 1);
+    char **final_args = (char**)malloc(final_arg_count * sizeof(char*));
+    int n = 0;
+    for (int i = 0; i < command_word_count; i++) {
+        final_args[n++] = command_words[i];
+    }
+    for (int i = 0; i < fuse_arg_count; i++) {
+        final_args[n++] = fuse_args[i];
+    }
     if (!has_json_flag) {
-        /* Add --json flag */
-        final_arg_count = fuse_arg_count + 1;
-        final_args = (char**)malloc(final_arg_count * sizeof(char*));
-        for (int i = 0; i < fuse_arg_count; i++) {
-            final_args[i] = fuse_args[i];
-        }
-        final_args[fuse_arg_count] = "--json";
-    } else {
-        final_args = fuse_args;
+        final_args[n++] = "--json";
     }
     
     /* Create and run bridge */
-    FuseBridge *bridge = bridge_create(sources, source_count, final_args, final_arg_count, time_format);
+    BridgeOptions opts = {
+        .time_format = time_format,
+        .use_pty = use_pty,
+        .input_path = input_path,
+        .output_policy = output_policy,
+        .queue_depth = queue_depth,
+        .sinks = sinks,
+        .sink_count = sink_count
+    };
+    FuseBridge *bridge = bridge_create(sources, source_count, final_args, final_arg_count, &opts);
     int exit_code = bridge_run(bridge);
     bridge_free(bridge);
+    metrics_stop();
     
-    /* Free allocated args array if we created one */
-    if (!has_json_flag) {
-        free(final_args);
-    }
+    free(final_args);
     
     if (config_path) {
         config_free(&config);
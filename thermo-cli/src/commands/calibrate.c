@@ -0,0 +1,393 @@
+/*
+ * Calibrate command implementation.
+ * Samples uncalibrated ADC voltage and CJC on every selected channel at once
+ * while the thermocouples are held at reference temperatures, then fits each
+ * channel's slope/offset by least squares against the NIST reference voltage
+ * (E(T_ref) - E(T_cjc)). Statistics are accumulated sample by sample, so
+ * nothing is buffered however long a point is held.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "commands/calibrate.h"
+#include "board_manager.h"
+#include "common.h"
+#include "hardware.h"
+#include "signals.h"
+#include "thermocouple.h"
+#include "utils.h"
+
+#define CAL_MAX_POINTS 16
+#define CAL_DEFAULT_SAMPLES 10
+
+/* Running sums for one series (Welford), shared by the per-point and fit statistics */
+typedef struct {
+    long n;
+    double mean_x;
+    double mean_y;
+    double m2_x;
+    double m2_y;
+    double c_xy;
+} CalAccum;
+
+/* Mean of one reference point on one channel */
+typedef struct {
+    double ref_c;
+    double raw_v;               /* Mean uncalibrated voltage */
+    double cjc_c;               /* Mean CJC temperature */
+    double noise_v;             /* Standard deviation of the voltage */
+    long samples;
+} CalPoint;
+
+typedef struct {
+    ThermalSource *source;
+    uint8_t tc_type;
+    CalibrationInfo current;
+    CalAccum fit;               /* x = raw voltage, y = reference voltage */
+    CalPoint points[CAL_MAX_POINTS];
+    int point_count;
+    long faults;
+    CalibrationInfo result;
+    double rms_v;               /* Residual of the fit */
+    double max_error_c;         /* Worst point error after calibration */
+    int fitted;
+} CalChannel;
+
+static void accum_add(CalAccum *acc, double x, double y) {
+    acc->n++;
+    double dx = x - acc->mean_x;
+    double dy = y - acc->mean_y;
+    acc->mean_x += dx / acc->n;
+    acc->mean_y += dy / acc->n;
+    acc->m2_x += dx * (x - acc->mean_x);
+    acc->m2_y += dy * (y - acc->mean_y);
+    acc->c_xy += dx * (y - acc->mean_y);
+}
+
+/* Parse "0,1,3" into a channel mask */
+static int parse_channel_list(const char *str, unsigned *mask) {
+    *mask = 0;
+    const char *p = str;
+    while (*p) {
+        char *end;
+        long ch = strtol(p, &end, 10);
+        if (end == p || ch < 0 || ch >= MCC134_NUM_CHANNELS || (*end != ',' && *end != '\0')) {
+            return THERMO_INVALID_PARAM;
+        }
+        *mask |= 1u << ch;
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return *mask ? THERMO_SUCCESS : THERMO_INVALID_PARAM;
+}
+
+/* Sample every channel for one reference point. Returns 0 if interrupted. */
+static int sample_point(CalChannel *channels, int count, double ref_c, int samples, uint8_t interval) {
+    CalAccum point[count];
+    memset(point, 0, sizeof(point));
+    
+    for (int s = 0; s < samples && g_running; s++) {
+        if (s > 0) {
+            sleep(interval);
+            if (!g_running) break;
+        }
+        for (int i = 0; i < count; i++) {
+            CalChannel *cc = &channels[i];
+            double raw, cjc;
+            if (thermo_read_adc_raw(cc->source->address, cc->source->channel, &raw) != THERMO_SUCCESS ||
+                thermo_read_cjc(cc->source->address, cc->source->channel, &cjc) != THERMO_SUCCESS ||
+                fabs(raw) >= MCC134_FULL_SCALE_V * 0.9999) {
+                cc->faults++;
+                continue;
+            }
+            double ref_v = (tc_temp_to_mv(cc->tc_type, ref_c) - tc_temp_to_mv(cc->tc_type, cjc)) / 1000.0;
+            accum_add(&cc->fit, raw, ref_v);
+            accum_add(&point[i], raw, cjc);
+        }
+        fprintf(stderr, "\r  sample %d/%d", s + 1, samples);
+    }
+    fprintf(stderr, "\n");
+    if (!g_running) return 0;
+    
+    for (int i = 0; i < count; i++) {
+        CalChannel *cc = &channels[i];
+        if (point[i].n == 0) {
+            fprintf(stderr, "  %-20s no valid samples (open or out of range?)\n", cc->source->key);
+            continue;
+        }
+        CalPoint *pt = &cc->points[cc->point_count++];
+        pt->ref_c = ref_c;
+        pt->raw_v = point[i].mean_x;
+        pt->cjc_c = point[i].mean_y;
+        pt->noise_v = point[i].n > 1 ? sqrt(point[i].m2_x / (point[i].n - 1)) : 0.0;
+        pt->samples = point[i].n;
+    
+        double ref_v = (tc_temp_to_mv(cc->tc_type, ref_c) - tc_temp_to_mv(cc->tc_type, pt->cjc_c)) / 1000.0;
+        fprintf(stderr, "  %-20s raw %10.3f uV  reference %10.3f uV  noise %.3f uV\n",
+                cc->source->key, pt->raw_v * 1e6, ref_v * 1e6, pt->noise_v * 1e6);
+    }
+    return 1;
+}
+
+/* Least squares over all samples. A single reference temperature can only
+ * fix the offset, so the current slope is kept. Offsets are in ADC counts. */
+static void fit_channel(CalChannel *cc) {
+    CalAccum *acc = &cc->fit;
+    if (cc->point_count == 0 || acc->n == 0) return;
+    
+    double slope = cc->current.slope;
+    int distinct = 0;
+    for (int p = 1; p < cc->point_count; p++) {
+        if (fabs(cc->points[p].ref_c - cc->points[0].ref_c) > 1.0) distinct = 1;
+    }
+    if (distinct && acc->m2_x > 0) {
+        slope = acc->c_xy / acc->m2_x;
+    }
+    double intercept_v = acc->mean_y - slope * acc->mean_x;
+    
+    double sse = acc->m2_y - 2 * slope * acc->c_xy + slope * slope * acc->m2_x;
+    cc->rms_v = sqrt(fmax(sse, 0.0) / acc->n);
+    cc->result.slope = slope;
+    cc->result.offset = intercept_v / MCC134_LSB_V;
+    cc->fitted = 1;
+    
+    /* Residual per point as a temperature, through the software linearization */
+    cc->max_error_c = 0.0;
+    for (int p = 0; p < cc->point_count; p++) {
+        const CalPoint *pt = &cc->points[p];
+        double temp = tc_linearize(cc->tc_type, slope * pt->raw_v + intercept_v, pt->cjc_c);
+        double error = fabs(temp - pt->ref_c);
+        if (error > cc->max_error_c) cc->max_error_c = error;
+    }
+}
+
+static void print_results(const CalChannel *channels, int count) {
+    printf("%-20s %4s %3s %6s %12s %12s %10s %10s\n",
+           "KEY", "ADDR", "CH", "POINTS", "SLOPE", "OFFSET", "RMS (uV)", "MAX (C)");
+    for (int i = 0; i < count; i++) {
+        const CalChannel *cc = &channels[i];
+        if (!cc->fitted) {
+            printf("%-20s %4d %3d %6d %12s\n", cc->source->key, cc->source->address,
+                   cc->source->channel, cc->point_count, "(no data)");
+            continue;
+        }
+        printf("%-20s %4d %3d %6d %12.6f %12.6f %10.3f %10.3f\n",
+               cc->source->key, cc->source->address, cc->source->channel, cc->point_count,
+               cc->result.slope, cc->result.offset, cc->rms_v * 1e6, cc->max_error_c);
+    }
+}
+
+/* Command: calibrate - Fit calibration coefficients from reference temperatures */
+int cmd_calibrate(int argc, char **argv) {
+    int address = 0;
+    const char *channel_list = "0";
+    const char *tc_type = "K";
+    char *config_path = NULL;
+    int samples = CAL_DEFAULT_SAMPLES;
+    int write_board = 0;
+    int update_config = 0;
+    
+    static struct option long_options[] = {
+        {"address", required_argument, 0, 'a'},
+        {"channel", required_argument, 0, 'c'},
+        {"tc-type", required_argument, 0, 't'},
+        {"config", required_argument, 0, 'C'},
+        {"samples", required_argument, 0, 'n'},
+        {"write", no_argument, 0, 'w'},
+        {"update-config", no_argument, 0, 'u'},
+        {0, 0, 0, 0}
+    };
+    
+    int opt;
+    while ((opt = getopt_long(argc, argv, "a:c:t:C:n:wu", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'a': address = atoi(optarg); break;
+            case 'c': channel_list = optarg; break;
+            case 't': tc_type = optarg; break;
+            case 'C': config_path = optarg; break;
+            case 'n': samples = atoi(optarg); break;
+            case 'w': write_board = 1; break;
+            case 'u': update_config = 1; break;
+            default:
+                fprintf(stderr, "Usage: thermo-cli calibrate [-a ADDR] [-c CH[,CH...]] [-t TYPE] "
+                                "[-C CONFIG] [-n SAMPLES] [--write] [--update-config]\n");
+                return 1;
+        }
+    }
+    
+    if (samples < 1) {
+        fprintf(stderr, "Error: --samples must be at least 1\n");
+        return 1;
+    }
+    if (update_config && !config_path) {
+        fprintf(stderr, "Error: --update-config requires --config\n");
+        return 1;
+    }
+    
+    /* Sources to calibrate: every source of the config, or the listed channels */
+    Config config = {0};
+    ThermalSource cli_sources[MCC134_NUM_CHANNELS];
+    ThermalSource *sources = cli_sources;
+    int source_count = 0;
+    if (config_path) {
+        if (config_load(config_path, &config) != THERMO_SUCCESS || config.source_count == 0) {
+            fprintf(stderr, "Error: Failed to load config file: %s\n", config_path);
+            config_free(&config);
+            return 1;
+        }
+        sources = config.sources;
+        source_count = config.source_count;
+    } else {
+        unsigned mask;
+        if (!validate_address(address) || parse_channel_list(channel_list, &mask) != THERMO_SUCCESS) {
+            fprintf(stderr, "Error: Invalid address or channel list '%s'\n", channel_list);
+            return 1;
+        }
+        for (int ch = 0; ch < MCC134_NUM_CHANNELS; ch++) {
+            if (!(mask & (1u << ch))) continue;
+            ThermalSource *src = &cli_sources[source_count++];
+            memset(src, 0, sizeof(*src));
+            snprintf(src->key, sizeof(src->key), "TEMP_%d_%d", address, ch);
+            src->address = (uint8_t)address;
+            src->channel = (uint8_t)ch;
+            snprintf(src->tc_type, sizeof(src->tc_type), "%s", tc_type);
+            src->cal_coeffs.slope = DEFAULT_CALIBRATION_SLOPE;
+            src->cal_coeffs.offset = DEFAULT_CALIBRATION_OFFSET;
+            src->update_interval = DEFAULT_UPDATE_INTERVAL;
+        }
+    }
+    
+    CalChannel *channels = calloc(source_count, sizeof(CalChannel));
+    if (!channels) {
+        fprintf(stderr, "Error: Failed to allocate memory\n");
+        config_free(&config);
+        return 1;
+    }
+    for (int i = 0; i < source_count; i++) {
+        channels[i].source = &sources[i];
+        channels[i].tc_type = thermo_tc_type_from_string(sources[i].tc_type);
+        if (channels[i].tc_type == TC_DISABLED) {
+            fprintf(stderr, "Error: Source %s: calibration needs a thermocouple type, not '%s'\n",
+                    sources[i].key, sources[i].tc_type);
+            free(channels);
+            config_free(&config);
+            return 1;
+        }
+    }
+    
+    BoardManager mgr;
+    if (board_manager_init(&mgr, sources, source_count) != THERMO_SUCCESS) {
+        free(channels);
+        config_free(&config);
+        return 1;
+    }
+    board_manager_configure(&mgr);
+    board_manager_wait_ready(&mgr);
+    
+    /* Pace samples at the slowest board's update interval so each is a new conversion */
+    uint8_t interval = DEFAULT_UPDATE_INTERVAL;
+    for (int i = 0; i < source_count; i++) {
+        uint8_t board_interval;
+        if (thermo_get_update_interval(sources[i].address, &board_interval) == THERMO_SUCCESS &&
+            board_interval > interval) {
+            interval = board_interval;
+        }
+        if (thermo_get_calibration_coeffs(sources[i].address, sources[i].channel,
+                                          &channels[i].current) != THERMO_SUCCESS) {
+            channels[i].current.slope = DEFAULT_CALIBRATION_SLOPE;
+            channels[i].current.offset = DEFAULT_CALIBRATION_OFFSET;
+        }
+    }
+    
+    signals_install_handlers();
+    
+    fprintf(stderr, "Calibrating %d channel%s, %d sample%s per point (%d s)\n",
+            source_count, source_count == 1 ? "" : "s", samples, samples == 1 ? "" : "s",
+            samples * interval);
+    int point_count = 0;
+    char line[128];
+    while (g_running && point_count < CAL_MAX_POINTS) {
+        fprintf(stderr, "Reference %d: hold all thermocouples at a known temperature and enter it "
+                        "in degC (blank line to fit): ", point_count + 1);
+        if (!fgets(line, sizeof(line), stdin)) break;
+        if (line[0] == '\n' || line[0] == '\0') break;
+    
+        char *end;
+        double ref_c = strtod(line, &end);
+        if (end == line || (*end != '\n' && *end != '\0')) {
+            fprintf(stderr, "Not a temperature: %s", line);
+            continue;
+        }
+        if (!sample_point(channels, source_count, ref_c, samples, interval)) break;
+        point_count++;
+    }
+    
+    if (!g_running) {
+        board_manager_close(&mgr);
+        free(channels);
+        config_free(&config);
+        return 1;
+    }
+    
+    int fitted = 0;
+    for (int i = 0; i < source_count; i++) {
+        fit_channel(&channels[i]);
+        fitted += channels[i].fitted;
+        if (channels[i].faults > 0) {
+            fprintf(stderr, "Warning: %s: %ld faulted sample%s skipped\n", channels[i].source->key,
+                    channels[i].faults, channels[i].faults == 1 ? "" : "s");
+        }
+    }
+    if (fitted == 0) {
+        fprintf(stderr, "Error: No reference points recorded\n");
+        board_manager_close(&mgr);
+        free(channels);
+        config_free(&config);
+        return 1;
+    }
+    if (point_count == 1) {
+        fprintf(stderr, "Note: one reference temperature fits the offset only; the current slope is kept\n");
+    }
+    print_results(channels, source_count);
+    
+    int result = 0;
+    
+    /* The board keeps these until it is opened again */
+    if (write_board) {
+        for (int i = 0; i < source_count; i++) {
+            CalChannel *cc = &channels[i];
+            if (!cc->fitted) continue;
+            if (thermo_set_calibration_coeffs(cc->source->address, cc->source->channel,
+                                              cc->result.slope, cc->result.offset) != THERMO_SUCCESS) {
+                fprintf(stderr, "Error: %s: failed to write calibration\n", cc->source->key);
+                result = 1;
+            }
+        }
+    }
+    
+    /* Persisted through the config, which get/fuse/set apply on every open */
+    if (update_config) {
+        ThermalSource updates[source_count];
+        int update_count = 0;
+        for (int i = 0; i < source_count; i++) {
+            if (!channels[i].fitted) continue;
+            updates[update_count] = *channels[i].source;
+            updates[update_count].cal_coeffs = channels[i].result;
+            update_count++;
+        }
+        if (config_update_calibration(config_path, updates, update_count) == THERMO_SUCCESS) {
+            printf("Updated %d source%s in %s\n", update_count, update_count == 1 ? "" : "s", config_path);
+        } else {
+            result = 1;
+        }
+    }
+    
+    board_manager_close(&mgr);
+    free(channels);
+    config_free(&config);
+    return result;
+}
@@ -9,6 +9,7 @@
 #include <getopt.h>
 #include <unistd.h>
 #include <time.h>
+#include <math.h>
 #include <daqhats/daqhats.h>
 
 #include "commands/get.h"
@@ -17,6 +18,13 @@
 #include "signals.h"
 #include "board_manager.h"
 #include "json_utils.h"
+#include "output_queue.h"
+#include "sink.h"
+#include "realtime.h"
+#include "deadband.h"
+#include "stats.h"
+#include "jitter.h"
+#include "metrics.h"
 
 #include "cJSON.h"
 
@@ -42,14 +50,50 @@ static void collected_data_free(CollectedData *data) {
  * NEW API using ChannelReading and BoardInfo
  * ============================================================================ */
 
-/* Collect dynamic readings from a channel (board must be open, TC type set) */
-int channel_reading_collect(ChannelReading *reading, uint8_t address, uint8_t channel,
+/* Collect dynamic readings from a channel (board must be open, TC type set).
+ * With mgr, the board's CJC from board_manager_read_cjc() is used instead of a per-channel read,
+ * the temperature's fault status is tracked and a backed-off channel is not read at all. */
+int channel_reading_collect(ChannelReading *reading, BoardManager *mgr,
+                           uint8_t address, uint8_t channel, uint8_t tc_type,
                            int get_temp, int get_adc, int get_cjc) {
     channel_reading_init(reading, address, channel);
     
+    /* Backed off: repeat the last fault without touching the bus */
+    if (mgr && get_temp && !board_manager_read_due(mgr, address, channel)) {
+        reading->status = board_manager_status(mgr, address, channel);
+        reading->temperature = thermo_status_value(reading->status);
+        reading->has_temp = 1;
+        return THERMO_SUCCESS;
+    }
+    
+    double board_cjc;
+    int have_cjc = mgr && board_manager_get_cjc(mgr, address, &board_cjc) == THERMO_SUCCESS;
+    
+    /* Temperature is linearized from the same voltage/CJC pair, so those come for free */
     if (get_temp) {
-        if (thermo_read_temp(address, channel, &reading->temperature) == THERMO_SUCCESS) {
-            reading->has_temp = 1;
+        int result;
+        if (have_cjc) {
+            reading->cjc_temp = board_cjc;
+            result = thermo_linearize_reading(address, channel, tc_type, board_cjc,
+                                              &reading->temperature, &reading->adc_voltage);
+        } else {
+            result = thermo_read_linearized(address, channel, tc_type, &reading->temperature,
+                                            &reading->adc_voltage, &reading->cjc_temp);
+        }
+        if (result == THERMO_SUCCESS) {
+            reading->status = thermo_classify_temp(reading->temperature);
+            reading->has_adc = get_adc;
+            reading->has_cjc = get_cjc;
+        } else {
+            reading->status = READING_READ_ERROR;
+            reading->temperature = NAN;
+        }
+        reading->has_temp = 1;
+        if (mgr) {
+            board_manager_report(mgr, address, channel, (ReadingStatus)reading->status);
+        }
+        if (result == THERMO_SUCCESS) {
+            return THERMO_SUCCESS;
         }
     }
     
@@ -60,7 +104,10 @@ int channel_reading_collect(ChannelReading *reading, uint8_t address, uint8_t ch
     }
     
     if (get_cjc) {
-        if (thermo_read_cjc(address, channel, &reading->cjc_temp) == THERMO_SUCCESS) {
+        if (have_cjc) {
+            reading->cjc_temp = board_cjc;
+            reading->has_cjc = 1;
+        } else if (thermo_read_cjc(address, channel, &reading->cjc_temp) == THERMO_SUCCESS) {
             reading->has_cjc = 1;
         }
     }
@@ -68,8 +115,8 @@ int channel_reading_collect(ChannelReading *reading, uint8_t address, uint8_t ch
     return THERMO_SUCCESS;
 }
 
-/* Collect board info (board must be open) */
-int board_info_collect(BoardInfo *info, uint8_t address, uint8_t channel,
+/* Collect board info (board must be open for coefficients and interval) */
+int board_info_collect(BoardInfo *info, Inventory *inv, uint8_t address, uint8_t channel,
                       int get_serial, int get_cal_date, int get_cal_coeffs, int get_interval) {
     /* Initialize only if address doesn't match (allows accumulating data for multiple channels) */
     if (info->address != address) {
@@ -77,7 +124,11 @@ int board_info_collect(BoardInfo *info, uint8_t address, uint8_t channel,
     }
     
     if (get_serial && info->serial[0] == '\0') {
-        thermo_get_serial(address, info->serial, sizeof(info->serial));
+        if (inv) {
+            inventory_get_serial(inv, address, info->serial, sizeof(info->serial));
+        } else {
+            thermo_get_serial(address, info->serial, sizeof(info->serial));
+        }
     }
     
     if (get_interval) {
@@ -85,7 +136,10 @@ int board_info_collect(BoardInfo *info, uint8_t address, uint8_t channel,
     }
     
     if (channel < MCC134_NUM_CHANNELS) {
-        if (get_cal_date) {
+        if (get_cal_date && inv) {
+            inventory_get_cal_date(inv, address, info->channels[channel].cal_date,
+                                   sizeof(info->channels[channel].cal_date));
+        } else if (get_cal_date) {
             thermo_get_calibration_date(address, info->channels[channel].cal_date,
                                        sizeof(info->channels[channel].cal_date));
         }
@@ -124,12 +178,19 @@ static int collect_channels(ThermalSource *sources, int source_count, CollectedD
     }
     out->board_count = 0;
     
-    /* Initialize BoardManager */
-    if (board_manager_init(mgr_out, sources, source_count) != THERMO_SUCCESS) {
+    /* Serial and calibration date come from the inventory cache: boards are
+     * only opened when something must actually be read from them */
+    int needs_boards = get_temp || get_adc || get_cjc || get_cal_coeffs || get_interval;
+    int init_result = needs_boards ? board_manager_init(mgr_out, sources, source_count)
+                                   : board_manager_init_static(mgr_out, sources, source_count);
+    if (init_result != THERMO_SUCCESS) {
         collected_data_free(out);
         return THERMO_ERROR;
     }
-    board_manager_configure(mgr_out);
+    if (needs_boards) {
+        board_manager_configure(mgr_out);
+        board_manager_wait_ready(mgr_out);
+    }
     
     DEBUG_PRINT("Beginning data collection for %d sources", source_count);
     
@@ -144,14 +205,18 @@ static int collect_channels(ThermalSource *sources, int source_count, CollectedD
         }
         
         /* Collect per-channel board info */
-        board_info_collect(&out->board_infos[addr], addr, sources[i].channel,
+        board_info_collect(&out->board_infos[addr], &mgr_out->inventory, addr, sources[i].channel,
                           get_serial, get_cal_date, get_cal_coeffs, get_interval);
     }
     
-    /* Collect dynamic readings */
+    /* Collect dynamic readings (CJC once per board) */
+    if (get_temp || get_cjc) {
+        board_manager_read_cjc(mgr_out);
+    }
     for (int i = 0; i < source_count; i++) {
-        channel_reading_collect(&out->readings[i], 
+        channel_reading_collect(&out->readings[i], mgr_out,
                                sources[i].address, sources[i].channel,
+                               thermo_tc_type_from_string(sources[i].tc_type),
                                get_temp, get_adc, get_cjc);
         DEBUG_PRINT("Reading collected for address %d, channel %d", 
                    sources[i].address, sources[i].channel);
@@ -235,23 +300,34 @@ static void output_collected_table(const CollectedData *data, const ThermalSourc
 static int stream_channels(ThermalSource *sources, int source_count,
                                int get_serial, int get_cal_date, int get_cal_coeffs,
                                int get_temp, int get_adc, int get_cjc, int get_interval,
-                               int stream_hz, int json_output, int clean_mode) {
+                               int stream_hz, int oversample, int json_output, int clean_mode,
+                               OutputPolicy output_policy, int queue_depth,
+                               const SinkSpec *sinks, int sink_count,
+                               const RealtimeConfig *realtime) {
     BoardManager mgr;
     BoardInfo board_infos[8] = {0};
     uint8_t board_collected[8] = {0};
     
-    /* Setup timing */
-    long sleep_us = 1000000 / stream_hz;
-    struct timespec sleep_time = {
-        .tv_sec = sleep_us / 1000000,
-        .tv_nsec = (sleep_us % 1000000) * 1000
-    };
+    /* Setup timing: oversample reads per output record, evenly spaced on absolute deadlines */
+    long period_ns = 1000000000L / stream_hz / oversample;
     
     /* Initialize boards */
     if (board_manager_init(&mgr, sources, source_count) != THERMO_SUCCESS) {
         return 1;
     }
     board_manager_configure(&mgr);
+    board_manager_wait_ready(&mgr);
+    
+    /* A board converts each channel once per update interval; reading faster
+     * than that only repeats the last conversion */
+    for (int a = 0; a < MAX_BOARDS && oversample > 1; a++) {
+        uint8_t interval = DEFAULT_UPDATE_INTERVAL;
+        if (!board_manager_is_open(&mgr, a) || thermo_get_update_interval(a, &interval) != THERMO_SUCCESS) continue;
+        if ((long)stream_hz * oversample * (interval > 0 ? interval : 1) > 1) {
+            fprintf(stderr, "Warning: Address %d updates every %d s; %d reads/s mostly repeat the same conversion\n",
+                    a, interval, stream_hz * oversample);
+        }
+    }
     
     /* Collect static board info ONCE */
     if (get_serial || get_cal_date || get_cal_coeffs || get_interval) {
@@ -261,7 +337,7 @@ static int stream_channels(ThermalSource *sources, int source_count,
                 board_info_init(&board_infos[addr], addr);
                 board_collected[addr] = 1;
             }
-            board_info_collect(&board_infos[addr], addr, sources[i].channel,
+            board_info_collect(&board_infos[addr], &mgr.inventory, addr, sources[i].channel,
                               get_serial, get_cal_date, get_cal_coeffs, get_interval);
         }
         
@@ -324,8 +400,19 @@ static int stream_channels(ThermalSource *sources, int source_count,
         }
     }
     
+    /* Table goes to the terminal unless stdout is one of the sinks */
+    int table_output = !json_output;
+    for (int i = 0; i < sink_count; i++) {
+        if (sinks[i].kind == SINK_STDOUT) {
+            table_output = 0;
+        }
+    }
+    
     /* Print streaming info */
-    if (!json_output && !clean_mode) {
+    if (table_output && !clean_mode) {
+        if (oversample > 1) {
+            printf("Sampling at %d Hz (%dx oversampled)\n", stream_hz * oversample, oversample);
+        }
         if (source_count == 1) {
             printf("Streaming at %d Hz\n", stream_hz);
             printf("----------------------------------------\n");
@@ -338,27 +425,120 @@ static int stream_channels(ThermalSource *sources, int source_count,
     
     signals_install_handlers();
     
-    /* Streaming loop - only dynamic readings */
-    while (g_running) {
-        ChannelReading *readings = calloc(source_count, sizeof(ChannelReading));
-        if (!readings) {
-            fprintf(stderr, "Error: Failed to allocate memory\n");
+    /* Records go through a writer thread so a stalled consumer can't stall sampling */
+    SinkSet *sink_set = NULL;
+    OutputQueue *output = NULL;
+    if (sink_count > 0) {
+        sink_set = sink_set_open(sinks, sink_count);
+        output = sink_set ? output_queue_create(queue_depth, output_policy, sink_set) : NULL;
+        if (!output) {
+            sink_set_close(sink_set);
             board_manager_close(&mgr);
             return 1;
         }
+    }
+    
+    /* Each source's temperature goes through its filter once per internal sample */
+    SourceFilter *filters = calloc(source_count, sizeof(SourceFilter));
+    if (!filters) {
+        fprintf(stderr, "Error: Failed to allocate memory\n");
+        output_queue_close(output);
+        sink_set_close(sink_set);
+        board_manager_close(&mgr);
+        return 1;
+    }
+    for (int i = 0; i < source_count; i++) {
+        source_filter_init(&filters[i], &sources[i].filter);
+    }
+    
+    /* Readings are reused every tick; only each output record's cJSON tree is
+     * allocated in the loop (from the pre-faulted heap under --realtime) */
+    ChannelReading *readings = calloc(source_count, sizeof(ChannelReading));
+    DeadbandState *deadbands = calloc(source_count, sizeof(DeadbandState));
+    if (!readings || !deadbands) {
+        fprintf(stderr, "Error: Failed to allocate memory\n");
+        free(readings);
+        free(deadbands);
+        free(filters);
+        output_queue_close(output);
+        sink_set_close(sink_set);
+        board_manager_close(&mgr);
+        return 1;
+    }
+    
+    /* After the writer thread exists, so only this thread is pinned and SCHED_FIFO */
+    trace_thread_register("acquisition");
+    if (realtime->enabled) {
+        RealtimeStatus rt_status;
+        realtime_enter(realtime, &rt_status);
+    }
+    
+    struct timespec deadline;
+    realtime_deadline_init(&deadline);
+    
+    /* Streaming loop - only dynamic readings */
+    while (g_running) {
+        TRACE_SCOPE("tick");
         
-        /* Collect dynamic data only */
-        for (int i = 0; i < source_count; i++) {
-            channel_reading_collect(&readings[i],
-                                   sources[i].address, sources[i].channel,
-                                   get_temp, get_adc, get_cjc);
+        /* Collect dynamic data only (CJC once per board); ADC/CJC keep the last sample */
+        for (int n = 0; n < oversample && g_running; n++) {
+            if (n > 0) {
+                trace_begin("sleep");
+                if (realtime_sleep_until_next(&deadline, period_ns)) {
+                    metrics_add(METRIC_OVERRUNS, 1);
+                }
+                trace_end("sleep");
+            }
+            TRACE_SCOPE("sample");
+            jitter_mark();
+            metrics_add(METRIC_TICKS, 1);
+            /* Backoff advances once per record; later samples only reread CJC */
+            if ((get_temp || get_cjc) && n == 0) {
+                board_manager_read_cjc(&mgr);
+            } else if (get_temp || get_cjc) {
+                board_manager_reread_cjc(&mgr);
+            }
+            for (int i = 0; i < source_count; i++) {
+                int due = board_manager_read_due(&mgr, sources[i].address, sources[i].channel);
+                channel_reading_collect(&readings[i], &mgr,
+                                       sources[i].address, sources[i].channel,
+                                       thermo_tc_type_from_string(sources[i].tc_type),
+                                       get_temp, get_adc, get_cjc);
+                if (due) {
+                    metrics_sample(i, readings[i].temperature, (ReadingStatus)readings[i].status);
+                }
+                if (get_temp) {
+                    source_filter_push(&filters[i], readings[i].temperature);
+                }
+            }
+        }
+        for (int i = 0; i < source_count && get_temp; i++) {
+            readings[i].temperature = source_filter_emit(&filters[i]);
+            readings[i].status = thermo_classify_temp(readings[i].temperature);
         }
         
-        /* Output */
-        if (json_output) {
-            cJSON *root = readings_to_json_array(readings, NULL, sources, source_count, 0, 0, 0, 0);
-            json_print_and_free(root, 0);
-        } else {
+        /* Output; a record in which every source is within its deadband is dropped */
+        if (output) {
+            TRACE_SCOPE("output");
+            int64_t now_us = time_now_us();
+            int changed = 0;
+            for (int i = 0; i < source_count; i++) {
+                double value;
+                ReadingStatus status = channel_reading_deadband_input(&readings[i], &value);
+                readings[i].unchanged = !deadband_update(&deadbands[i], &sources[i].deadband,
+                                                         value, status, now_us);
+                changed |= !readings[i].unchanged;
+            }
+            if (changed) {
+                cJSON *root = readings_to_json_array(readings, NULL, sources, source_count, 0, 0, 0, 0);
+                output_queue_push_json(output, root, now_us);
+            }
+            for (int i = 0; i < source_count; i++) {
+                readings[i].unchanged = 0;
+            }
+        }
+        if (table_output) {
+            TRACE_SCOPE("table");
             if (source_count == 1) {
                 /* Calculate formatting widths for single reading */
                 int max_key_len = 0, max_value_width = 0, max_unit_len = 0;
@@ -410,14 +590,41 @@ static int stream_channels(ThermalSource *sources, int source_count,
             }
         }
         
-        free(readings);
-        nanosleep(&sleep_time, NULL);
+        stats_report_due();
+        jitter_report_due();
+        
+        trace_begin("sleep");
+        if (realtime_sleep_until_next(&deadline, period_ns)) {
+            metrics_add(METRIC_OVERRUNS, 1);
+        }
+        trace_end("sleep");
     }
     
+    free(deadbands);
+    free(readings);
+    free(filters);
+    output_queue_close(output);
+    sink_set_close(sink_set);
     board_manager_close(&mgr);
     return 0;
 }
 
+/* Long-only option codes */
+enum {
+    OPT_OUTPUT_POLICY = 256,
+    OPT_QUEUE_DEPTH,
+    OPT_SINK,
+    OPT_FILTER,
+    OPT_DEADBAND,
+    OPT_TRACE,
+    OPT_STATS,
+    OPT_METRICS,
+    OPT_JITTER,
+    OPT_OVERSAMPLE,
+    OPT_REALTIME,
+    OPT_CPU
+};
+
 /* Command: get - Read data from a specific channel */
 int cmd_get(int argc, char **argv) {
     int address = -1;  /* -1 means not specified */
@@ -427,6 +634,20 @@ int cmd_get(int argc, char **argv) {
     int json_output = 0;
     int stream_hz = 0;
     int clean_mode = 0;
+    OutputPolicy output_policy = OUTPUT_POLICY_BLOCK;
+    int queue_depth = OUTPUT_QUEUE_DEFAULT_DEPTH;
+    SinkSpec sinks[MAX_SINKS];
+    int sink_count = 0;
+    FilterSpec cli_filter = {0};
+    DeadbandSpec cli_deadband = {0};
+    const char *trace_path = NULL;
+    int stats_enabled = 0;
+    double stats_interval = 0;
+    const char *metrics_endpoint = NULL;
+    int jitter_enabled = 0;
+    double jitter_interval = 0;
+    int oversample = 1;
+    RealtimeConfig realtime = { .enabled = 0, .priority = REALTIME_DEFAULT_PRIORITY, .cpu = -1 };
     
     int get_serial = 0;
     int get_cal_date = 0;
@@ -451,6 +672,18 @@ int cmd_get(int argc, char **argv) {
         {"json", no_argument, 0, 'j'},
         {"stream", required_argument, 0, 'S'},
         {"clean", no_argument, 0, 'l'},
+        {"output-policy", required_argument, 0, OPT_OUTPUT_POLICY},
+        {"queue-depth", required_argument, 0, OPT_QUEUE_DEPTH},
+        {"sink", required_argument, 0, OPT_SINK},
+        {"filter", required_argument, 0, OPT_FILTER},
+        {"deadband", required_argument, 0, OPT_DEADBAND},
+        {"trace", required_argument, 0, OPT_TRACE},
+        {"stats", optional_argument, 0, OPT_STATS},
+        {"metrics", required_argument, 0, OPT_METRICS},
+        {"jitter", optional_argument, 0, OPT_JITTER},
+        {"oversample", required_argument, 0, OPT_OVERSAMPLE},
+        {"realtime", optional_argument, 0, OPT_REALTIME},
+        {"cpu", required_argument, 0, OPT_CPU},
         {0, 0, 0, 0}
     };
     
@@ -471,12 +704,72 @@ int cmd_get(int argc, char **argv) {
             case 'j': json_output = 1; break;
             case 'S': stream_hz = atoi(optarg); break;
             case 'l': clean_mode = 1; break;
+            case OPT_OUTPUT_POLICY:
+                if (output_policy_from_string(optarg, &output_policy) != THERMO_SUCCESS) {
+                    fprintf(stderr, "Error: Invalid --output-policy '%s' (block, drop-oldest, coalesce)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_QUEUE_DEPTH: queue_depth = atoi(optarg); break;
+            case OPT_SINK:
+                if (sink_count >= MAX_SINKS) {
+                    fprintf(stderr, "Error: At most %d --sink options\n", MAX_SINKS);
+                    return 1;
+                }
+                if (sink_spec_parse(optarg, &sinks[sink_count]) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                sink_count++;
+                break;
+            case OPT_FILTER:
+                if (filter_spec_parse(optarg, &cli_filter) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                break;
+            case OPT_DEADBAND:
+                if (deadband_spec_parse(optarg, &cli_deadband) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                break;
+            case OPT_OVERSAMPLE: oversample = atoi(optarg); break;
+            case OPT_TRACE: trace_path = optarg; break;
+            case OPT_STATS:
+                if (stats_parse_interval(optarg, &stats_interval) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                stats_enabled = 1;
+                break;
+            case OPT_METRICS: metrics_endpoint = optarg; break;
+            case OPT_JITTER:
+                if (jitter_parse_interval(optarg, &jitter_interval) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                jitter_enabled = 1;
+                break;
+            case OPT_REALTIME:
+                if (realtime_parse_priority(optarg, &realtime.priority) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                realtime.enabled = 1;
+                break;
+            case OPT_CPU:
+                if (realtime_parse_cpu(optarg, &realtime.cpu) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                break;
             default:
                 fprintf(stderr, "Usage: thermo-cli get [OPTIONS]\n");
                 return 1;
         }
     }
     
+    if (trace_path && trace_start(trace_path) != THERMO_SUCCESS) {
+        return 1;
+    }
+    if (stats_enabled) {
+        stats_enable(stats_interval);
+    }
+    
     /* Default to temperature if nothing specified */
     if (!get_serial && !get_cal_date && !get_cal_coeffs && 
         !get_temp && !get_adc && !get_cjc && !get_interval) {
@@ -484,6 +777,63 @@ int cmd_get(int argc, char **argv) {
     }
     
     /* Validate arguments */
+    if (sink_count > 0 && stream_hz <= 0) {
+        fprintf(stderr, "Error: --sink requires --stream\n");
+        return 1;
+    }
+    
+    if (oversample < 1 || oversample > FILTER_MAX_OVERSAMPLE) {
+        fprintf(stderr, "Error: --oversample must be 1-%d\n", FILTER_MAX_OVERSAMPLE);
+        return 1;
+    }
+    
+    if ((oversample > 1 || cli_filter.count > 0) && stream_hz <= 0) {
+        fprintf(stderr, "Error: --filter and --oversample require --stream\n");
+        return 1;
+    }
+    
+    if (cli_deadband.enabled && stream_hz <= 0) {
+        fprintf(stderr, "Error: --deadband requires --stream\n");
+        return 1;
+    }
+    
+    if (metrics_endpoint && stream_hz <= 0) {
+        fprintf(stderr, "Error: --metrics requires --stream\n");
+        return 1;
+    }
+    
+    if (jitter_enabled && stream_hz <= 0) {
+        fprintf(stderr, "Error: --jitter requires --stream\n");
+        return 1;
+    }
+    
+    if (realtime.enabled && stream_hz <= 0) {
+        fprintf(stderr, "Error: --realtime requires --stream\n");
+        return 1;
+    }
+    
+    if (realtime.cpu >= 0 && !realtime.enabled) {
+        fprintf(stderr, "Error: --cpu requires --realtime\n");
+        return 1;
+    }
+    
+    /* --json streams to stdout alongside any other sinks */
+    if (json_output && stream_hz > 0) {
+        int has_stdout = 0;
+        for (int i = 0; i < sink_count; i++) {
+            if (sinks[i].kind == SINK_STDOUT) {
+                has_stdout = 1;
+            }
+        }
+        if (!has_stdout) {
+            if (sink_count >= MAX_SINKS) {
+                fprintf(stderr, "Error: At most %d --sink options\n", MAX_SINKS);
+                return 1;
+            }
+            sink_spec_default(&sinks[sink_count++]);
+        }
+    }
+    
     if (config_path && (address >= 0 || channel >= 0)) {
         fprintf(stderr, "Error: Cannot specify both --config and --address/--channel\n");
         return 1;
@@ -532,17 +882,46 @@ int cmd_get(int argc, char **argv) {
         source_count = 1;
     }
     
+    /* --filter covers sources without a filter of their own */
+    for (int i = 0; i < source_count && cli_filter.count > 0; i++) {
+        if (sources[i].filter.count == 0) {
+            sources[i].filter = cli_filter;
+        }
+    }
+    
+    /* Likewise --deadband */
+    for (int i = 0; i < source_count && cli_deadband.enabled; i++) {
+        if (!sources[i].deadband.enabled) {
+            sources[i].deadband = cli_deadband;
+        }
+    }
+    
     DEBUG_PRINT("Setup complete.");
     
     /* Execute unified path for both single and multi-channel */
     int result = 0;
     
     if (stream_hz > 0) {
+        if (metrics_endpoint && metrics_start(metrics_endpoint, sources, source_count) != THERMO_SUCCESS) {
+            if (config_path) {
+                config_free(&config);
+            }
+            return 1;
+        }
+        
+        /* Scored against the per-read period, oversampled reads included */
+        if (jitter_enabled) {
+            jitter_enable(jitter_interval, 1000000000L / stream_hz / oversample);
+        }
+        
         /* Stream mode - use new API */
         result = stream_channels(sources, source_count,
                                     get_serial, get_cal_date, get_cal_coeffs,
                                     get_temp, get_adc, get_cjc, get_interval,
-                                    stream_hz, json_output, clean_mode);
+                                    stream_hz, oversample, json_output, clean_mode,
+                                    output_policy, queue_depth,
+                                    sinks, sink_count, &realtime);
+        metrics_stop();
     } else {
         /* Single reading mode - use new API */
         CollectedData data;
@@ -0,0 +1,532 @@
+/*
+ * Linearize command implementation.
+ * Reads a recording (CSV or binary, as written by the file sinks), finds
+ * every <NAME>_ADC / <NAME>_CJC column pair and writes <NAME>_TEMP
+ * recomputed with the software linearization. Rows are processed in
+ * blocks so each pair is converted with one batched call.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "commands/linearize.h"
+#include "common.h"
+#include "hardware.h"
+#include "serialize.h"
+#include "thermocouple.h"
+#include "utils.h"
+
+#define LINEARIZE_BLOCK 1024
+#define LINEARIZE_MAX_PAIRS 64
+
+typedef struct {
+    char name[128];             /* Column prefix shared by _ADC/_CJC/_TEMP */
+    int adc_col;
+    int cjc_col;
+    int temp_col;               /* Existing _TEMP/_TEMPERATURE column (-1 = none) */
+    int out_col;                /* TEMP column in binary output */
+    uint8_t tc_type;
+    double adc[LINEARIZE_BLOCK];
+    double cjc[LINEARIZE_BLOCK];
+    double temp[LINEARIZE_BLOCK];
+    double recorded[LINEARIZE_BLOCK];   /* Existing TEMP value (NAN if none) */
+} TcPair;
+
+typedef struct {
+    int start;
+    int end;
+} FieldSpan;
+
+static int is_fault_value(double value) {
+    return value == OPEN_TC_VALUE || value == OVERRANGE_TC_VALUE || value == COMMON_MODE_TC_VALUE;
+}
+
+/* Recorded fault codes are kept: they can't be derived from the voltage */
+static double pair_result(const TcPair *pair, int row) {
+    return is_fault_value(pair->recorded[row]) ? pair->recorded[row] : pair->temp[row];
+}
+
+/* TC type for a column prefix: a config source whose key ends the prefix, else the default */
+static uint8_t pair_tc_type(const char *name, const Config *config, uint8_t fallback) {
+    size_t name_len = strlen(name);
+    for (int i = 0; config && i < config->source_count; i++) {
+        const char *key = config->sources[i].key;
+        size_t key_len = strlen(key);
+        if (key_len == 0 || key_len > name_len) continue;
+        if (strcmp(name + name_len - key_len, key) == 0 &&
+            (key_len == name_len || name[name_len - key_len - 1] == '_')) {
+            return thermo_tc_type_from_string(config->sources[i].tc_type);
+        }
+    }
+    return fallback;
+}
+
+static int find_column(char **names, int count, const char *prefix, const char *suffix) {
+    size_t prefix_len = strlen(prefix);
+    for (int i = 0; i < count; i++) {
+        if (strncmp(names[i], prefix, prefix_len) == 0 && strcmp(names[i] + prefix_len, suffix) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Find _ADC/_CJC pairs among the column names */
+static int find_pairs(char **names, int count, TcPair *pairs, const Config *config, uint8_t fallback) {
+    int pair_count = 0;
+    
+    for (int i = 0; i < count && pair_count < LINEARIZE_MAX_PAIRS; i++) {
+        size_t len = strlen(names[i]);
+        if (len <= 4 || len - 4 >= sizeof(pairs[0].name) || strcmp(names[i] + len - 4, "_ADC") != 0) {
+            continue;
+        }
+    
+        TcPair *pair = &pairs[pair_count];
+        memcpy(pair->name, names[i], len - 4);
+        pair->name[len - 4] = '\0';
+        pair->adc_col = i;
+        pair->cjc_col = find_column(names, count, pair->name, "_CJC");
+        pair->temp_col = find_column(names, count, pair->name, "_TEMP");
+        if (pair->temp_col < 0) {
+            pair->temp_col = find_column(names, count, pair->name, "_TEMPERATURE");  /* get records */
+        }
+        pair->out_col = pair->temp_col;
+    
+        if (pair->cjc_col >= 0) {
+            pair->tc_type = pair_tc_type(pair->name, config, fallback);
+            pair_count++;
+        }
+    }
+    return pair_count;
+}
+
+static void convert_block(TcPair *pairs, int pair_count, int rows) {
+    for (int p = 0; p < pair_count; p++) {
+        tc_linearize_batch(pairs[p].tc_type, pairs[p].adc, pairs[p].cjc, pairs[p].temp, rows);
+    }
+}
+
+/* ============================================================================
+ * CSV recordings
+ * ============================================================================ */
+
+/* Split a CSV line into field spans (quotes may contain commas). Returns field count. */
+static int csv_split(const char *line, FieldSpan *fields, int max_fields) {
+    int count = 0;
+    int pos = 0;
+    
+    while (count < max_fields) {
+        int start = pos;
+        int quoted = 0;
+        while (line[pos] && (quoted || line[pos] != ',')) {
+            if (line[pos] == '"') quoted = !quoted;
+            pos++;
+        }
+        fields[count].start = start;
+        fields[count].end = pos;
+        count++;
+        if (line[pos] != ',') break;
+        pos++;
+    }
+    return count;
+}
+
+static double field_number(const char *line, const FieldSpan *field) {
+    if (field->end == field->start) return NAN;
+    char *end = NULL;
+    double value = strtod(line + field->start, &end);
+    return (end == line + field->start) ? NAN : value;
+}
+
+static void append_value(ByteBuffer *out, double value) {
+    if (!isnan(value)) {
+        char number[32];
+        byte_buffer_append(out, number, (size_t)csv_format_number(number, sizeof(number), value));
+    }
+}
+
+/* Buffered rows of one block; TEMP cell spans are kept so output rows are
+ * built by copying the original text around the replaced cells */
+typedef struct {
+    char *lines[LINEARIZE_BLOCK];
+    size_t caps[LINEARIZE_BLOCK];
+    FieldSpan *temp_spans;          /* pair_count spans per row ({-1,-1} = none) */
+    int order[LINEARIZE_MAX_PAIRS]; /* Pairs with an existing TEMP column, left to right */
+    int replace_count;
+} CsvBlock;
+
+static void csv_emit_block(const CsvBlock *blk, const TcPair *pairs, int pair_count, int rows, ByteBuffer *out) {
+    for (int r = 0; r < rows; r++) {
+        const char *line = blk->lines[r];
+        const FieldSpan *spans = &blk->temp_spans[(size_t)r * pair_count];
+        int copied = 0;
+    
+        byte_buffer_reset(out);
+        for (int k = 0; k < blk->replace_count; k++) {
+            int p = blk->order[k];
+            if (spans[p].start < 0) continue;
+            byte_buffer_append(out, line + copied, spans[p].start - copied);
+            append_value(out, pair_result(&pairs[p], r));
+            copied = spans[p].end;
+        }
+        byte_buffer_append(out, line + copied, strlen(line + copied));
+    
+        for (int p = 0; p < pair_count; p++) {
+            if (pairs[p].temp_col < 0) {
+                byte_buffer_append(out, ",", 1);
+                append_value(out, pair_result(&pairs[p], r));
+            }
+        }
+        byte_buffer_append(out, "\n", 1);
+        fwrite(out->data, 1, out->len, stdout);
+    }
+}
+
+/* Convert data rows block by block. Returns rows processed. */
+static long long csv_convert_rows(FILE *in, CsvBlock *blk, FieldSpan *fields, int max_fields,
+                                  TcPair *pairs, int pair_count) {
+    ByteBuffer out = {0};
+    long long rows = 0;
+    
+    for (;;) {
+        int block = 0;
+        while (block < LINEARIZE_BLOCK) {
+            ssize_t len = getline(&blk->lines[block], &blk->caps[block], in);
+            if (len <= 0) break;
+            if (blk->lines[block][len - 1] == '\n') blk->lines[block][--len] = '\0';
+            if (len == 0) continue;
+    
+            const char *line = blk->lines[block];
+            FieldSpan *spans = &blk->temp_spans[(size_t)block * pair_count];
+            int n = csv_split(line, fields, max_fields);
+            for (int p = 0; p < pair_count; p++) {
+                TcPair *pair = &pairs[p];
+                pair->adc[block] = pair->adc_col < n ? field_number(line, &fields[pair->adc_col]) : NAN;
+                pair->cjc[block] = pair->cjc_col < n ? field_number(line, &fields[pair->cjc_col]) : NAN;
+                pair->recorded[block] = NAN;
+                spans[p].start = spans[p].end = -1;
+                if (pair->temp_col >= 0 && pair->temp_col < n) {
+                    pair->recorded[block] = field_number(line, &fields[pair->temp_col]);
+                    spans[p] = fields[pair->temp_col];
+                }
+            }
+            block++;
+        }
+        if (block == 0) break;
+    
+        convert_block(pairs, pair_count, block);
+        csv_emit_block(blk, pairs, pair_count, block, &out);
+        rows += block;
+    }
+    
+    byte_buffer_free(&out);
+    return rows;
+}
+
+/* Convert a CSV recording; prefix holds bytes already consumed from in. Returns rows or -1. */
+static long long linearize_csv(FILE *in, const char *prefix, size_t prefix_len,
+                               TcPair *pairs, const Config *config, uint8_t fallback) {
+    CsvBlock *blk = (CsvBlock*)calloc(1, sizeof(CsvBlock));
+    ByteBuffer header = {0};
+    if (!blk) return -1;
+    
+    /* Too-short headers can't name a column pair; they fail below */
+    byte_buffer_append(&header, prefix, prefix_len);
+    if (!memchr(prefix, '\n', prefix_len)) {
+        ssize_t len = getline(&blk->lines[0], &blk->caps[0], in);
+        if (len > 0) byte_buffer_append(&header, blk->lines[0], (size_t)len);
+    }
+    while (header.len > 0 && (header.data[header.len - 1] == '\n' || header.data[header.len - 1] == '\r')) {
+        header.len--;
+    }
+    byte_buffer_append(&header, "", 1);
+    
+    int max_fields = 1;
+    for (size_t i = 0; i < header.len; i++) {
+        if (header.data[i] == ',') max_fields++;
+    }
+    
+    FieldSpan *fields = (FieldSpan*)malloc(max_fields * sizeof(FieldSpan));
+    char **names = (char**)calloc(max_fields, sizeof(char*));
+    int field_count = 0;
+    int pair_count = 0;
+    if (fields && names) {
+        field_count = csv_split(header.data, fields, max_fields);
+        for (int i = 0; i < field_count; i++) {
+            names[i] = strndup(header.data + fields[i].start, fields[i].end - fields[i].start);
+            if (!names[i]) names[i] = strdup("");
+        }
+        pair_count = find_pairs(names, field_count, pairs, config, fallback);
+    }
+    if (pair_count > 0) {
+        blk->temp_spans = (FieldSpan*)malloc((size_t)LINEARIZE_BLOCK * pair_count * sizeof(FieldSpan));
+    }
+    
+    long long rows = -1;
+    if (header.len <= 1) {
+        fprintf(stderr, "Error: Empty input\n");
+    } else if (pair_count == 0) {
+        fprintf(stderr, "Error: No <NAME>_ADC / <NAME>_CJC column pairs in header\n");
+    } else if (blk->temp_spans) {
+        /* Existing TEMP cells are rewritten in column order; missing ones are appended */
+        for (int p = 0; p < pair_count; p++) {
+            if (pairs[p].temp_col < 0) continue;
+            int k = blk->replace_count++;
+            while (k > 0 && pairs[blk->order[k - 1]].temp_col > pairs[p].temp_col) {
+                blk->order[k] = blk->order[k - 1];
+                k--;
+            }
+            blk->order[k] = p;
+        }
+    
+        fputs(header.data, stdout);
+        for (int p = 0; p < pair_count; p++) {
+            if (pairs[p].temp_col < 0) printf(",%s_TEMP", pairs[p].name);
+        }
+        putchar('\n');
+    
+        rows = csv_convert_rows(in, blk, fields, max_fields, pairs, pair_count);
+    }
+    
+    for (int i = 0; names && i < field_count; i++) {
+        free(names[i]);
+    }
+    for (int i = 0; i < LINEARIZE_BLOCK; i++) {
+        free(blk->lines[i]);
+    }
+    free(names);
+    free(fields);
+    free(blk->temp_spans);
+    free(blk);
+    byte_buffer_free(&header);
+    return rows;
+}
+
+/* ============================================================================
+ * Binary recordings
+ * ============================================================================ */
+
+typedef struct {
+    RecordSchema schema;        /* Input columns plus appended TEMP columns */
+    FlatRecord rows[LINEARIZE_BLOCK];
+    int ready;
+    ByteBuffer out;
+} TcrBlock;
+
+static void tcr_block_reset(TcrBlock *blk) {
+    if (!blk->ready) return;
+    for (int r = 0; r < LINEARIZE_BLOCK; r++) {
+        flat_record_free(&blk->rows[r]);
+    }
+    record_schema_free(&blk->schema);
+    blk->ready = 0;
+}
+
+/* New session: derive pairs and output schema, emit its schema frame. Returns pair count or -1. */
+static int tcr_block_setup(TcrBlock *blk, const RecordSchema *in_schema, TcPair *pairs,
+                           const Config *config, uint8_t fallback) {
+    tcr_block_reset(blk);
+    
+    for (int i = 0; i < in_schema->count; i++) {
+        record_schema_add(&blk->schema, in_schema->names[i], 0);
+    }
+    int pair_count = find_pairs(in_schema->names, in_schema->count, pairs, config, fallback);
+    for (int p = 0; p < pair_count; p++) {
+        if (pairs[p].temp_col < 0) {
+            char name[160];
+            snprintf(name, sizeof(name), "%s_TEMP", pairs[p].name);
+            pairs[p].out_col = record_schema_add(&blk->schema, name, 0);
+        }
+    }
+    
+    int initialized = 0;
+    while (initialized < LINEARIZE_BLOCK &&
+           flat_record_init(&blk->rows[initialized], &blk->schema) == THERMO_SUCCESS) {
+        initialized++;
+    }
+    int columns_ok = 1;
+    for (int p = 0; p < pair_count; p++) {
+        if (pairs[p].out_col < 0) columns_ok = 0;
+    }
+    if (initialized < LINEARIZE_BLOCK || !columns_ok) {
+        for (int r = 0; r < initialized; r++) {
+            flat_record_free(&blk->rows[r]);
+        }
+        record_schema_free(&blk->schema);
+        return -1;
+    }
+    blk->ready = 1;
+    
+    if (pair_count == 0) {
+        fprintf(stderr, "Warning: No <NAME>_ADC / <NAME>_CJC column pairs in session; copied unchanged\n");
+    }
+    
+    byte_buffer_reset(&blk->out);
+    tcr_encode_schema(&blk->out, &blk->schema);
+    fwrite(blk->out.data, 1, blk->out.len, stdout);
+    return pair_count;
+}
+
+static void tcr_flush_block(TcrBlock *blk, TcPair *pairs, int pair_count, int rows) {
+    convert_block(pairs, pair_count, rows);
+    
+    byte_buffer_reset(&blk->out);
+    for (int r = 0; r < rows; r++) {
+        FlatRecord *rec = &blk->rows[r];
+        for (int p = 0; p < pair_count; p++) {
+            double value = pair_result(&pairs[p], r);
+            rec->values[pairs[p].out_col] = value;
+            rec->present[pairs[p].out_col] = !isnan(value);
+        }
+        tcr_encode_data(&blk->out, &blk->schema, rec);
+    }
+    fwrite(blk->out.data, 1, blk->out.len, stdout);
+}
+
+/* Convert a binary recording (magic already consumed). Returns rows or -1. */
+static long long linearize_tcr(FILE *in, TcPair *pairs, const Config *config, uint8_t fallback) {
+    if (isatty(STDOUT_FILENO)) {
+        fprintf(stderr, "Error: Output is a binary recording; redirect stdout to a file\n");
+        return -1;
+    }
+    
+    TcrBlock *blk = (TcrBlock*)calloc(1, sizeof(TcrBlock));
+    if (!blk) return -1;
+    
+    TcrReader reader = {0};
+    reader.fp = in;
+    fwrite(TCR_MAGIC, 1, TCR_MAGIC_LEN, stdout);
+    
+    long long rows = 0;
+    int pair_count = 0;
+    int block = 0;
+    int result;
+    while ((result = tcr_reader_next(&reader)) == 1) {
+        if (reader.schema_changed || !blk->ready) {
+            if (block > 0) tcr_flush_block(blk, pairs, pair_count, block);
+            rows += block;
+            block = 0;
+            pair_count = tcr_block_setup(blk, &reader.schema, pairs, config, fallback);
+            if (pair_count < 0) {
+                fprintf(stderr, "Error: Failed to allocate memory\n");
+                result = THERMO_ERROR;
+                break;
+            }
+        }
+    
+        const FlatRecord *in_rec = &reader.record;
+        FlatRecord *rec = &blk->rows[block];
+        rec->timestamp_us = in_rec->timestamp_us;
+        memcpy(rec->values, in_rec->values, in_rec->count * sizeof(double));
+        memcpy(rec->present, in_rec->present, in_rec->count);
+    
+        for (int p = 0; p < pair_count; p++) {
+            TcPair *pair = &pairs[p];
+            pair->adc[block] = in_rec->present[pair->adc_col] ? in_rec->values[pair->adc_col] : NAN;
+            pair->cjc[block] = in_rec->present[pair->cjc_col] ? in_rec->values[pair->cjc_col] : NAN;
+            pair->recorded[block] = (pair->temp_col >= 0 && in_rec->present[pair->temp_col])
+                                    ? in_rec->values[pair->temp_col] : NAN;
+        }
+    
+        if (++block == LINEARIZE_BLOCK) {
+            tcr_flush_block(blk, pairs, pair_count, block);
+            rows += block;
+            block = 0;
+        }
+    }
+    
+    if (result == 0) {
+        if (block > 0) tcr_flush_block(blk, pairs, pair_count, block);
+        rows += block;
+    } else {
+        if (result != THERMO_ERROR) {
+            fprintf(stderr, "Error: Damaged frame after %lld records\n", rows + block);
+        }
+        rows = -1;
+    }
+    
+    tcr_reader_close(&reader);
+    tcr_block_reset(blk);
+    byte_buffer_free(&blk->out);
+    free(blk);
+    return rows;
+}
+
+/* Command: linearize - Re-linearize recorded ADC/CJC columns */
+int cmd_linearize(int argc, char **argv) {
+    char *config_path = NULL;
+    char tc_type_str[8] = "K";
+    
+    static struct option long_options[] = {
+        {"config", required_argument, 0, 'C'},
+        {"tc-type", required_argument, 0, 't'},
+        {0, 0, 0, 0}
+    };
+    
+    int opt;
+    while ((opt = getopt_long(argc, argv, "C:t:", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'C': config_path = optarg; break;
+            case 't': strncpy(tc_type_str, optarg, sizeof(tc_type_str) - 1); break;
+            default:
+                fprintf(stderr, "Usage: thermo-cli linearize [-C config.yaml] [-t TYPE] [FILE]\n");
+                return 1;
+        }
+    }
+    
+    uint8_t fallback = thermo_tc_type_from_string(tc_type_str);
+    if (fallback == TC_DISABLED) {
+        fprintf(stderr, "Error: Invalid thermocouple type '%s'\n", tc_type_str);
+        return 1;
+    }
+    
+    Config config = {0};
+    if (config_path && config_load(config_path, &config) != THERMO_SUCCESS) {
+        fprintf(stderr, "Error: Failed to load config file: %s\n", config_path);
+        return 1;
+    }
+    
+    FILE *in = stdin;
+    if (optind < argc && strcmp(argv[optind], "-") != 0) {
+        in = fopen(argv[optind], "r");
+        if (!in) {
+            fprintf(stderr, "Error: Cannot open '%s'\n", argv[optind]);
+            config_free(&config);
+            return 1;
+        }
+    }
+    
+    TcPair *pairs = (TcPair*)malloc(LINEARIZE_MAX_PAIRS * sizeof(TcPair));
+    long long rows = -1;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    /* Binary recordings start with the magic; anything else is read as CSV */
+    if (!pairs) {
+        fprintf(stderr, "Error: Failed to allocate memory\n");
+    } else {
+        char magic[TCR_MAGIC_LEN];
+        size_t got = fread(magic, 1, sizeof(magic), in);
+        if (got == TCR_MAGIC_LEN && memcmp(magic, TCR_MAGIC, TCR_MAGIC_LEN) == 0) {
+            rows = linearize_tcr(in, pairs, config_path ? &config : NULL, fallback);
+        } else {
+            rows = linearize_csv(in, magic, got, pairs, config_path ? &config : NULL, fallback);
+        }
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (rows >= 0) {
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        fprintf(stderr, "Linearized %lld record%s in %.3f s\n", rows, rows == 1 ? "" : "s", elapsed);
+    }
+    
+    free(pairs);
+    if (in != stdin) fclose(in);
+    config_free(&config);
+    return rows >= 0 ? 0 : 1;
+}
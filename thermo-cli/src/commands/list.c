@@ -10,6 +10,7 @@
 
 #include "commands/list.h"
 #include "hardware.h"
+#include "inventory.h"
 #include "utils.h"
 
 #include "cJSON.h"
@@ -17,33 +18,38 @@
 /* Command: list - List all connected MCC 134 boards */
 int cmd_list(int argc, char **argv) {
     int json_output = 0;
+    int refresh = 0;
     
     /* Parse options */
     static struct option long_options[] = {
         {"json", no_argument, 0, 'j'},
+        {"refresh", no_argument, 0, 'r'},
         {0, 0, 0, 0}
     };
     
     int opt;
-    while ((opt = getopt_long(argc, argv, "j", long_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "jr", long_options, NULL)) != -1) {
         switch (opt) {
             case 'j':
                 json_output = 1;
                 break;
+            case 'r':
+                refresh = 1;
+                break;
             default:
-                fprintf(stderr, "Usage: thermo-cli list [--json]\n");
+                fprintf(stderr, "Usage: thermo-cli list [--json] [--refresh]\n");
                 return 1;
         }
     }
     
-    struct HatInfo *boards = NULL;
-    int count = 0;
-    
-    int result = thermo_list_boards(&boards, &count);
-    if (result != THERMO_SUCCESS) {
+    /* Served from the inventory cache unless the boards' EEPROM images changed */
+    Inventory inv;
+    if (inventory_load(&inv, refresh) != THERMO_SUCCESS) {
         fprintf(stderr, "Error listing boards\n");
         return 1;
     }
+    InventoryBoard *boards = inv.boards;
+    int count = inv.count;
     
     if (json_output) {
         cJSON *root = cJSON_CreateObject();
@@ -84,6 +90,5 @@ int cmd_list(int argc, char **argv) {
         }
     }
     
-    if (boards) free(boards);
     return 0;
 }
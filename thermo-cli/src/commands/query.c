@@ -0,0 +1,1080 @@
+/*
+ * Query command implementation.
+ * Aggregates recorded columns (mean, min, max, count) over a time range,
+ * per interval. The recordings' time index turns the range into the
+ * chunks that can hold it; runs of consecutive chunks are shared out to
+ * worker threads, each reading its run from the indexed offset into
+ * buckets of its own, which are merged as runs finish. The work is
+ * proportional to the range, not to the recordings. When a rollup level
+ * kept beside every file lines up with the range and the intervals, its
+ * rows are added up instead, in proportion to the intervals.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <glob.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "commands/query.h"
+#include "bridge.h"
+#include "hardware.h"
+#include "json_utils.h"
+#include "recording.h"
+#include "rollup.h"
+#include "timeindex.h"
+
+#define QUERY_MAX_THREADS 64
+#define QUERY_MAX_CELLS (16 * 1024 * 1024)     /* Buckets x columns held at once */
+
+/* ============================================================================
+ * Aggregates
+ * ============================================================================ */
+
+typedef enum {
+    AGG_MEAN,
+    AGG_MIN,
+    AGG_MAX,
+    AGG_COUNT
+} AggKind;
+
+static const char *agg_names[] = {"MEAN", "MIN", "MAX", "COUNT"};
+
+typedef struct {
+    double sum;
+    double min;
+    double max;
+    long long count;
+} ColumnAgg;
+
+/* Consecutive buckets; bucket i aggregates bucket number base + i */
+typedef struct {
+    int columns;
+    int64_t base;
+    int count;
+    int capacity;
+    ColumnAgg *aggs;                /* count x columns */
+    long long *records;             /* Records per bucket */
+} Buckets;
+
+/* Index of bucket number id, growing the range to hold it. Returns -1 if
+ * out of memory or past QUERY_MAX_CELLS. */
+static int buckets_index(Buckets *b, int64_t id) {
+    if (b->count > 0 && id >= b->base && id < b->base + b->count) {
+        return (int)(id - b->base);
+    }
+    
+    int64_t first = (b->count == 0 || id < b->base) ? id : b->base;
+    int64_t last = (b->count == 0 || id >= b->base + b->count) ? id : b->base + b->count - 1;
+    int64_t needed = last - first + 1;
+    if (needed > QUERY_MAX_CELLS / (b->columns > 0 ? b->columns : 1)) return -1;
+    
+    if (needed > b->capacity) {
+        int64_t capacity = b->capacity > 0 ? (int64_t)b->capacity * 2 : 16;
+        if (capacity < needed) capacity = needed;
+        if (capacity > QUERY_MAX_CELLS / (b->columns > 0 ? b->columns : 1)) capacity = needed;
+    
+        ColumnAgg *aggs = (ColumnAgg*)realloc(b->aggs, (size_t)capacity * b->columns * sizeof(ColumnAgg));
+        if (!aggs) return -1;
+        b->aggs = aggs;
+        long long *records = (long long*)realloc(b->records, (size_t)capacity * sizeof(long long));
+        if (!records) return -1;
+        b->records = records;
+        b->capacity = (int)capacity;
+    }
+    
+    if (b->count == 0) {
+        memset(b->aggs, 0, (size_t)needed * b->columns * sizeof(ColumnAgg));
+        memset(b->records, 0, (size_t)needed * sizeof(long long));
+    } else if (first < b->base) {
+        size_t shift = (size_t)(b->base - first);
+        memmove(b->aggs + shift * b->columns, b->aggs, (size_t)b->count * b->columns * sizeof(ColumnAgg));
+        memmove(b->records + shift, b->records, (size_t)b->count * sizeof(long long));
+        memset(b->aggs, 0, shift * b->columns * sizeof(ColumnAgg));
+        memset(b->records, 0, shift * sizeof(long long));
+    } else {
+        size_t added = (size_t)(needed - b->count);
+        memset(b->aggs + (size_t)b->count * b->columns, 0, added * b->columns * sizeof(ColumnAgg));
+        memset(b->records + b->count, 0, added * sizeof(long long));
+    }
+    b->base = first;
+    b->count = (int)needed;
+    return (int)(id - first);
+}
+
+static void column_agg_add(ColumnAgg *agg, double value) {
+    if (agg->count == 0 || value < agg->min) agg->min = value;
+    if (agg->count == 0 || value > agg->max) agg->max = value;
+    agg->sum += value;
+    agg->count++;
+}
+
+static void column_agg_merge(ColumnAgg *agg, const ColumnAgg *other) {
+    if (other->count == 0) return;
+    if (agg->count == 0 || other->min < agg->min) agg->min = other->min;
+    if (agg->count == 0 || other->max > agg->max) agg->max = other->max;
+    agg->sum += other->sum;
+    agg->count += other->count;
+}
+
+/* Add every bucket of from into into. Returns THERMO_ERROR if into can't grow. */
+static int buckets_merge(Buckets *into, const Buckets *from) {
+    for (int i = 0; i < from->count; i++) {
+        if (from->records[i] == 0) continue;
+        int b = buckets_index(into, from->base + i);
+        if (b < 0) return THERMO_ERROR;
+        into->records[b] += from->records[i];
+        for (int c = 0; c < from->columns; c++) {
+            column_agg_merge(&into->aggs[(size_t)b * into->columns + c], &from->aggs[(size_t)i * from->columns + c]);
+        }
+    }
+    return THERMO_SUCCESS;
+}
+
+static void buckets_free(Buckets *b) {
+    free(b->aggs);
+    free(b->records);
+    b->aggs = NULL;
+    b->records = NULL;
+    b->count = 0;
+    b->capacity = 0;
+}
+
+/* ============================================================================
+ * Chunks and tasks
+ * ============================================================================ */
+
+/* One index entry's span of a recording (a whole file if it has no index) */
+typedef struct {
+    int file;
+    int indexed;
+    int64_t start_us;               /* First record (unknown without an index) */
+    long long header_offset;
+    long long offset;
+    long long end;                  /* Offset past the chunk */
+} Chunk;
+
+/* Consecutive chunks of one file, read in one pass */
+typedef struct {
+    int file;
+    int indexed;
+    int64_t from_us;                /* Records before this are left out */
+    long long header_offset;
+    long long offset;
+    long long end;
+} QueryTask;
+
+typedef struct {
+    char **paths;
+    int64_t from_us;
+    int64_t to_us;                  /* Exclusive */
+    int64_t origin_us;              /* Bucket 0 starts here */
+    int64_t every_us;               /* Bucket width (0 = one bucket) */
+    char **columns;
+    uint8_t *temperature;           /* Column holds temperatures: fault codes are skipped */
+    int column_count;
+    QueryTask *tasks;
+    int task_count;
+    atomic_int next_task;
+    atomic_int failed;
+    pthread_mutex_t lock;
+    Buckets total;                  /* Guarded by lock, as are the fields below */
+    long long records;
+    int64_t first_us;
+    int64_t last_us;
+} QueryRun;
+
+static int64_t floor_div(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+/* Output column of each schema column (-1 = not queried) */
+static void map_schema(const QueryRun *run, const RecordSchema *schema, int *map) {
+    for (int s = 0; s < schema->count; s++) {
+        map[s] = -1;
+        for (int c = 0; c < run->column_count && map[s] < 0; c++) {
+            if (strcmp(schema->names[s], run->columns[c]) == 0) map[s] = c;
+        }
+    }
+}
+
+/* Read one task's records into local, then merge local into the total */
+static int query_task(QueryRun *run, const QueryTask *task, RecordingReader *rd, Buckets *local) {
+    int map[TCR_MAX_COLUMNS];
+    long long records = 0;
+    int64_t first_us = INT64_MAX;
+    int64_t last_us = INT64_MIN;
+    
+    recording_reader_init(rd, &run->paths[task->file], 1);
+    local->count = 0;
+    
+    int result = task->indexed ? recording_reader_seek(rd, task->header_offset, task->offset) : THERMO_SUCCESS;
+    while (result == THERMO_SUCCESS || result == 1) {
+        result = recording_reader_next(rd);
+        if (result != 1 || rd->record_offset >= task->end) break;
+    
+        if (rd->schema_changed) {
+            map_schema(run, rd->schema, map);
+            rd->schema_changed = 0;
+        }
+        const FlatRecord *rec = rd->record;
+        int64_t timestamp_us = rec->timestamp_us;
+        if (timestamp_us < task->from_us || timestamp_us >= run->to_us) continue;
+    
+        int64_t id = run->every_us > 0 ? floor_div(timestamp_us - run->origin_us, run->every_us) : 0;
+        int b = buckets_index(local, id);
+        if (b < 0) {
+            fprintf(stderr, "Error: Too many intervals; use a longer --every or a shorter range\n");
+            result = THERMO_ERROR;
+            break;
+        }
+        local->records[b]++;
+        for (int s = 0; s < rec->count; s++) {
+            int c = map[s];
+            if (c < 0 || !rec->present[s] || rec->strings[s]) continue;
+            double value = rec->values[s];
+            if (isnan(value) || (run->temperature[c] && thermo_classify_temp(value) != READING_OK)) continue;
+            column_agg_add(&local->aggs[(size_t)b * local->columns + c], value);
+        }
+    
+        records++;
+        if (timestamp_us < first_us) first_us = timestamp_us;
+        if (timestamp_us > last_us) last_us = timestamp_us;
+    }
+    recording_reader_free(rd);
+    if (result < 0) return result;
+    
+    pthread_mutex_lock(&run->lock);
+    result = buckets_merge(&run->total, local);
+    run->records += records;
+    if (first_us < run->first_us) run->first_us = first_us;
+    if (last_us > run->last_us) run->last_us = last_us;
+    pthread_mutex_unlock(&run->lock);
+    
+    if (result != THERMO_SUCCESS) {
+        fprintf(stderr, "Error: Too many intervals; use a longer --every or a shorter range\n");
+    }
+    return result;
+}
+
+static void* query_worker(void *arg) {
+    QueryRun *run = (QueryRun*)arg;
+    Buckets local = { .columns = run->column_count };
+    RecordingReader *rd = (RecordingReader*)malloc(sizeof(RecordingReader));
+    
+    if (!rd) {
+        fprintf(stderr, "Error: Failed to allocate memory\n");
+        atomic_store(&run->failed, 1);
+        return NULL;
+    }
+    
+    while (!atomic_load(&run->failed)) {
+        int t = atomic_fetch_add(&run->next_task, 1);
+        if (t >= run->task_count) break;
+        if (query_task(run, &run->tasks[t], rd, &local) != THERMO_SUCCESS) {
+            atomic_store(&run->failed, 1);
+        }
+    }
+    
+    buckets_free(&local);
+    free(rd);
+    return NULL;
+}
+
+/* Chunks of every file in order; files without an index are one chunk.
+ * Returns the count, or -1. */
+static int collect_chunks(char **paths, int path_count, Chunk **chunks_out, long long *total_bytes) {
+    Chunk *chunks = NULL;
+    int count = 0;
+    int capacity = 0;
+    *total_bytes = 0;
+    
+    for (int f = 0; f < path_count; f++) {
+        struct stat st;
+        if (stat(paths[f], &st) != 0) {
+            fprintf(stderr, "Error: Cannot open '%s'\n", paths[f]);
+            free(chunks);
+            return -1;
+        }
+        long long size = (long long)st.st_size;
+        *total_bytes += size;
+    
+        TimeIndexEntry *entries = NULL;
+        int entry_count = time_index_load(paths[f], size, &entries);
+        if (entry_count < 0) {
+            fprintf(stderr, "Error: Failed to allocate memory\n");
+            free(chunks);
+            return -1;
+        }
+        if (entry_count == 0) {
+            fprintf(stderr, "Warning: '%s' has no time index; reading all of it\n", paths[f]);
+        }
+    
+        int needed = count + (entry_count > 0 ? entry_count : 1);
+        if (needed > capacity) {
+            capacity = needed * 2;
+            Chunk *grown = (Chunk*)realloc(chunks, (size_t)capacity * sizeof(Chunk));
+            if (!grown) {
+                fprintf(stderr, "Error: Failed to allocate memory\n");
+                free(entries);
+                free(chunks);
+                return -1;
+            }
+            chunks = grown;
+        }
+    
+        if (entry_count == 0) {
+            chunks[count++] = (Chunk){ .file = f, .indexed = 0, .start_us = INT64_MIN,
+                                       .header_offset = 0, .offset = 0, .end = size };
+        }
+        for (int i = 0; i < entry_count; i++) {
+            chunks[count++] = (Chunk){ .file = f, .indexed = 1, .start_us = entries[i].timestamp_us,
+                                       .header_offset = entries[i].header_offset, .offset = entries[i].offset,
+                                       .end = (i + 1 < entry_count) ? entries[i + 1].offset : size };
+        }
+        free(entries);
+    }
+    
+    *chunks_out = chunks;
+    return count;
+}
+
+/* Chunks that can hold records in [from, to): a chunk ends where the next
+ * one starts, so it is read unless it starts at or after to, or the next
+ * starts before from. Runs of up to run_length consecutive chunks of a
+ * file become one task. Returns the task count, or -1. */
+static int plan_tasks(const Chunk *chunks, int chunk_count, int64_t from_us, int64_t to_us, int threads,
+                      QueryTask **tasks_out, int *selected_out, long long *bytes_out) {
+    uint8_t *selected = (uint8_t*)calloc((size_t)chunk_count + 1, 1);
+    QueryTask *tasks = (QueryTask*)malloc(((size_t)chunk_count + 1) * sizeof(QueryTask));
+    if (!selected || !tasks) {
+        fprintf(stderr, "Error: Failed to allocate memory\n");
+        free(selected);
+        free(tasks);
+        return -1;
+    }
+    
+    int selected_count = 0;
+    for (int i = 0; i < chunk_count; i++) {
+        /* A file's last chunk runs to its end, whatever the next file holds */
+        int64_t next_us = (i + 1 < chunk_count && chunks[i + 1].file == chunks[i].file &&
+                           chunks[i + 1].start_us != INT64_MIN) ? chunks[i + 1].start_us : INT64_MAX;
+        selected[i] = (chunks[i].start_us == INT64_MIN) || (chunks[i].start_us < to_us && next_us >= from_us);
+        selected_count += selected[i];
+    }
+    
+    /* A few runs per thread keeps them busy without re-seeking every chunk */
+    int run_length = selected_count / (threads * 4);
+    if (run_length < 1) run_length = 1;
+    
+    int task_count = 0;
+    int in_run = 0;
+    *bytes_out = 0;
+    for (int i = 0; i < chunk_count; i++) {
+        if (!selected[i]) {
+            in_run = 0;
+            continue;
+        }
+        *bytes_out += chunks[i].end - chunks[i].offset;
+        if (in_run > 0 && in_run < run_length && chunks[i].file == tasks[task_count - 1].file) {
+            tasks[task_count - 1].end = chunks[i].end;
+            in_run++;
+            continue;
+        }
+        tasks[task_count++] = (QueryTask){ .file = chunks[i].file, .indexed = chunks[i].indexed,
+                                           .from_us = from_us, .header_offset = chunks[i].header_offset,
+                                           .offset = chunks[i].offset, .end = chunks[i].end };
+        in_run = 1;
+    }
+    
+    free(selected);
+    *tasks_out = tasks;
+    *selected_out = selected_count;
+    return task_count;
+}
+
+/* ============================================================================
+ * Rollups
+ * ============================================================================ */
+
+/* Rows of a rollup file are read from the first one at or after --from,
+ * found by bisection; this close, they are scanned */
+#define ROLLUP_SCAN_BYTES 4096
+
+/* Does the rollup file at path hold every queried column? */
+static int rollup_has_columns(const QueryRun *run, const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+    
+    char *line = NULL;
+    size_t cap = 0;
+    int found = 0;
+    int wanted = run->column_count * 4;
+    if (getline(&line, &cap, fp) > 0) {
+        char *saveptr = NULL;
+        for (char *name = strtok_r(line, ",\r\n", &saveptr); name; name = strtok_r(NULL, ",\r\n", &saveptr)) {
+            for (int c = 0; c < run->column_count; c++) {
+                size_t len = strlen(run->columns[c]);
+                if (strncmp(name, run->columns[c], len) != 0 || name[len] != '_') continue;
+                for (int a = 0; a < 4; a++) {
+                    found += strcmp(name + len + 1, agg_names[a]) == 0;
+                }
+            }
+        }
+    }
+    free(line);
+    fclose(fp);
+    return found >= wanted;
+}
+
+/* Rollup intervals of width_us cover the range and the output intervals
+ * exactly when their bounds are multiples of it (rollups start at the epoch) */
+static int rollup_fits(const QueryRun *run, int64_t width_us) {
+    return (run->every_us == 0 || run->every_us % width_us == 0) &&
+           (run->from_us == INT64_MIN || run->from_us % width_us == 0) &&
+           (run->to_us == INT64_MAX || run->to_us % width_us == 0);
+}
+
+/* The widest rollup level every file has that fits the query, or 0 */
+static int64_t choose_rollup(const QueryRun *run, int file_count) {
+    char pattern[320];
+    snprintf(pattern, sizeof(pattern), "%s%s*", run->paths[0], ROLLUP_SUFFIX);
+    glob_t matches;
+    if (glob(pattern, 0, NULL, &matches) != 0) return 0;
+    
+    int64_t best_us = 0;
+    size_t prefix_len = strlen(run->paths[0]) + strlen(ROLLUP_SUFFIX);
+    for (size_t m = 0; m < matches.gl_pathc; m++) {
+        int64_t width_us;
+        if (rollup_parse_width(matches.gl_pathv[m] + prefix_len, &width_us) != THERMO_SUCCESS || width_us <= best_us ||
+            !rollup_fits(run, width_us)) {
+            continue;
+        }
+        int usable = 1;
+        for (int f = 0; f < file_count && usable; f++) {
+            char path[320];
+            rollup_path(path, sizeof(path), run->paths[f], width_us);
+            usable = rollup_has_columns(run, path);
+        }
+        if (usable) best_us = width_us;
+    }
+    globfree(&matches);
+    return best_us;
+}
+
+/* TIME of a rollup row ("SECONDS.MICROS,...") */
+static int rollup_row_time(const char *line, int64_t *timestamp_us) {
+    char *end = NULL;
+    long long sec = strtoll(line, &end, 10);
+    if (end == line || *end != '.') return THERMO_INVALID_PARAM;
+    long long usec = strtoll(end + 1, &end, 10);
+    if (*end != ',') return THERMO_INVALID_PARAM;
+    *timestamp_us = (int64_t)sec * 1000000 + usec;
+    return THERMO_SUCCESS;
+}
+
+/* Offset of a row at or before the first one at or after from_us, with
+ * every row before it earlier than from_us */
+static long long rollup_lower_bound(FILE *fp, int64_t from_us) {
+    char *line = NULL;
+    size_t cap = 0;
+    rewind(fp);
+    ssize_t header_len = getline(&line, &cap, fp);
+    long long lo = header_len > 0 ? header_len : 0;
+    
+    if (from_us != INT64_MIN && fseeko(fp, 0, SEEK_END) == 0) {
+        long long hi = (long long)ftello(fp);
+        while (hi - lo > ROLLUP_SCAN_BYTES) {
+            long long mid = lo + (hi - lo) / 2;
+            int64_t row_us;
+            fseeko(fp, (off_t)mid, SEEK_SET);
+            getline(&line, &cap, fp);       /* Rest of the row mid falls in */
+            long long row = (long long)ftello(fp);
+            if (getline(&line, &cap, fp) <= 0 || rollup_row_time(line, &row_us) != THERMO_SUCCESS ||
+                row_us >= from_us) {
+                hi = mid;
+            } else {
+                lo = row;
+            }
+        }
+    }
+    free(line);
+    return lo;
+}
+
+/* TIME of the last row (INT64_MIN if there is none), read from the end */
+static int64_t rollup_last_time(FILE *fp) {
+    char *line = NULL;
+    size_t cap = 0;
+    int64_t last_us = INT64_MIN;
+    rewind(fp);
+    ssize_t header_len = getline(&line, &cap, fp);
+    long long lo = header_len > 0 ? header_len : 0;
+    
+    if (fseeko(fp, 0, SEEK_END) == 0) {
+        long long size = (long long)ftello(fp);
+        for (long long span = ROLLUP_SCAN_BYTES; last_us == INT64_MIN; span *= 2) {
+            long long start = size - span > lo ? size - span : lo;
+            fseeko(fp, (off_t)start, SEEK_SET);
+            if (start > lo) {
+                getline(&line, &cap, fp);   /* Rest of the row start falls in */
+            }
+            int64_t row_us;
+            while (getline(&line, &cap, fp) > 0) {
+                if (rollup_row_time(line, &row_us) == THERMO_SUCCESS) last_us = row_us;
+            }
+            if (start == lo) break;
+        }
+    }
+    free(line);
+    return last_us;
+}
+
+/* Add the rows of a rollup file in [from, to) to the total, up to its
+ * last interval, which may still be open (or was cut short and then
+ * continued); *tail_us is where the records take over. Returns the rows
+ * read, or an error. */
+static long long query_rollup_file(QueryRun *run, char *path, RecordingReader *rd, int64_t *tail_us) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open '%s'\n", path);
+        return THERMO_IO_ERROR;
+    }
+    long long offset = rollup_lower_bound(fp, run->from_us);
+    *tail_us = rollup_last_time(fp);
+    fclose(fp);
+    
+    /* Schema columns of RECORDS and of each queried column's aggregates */
+    int records_column = -1;
+    int columns[TCR_MAX_COLUMNS][4];
+    long long rows = 0;
+    
+    recording_reader_init(rd, &path, 1);
+    int result = recording_reader_seek(rd, 0, offset);
+    if (result == THERMO_SUCCESS) {
+        const RecordSchema *schema = rd->schema;
+        for (int c = 0; c < run->column_count; c++) {
+            for (int a = 0; a < 4; a++) {
+                char name[300];
+                snprintf(name, sizeof(name), "%s_%s", run->columns[c], agg_names[a]);
+                columns[c][a] = -1;
+                for (int s = 0; s < schema->count; s++) {
+                    if (strcmp(schema->names[s], name) == 0) columns[c][a] = s;
+                }
+            }
+        }
+        for (int s = 0; s < schema->count; s++) {
+            if (strcmp(schema->names[s], "RECORDS") == 0) records_column = s;
+        }
+    }
+    
+    while (result == THERMO_SUCCESS || result == 1) {
+        result = recording_reader_next(rd);
+        if (result != 1) break;
+    
+        const FlatRecord *rec = rd->record;
+        int64_t timestamp_us = rec->timestamp_us;
+        if (timestamp_us < run->from_us) continue;
+        if (timestamp_us >= run->to_us || timestamp_us >= *tail_us) break;
+    
+        int64_t id = run->every_us > 0 ? floor_div(timestamp_us - run->origin_us, run->every_us) : 0;
+        int b = buckets_index(&run->total, id);
+        if (b < 0) {
+            fprintf(stderr, "Error: Too many intervals; use a longer --every or a shorter range\n");
+            result = THERMO_ERROR;
+            break;
+        }
+        long long records = (records_column >= 0 && rec->present[records_column])
+                            ? (long long)rec->values[records_column] : 0;
+        run->total.records[b] += records;
+        run->records += records;
+        for (int c = 0; c < run->column_count; c++) {
+            int count = columns[c][AGG_COUNT];
+            if (count < 0 || columns[c][AGG_MEAN] < 0 || columns[c][AGG_MIN] < 0 || columns[c][AGG_MAX] < 0 ||
+                !rec->present[count] || rec->values[count] <= 0) {
+                continue;
+            }
+            ColumnAgg agg = { .count = (long long)rec->values[count] };
+            agg.sum = rec->values[columns[c][AGG_MEAN]] * agg.count;
+            agg.min = rec->values[columns[c][AGG_MIN]];
+            agg.max = rec->values[columns[c][AGG_MAX]];
+            column_agg_merge(&run->total.aggs[(size_t)b * run->total.columns + c], &agg);
+        }
+    
+        rows++;
+        if (timestamp_us < run->first_us) run->first_us = timestamp_us;
+        if (timestamp_us > run->last_us) run->last_us = timestamp_us;
+    }
+    recording_reader_free(rd);
+    return result < 0 ? result : rows;
+}
+
+/* Add the records of file f from from_us on, reading only the chunks its
+ * time index places there. Returns the records added, or an error. */
+static long long query_rollup_tail(QueryRun *run, int f, int64_t from_us, RecordingReader *rd,
+                                   long long *bytes) {
+    Chunk *chunks = NULL;
+    QueryTask *tasks = NULL;
+    Buckets local = { .columns = run->column_count };
+    long long total_bytes = 0;
+    long long records = run->records;
+    int selected = 0;
+    
+    int chunk_count = collect_chunks(&run->paths[f], 1, &chunks, &total_bytes);
+    int task_count = chunk_count < 0 ? -1
+                     : plan_tasks(chunks, chunk_count, from_us, run->to_us, 1, &tasks, &selected, bytes);
+    int result = task_count < 0 ? THERMO_ERROR : THERMO_SUCCESS;
+    for (int t = 0; t < task_count && result == THERMO_SUCCESS; t++) {
+        tasks[t].file = f;
+        result = query_task(run, &tasks[t], rd, &local);
+    }
+    
+    buckets_free(&local);
+    free(tasks);
+    free(chunks);
+    return result != THERMO_SUCCESS ? result : run->records - records;
+}
+
+/* ============================================================================
+ * Columns
+ * ============================================================================ */
+
+/* A requested name prefixes the value columns it selects ("MOTOR" selects
+ * MOTOR_TEMPERATURE, MOTOR_ADC, ...); a column named in full is always taken */
+static int name_selects(const char *request, const char *name) {
+    size_t len = strlen(request);
+    return strncmp(name, request, len) == 0 && (name[len] == '\0' || name[len] == '_');
+}
+
+/* Queried columns from the first record's schema: those requested, else
+ * every numeric value column (not addresses, channels or flags) */
+static int select_columns(QueryRun *run, const RecordSchema *schema, const FlatRecord *first,
+                          char **requested, int requested_count) {
+    run->columns = (char**)calloc((size_t)schema->count + 1, sizeof(char*));
+    run->temperature = (uint8_t*)calloc((size_t)schema->count + 1, 1);
+    if (!run->columns || !run->temperature) {
+        fprintf(stderr, "Error: Failed to allocate memory\n");
+        return THERMO_ERROR;
+    }
+    
+    for (int r = 0; r < requested_count; r++) {
+        int matched = 0;
+        for (int s = 0; s < schema->count; s++) {
+            matched |= name_selects(requested[r], schema->names[s]);
+        }
+        if (!matched) {
+            fprintf(stderr, "Warning: No column '%s' in '%s'\n", requested[r], run->paths[0]);
+        }
+    }
+    
+    for (int s = 0; s < schema->count; s++) {
+        const char *name = schema->names[s];
+        int value_column = !(first->present[s] && first->strings[s]) && record_column_is_value(name);
+        int wanted = (requested_count == 0) && value_column;
+        for (int r = 0; r < requested_count && !wanted; r++) {
+            wanted = strcmp(requested[r], name) == 0 || (value_column && name_selects(requested[r], name));
+        }
+        if (!wanted) continue;
+    
+        run->columns[run->column_count] = strdup(name);
+        if (!run->columns[run->column_count]) {
+            fprintf(stderr, "Error: Failed to allocate memory\n");
+            return THERMO_ERROR;
+        }
+        run->temperature[run->column_count] = record_column_is_temperature(name);
+        run->column_count++;
+    }
+    
+    if (run->column_count == 0) {
+        fprintf(stderr, "Error: No columns to aggregate in '%s'\n", run->paths[0]);
+        return THERMO_INVALID_PARAM;
+    }
+    return THERMO_SUCCESS;
+}
+
+/* ============================================================================
+ * Output
+ * ============================================================================ */
+
+/* Intervals start at origin; the whole range starts at --from or its first record */
+static int64_t bucket_start(const QueryRun *run, int64_t id) {
+    if (run->every_us > 0) return run->origin_us + id * run->every_us;
+    return run->from_us != INT64_MIN ? run->from_us : run->first_us;
+}
+
+static void print_csv(const QueryRun *run, const AggKind *aggs, int agg_count) {
+    printf("TIME,RECORDS");
+    for (int c = 0; c < run->column_count; c++) {
+        for (int a = 0; a < agg_count; a++) {
+            printf(",%s_%s", run->columns[c], agg_names[aggs[a]]);
+        }
+    }
+    printf("\n");
+    
+    const Buckets *b = &run->total;
+    for (int i = 0; i < b->count; i++) {
+        if (b->records[i] == 0) continue;
+        int64_t start_us = bucket_start(run, b->base + i);
+        printf("%lld.%06lld,%lld", (long long)floor_div(start_us, 1000000),
+               (long long)(start_us - floor_div(start_us, 1000000) * 1000000), b->records[i]);
+        for (int c = 0; c < run->column_count; c++) {
+            const ColumnAgg *agg = &b->aggs[(size_t)i * b->columns + c];
+            for (int a = 0; a < agg_count; a++) {
+                char number[32];
+                number[0] = '\0';
+                if (agg->count > 0) {
+                    switch (aggs[a]) {
+                        case AGG_MEAN: csv_format_number(number, sizeof(number), agg->sum / agg->count); break;
+                        case AGG_MIN: csv_format_number(number, sizeof(number), agg->min); break;
+                        case AGG_MAX: csv_format_number(number, sizeof(number), agg->max); break;
+                        case AGG_COUNT: snprintf(number, sizeof(number), "%lld", agg->count); break;
+                    }
+                }
+                printf(",%s", number);
+            }
+        }
+        printf("\n");
+    }
+}
+
+static void print_json(const QueryRun *run, const AggKind *aggs, int agg_count) {
+    const Buckets *b = &run->total;
+    for (int i = 0; i < b->count; i++) {
+        if (b->records[i] == 0) continue;
+        int64_t start_us = bucket_start(run, b->base + i);
+    
+        cJSON *root = cJSON_CreateObject();
+        cJSON_AddNumberToObject(root, "TIME", start_us / 1e6);
+        cJSON_AddNumberToObject(root, "RECORDS", (double)b->records[i]);
+        for (int c = 0; c < run->column_count; c++) {
+            const ColumnAgg *agg = &b->aggs[(size_t)i * b->columns + c];
+            if (agg->count == 0) continue;
+            cJSON *column = cJSON_AddObjectToObject(root, run->columns[c]);
+            for (int a = 0; a < agg_count; a++) {
+                double value = 0;
+                switch (aggs[a]) {
+                    case AGG_MEAN: value = agg->sum / agg->count; break;
+                    case AGG_MIN: value = agg->min; break;
+                    case AGG_MAX: value = agg->max; break;
+                    case AGG_COUNT: value = (double)agg->count; break;
+                }
+                cJSON_AddNumberToObject(column, agg_names[aggs[a]], value);
+            }
+        }
+        json_print_and_free(root, 0);
+    }
+}
+
+/* ============================================================================
+ * Options
+ * ============================================================================ */
+
+/* Epoch seconds, or local time as YYYY-MM-DDTHH:MM:SS[.ffffff] */
+static int parse_query_time(const char *str, const char *option, int64_t *timestamp_us) {
+    static const char *formats[] = {
+        "%Y-%m-%dT%H:%M:%S.%f", "%Y-%m-%dT%H:%M:%S", "%Y-%m-%d %H:%M:%S.%f", "%Y-%m-%d %H:%M:%S"
+    };
+    
+    char *end = NULL;
+    double seconds = strtod(str, &end);
+    if (end != str && *end == '\0' && isfinite(seconds)) {
+        *timestamp_us = (int64_t)llround(seconds * 1e6);
+        return THERMO_SUCCESS;
+    }
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        struct timeval tv = {0};
+        if (bridge_parse_timestamp(str, formats[i], &tv) == THERMO_SUCCESS) {
+            *timestamp_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+            return THERMO_SUCCESS;
+        }
+    }
+    fprintf(stderr, "Error: Invalid %s '%s' (epoch seconds or YYYY-MM-DDTHH:MM:SS[.ffffff])\n", option, str);
+    return THERMO_INVALID_PARAM;
+}
+
+/* N[us|ms|s|m|h|d], seconds by default */
+static int parse_every(const char *str, int64_t *every_us) {
+    static const struct { const char *suffix; double us; } units[] = {
+        {"", 1e6}, {"us", 1.0}, {"ms", 1e3}, {"s", 1e6}, {"m", 60e6}, {"h", 3600e6}, {"d", 86400e6}
+    };
+    
+    char *end = NULL;
+    double value = strtod(str, &end);
+    if (end != str && value > 0) {
+        for (size_t i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+            double us = value * units[i].us;
+            if (strcmp(end, units[i].suffix) == 0 && us >= 1 && us < 9e18) {
+                *every_us = (int64_t)llround(us);
+                return THERMO_SUCCESS;
+            }
+        }
+    }
+    fprintf(stderr, "Error: Invalid --every '%s' (a duration such as 500ms, 10s, 5m or 1h)\n", str);
+    return THERMO_INVALID_PARAM;
+}
+
+static int parse_aggs(const char *str, AggKind *aggs, int *count) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s", str);
+    *count = 0;
+    
+    char *saveptr = NULL;
+    for (char *tok = strtok_r(buf, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+        int kind = -1;
+        for (int k = 0; k < (int)(sizeof(agg_names) / sizeof(agg_names[0])); k++) {
+            if (strcasecmp(tok, agg_names[k]) == 0) kind = k;
+        }
+        if (kind < 0 || *count >= 4) {
+            fprintf(stderr, "Error: Invalid --agg '%s' (mean, min, max, count)\n", str);
+            return THERMO_INVALID_PARAM;
+        }
+        aggs[(*count)++] = (AggKind)kind;
+    }
+    if (*count == 0) {
+        fprintf(stderr, "Error: Invalid --agg '%s' (mean, min, max, count)\n", str);
+        return THERMO_INVALID_PARAM;
+    }
+    return THERMO_SUCCESS;
+}
+
+/* Long-only option codes */
+enum {
+    OPT_FROM = 256,
+    OPT_TO,
+    OPT_EVERY,
+    OPT_AGG,
+    OPT_COLUMNS,
+    OPT_THREADS,
+    OPT_RAW
+};
+
+/* Command: query - Aggregate recorded values over a time range */
+int cmd_query(int argc, char **argv) {
+    int64_t from_us = INT64_MIN;
+    int64_t to_us = INT64_MAX;
+    int64_t every_us = 0;
+    int has_from = 0;
+    AggKind aggs[4] = {AGG_MEAN, AGG_MIN, AGG_MAX};
+    int agg_count = 3;
+    char *columns_arg = NULL;
+    int threads = 0;
+    int json_output = 0;
+    int raw = 0;
+    
+    static struct option long_options[] = {
+        {"from", required_argument, 0, OPT_FROM},
+        {"to", required_argument, 0, OPT_TO},
+        {"every", required_argument, 0, OPT_EVERY},
+        {"agg", required_argument, 0, OPT_AGG},
+        {"columns", required_argument, 0, OPT_COLUMNS},
+        {"threads", required_argument, 0, OPT_THREADS},
+        {"raw", no_argument, 0, OPT_RAW},
+        {"json", no_argument, 0, 'j'},
+        {0, 0, 0, 0}
+    };
+    
+    int opt;
+    while ((opt = getopt_long(argc, argv, "j", long_options, NULL)) != -1) {
+        switch (opt) {
+            case OPT_FROM:
+                if (parse_query_time(optarg, "--from", &from_us) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                has_from = 1;
+                break;
+            case OPT_TO:
+                if (parse_query_time(optarg, "--to", &to_us) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                break;
+            case OPT_EVERY:
+                if (parse_every(optarg, &every_us) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                break;
+            case OPT_AGG:
+                if (parse_aggs(optarg, aggs, &agg_count) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                break;
+            case OPT_COLUMNS: columns_arg = optarg; break;
+            case OPT_THREADS:
+                threads = atoi(optarg);
+                if (threads < 1 || threads > QUERY_MAX_THREADS) {
+                    fprintf(stderr, "Error: --threads must be 1 to %d\n", QUERY_MAX_THREADS);
+                    return 1;
+                }
+                break;
+            case OPT_RAW: raw = 1; break;
+            case 'j': json_output = 1; break;
+            default:
+                fprintf(stderr, "Usage: thermo-cli query [OPTIONS] FILE...\n");
+                return 1;
+        }
+    }
+    
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: thermo-cli query [OPTIONS] FILE...\n");
+        return 1;
+    }
+    if (to_us <= from_us) {
+        fprintf(stderr, "Error: --to must be after --from\n");
+        return 1;
+    }
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus < 1 ? 1 : (cpus > QUERY_MAX_THREADS ? QUERY_MAX_THREADS : (int)cpus);
+    }
+    
+    QueryRun *run = (QueryRun*)calloc(1, sizeof(QueryRun));
+    RecordingReader *rd = (RecordingReader*)malloc(sizeof(RecordingReader));
+    if (!run || !rd) {
+        fprintf(stderr, "Error: Failed to allocate memory\n");
+        free(run);
+        free(rd);
+        return 1;
+    }
+    run->paths = &argv[optind];
+    run->from_us = from_us;
+    run->to_us = to_us;
+    run->origin_us = has_from ? from_us : 0;
+    run->every_us = every_us;
+    run->first_us = INT64_MAX;
+    run->last_us = INT64_MIN;
+    pthread_mutex_init(&run->lock, NULL);
+    
+    /* The first record's schema names the columns; numeric ones by default */
+    char *requested[TCR_MAX_COLUMNS];
+    int requested_count = 0;
+    char *saveptr = NULL;
+    for (char *tok = columns_arg ? strtok_r(columns_arg, ",", &saveptr) : NULL;
+         tok && requested_count < TCR_MAX_COLUMNS; tok = strtok_r(NULL, ",", &saveptr)) {
+        requested[requested_count++] = tok;
+    }
+    
+    recording_reader_init(rd, run->paths, 1);
+    int result = recording_reader_next(rd);
+    if (result == 0) {
+        fprintf(stderr, "Error: No records in '%s'\n", run->paths[0]);
+        result = THERMO_INVALID_PARAM;
+    } else if (result == 1) {
+        result = select_columns(run, rd->schema, rd->record, requested, requested_count);
+    }
+    recording_reader_free(rd);
+    run->total.columns = run->column_count;
+    
+    /* A rollup level that fits stands in for the records, a row per interval */
+    int file_count = argc - optind;
+    int64_t rollup_us = (result == THERMO_SUCCESS && !raw) ? choose_rollup(run, file_count) : 0;
+    if (rollup_us > 0) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    
+        /* Each file's last interval, still open while it is recorded, comes from its records */
+        long long rows = 0;
+        long long tail_records = 0;
+        long long tail_bytes = 0;
+        for (int f = 0; f < file_count && result == THERMO_SUCCESS; f++) {
+            char path[320];
+            int64_t tail_us;
+            rollup_path(path, sizeof(path), run->paths[f], rollup_us);
+            long long n = query_rollup_file(run, path, rd, &tail_us);
+            if (n >= 0) {
+                rows += n;
+                long long bytes = 0;
+                n = query_rollup_tail(run, f, tail_us > run->from_us ? tail_us : run->from_us, rd, &bytes);
+                tail_records += n > 0 ? n : 0;
+                tail_bytes += bytes;
+            }
+            if (n < 0) {
+                result = (int)n;
+            }
+        }
+    
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+        if (result == THERMO_SUCCESS) {
+            if (json_output) {
+                print_json(run, aggs, agg_count);
+            } else {
+                print_csv(run, aggs, agg_count);
+            }
+            char width[32];
+            rollup_format_width(rollup_us, width, sizeof(width));
+            fprintf(stderr, "Aggregated %lld record%s from %lld row%s of the %s rollups and %lld record%s "
+                    "(%lld bytes) after them in %.3f s\n", run->records, run->records == 1 ? "" : "s",
+                    rows, rows == 1 ? "" : "s", width, tail_records, tail_records == 1 ? "" : "s",
+                    tail_bytes, elapsed);
+        }
+    }
+    free(rd);
+    
+    Chunk *chunks = NULL;
+    int chunk_count = 0;
+    int selected = 0;
+    long long total_bytes = 0;
+    long long read_bytes = 0;
+    if (result == THERMO_SUCCESS && rollup_us == 0) {
+        chunk_count = collect_chunks(run->paths, file_count, &chunks, &total_bytes);
+        run->task_count = chunk_count < 0 ? -1
+                          : plan_tasks(chunks, chunk_count, from_us, to_us, threads, &run->tasks, &selected, &read_bytes);
+        if (run->task_count < 0) {
+            result = THERMO_ERROR;
+        }
+    }
+    
+    if (result == THERMO_SUCCESS && rollup_us == 0) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    
+        if (threads > run->task_count) threads = run->task_count > 0 ? run->task_count : 1;
+        pthread_t workers[QUERY_MAX_THREADS];
+        int started = 0;
+        for (int i = 1; i < threads; i++) {
+            if (pthread_create(&workers[started], NULL, query_worker, run) != 0) break;
+            started++;
+        }
+        query_worker(run);
+        for (int i = 0; i < started; i++) {
+            pthread_join(workers[i], NULL);
+        }
+    
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+        if (atomic_load(&run->failed)) {
+            result = THERMO_ERROR;
+        } else {
+            if (json_output) {
+                print_json(run, aggs, agg_count);
+            } else {
+                print_csv(run, aggs, agg_count);
+            }
+            fprintf(stderr, "Aggregated %lld record%s from %d of %d chunk%s (%lld of %lld bytes) in %.3f s on %d thread%s\n",
+                    run->records, run->records == 1 ? "" : "s", selected, chunk_count, chunk_count == 1 ? "" : "s",
+                    read_bytes, total_bytes, elapsed, started + 1, started == 0 ? "" : "s");
+        }
+    }
+    
+    for (int c = 0; c < run->column_count; c++) {
+        free(run->columns[c]);
+    }
+    free(run->columns);
+    free(run->temperature);
+    free(run->tasks);
+    free(chunks);
+    buckets_free(&run->total);
+    pthread_mutex_destroy(&run->lock);
+    free(run);
+    return result == THERMO_SUCCESS ? 0 : 1;
+}
@@ -0,0 +1,719 @@
+/*
+ * Replay command implementation.
+ * Feeds recordings written by the file sinks (CSV or binary; several files
+ * are rotated segments, replayed in order) back through the stages a live
+ * stream goes through: each source's filter and deadband, then either get's
+ * JSON record or, with --fuse, injection into the lines of a recorded
+ * cmg-cli stream, and finally the output queue and sinks. The recorded
+ * timestamps set the pace: real time, N times faster, or as fast as the
+ * sinks take it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "commands/replay.h"
+#include "bridge.h"
+#include "common.h"
+#include "hardware.h"
+#include "json_utils.h"
+#include "output_queue.h"
+#include "recording.h"
+#include "signals.h"
+#include "sink.h"
+#include "stats.h"
+#include "trace.h"
+#include "utils.h"
+
+#define REPLAY_MAX_SOURCES 64
+#define REPLAY_DEFAULT_TIME_FORMAT "%Y-%m-%dT%H:%M:%S.%f"
+
+/* ============================================================================
+ * Sources
+ * ============================================================================ */
+
+/* Column of each recorded field of a source (-1 = not in the recording) */
+typedef struct {
+    int temp;
+    int adc;
+    int cjc;
+    int status;
+    int unchanged;
+    int address;
+    int channel;
+} SourceColumns;
+
+/* Latest recorded values of a source; records that leave a value out hold it */
+typedef struct {
+    double temp;
+    double adc;
+    double cjc;
+} HeldSample;
+
+typedef struct {
+    ThermalSource sources[REPLAY_MAX_SOURCES];
+    char prefixes[REPLAY_MAX_SOURCES][128];     /* Column prefix ("" = single-source recording) */
+    SourceColumns columns[REPLAY_MAX_SOURCES];
+    HeldSample held[REPLAY_MAX_SOURCES];
+    SourceFilter filters[REPLAY_MAX_SOURCES];
+    DeadbandState deadbands[REPLAY_MAX_SOURCES];
+    ChannelReading readings[REPLAY_MAX_SOURCES];
+    int count;
+} ReplaySources;
+
+/* Value columns name a source: <PREFIX>_TEMPERATURE (get), <PREFIX>_TEMP
+ * (fuse), <PREFIX>_ADC, <PREFIX>_CJC, or the bare field in a single-source
+ * recording. Returns the prefix length, or -1 for any other column. */
+static int value_column_prefix(const char *name) {
+    static const char *suffixes[] = {"TEMPERATURE", "TEMP", "ADC", "CJC"};
+    size_t len = strlen(name);
+    
+    for (size_t k = 0; k < sizeof(suffixes) / sizeof(suffixes[0]); k++) {
+        size_t suffix_len = strlen(suffixes[k]);
+        if (len == suffix_len && strcmp(name, suffixes[k]) == 0) return 0;
+        if (len > suffix_len + 1 && strcmp(name + len - suffix_len, suffixes[k]) == 0 &&
+            name[len - suffix_len - 1] == '_') {
+            return (int)(len - suffix_len - 1);
+        }
+    }
+    return -1;
+}
+
+static int find_field(const RecordSchema *schema, const char *prefix, const char *field) {
+    char name[192];
+    if (prefix[0] != '\0') {
+        snprintf(name, sizeof(name), "%s_%s", prefix, field);
+    } else {
+        snprintf(name, sizeof(name), "%s", field);
+    }
+    for (int i = 0; i < schema->count; i++) {
+        if (strcmp(schema->names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+static void map_columns(ReplaySources *rs, const RecordSchema *schema) {
+    for (int i = 0; i < rs->count; i++) {
+        const char *prefix = rs->prefixes[i];
+        SourceColumns *col = &rs->columns[i];
+        col->temp = find_field(schema, prefix, "TEMPERATURE");
+        if (col->temp < 0) {
+            col->temp = find_field(schema, prefix, "TEMP");
+        }
+        col->adc = find_field(schema, prefix, "ADC");
+        col->cjc = find_field(schema, prefix, "CJC");
+        col->status = find_field(schema, prefix, "STATUS");
+        col->unchanged = find_field(schema, prefix, "UNCHANGED");
+        col->address = find_field(schema, prefix, "ADDRESS");
+        col->channel = find_field(schema, prefix, "CHANNEL");
+    }
+}
+
+/* Distinct source prefixes of a recording, in column order. In a fuse
+ * recording only the THERMOCOUPLE object holds sources. */
+static int recorded_prefixes(const RecordSchema *schema, char prefixes[][128], int max) {
+    int fused = 0;
+    for (int i = 0; i < schema->count; i++) {
+        if (strncmp(schema->names[i], "THERMOCOUPLE_", 13) == 0) fused = 1;
+    }
+    
+    int count = 0;
+    for (int i = 0; i < schema->count && count < max; i++) {
+        int len = value_column_prefix(schema->names[i]);
+        if (len < 0 || len >= 128) continue;
+        if (fused && strncmp(schema->names[i], "THERMOCOUPLE_", 13) != 0) continue;
+    
+        int seen = 0;
+        for (int p = 0; p < count && !seen; p++) {
+            seen = (strncmp(prefixes[p], schema->names[i], len) == 0 && prefixes[p][len] == '\0');
+        }
+        if (!seen) {
+            memcpy(prefixes[count], schema->names[i], len);
+            prefixes[count][len] = '\0';
+            count++;
+        }
+    }
+    return count;
+}
+
+/* Config sources take the recorded prefix equal to or ending in "_<KEY>" */
+static int match_config_sources(ReplaySources *rs, const Config *config, const RecordSchema *schema,
+                                const char *path) {
+    char prefixes[REPLAY_MAX_SOURCES][128];
+    int prefix_count = recorded_prefixes(schema, prefixes, REPLAY_MAX_SOURCES);
+    
+    if (config->source_count > REPLAY_MAX_SOURCES) {
+        fprintf(stderr, "Error: At most %d sources can be replayed\n", REPLAY_MAX_SOURCES);
+        return THERMO_INVALID_PARAM;
+    }
+    
+    for (int i = 0; i < config->source_count; i++) {
+        const char *key = config->sources[i].key;
+        size_t key_len = strlen(key);
+        int match = -1;
+        for (int p = 0; p < prefix_count && match < 0; p++) {
+            size_t len = strlen(prefixes[p]);
+            if (key_len > 0 && len >= key_len && strcmp(prefixes[p] + len - key_len, key) == 0 &&
+                (len == key_len || prefixes[p][len - key_len - 1] == '_')) {
+                match = p;
+            }
+        }
+        if (match < 0 && prefix_count == 1 && prefixes[0][0] == '\0' && config->source_count == 1) {
+            match = 0;
+        }
+    
+        rs->sources[i] = config->sources[i];
+        if (match >= 0) {
+            strcpy(rs->prefixes[i], prefixes[match]);
+        } else {
+            fprintf(stderr, "Warning: No columns for source '%s' in '%s'; it replays as a read error\n",
+                    key, path);
+            snprintf(rs->prefixes[i], sizeof(rs->prefixes[i]), "%s", key);
+        }
+    }
+    rs->count = config->source_count;
+    return THERMO_SUCCESS;
+}
+
+/* Without a config every recorded source is replayed under its own key */
+static int recorded_sources(ReplaySources *rs, const RecordSchema *schema, const FlatRecord *first,
+                            const char *path) {
+    rs->count = recorded_prefixes(schema, rs->prefixes, REPLAY_MAX_SOURCES);
+    if (rs->count == 0) {
+        fprintf(stderr, "Error: No thermocouple columns in '%s'\n", path);
+        return THERMO_INVALID_PARAM;
+    }
+    
+    for (int i = 0; i < rs->count; i++) {
+        ThermalSource *src = &rs->sources[i];
+        memset(src, 0, sizeof(*src));
+        const char *key = rs->prefixes[i];
+        if (strncmp(key, "THERMOCOUPLE_", 13) == 0) {
+            key += 13;
+        }
+        if (key[0] == '\0') {
+            int column = find_field(schema, "", "KEY");
+            key = (column >= 0 && first->present[column] && first->strings[column]) ? first->strings[column] : "";
+        }
+        snprintf(src->key, sizeof(src->key), "%s", key);
+        strcpy(src->tc_type, "K");
+        src->cal_coeffs.slope = DEFAULT_CALIBRATION_SLOPE;
+        src->cal_coeffs.offset = DEFAULT_CALIBRATION_OFFSET;
+        src->update_interval = DEFAULT_UPDATE_INTERVAL;
+    }
+    return THERMO_SUCCESS;
+}
+
+static int column_value(const FlatRecord *rec, int column, double *value) {
+    if (column < 0 || !rec->present[column] || rec->strings[column]) return 0;
+    *value = rec->values[column];
+    return 1;
+}
+
+/* A temperature left out of a record that isn't marked unchanged was a
+ * fault: the one its STATUS names (binary recordings keep no strings, so
+ * those replay as read errors) */
+static double recorded_fault(const FlatRecord *rec, int column) {
+    if (column >= 0 && rec->present[column] && rec->strings[column]) {
+        for (int s = READING_OPEN; s <= READING_READ_ERROR; s++) {
+            if (strcmp(rec->strings[column], thermo_status_name((ReadingStatus)s)) == 0) {
+                return thermo_status_value((ReadingStatus)s);
+            }
+        }
+    }
+    return NAN;
+}
+
+/* Take a record's values into each source's held sample */
+static void apply_record(ReplaySources *rs, const FlatRecord *rec) {
+    for (int i = 0; i < rs->count; i++) {
+        const SourceColumns *col = &rs->columns[i];
+        HeldSample *held = &rs->held[i];
+        double value;
+    
+        int unchanged = column_value(rec, col->unchanged, &value) && value != 0;
+        if (column_value(rec, col->temp, &value)) {
+            held->temp = value;
+        } else if (col->temp >= 0 && !unchanged) {
+            held->temp = recorded_fault(rec, col->status);
+        }
+        if (column_value(rec, col->adc, &value)) held->adc = value;
+        if (column_value(rec, col->cjc, &value)) held->cjc = value;
+        if (column_value(rec, col->address, &value)) rs->sources[i].address = (uint8_t)value;
+        if (column_value(rec, col->channel, &value)) rs->sources[i].channel = (uint8_t)value;
+    }
+}
+
+/* Filter and deadband as get --stream does; returns 1 if a record was queued */
+static int emit_thermal(ReplaySources *rs, OutputQueue *output, int64_t timestamp_us) {
+    int changed = 0;
+    
+    for (int i = 0; i < rs->count; i++) {
+        ChannelReading *reading = &rs->readings[i];
+        const HeldSample *held = &rs->held[i];
+        reading->address = rs->sources[i].address;
+        reading->channel = rs->sources[i].channel;
+        if (reading->has_temp) {
+            source_filter_push(&rs->filters[i], held->temp);
+            reading->temperature = source_filter_emit(&rs->filters[i]);
+            reading->status = thermo_classify_temp(reading->temperature);
+        }
+        reading->adc_voltage = held->adc;
+        reading->cjc_temp = held->cjc;
+    
+        double value;
+        ReadingStatus status = channel_reading_deadband_input(reading, &value);
+        reading->unchanged = !deadband_update(&rs->deadbands[i], &rs->sources[i].deadband,
+                                              value, status, timestamp_us);
+        changed |= !reading->unchanged;
+    }
+    
+    if (changed) {
+        cJSON *root = readings_to_json_array(rs->readings, NULL, rs->sources, rs->count, 0, 0, 0, 0);
+        output_queue_push_json(output, root, timestamp_us);
+    }
+    for (int i = 0; i < rs->count; i++) {
+        rs->readings[i].unchanged = 0;
+    }
+    return changed;
+}
+
+/* THERMOCOUPLE object for a cmg-cli line, as fuse builds it */
+static cJSON* fused_data(ReplaySources *rs, int64_t timestamp_us) {
+    cJSON *data = cJSON_CreateObject();
+    for (int i = 0; i < rs->count; i++) {
+        const HeldSample *held = &rs->held[i];
+        int has_voltage = !isnan(held->adc) && !isnan(held->cjc);
+        bridge_add_source(data, &rs->sources[i], &rs->filters[i], &rs->deadbands[i],
+                          held->temp, has_voltage, held->adc, held->cjc, timestamp_us);
+    }
+    return data;
+}
+
+/* Recorded time of a cmg-cli line: the TIMESTAMP fuse added (just before
+ * THERMOCOUPLE in a fused recording; both are removed so the line is fused
+ * afresh), else the producer's own. Returns 1 if one parsed. */
+static int line_time(cJSON *json, const char *time_format, struct timeval *tv) {
+    int found = 0;
+    
+    cJSON *thermo = cJSON_GetObjectItemCaseSensitive(json, "THERMOCOUPLE");
+    if (thermo) {
+        cJSON *stamp = (thermo != json->child) ? thermo->prev : NULL;
+        if (cJSON_IsString(stamp) && stamp->string && strcmp(stamp->string, "TIMESTAMP") == 0) {
+            found = (bridge_parse_timestamp(stamp->valuestring, time_format, tv) == THERMO_SUCCESS);
+            cJSON_Delete(cJSON_DetachItemViaPointer(json, stamp));
+        }
+        cJSON_Delete(cJSON_DetachItemViaPointer(json, thermo));
+    }
+    if (!found) {
+        cJSON *stamp = cJSON_GetObjectItemCaseSensitive(json, "TIMESTAMP");
+        found = cJSON_IsString(stamp) &&
+                bridge_parse_timestamp(stamp->valuestring, time_format, tv) == THERMO_SUCCESS;
+    }
+    return found;
+}
+
+/* ============================================================================
+ * Pacing
+ * ============================================================================ */
+
+typedef struct {
+    double speed;                   /* Recorded seconds per second (0 = no pacing) */
+    int started;
+    int64_t origin_us;              /* Recorded time at origin */
+    struct timespec origin;
+} Pacer;
+
+/* Sleep until a recorded time is due. A step back in recorded time (a new
+ * session) restarts the schedule there. */
+static void pacer_wait(Pacer *pacer, int64_t timestamp_us) {
+    if (pacer->speed <= 0) return;
+    
+    if (!pacer->started || timestamp_us < pacer->origin_us) {
+        clock_gettime(CLOCK_MONOTONIC, &pacer->origin);
+        pacer->origin_us = timestamp_us;
+        pacer->started = 1;
+        return;
+    }
+    
+    double offset_ns = (double)(timestamp_us - pacer->origin_us) * 1000.0 / pacer->speed;
+    struct timespec deadline = pacer->origin;
+    long long ns = deadline.tv_nsec + (long long)offset_ns;
+    deadline.tv_sec += ns / 1000000000LL;
+    deadline.tv_nsec = ns % 1000000000LL;
+    
+    trace_begin("sleep");
+    while (g_running && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+        /* Interrupted by a signal; g_running says whether to carry on */
+    }
+    trace_end("sleep");
+}
+
+static int parse_speed(const char *str, double *speed) {
+    if (strcmp(str, "max") == 0) {
+        *speed = 0;
+        return THERMO_SUCCESS;
+    }
+    char *end = NULL;
+    double value = strtod(str, &end);
+    if (end == str || (*end != '\0' && strcmp(end, "x") != 0) || !(value > 0)) {
+        fprintf(stderr, "Error: Invalid --speed '%s' (a factor such as 1, 10 or 0.5, or max)\n", str);
+        return THERMO_INVALID_PARAM;
+    }
+    *speed = value;
+    return THERMO_SUCCESS;
+}
+
+/* ============================================================================
+ * Replay loops
+ * ============================================================================ */
+
+typedef struct {
+    long long records;              /* Records queued for output */
+    int started;
+    int64_t last_us;
+    int64_t span_us;                /* Recorded time covered; segments that restart it add up */
+} ReplayCount;
+
+static void count_record(ReplayCount *count, int64_t timestamp_us, int queued) {
+    if (count->started && timestamp_us > count->last_us) {
+        count->span_us += timestamp_us - count->last_us;
+    }
+    count->started = 1;
+    count->last_us = timestamp_us;
+    count->records += queued;
+}
+
+/* Thermal recording only: one output record per recorded record, as get --stream */
+static int replay_thermal(RecordingReader *rd, ReplaySources *rs, OutputQueue *output,
+                          Pacer *pacer, ReplayCount *count) {
+    int result = 1;
+    
+    while (g_running && result == 1) {
+        if (rd->schema_changed) {
+            map_columns(rs, rd->schema);
+            rd->schema_changed = 0;
+        }
+        apply_record(rs, rd->record);
+    
+        int64_t timestamp_us = rd->record->timestamp_us;
+        pacer_wait(pacer, timestamp_us);
+        if (!g_running) break;
+    
+        TRACE_SCOPE("record");
+        count_record(count, timestamp_us, emit_thermal(rs, output, timestamp_us));
+        stats_report_due();
+        result = recording_reader_next(rd);
+    }
+    return result < 0 ? result : THERMO_SUCCESS;
+}
+
+/* Apply recorded records up to a time; returns the reader's last result */
+static int advance_thermal(RecordingReader *rd, ReplaySources *rs, int result, int64_t until_us,
+                           int64_t *thermal_us) {
+    while (result == 1 && rd->record->timestamp_us <= until_us) {
+        if (rd->schema_changed) {
+            map_columns(rs, rd->schema);
+            rd->schema_changed = 0;
+        }
+        apply_record(rs, rd->record);
+        *thermal_us = rd->record->timestamp_us;
+        result = recording_reader_next(rd);
+    }
+    return result;
+}
+
+/* Each cmg-cli line gets the thermal values recorded at or before its
+ * time; lines without a usable TIMESTAMP take the next record in turn */
+static int replay_fused(RecordingReader *rd, ReplaySources *rs, FILE *cmg, const char *time_format,
+                        OutputQueue *output, Pacer *pacer, ReplayCount *count) {
+    int64_t thermal_us = rd->record->timestamp_us;
+    int result = advance_thermal(rd, rs, 1, thermal_us, &thermal_us);
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t len;
+    
+    while (g_running && result >= 0 && (len = getline(&line, &line_cap, cmg)) > 0) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+    
+        cJSON *json = (len > 0) ? cJSON_Parse(line) : NULL;
+        if (!cJSON_IsObject(json)) {
+            cJSON_Delete(json);
+            output_queue_push_line(output, line);
+            continue;
+        }
+    
+        struct timeval tv = { .tv_sec = thermal_us / 1000000, .tv_usec = thermal_us % 1000000 };
+        int64_t timestamp_us;
+        if (line_time(json, time_format, &tv)) {
+            timestamp_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+            result = advance_thermal(rd, rs, result, timestamp_us, &thermal_us);
+        } else {
+            if (result == 1) {
+                result = advance_thermal(rd, rs, result, rd->record->timestamp_us, &thermal_us);
+            }
+            timestamp_us = thermal_us;
+            tv.tv_sec = thermal_us / 1000000;
+            tv.tv_usec = thermal_us % 1000000;
+        }
+        if (result < 0) {
+            cJSON_Delete(json);
+            break;
+        }
+    
+        pacer_wait(pacer, timestamp_us);
+        if (!g_running) {
+            cJSON_Delete(json);
+            break;
+        }
+    
+        TRACE_SCOPE("record");
+        cJSON *data = fused_data(rs, timestamp_us);
+        bridge_inject_json(json, data, &tv, time_format);
+        cJSON_Delete(data);
+        output_queue_push_json(output, json, timestamp_us);
+        count_record(count, timestamp_us, 1);
+        stats_report_due();
+    }
+    
+    free(line);
+    return result < 0 ? result : THERMO_SUCCESS;
+}
+
+/* Long-only option codes */
+enum {
+    OPT_SPEED = 256,
+    OPT_FUSE,
+    OPT_OUTPUT_POLICY,
+    OPT_QUEUE_DEPTH,
+    OPT_SINK,
+    OPT_FILTER,
+    OPT_DEADBAND,
+    OPT_TRACE,
+    OPT_STATS
+};
+
+/* Command: replay - Feed recordings through the filter/fusion/output stages */
+int cmd_replay(int argc, char **argv) {
+    char *config_path = NULL;
+    char *fuse_path = NULL;
+    char time_format[64] = REPLAY_DEFAULT_TIME_FORMAT;
+    double speed = 1.0;
+    int json_output = 0;
+    OutputPolicy output_policy = OUTPUT_POLICY_BLOCK;
+    int queue_depth = OUTPUT_QUEUE_DEFAULT_DEPTH;
+    SinkSpec sinks[MAX_SINKS];
+    int sink_count = 0;
+    FilterSpec cli_filter = {0};
+    DeadbandSpec cli_deadband = {0};
+    const char *trace_path = NULL;
+    int stats_enabled = 0;
+    double stats_interval = 0;
+    
+    static struct option long_options[] = {
+        {"config", required_argument, 0, 'C'},
+        {"speed", required_argument, 0, OPT_SPEED},
+        {"fuse", required_argument, 0, OPT_FUSE},
+        {"time-format", required_argument, 0, 'T'},
+        {"json", no_argument, 0, 'j'},
+        {"output-policy", required_argument, 0, OPT_OUTPUT_POLICY},
+        {"queue-depth", required_argument, 0, OPT_QUEUE_DEPTH},
+        {"sink", required_argument, 0, OPT_SINK},
+        {"filter", required_argument, 0, OPT_FILTER},
+        {"deadband", required_argument, 0, OPT_DEADBAND},
+        {"trace", required_argument, 0, OPT_TRACE},
+        {"stats", optional_argument, 0, OPT_STATS},
+        {0, 0, 0, 0}
+    };
+    
+    int opt;
+    while ((opt = getopt_long(argc, argv, "C:T:j", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'C': config_path = optarg; break;
+            case 'T': strncpy(time_format, optarg, sizeof(time_format) - 1); break;
+            case 'j': json_output = 1; break;
+            case OPT_SPEED:
+                if (parse_speed(optarg, &speed) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                break;
+            case OPT_FUSE: fuse_path = optarg; break;
+            case OPT_OUTPUT_POLICY:
+                if (output_policy_from_string(optarg, &output_policy) != THERMO_SUCCESS) {
+                    fprintf(stderr, "Error: Invalid --output-policy '%s' (block, drop-oldest, coalesce)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_QUEUE_DEPTH: queue_depth = atoi(optarg); break;
+            case OPT_SINK:
+                if (sink_count >= MAX_SINKS) {
+                    fprintf(stderr, "Error: At most %d --sink options\n", MAX_SINKS);
+                    return 1;
+                }
+                if (sink_spec_parse(optarg, &sinks[sink_count]) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                sink_count++;
+                break;
+            case OPT_FILTER:
+                if (filter_spec_parse(optarg, &cli_filter) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                break;
+            case OPT_DEADBAND:
+                if (deadband_spec_parse(optarg, &cli_deadband) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                break;
+            case OPT_TRACE: trace_path = optarg; break;
+            case OPT_STATS:
+                if (stats_parse_interval(optarg, &stats_interval) != THERMO_SUCCESS) {
+                    return 1;
+                }
+                stats_enabled = 1;
+                break;
+            default:
+                fprintf(stderr, "Usage: thermo-cli replay [OPTIONS] FILE...\n");
+                return 1;
+        }
+    }
+    
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: thermo-cli replay [OPTIONS] FILE...\n");
+        return 1;
+    }
+    
+    /* Records go to stdout unless sinks say otherwise; --json adds stdout to them */
+    int has_stdout = 0;
+    for (int i = 0; i < sink_count; i++) {
+        if (sinks[i].kind == SINK_STDOUT) {
+            has_stdout = 1;
+        }
+    }
+    if ((sink_count == 0 || json_output) && !has_stdout) {
+        if (sink_count >= MAX_SINKS) {
+            fprintf(stderr, "Error: At most %d --sink options\n", MAX_SINKS);
+            return 1;
+        }
+        sink_spec_default(&sinks[sink_count++]);
+    }
+    
+    if (trace_path && trace_start(trace_path) != THERMO_SUCCESS) {
+        return 1;
+    }
+    if (stats_enabled) {
+        stats_enable(stats_interval);
+    }
+    
+    Config config = {0};
+    if (config_path && config_load(config_path, &config) != THERMO_SUCCESS) {
+        fprintf(stderr, "Error: Failed to load config file: %s\n", config_path);
+        return 1;
+    }
+    
+    FILE *cmg = NULL;
+    if (fuse_path) {
+        cmg = strcmp(fuse_path, "-") == 0 ? stdin : fopen(fuse_path, "r");
+        if (!cmg) {
+            fprintf(stderr, "Error: Cannot open '%s'\n", fuse_path);
+            config_free(&config);
+            return 1;
+        }
+    }
+    
+    RecordingReader *rd = (RecordingReader*)calloc(1, sizeof(RecordingReader));
+    ReplaySources *rs = (ReplaySources*)calloc(1, sizeof(ReplaySources));
+    if (!rd || !rs) {
+        fprintf(stderr, "Error: Failed to allocate memory\n");
+        free(rd);
+        free(rs);
+        if (cmg && cmg != stdin) fclose(cmg);
+        config_free(&config);
+        return 1;
+    }
+    recording_reader_init(rd, &argv[optind], argc - optind);
+    
+    /* Sources come from the config, or from the first recording's columns */
+    int result = recording_reader_next(rd);
+    if (result == 0) {
+        fprintf(stderr, "Error: No records in '%s'\n", rd->paths[0]);
+        result = THERMO_INVALID_PARAM;
+    } else if (result == 1) {
+        result = config_path ? match_config_sources(rs, &config, rd->schema, rd->path)
+                             : recorded_sources(rs, rd->schema, rd->record, rd->path);
+    }
+    
+    SinkSet *sink_set = NULL;
+    OutputQueue *output = NULL;
+    if (result == THERMO_SUCCESS) {
+        for (int i = 0; i < rs->count; i++) {
+            ThermalSource *src = &rs->sources[i];
+            if (src->filter.count == 0 && cli_filter.count > 0) {
+                src->filter = cli_filter;
+            }
+            if (!src->deadband.enabled && cli_deadband.enabled) {
+                src->deadband = cli_deadband;
+            }
+            source_filter_init(&rs->filters[i], &src->filter);
+            rs->held[i].temp = NAN;
+            rs->held[i].adc = NAN;
+            rs->held[i].cjc = NAN;
+        }
+        map_columns(rs, rd->schema);
+        rd->schema_changed = 0;
+        for (int i = 0; i < rs->count; i++) {
+            channel_reading_init(&rs->readings[i], rs->sources[i].address, rs->sources[i].channel);
+            rs->readings[i].has_temp = rs->columns[i].temp >= 0;
+            rs->readings[i].has_adc = rs->columns[i].adc >= 0;
+            rs->readings[i].has_cjc = rs->columns[i].cjc >= 0;
+        }
+    
+        sink_set = sink_set_open(sinks, sink_count);
+        output = sink_set ? output_queue_create(queue_depth, output_policy, sink_set) : NULL;
+        if (!output) {
+            result = THERMO_ERROR;
+        }
+    }
+    
+    if (result == THERMO_SUCCESS) {
+        signals_install_handlers();
+        trace_thread_register("replay");
+    
+        Pacer pacer = { .speed = speed };
+        ReplayCount count = {0};
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    
+        if (cmg) {
+            result = replay_fused(rd, rs, cmg, time_format, output, &pacer, &count);
+        } else {
+            result = replay_thermal(rd, rs, output, &pacer, &count);
+        }
+        output_queue_close(output);
+        output = NULL;
+    
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        double recorded = count.span_us / 1e6;
+        fprintf(stderr, "Replayed %lld record%s (%.3f s recorded) in %.3f s: %.0f records/s, %.1fx real time\n",
+                count.records, count.records == 1 ? "" : "s", recorded, elapsed,
+                elapsed > 0 ? count.records / elapsed : 0.0, elapsed > 0 ? recorded / elapsed : 0.0);
+    }
+    
+    output_queue_close(output);
+    sink_set_close(sink_set);
+    recording_reader_free(rd);
+    free(rd);
+    free(rs);
+    if (cmg && cmg != stdin) fclose(cmg);
+    config_free(&config);
+    return result == THERMO_SUCCESS ? 0 : 1;
+}
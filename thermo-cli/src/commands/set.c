@@ -1,16 +1,275 @@
 /*
  * Set command implementation.
- * Configures MCC 134 channel parameters.
+ * Configures MCC 134 channel parameters, either one channel from the command
+ * line or every source of a config file (one open per board, with a diff
+ * against the board's current settings and read-back verification).
+ * TC types and calibration are held by the board library and are lost when
+ * the board is closed, so for those --config checks that the boards accept
+ * the config; get and fuse apply it whenever they open them.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <getopt.h>
 
 #include "commands/set.h"
+#include "common.h"
 #include "hardware.h"
+#include "inventory.h"
 #include "utils.h"
 
+/* Calibration coefficients are doubles held by the library, so read-back
+ * should match exactly; allow for formatting round-trips only */
+#define CAL_VERIFY_TOLERANCE 1e-9
+
+/* ============================================================================
+ * Batch mode (--config)
+ * ============================================================================ */
+
+/* What a config asks of one board */
+typedef struct {
+    int used;
+    int interval;                               /* -1 = leave as is */
+    const char *interval_key;                   /* Source that asked for it */
+    const char *key[MCC134_NUM_CHANNELS];       /* NULL = channel not configured */
+    uint8_t tc_type[MCC134_NUM_CHANNELS];
+    int has_cal[MCC134_NUM_CHANNELS];
+    CalibrationInfo cal[MCC134_NUM_CHANNELS];
+} BoardPlan;
+
+/* Board settings as read back */
+typedef struct {
+    uint8_t interval;
+    uint8_t tc_type[MCC134_NUM_CHANNELS];
+    CalibrationInfo cal[MCC134_NUM_CHANNELS];
+} BoardState;
+
+static int cal_equal(const CalibrationInfo *a, const CalibrationInfo *b) {
+    return fabs(a->slope - b->slope) <= CAL_VERIFY_TOLERANCE &&
+           fabs(a->offset - b->offset) <= CAL_VERIFY_TOLERANCE;
+}
+
+/* Group sources per board. Calibration and update interval follow get/fuse:
+ * only values that differ from the defaults are applied. */
+static int build_plans(const Config *config, BoardPlan plans[THERMO_MAX_ADDRESSES]) {
+    memset(plans, 0, THERMO_MAX_ADDRESSES * sizeof(BoardPlan));
+    for (int a = 0; a < THERMO_MAX_ADDRESSES; a++) {
+        plans[a].interval = -1;
+    }
+    
+    for (int i = 0; i < config->source_count; i++) {
+        const ThermalSource *src = &config->sources[i];
+        BoardPlan *plan = &plans[src->address];
+        uint8_t ch = src->channel;
+        plan->used = 1;
+        
+        uint8_t tc_type = thermo_tc_type_from_string(src->tc_type);
+        if (tc_type == TC_DISABLED && strcmp(src->tc_type, "DISABLED") != 0) {
+            fprintf(stderr, "Error: Source %s: unknown tc_type '%s'\n", src->key, src->tc_type);
+            return THERMO_INVALID_PARAM;
+        }
+        int has_cal = src->cal_coeffs.slope != DEFAULT_CALIBRATION_SLOPE ||
+                      src->cal_coeffs.offset != DEFAULT_CALIBRATION_OFFSET;
+        
+        /* The same channel may appear twice (e.g. under two keys) if it asks for the same thing */
+        if (plan->key[ch] && (plan->tc_type[ch] != tc_type || plan->has_cal[ch] != has_cal ||
+                              (has_cal && !cal_equal(&plan->cal[ch], &src->cal_coeffs)))) {
+            fprintf(stderr, "Error: Sources %s and %s configure address %d channel %d differently\n",
+                    plan->key[ch], src->key, src->address, ch);
+            return THERMO_INVALID_PARAM;
+        }
+        plan->key[ch] = src->key;
+        plan->tc_type[ch] = tc_type;
+        plan->has_cal[ch] = has_cal;
+        plan->cal[ch] = src->cal_coeffs;
+        
+        if (src->update_interval > 0 && src->update_interval != DEFAULT_UPDATE_INTERVAL) {
+            if (src->update_interval > 255) {
+                fprintf(stderr, "Error: Source %s: update_interval must be 1-255\n", src->key);
+                return THERMO_INVALID_PARAM;
+            }
+            if (plan->interval >= 0 && plan->interval != src->update_interval) {
+                fprintf(stderr, "Error: Sources %s and %s ask address %d for update intervals %d and %d\n",
+                        plan->interval_key, src->key, src->address, plan->interval, src->update_interval);
+                return THERMO_INVALID_PARAM;
+            }
+            plan->interval = src->update_interval;
+            plan->interval_key = src->key;
+        }
+    }
+    return THERMO_SUCCESS;
+}
+
+static int read_state(uint8_t address, const BoardPlan *plan, BoardState *state) {
+    if (thermo_get_update_interval(address, &state->interval) != THERMO_SUCCESS) {
+        return THERMO_ERROR;
+    }
+    for (uint8_t ch = 0; ch < MCC134_NUM_CHANNELS; ch++) {
+        if (!plan->key[ch]) continue;
+        if (thermo_get_tc_type(address, ch, &state->tc_type[ch]) != THERMO_SUCCESS ||
+            thermo_get_calibration_coeffs(address, ch, &state->cal[ch]) != THERMO_SUCCESS) {
+            return THERMO_ERROR;
+        }
+    }
+    return THERMO_SUCCESS;
+}
+
+/* Print the board's pending changes; returns how many there are */
+static int print_diff(uint8_t address, const BoardPlan *plan, const BoardState *state, int *unchanged) {
+    int changes = 0;
+    
+    printf("Address %d:\n", address);
+    if (plan->interval >= 0) {
+        if (state->interval != plan->interval) {
+            printf("  %-22s %d -> %d seconds\n", "update_interval", state->interval, plan->interval);
+            changes++;
+        } else {
+            (*unchanged)++;
+        }
+    }
+    for (uint8_t ch = 0; ch < MCC134_NUM_CHANNELS; ch++) {
+        if (!plan->key[ch]) continue;
+        
+        if (state->tc_type[ch] != plan->tc_type[ch]) {
+            printf("  ch %d %-17s %s -> %s\n", ch, "tc_type",
+                   thermo_tc_type_to_string(state->tc_type[ch]), thermo_tc_type_to_string(plan->tc_type[ch]));
+            changes++;
+        } else {
+            (*unchanged)++;
+        }
+        
+        if (plan->has_cal[ch] && !cal_equal(&state->cal[ch], &plan->cal[ch])) {
+            printf("  ch %d %-17s %.6f, %.6f -> %.6f, %.6f\n", ch, "calibration",
+                   state->cal[ch].slope, state->cal[ch].offset, plan->cal[ch].slope, plan->cal[ch].offset);
+            changes++;
+        } else if (plan->has_cal[ch]) {
+            (*unchanged)++;
+        }
+    }
+    if (changes == 0) {
+        printf("  (up to date)\n");
+    }
+    return changes;
+}
+
+/* Write what differs, then read everything back */
+static int apply_and_verify(uint8_t address, const BoardPlan *plan, const BoardState *state) {
+    int result = THERMO_SUCCESS;
+    
+    if (plan->interval >= 0 && state->interval != plan->interval &&
+        thermo_set_update_interval(address, (uint8_t)plan->interval) != THERMO_SUCCESS) {
+        fprintf(stderr, "Error: Address %d: failed to set update interval\n", address);
+        result = THERMO_ERROR;
+    }
+    for (uint8_t ch = 0; ch < MCC134_NUM_CHANNELS; ch++) {
+        if (!plan->key[ch]) continue;
+        if (plan->has_cal[ch] && !cal_equal(&state->cal[ch], &plan->cal[ch]) &&
+            thermo_set_calibration_coeffs(address, ch, plan->cal[ch].slope, plan->cal[ch].offset) != THERMO_SUCCESS) {
+            fprintf(stderr, "Error: Address %d channel %d: failed to set calibration\n", address, ch);
+            result = THERMO_ERROR;
+        }
+        if (state->tc_type[ch] != plan->tc_type[ch] &&
+            thermo_set_tc_type(address, ch, thermo_tc_type_to_string(plan->tc_type[ch])) != THERMO_SUCCESS) {
+            fprintf(stderr, "Error: Address %d channel %d: failed to set TC type\n", address, ch);
+            result = THERMO_ERROR;
+        }
+    }
+    
+    BoardState after;
+    if (read_state(address, plan, &after) != THERMO_SUCCESS) {
+        fprintf(stderr, "Error: Address %d: read-back failed\n", address);
+        return THERMO_ERROR;
+    }
+    if (plan->interval >= 0 && after.interval != plan->interval) {
+        fprintf(stderr, "Error: Address %d: update interval reads back %d, expected %d\n",
+                address, after.interval, plan->interval);
+        result = THERMO_ERROR;
+    }
+    for (uint8_t ch = 0; ch < MCC134_NUM_CHANNELS; ch++) {
+        if (!plan->key[ch]) continue;
+        if (after.tc_type[ch] != plan->tc_type[ch]) {
+            fprintf(stderr, "Error: Address %d channel %d: TC type reads back %s, expected %s\n", address, ch,
+                    thermo_tc_type_to_string(after.tc_type[ch]), thermo_tc_type_to_string(plan->tc_type[ch]));
+            result = THERMO_ERROR;
+        }
+        if (plan->has_cal[ch] && !cal_equal(&after.cal[ch], &plan->cal[ch])) {
+            fprintf(stderr, "Error: Address %d channel %d: calibration reads back %.6f, %.6f\n",
+                    address, ch, after.cal[ch].slope, after.cal[ch].offset);
+            result = THERMO_ERROR;
+        }
+    }
+    return result;
+}
+
+static int set_from_config(const char *config_path, int dry_run) {
+    Config config = {0};
+    if (config_load(config_path, &config) != THERMO_SUCCESS) {
+        fprintf(stderr, "Error: Failed to load config file: %s\n", config_path);
+        return 1;
+    }
+    
+    Inventory inv;
+    BoardPlan plans[THERMO_MAX_ADDRESSES];
+    if (config.source_count == 0 || inventory_load(&inv, 0) != THERMO_SUCCESS ||
+        inventory_validate_sources(&inv, config.sources, config.source_count) != THERMO_SUCCESS ||
+        build_plans(&config, plans) != THERMO_SUCCESS) {
+        if (config.source_count == 0) {
+            fprintf(stderr, "Error: No sources defined in config file\n");
+        }
+        config_free(&config);
+        return 1;
+    }
+    
+    int boards = 0, changes = 0, unchanged = 0, failed = 0;
+    for (uint8_t addr = 0; addr < THERMO_MAX_ADDRESSES; addr++) {
+        if (!plans[addr].used) continue;
+        boards++;
+        
+        /* One session per board: read, diff, write, verify */
+        if (thermo_open(addr) != THERMO_SUCCESS) {
+            fprintf(stderr, "Error opening board at address %d\n", addr);
+            failed++;
+            continue;
+        }
+        BoardState state;
+        if (read_state(addr, &plans[addr], &state) != THERMO_SUCCESS) {
+            fprintf(stderr, "Error: Address %d: failed to read current settings\n", addr);
+            failed++;
+        } else {
+            int board_changes = print_diff(addr, &plans[addr], &state, &unchanged);
+            changes += board_changes;
+            if (!dry_run && board_changes > 0 &&
+                apply_and_verify(addr, &plans[addr], &state) != THERMO_SUCCESS) {
+                failed++;
+            }
+        }
+        thermo_close(addr);
+    }
+    config_free(&config);
+    
+    if (dry_run) {
+        printf("Dry run: %d change(s) on %d board(s), %d already set; nothing written\n",
+               changes, boards, unchanged);
+    } else if (failed == 0) {
+        printf("Applied and verified %d change(s) on %d board(s), %d already set\n",
+               changes, boards, unchanged);
+        /* The library holds TC types and calibration per open, not the boards */
+        if (changes > 0) {
+            printf("Note: TC types and calibration last until a board is opened again; "
+                   "get and fuse apply them from the config each time\n");
+        }
+    } else {
+        fprintf(stderr, "Error: %d of %d board(s) not fully configured\n", failed, boards);
+    }
+    return failed == 0 ? 0 : 1;
+}
+
+/* ============================================================================
+ * Command
+ * ============================================================================ */
+
 /* Command: set - Configure channel parameters */
 int cmd_set(int argc, char **argv) {
     int address = 0;
@@ -21,8 +280,13 @@ int cmd_set(int argc, char **argv) {
     int has_offset = 0;
     int update_interval = 0;
     int has_interval = 0;
+    int has_target = 0;
+    char *config_path = NULL;
+    int dry_run = 0;
     
     static struct option long_options[] = {
+        {"config", required_argument, 0, 'C'},
+        {"dry-run", no_argument, 0, 'n'},
         {"address", required_argument, 0, 'a'},
         {"channel", required_argument, 0, 'c'},
         {"cali-slope", required_argument, 0, 'S'},
@@ -32,10 +296,12 @@ int cmd_set(int argc, char **argv) {
     };
     
     int opt;
-    while ((opt = getopt_long(argc, argv, "a:c:S:O:i:", long_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "C:na:c:S:O:i:", long_options, NULL)) != -1) {
         switch (opt) {
-            case 'a': address = atoi(optarg); break;
-            case 'c': channel = atoi(optarg); break;
+            case 'C': config_path = optarg; break;
+            case 'n': dry_run = 1; break;
+            case 'a': address = atoi(optarg); has_target = 1; break;
+            case 'c': channel = atoi(optarg); has_target = 1; break;
             case 'S': cal_slope = atof(optarg); has_slope = 1; break;
             case 'O': cal_offset = atof(optarg); has_offset = 1; break;
             case 'i': update_interval = atoi(optarg); has_interval = 1; break;
@@ -45,6 +311,18 @@ int cmd_set(int argc, char **argv) {
         }
     }
     
+    if (config_path) {
+        if (has_target || has_slope || has_offset || has_interval) {
+            fprintf(stderr, "Error: --config cannot be combined with per-channel options\n");
+            return 1;
+        }
+        return set_from_config(config_path, dry_run);
+    }
+    if (dry_run) {
+        fprintf(stderr, "Error: --dry-run requires --config\n");
+        return 1;
+    }
+    
     /* Validate inputs */
     if (!validate_address(address)) {
         fprintf(stderr, "Error: Address must be 0-7\n");
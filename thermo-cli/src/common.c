@@ -6,6 +6,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <unistd.h>
 #include <yaml.h>
 
 #include "common.h"
@@ -24,9 +26,20 @@ void channel_reading_init(ChannelReading *reading, uint8_t address, uint8_t chan
     reading->temperature = 0.0;
     reading->adc_voltage = 0.0;
     reading->cjc_temp = 0.0;
+    reading->status = READING_OK;
     reading->has_temp = 0;
     reading->has_adc = 0;
     reading->has_cjc = 0;
+    reading->unchanged = 0;
+}
+
+ReadingStatus channel_reading_deadband_input(const ChannelReading *reading, double *value) {
+    if (reading->has_temp) {
+        *value = reading->temperature;
+        return (ReadingStatus)reading->status;
+    }
+    *value = reading->has_adc ? reading->adc_voltage : reading->cjc_temp;
+    return isnan(*value) ? READING_READ_ERROR : READING_OK;
 }
 
 /* Initialize a BoardInfo structure */
@@ -129,6 +142,8 @@ static int load_json_config(const char *path, Config *config) {
         cJSON *cal_slope_item = cJSON_GetObjectItem(src, "cal_slope");
         cJSON *cal_offset_item = cJSON_GetObjectItem(src, "cal_offset");
         cJSON *update_interval_item = cJSON_GetObjectItem(src, "update_interval");
+        cJSON *filter_item = cJSON_GetObjectItem(src, "filter");
+        cJSON *deadband_item = cJSON_GetObjectItem(src, "deadband");
 
         if (!addr_item || !chan_item) {
             fprintf(stderr, "Warning: Source %d missing required fields (address/channel), skipping\n", i);
@@ -174,6 +189,30 @@ static int load_json_config(const char *path, Config *config) {
             ts->update_interval = DEFAULT_UPDATE_INTERVAL;
         }
 
+        if (filter_item && cJSON_IsString(filter_item) &&
+            filter_spec_parse(filter_item->valuestring, &ts->filter) != THERMO_SUCCESS) {
+            fprintf(stderr, "Error: Invalid filter for source '%s'\n", ts->key);
+            cJSON_Delete(root);
+            config_free(config);
+            return THERMO_ERROR;
+        }
+
+        /* A bare number is an absolute band */
+        char deadband_buf[32];
+        const char *deadband_str = NULL;
+        if (deadband_item && cJSON_IsString(deadband_item)) {
+            deadband_str = deadband_item->valuestring;
+        } else if (deadband_item && cJSON_IsNumber(deadband_item)) {
+            snprintf(deadband_buf, sizeof(deadband_buf), "%.17g", deadband_item->valuedouble);
+            deadband_str = deadband_buf;
+        }
+        if (deadband_str && deadband_spec_parse(deadband_str, &ts->deadband) != THERMO_SUCCESS) {
+            fprintf(stderr, "Error: Invalid deadband for source '%s'\n", ts->key);
+            cJSON_Delete(root);
+            config_free(config);
+            return THERMO_ERROR;
+        }
+
         config->source_count++;
     }
 
@@ -211,6 +250,8 @@ static int load_yaml_config(const char *path, Config *config) {
     ThermalSource current_source = {0};
     char current_key[64] = {0};
     int expecting_value = 0;
+    int bad_filter = 0;
+    int bad_deadband = 0;
     
     /* Initialize defaults for current source */
     current_source.cal_coeffs.slope = DEFAULT_CALIBRATION_SLOPE;
@@ -250,6 +291,14 @@ static int load_yaml_config(const char *path, Config *config) {
                         current_source.cal_coeffs.offset = atof((char*)event.data.scalar.value);
                     } else if (strcmp(current_key, "update_interval") == 0) {
                         current_source.update_interval = atoi((char*)event.data.scalar.value);
+                    } else if (strcmp(current_key, "filter") == 0) {
+                        if (filter_spec_parse((char*)event.data.scalar.value, &current_source.filter) != THERMO_SUCCESS) {
+                            bad_filter = 1;
+                        }
+                    } else if (strcmp(current_key, "deadband") == 0) {
+                        if (deadband_spec_parse((char*)event.data.scalar.value, &current_source.deadband) != THERMO_SUCCESS) {
+                            bad_deadband = 1;
+                        }
                     }
                     current_key[0] = '\0';
                     expecting_value = 0;
@@ -312,6 +361,17 @@ static int load_yaml_config(const char *path, Config *config) {
     yaml_parser_delete(&parser);
     fclose(fp);
 
+    if (bad_filter) {
+        fprintf(stderr, "Error: Invalid filter in config file: %s\n", path);
+        config_free(config);
+        return THERMO_ERROR;
+    }
+    if (bad_deadband) {
+        fprintf(stderr, "Error: Invalid deadband in config file: %s\n", path);
+        config_free(config);
+        return THERMO_ERROR;
+    }
+
     return THERMO_SUCCESS;
 }
 
@@ -418,3 +478,333 @@ int config_create_example(const char *output_path) {
     fclose(fp);
     return THERMO_SUCCESS;
 }
+
+/* ============================================================================
+ * CONFIGURATION UPDATE
+ * ============================================================================ */
+
+/* A "- key: ..." item of the YAML sources list */
+typedef struct {
+    int last_line;              /* Last non-blank line of the item */
+    int indent;                 /* Column of the item's keys */
+    int slope_line;             /* -1 = not present */
+    int offset_line;
+    size_t slope_value;         /* Offset of the value within its line */
+    size_t offset_value;
+    char key[64];
+    int address;
+    int channel;
+} YamlItem;
+
+/* Key a source is known by (the loaders' default when none is given) */
+static void source_key(char *buffer, size_t len, const char *key, int address, int channel) {
+    if (key && key[0]) {
+        snprintf(buffer, len, "%s", key);
+    } else {
+        snprintf(buffer, len, "TEMP_%d_%d", address, channel);
+    }
+}
+
+static const ThermalSource* find_update(const ThermalSource *updates, int count, const char *key) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(updates[i].key, key) == 0) return &updates[i];
+    }
+    return NULL;
+}
+
+/* Write text to path through a temporary file, so a failure leaves the original intact */
+static int write_file_atomic(const char *path, char **lines, int line_count, const char *text) {
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    FILE *fp = fopen(tmp, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Could not write %s\n", tmp);
+        return THERMO_IO_ERROR;
+    }
+    int ok = 1;
+    if (text) {
+        ok = fputs(text, fp) >= 0;
+    }
+    for (int i = 0; i < line_count && ok; i++) {
+        ok = fputs(lines[i], fp) >= 0;
+    }
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        fprintf(stderr, "Error: Could not write %s\n", path);
+        return THERMO_IO_ERROR;
+    }
+    return THERMO_SUCCESS;
+}
+
+/* "name: value  # comment" -> name and the value's span */
+static int split_field(const char *text, char *name, size_t name_len, size_t *value_start, size_t *value_end) {
+    const char *colon = strchr(text, ':');
+    if (!colon || (size_t)(colon - text) >= name_len) return 0;
+    memcpy(name, text, colon - text);
+    name[colon - text] = '\0';
+
+    const char *v = colon + 1;
+    while (*v == ' ' || *v == '\t') v++;
+    const char *end = v;
+    while (*end && *end != '\n' && *end != '#') end++;
+    while (end > v && (end[-1] == ' ' || end[-1] == '\t')) end--;
+    *value_start = v - text;
+    *value_end = end - text;
+    return 1;
+}
+
+static int update_yaml_calibration(const char *path, const ThermalSource *updates, int count) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Could not open config file: %s\n", path);
+        return THERMO_NOT_FOUND;
+    }
+
+    int line_count = 0, line_cap = 64;
+    char **lines = malloc(line_cap * sizeof(char*));
+    char *line = NULL;
+    size_t cap = 0;
+    while (getline(&line, &cap, fp) > 0) {
+        if (line_count == line_cap) {
+            line_cap *= 2;
+            lines = realloc(lines, line_cap * sizeof(char*));
+        }
+        lines[line_count++] = line;
+        line = NULL;
+        cap = 0;
+    }
+    free(line);
+    fclose(fp);
+    /* Room for two inserted lines per update */
+    lines = realloc(lines, (line_count + 2 * count + 1) * sizeof(char*));
+
+    /* Find the items of the sources list */
+    int item_cap = 16, item_count = 0;
+    YamlItem *items = calloc(item_cap, sizeof(YamlItem));
+    int in_sources = 0;
+    YamlItem *item = NULL;
+    for (int i = 0; i < line_count; i++) {
+        const char *text = lines[i];
+        int col = 0;
+        while (text[col] == ' ') col++;
+        if (text[col] == '\n' || text[col] == '\0' || text[col] == '#') continue;
+
+        if (col == 0 && strncmp(text, "sources:", 8) == 0) {
+            in_sources = 1;
+            continue;
+        }
+        if (!in_sources) continue;
+
+        size_t field = col;
+        if (text[col] == '-' && (text[col + 1] == ' ' || text[col + 1] == '\n')) {
+            if (item_count == item_cap) {
+                item_cap *= 2;
+                items = realloc(items, item_cap * sizeof(YamlItem));
+            }
+            item = &items[item_count++];
+            memset(item, 0, sizeof(*item));
+            item->slope_line = item->offset_line = -1;
+            field = col + 1;
+            while (text[field] == ' ') field++;
+            item->indent = (int)field;
+        } else if (col == 0) {
+            in_sources = 0;     /* Next top-level key */
+            item = NULL;
+            continue;
+        }
+        if (!item) continue;
+        item->last_line = i;
+
+        char name[64];
+        size_t vs, ve;
+        if (!split_field(text + field, name, sizeof(name), &vs, &ve)) continue;
+        vs += field;
+        ve += field;
+        char value[64];
+        size_t vlen = ve - vs < sizeof(value) - 1 ? ve - vs : sizeof(value) - 1;
+        memcpy(value, text + vs, vlen);
+        value[vlen] = '\0';
+
+        if (strcmp(name, "key") == 0) {
+            /* Quoted keys are plain strings to the loader */
+            char *v = value;
+            size_t n = strlen(v);
+            if (n >= 2 && (v[0] == '"' || v[0] == '\'') && v[n - 1] == v[0]) {
+                v[n - 1] = '\0';
+                v++;
+            }
+            snprintf(item->key, sizeof(item->key), "%s", v);
+        } else if (strcmp(name, "address") == 0) {
+            item->address = atoi(value);
+        } else if (strcmp(name, "channel") == 0) {
+            item->channel = atoi(value);
+        } else if (strcmp(name, "cal_slope") == 0) {
+            item->slope_line = i;
+            item->slope_value = vs;
+        } else if (strcmp(name, "cal_offset") == 0) {
+            item->offset_line = i;
+            item->offset_value = vs;
+        }
+    }
+
+    /* Every update must name a source in the file */
+    int result = THERMO_SUCCESS;
+    for (int u = 0; u < count; u++) {
+        int found = 0;
+        for (int k = 0; k < item_count && !found; k++) {
+            char key[64];
+            source_key(key, sizeof(key), items[k].key, items[k].address, items[k].channel);
+            found = strcmp(key, updates[u].key) == 0;
+        }
+        if (!found) {
+            fprintf(stderr, "Error: Source %s not found in %s\n", updates[u].key, path);
+            result = THERMO_NOT_FOUND;
+        }
+    }
+
+    /* Replace values in place (keeping any trailing comment), or append the
+     * missing fields after the item's last line. Items are processed last
+     * first so inserted lines don't shift the ones still to do. */
+    for (int k = item_count - 1; k >= 0 && result == THERMO_SUCCESS; k--) {
+        YamlItem *it = &items[k];
+        char key[64];
+        source_key(key, sizeof(key), it->key, it->address, it->channel);
+        const ThermalSource *update = find_update(updates, count, key);
+        if (!update) continue;
+
+        char formatted[2][64];
+        snprintf(formatted[0], sizeof(formatted[0]), "%.6f", update->cal_coeffs.slope);
+        snprintf(formatted[1], sizeof(formatted[1]), "%.6f", update->cal_coeffs.offset);
+        int at[2] = { it->slope_line, it->offset_line };
+        size_t value_at[2] = { it->slope_value, it->offset_value };
+        const char *names[2] = { "cal_slope", "cal_offset" };
+        int insert_after = it->last_line;
+
+        for (int f = 0; f < 2; f++) {
+            char *old = NULL;
+            char *replacement;
+            if (at[f] >= 0) {
+                old = lines[at[f]];
+                const char *rest = old + value_at[f];
+                while (*rest && *rest != '\n' && *rest != '#') rest++;
+                const char *comment = (*rest == '#') ? rest : "\n";
+                size_t n = value_at[f] + strlen(formatted[f]) + strlen(comment) + 2;
+                replacement = malloc(n);
+                snprintf(replacement, n, "%.*s%s%s%s", (int)value_at[f], old, formatted[f],
+                         (*rest == '#') ? " " : "", comment);
+                lines[at[f]] = replacement;
+                free(old);
+            } else {
+                size_t n = it->indent + strlen(names[f]) + strlen(formatted[f]) + 4;
+                replacement = malloc(n);
+                snprintf(replacement, n, "%*s%s: %s\n", it->indent, "", names[f], formatted[f]);
+                /* A last line without a newline (end of file) needs one first */
+                size_t last_len = strlen(lines[insert_after]);
+                if (last_len == 0 || lines[insert_after][last_len - 1] != '\n') {
+                    lines[insert_after] = realloc(lines[insert_after], last_len + 2);
+                    strcpy(lines[insert_after] + last_len, "\n");
+                }
+                memmove(&lines[insert_after + 2], &lines[insert_after + 1],
+                        (line_count - insert_after - 1) * sizeof(char*));
+                lines[++insert_after] = replacement;
+                line_count++;
+            }
+        }
+    }
+
+    if (result == THERMO_SUCCESS) {
+        result = write_file_atomic(path, lines, line_count, NULL);
+    }
+    for (int i = 0; i < line_count; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+    free(items);
+    return result;
+}
+
+static int update_json_calibration(const char *path, const ThermalSource *updates, int count) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Could not open config file: %s\n", path);
+        return THERMO_NOT_FOUND;
+    }
+    fseek(fp, 0, SEEK_END);
+    long fsize = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *content = malloc(fsize + 1);
+    size_t bytes_read = fread(content, 1, fsize, fp);
+    fclose(fp);
+    content[bytes_read] = '\0';
+
+    cJSON *root = cJSON_Parse(content);
+    free(content);
+    cJSON *sources = root ? cJSON_GetObjectItem(root, "sources") : NULL;
+    if (!sources || !cJSON_IsArray(sources)) {
+        fprintf(stderr, "Error: Config must contain 'sources' array\n");
+        cJSON_Delete(root);
+        return THERMO_ERROR;
+    }
+
+    int result = THERMO_SUCCESS;
+    for (int u = 0; u < count; u++) {
+        cJSON *match = NULL;
+        cJSON *src;
+        cJSON_ArrayForEach(src, sources) {
+            cJSON *key_item = cJSON_GetObjectItem(src, "key");
+            cJSON *addr_item = cJSON_GetObjectItem(src, "address");
+            cJSON *chan_item = cJSON_GetObjectItem(src, "channel");
+            char key[64];
+            source_key(key, sizeof(key), cJSON_IsString(key_item) ? key_item->valuestring : NULL,
+                       cJSON_IsNumber(addr_item) ? addr_item->valueint : 0,
+                       cJSON_IsNumber(chan_item) ? chan_item->valueint : 0);
+            if (strcmp(key, updates[u].key) == 0) {
+                match = src;
+                break;
+            }
+        }
+        if (!match) {
+            fprintf(stderr, "Error: Source %s not found in %s\n", updates[u].key, path);
+            result = THERMO_NOT_FOUND;
+            continue;
+        }
+
+        cJSON *slope = cJSON_CreateNumber(updates[u].cal_coeffs.slope);
+        cJSON *offset = cJSON_CreateNumber(updates[u].cal_coeffs.offset);
+        if (cJSON_GetObjectItem(match, "cal_slope")) {
+            cJSON_ReplaceItemInObject(match, "cal_slope", slope);
+        } else {
+            cJSON_AddItemToObject(match, "cal_slope", slope);
+        }
+        if (cJSON_GetObjectItem(match, "cal_offset")) {
+            cJSON_ReplaceItemInObject(match, "cal_offset", offset);
+        } else {
+            cJSON_AddItemToObject(match, "cal_offset", offset);
+        }
+    }
+
+    if (result == THERMO_SUCCESS) {
+        char *text = cJSON_Print(root);
+        size_t len = strlen(text);
+        text = realloc(text, len + 2);
+        strcpy(text + len, "\n");
+        result = write_file_atomic(path, NULL, 0, text);
+        free(text);
+    }
+    cJSON_Delete(root);
+    return result;
+}
+
+/* Update calibration coefficients in a config file (format by extension, as config_load) */
+int config_update_calibration(const char *path, const ThermalSource *updates, int count) {
+    if (path == NULL || updates == NULL) {
+        return THERMO_INVALID_PARAM;
+    }
+
+    const char *ext = strrchr(path, '.');
+    if (ext && strcmp(ext, ".json") == 0) {
+        return update_json_calibration(path, updates, count);
+    }
+    return update_yaml_calibration(path, updates, count);
+}
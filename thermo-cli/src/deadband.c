@@ -0,0 +1,74 @@
+/*
+ * Per-source deadband implementation.
+ * The band is measured from the last emitted value, not the previous
+ * sample, so a slow drift is still reported once it adds up to the band.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "deadband.h"
+
+int deadband_spec_parse(const char *str, DeadbandSpec *spec) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s", str ? str : "");
+    memset(spec, 0, sizeof(*spec));
+    
+    if (buf[0] == '\0' || strcmp(buf, "none") == 0) {
+        return THERMO_SUCCESS;
+    }
+    
+    spec->heartbeat_s = DEADBAND_DEFAULT_HEARTBEAT_S;
+    char *slash = strchr(buf, '/');
+    if (slash) {
+        *slash++ = '\0';
+        char *end = NULL;
+        spec->heartbeat_s = strtod(slash, &end);
+        if (*slash == '\0' || *end != '\0' || spec->heartbeat_s < 0) {
+            fprintf(stderr, "Error: Deadband heartbeat must be a number of seconds (e.g. 0.1/300)\n");
+            return THERMO_INVALID_PARAM;
+        }
+    }
+    
+    char *end = NULL;
+    spec->band = strtod(buf, &end);
+    if (end != buf && *end == '%' && end[1] == '\0') {
+        spec->relative = 1;
+        spec->band /= 100.0;
+    } else if (end == buf || *end != '\0') {
+        fprintf(stderr, "Error: Deadband must be BAND or BAND%% with an optional /HEARTBEAT (e.g. 0.1, 0.5%%/300)\n");
+        return THERMO_INVALID_PARAM;
+    }
+    if (spec->band < 0) {
+        fprintf(stderr, "Error: Deadband must not be negative\n");
+        return THERMO_INVALID_PARAM;
+    }
+    
+    spec->enabled = 1;
+    return THERMO_SUCCESS;
+}
+
+int deadband_update(DeadbandState *state, const DeadbandSpec *spec, double value,
+                    ReadingStatus status, int64_t now_us) {
+    int emit = !spec->enabled || !state->has_last || status != state->last_status;
+    
+    if (!emit && spec->heartbeat_s > 0 &&
+        (double)(now_us - state->last_emit_us) >= spec->heartbeat_s * 1e6) {
+        emit = 1;
+    }
+    /* Faults carry no value to compare: a repeated fault is unchanged */
+    if (!emit && status == READING_OK) {
+        double band = spec->relative ? spec->band * fabs(state->last) : spec->band;
+        emit = fabs(value - state->last) > band;
+    }
+    
+    if (emit) {
+        state->last = value;
+        state->last_status = status;
+        state->last_emit_us = now_us;
+        state->has_last = 1;
+    }
+    return emit;
+}
@@ -0,0 +1,252 @@
+/*
+ * Per-source filter stage implementation.
+ * Samples are fed at the internal (oversampled) rate and the chain is read
+ * once per output period. Fault codes never enter the filters: a period
+ * with no valid samples reports its fault instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "filter.h"
+#include "hardware.h"
+
+#define CIC_SCALE 1024.0        /* Fixed-point steps per degree */
+
+static int is_fault(double sample) {
+    return isnan(sample) || sample == OPEN_TC_VALUE || sample == OVERRANGE_TC_VALUE ||
+           sample == COMMON_MODE_TC_VALUE;
+}
+
+/* ============================================================================
+ * Spec parsing
+ * ============================================================================ */
+
+static int parse_stage(char *token, FilterStage *stage) {
+    char *param = strchr(token, ':');
+    if (param) *param++ = '\0';
+    char *end = NULL;
+    
+    if (strcmp(token, "boxcar") == 0 || strcmp(token, "median") == 0) {
+        stage->kind = (token[0] == 'b') ? FILTER_BOXCAR : FILTER_MEDIAN;
+        stage->window = param ? (int)strtol(param, &end, 10) : 0;
+        if (!param || *end != '\0' || stage->window < 1 || stage->window > FILTER_MAX_WINDOW) {
+            fprintf(stderr, "Error: %s needs a window of 1-%d samples (e.g. %s:5)\n",
+                    token, FILTER_MAX_WINDOW, token);
+            return THERMO_INVALID_PARAM;
+        }
+    } else if (strcmp(token, "ema") == 0) {
+        stage->kind = FILTER_EMA;
+        stage->alpha = param ? strtod(param, &end) : 0.0;
+        if (!param || *end != '\0' || !(stage->alpha > 0.0 && stage->alpha <= 1.0)) {
+            fprintf(stderr, "Error: ema needs a smoothing factor in (0, 1] (e.g. ema:0.2)\n");
+            return THERMO_INVALID_PARAM;
+        }
+    } else if (strcmp(token, "cic") == 0) {
+        stage->kind = FILTER_CIC;
+        stage->window = param ? (int)strtol(param, &end, 10) : 3;
+        if ((param && *end != '\0') || stage->window < 1 || stage->window > FILTER_MAX_CIC_ORDER) {
+            fprintf(stderr, "Error: cic order must be 1-%d\n", FILTER_MAX_CIC_ORDER);
+            return THERMO_INVALID_PARAM;
+        }
+    } else {
+        fprintf(stderr, "Error: Unknown filter '%s' (boxcar, ema, median, cic)\n", token);
+        return THERMO_INVALID_PARAM;
+    }
+    return THERMO_SUCCESS;
+}
+
+int filter_spec_parse(const char *str, FilterSpec *spec) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s", str ? str : "");
+    memset(spec, 0, sizeof(*spec));
+    
+    if (buf[0] == '\0' || strcmp(buf, "none") == 0) {
+        return THERMO_SUCCESS;
+    }
+    
+    char *saveptr = NULL;
+    for (char *token = strtok_r(buf, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr)) {
+        if (spec->count >= FILTER_MAX_STAGES) {
+            fprintf(stderr, "Error: At most %d filter stages\n", FILTER_MAX_STAGES);
+            return THERMO_INVALID_PARAM;
+        }
+        if (spec->count > 0 && spec->stages[spec->count - 1].kind == FILTER_CIC) {
+            fprintf(stderr, "Error: cic decimates, so it must be the last filter stage\n");
+            return THERMO_INVALID_PARAM;
+        }
+        if (parse_stage(token, &spec->stages[spec->count]) != THERMO_SUCCESS) {
+            return THERMO_INVALID_PARAM;
+        }
+        spec->count++;
+    }
+    return THERMO_SUCCESS;
+}
+
+/* ============================================================================
+ * Stages
+ * ============================================================================ */
+
+static void ring_push(FilterStageState *st, int window, double x) {
+    st->ring[st->head] = x;
+    st->head = (st->head + 1) % window;
+    if (st->filled < window) st->filled++;
+}
+
+static double boxcar_step(FilterStageState *st, int window, double x) {
+    if (st->filled == window) {
+        st->sum -= st->ring[st->head];
+    }
+    ring_push(st, window, x);
+    st->sum += x;
+    
+    /* Re-add from scratch once per lap so rounding can't accumulate */
+    if (st->head == 0) {
+        st->sum = 0.0;
+        for (int i = 0; i < st->filled; i++) {
+            st->sum += st->ring[i];
+        }
+    }
+    return st->sum / st->filled;
+}
+
+static double median_step(FilterStageState *st, int window, double x) {
+    ring_push(st, window, x);
+    
+    double sorted[FILTER_MAX_WINDOW];
+    int n = st->filled;
+    for (int i = 0; i < n; i++) {
+        double v = st->ring[i];
+        int j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    return (n % 2) ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+}
+
+static double ema_step(FilterStageState *st, double alpha, double x) {
+    if (!st->ema_ready) {
+        st->ema = x;
+        st->ema_ready = 1;
+    } else {
+        st->ema += alpha * (x - st->ema);
+    }
+    return st->ema;
+}
+
+/* Integrators run at the input rate */
+static void cic_step(FilterStageState *st, int order, double x) {
+    uint64_t acc = (uint64_t)llround(x * CIC_SCALE);
+    for (int k = 0; k < order; k++) {
+        st->integrators[k] += acc;
+        acc = st->integrators[k];
+    }
+    st->cic_sum += x;
+    st->cic_count++;
+}
+
+/* Combs run once per output period; gain is count^order. Until the combs hold
+ * order periods of the same length the period mean is reported instead. */
+static double cic_emit(FilterStageState *st, int order) {
+    uint64_t acc = st->integrators[order - 1];
+    for (int k = 0; k < order; k++) {
+        uint64_t delayed = st->combs[k];
+        st->combs[k] = acc;
+        acc -= delayed;
+    }
+    
+    if (st->cic_count != st->cic_last_count) {
+        st->cic_primed = 0;
+        st->cic_last_count = st->cic_count;
+    }
+    
+    double result;
+    if (st->cic_primed < order) {
+        st->cic_primed++;
+        result = st->cic_sum / st->cic_count;
+    } else {
+        double gain = pow((double)st->cic_count, order) * CIC_SCALE;
+        result = (double)(int64_t)acc / gain;
+    }
+    st->cic_sum = 0.0;
+    st->cic_count = 0;
+    return result;
+}
+
+/* ============================================================================
+ * Source filter
+ * ============================================================================ */
+
+void source_filter_init(SourceFilter *filter, const FilterSpec *spec) {
+    memset(filter, 0, sizeof(*filter));
+    if (spec) {
+        filter->spec = *spec;
+    }
+    filter->last_fault = NAN;
+}
+
+static int ends_with_cic(const SourceFilter *filter) {
+    return filter->spec.count > 0 && filter->spec.stages[filter->spec.count - 1].kind == FILTER_CIC;
+}
+
+void source_filter_push(SourceFilter *filter, double sample) {
+    filter->period_samples++;
+    
+    if (is_fault(sample)) {
+        filter->last_fault = sample;
+        /* A decimator needs every slot of the period filled: hold the last good value */
+        if (!ends_with_cic(filter) || !filter->has_hold) return;
+        sample = filter->hold;
+    } else {
+        filter->hold = sample;
+        filter->has_hold = 1;
+        filter->period_sum += sample;
+        filter->period_valid++;
+    }
+    
+    double v = sample;
+    for (int i = 0; i < filter->spec.count; i++) {
+        const FilterStage *stage = &filter->spec.stages[i];
+        FilterStageState *st = &filter->states[i];
+        switch (stage->kind) {
+            case FILTER_BOXCAR: v = boxcar_step(st, stage->window, v); break;
+            case FILTER_MEDIAN: v = median_step(st, stage->window, v); break;
+            case FILTER_EMA:    v = ema_step(st, stage->alpha, v); break;
+            case FILTER_CIC:    cic_step(st, stage->window, v); break;
+        }
+    }
+    filter->value = v;
+}
+
+double source_filter_emit(SourceFilter *filter) {
+    double result;
+    
+    if (filter->period_valid == 0) {
+        /* Nothing usable this period: report the fault and restart the filters,
+         * whose history is now stale */
+        result = filter->period_samples > 0 ? filter->last_fault : NAN;
+        FilterSpec spec = filter->spec;
+        source_filter_init(filter, &spec);
+        return result;
+    }
+    
+    if (filter->spec.count == 0) {
+        result = filter->period_sum / filter->period_valid;
+    } else if (ends_with_cic(filter)) {
+        int last = filter->spec.count - 1;
+        result = cic_emit(&filter->states[last], filter->spec.stages[last].window);
+    } else {
+        result = filter->value;
+    }
+    
+    filter->period_sum = 0.0;
+    filter->period_valid = 0;
+    filter->period_samples = 0;
+    filter->last_fault = NAN;
+    return result;
+}
@@ -12,9 +12,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <math.h>
 #include <daqhats/daqhats.h>
 
 #include "hardware.h"
+#include "thermocouple.h"
+#include "stats.h"
 #include "utils.h"
 
 /* Convert string to TC type enum */
@@ -30,6 +33,12 @@ uint8_t thermo_tc_type_from_string(const char *tc_type_str) {
     return TC_DISABLED;
 }
 
+/* Name of a TC type constant ("DISABLED" for anything else) */
+const char* thermo_tc_type_to_string(uint8_t tc_type) {
+    static const char *names[] = {"J", "K", "T", "E", "R", "S", "B", "N"};
+    return (tc_type < TC_DISABLED) ? names[tc_type] : "DISABLED";
+}
+
 /* Open a board for operations */
 int thermo_open(uint8_t address) {
     int result = mcc134_open(address);
@@ -47,21 +56,23 @@ int thermo_is_open(uint8_t address) {
     return mcc134_is_open(address);
 }
 
-/* List all connected MCC 134 boards (no open required) */
+/* List all connected MCC 134 boards (no open required).
+ * At most one board per address, so one hat_list() call fills a buffer sized
+ * for every address instead of a count pass followed by a fill pass. */
 int thermo_list_boards(struct HatInfo **boards, int *count) {
-    int num_boards = hat_list(HAT_ID_MCC_134, NULL);
+    *boards = (struct HatInfo*)malloc(THERMO_MAX_ADDRESSES * sizeof(struct HatInfo));
+    if (*boards == NULL) {
+        return THERMO_ERROR;
+    }
+    
+    int num_boards = hat_list(HAT_ID_MCC_134, *boards);
     if (num_boards <= 0) {
+        free(*boards);
         *boards = NULL;
         *count = 0;
         return THERMO_SUCCESS;
     }
-
-    *boards = (struct HatInfo*)malloc(num_boards * sizeof(struct HatInfo));
-    if (*boards == NULL) {
-        return THERMO_ERROR;
-    }
-
-    hat_list(HAT_ID_MCC_134, *boards);
+    
     *count = num_boards;
     return THERMO_SUCCESS;
 }
@@ -140,13 +151,25 @@ int thermo_set_tc_type(uint8_t address, uint8_t channel, const char *tc_type_str
     int result = mcc134_tc_type_write(address, channel, tc_type);
     return (result == RESULT_SUCCESS) ? THERMO_SUCCESS : THERMO_ERROR;
 }
+
+/* Read the thermocouple type configured on a channel (board must be open) */
+int thermo_get_tc_type(uint8_t address, uint8_t channel, uint8_t *tc_type) {
+    if (tc_type == NULL || channel > 3) {
+        return THERMO_INVALID_PARAM;
+    }
+
+    int result = mcc134_tc_type_read(address, channel, tc_type);
+    return (result == RESULT_SUCCESS) ? THERMO_SUCCESS : THERMO_ERROR;
+}
 /* Read temperature from channel (board must be open, tc_type must be set) */
 int thermo_read_temp(uint8_t address, uint8_t channel, double *value) {
     if (value == NULL || channel > 3) {
         return THERMO_INVALID_PARAM;
     }
-
+    
+    uint64_t t0 = stats_start();
     int result = mcc134_t_in_read(address, channel, value);
+    stats_record(STAT_T_IN_READ, STATS_SLOT(address, channel), t0);
     return (result == RESULT_SUCCESS) ? THERMO_SUCCESS : THERMO_ERROR;
 }
 
@@ -155,8 +178,23 @@ int thermo_read_adc(uint8_t address, uint8_t channel, double *value) {
     if (value == NULL || channel > 3) {
         return THERMO_INVALID_PARAM;
     }
-
+    
+    uint64_t t0 = stats_start();
     int result = mcc134_a_in_read(address, channel, OPTS_DEFAULT, value);
+    stats_record(STAT_A_IN_READ, STATS_SLOT(address, channel), t0);
+    return (result == RESULT_SUCCESS) ? THERMO_SUCCESS : THERMO_ERROR;
+}
+
+/* Read ADC voltage without the board's calibration coefficients applied, as
+ * needed to fit new ones (board must be open, tc_type must be set) */
+int thermo_read_adc_raw(uint8_t address, uint8_t channel, double *value) {
+    if (value == NULL || channel > 3) {
+        return THERMO_INVALID_PARAM;
+    }
+    
+    uint64_t t0 = stats_start();
+    int result = mcc134_a_in_read(address, channel, OPTS_NOCALIBRATEDATA, value);
+    stats_record(STAT_A_IN_READ, STATS_SLOT(address, channel), t0);
     return (result == RESULT_SUCCESS) ? THERMO_SUCCESS : THERMO_ERROR;
 }
 
@@ -165,13 +203,83 @@ int thermo_read_cjc(uint8_t address, uint8_t channel, double *value) {
     if (value == NULL || channel > 3) {
         return THERMO_INVALID_PARAM;
     }
-
+    
+    TRACE_SCOPE("cjc_read");
+    uint64_t t0 = stats_start();
     int result = mcc134_cjc_read(address, channel, value);
+    stats_record(STAT_CJC_READ, STATS_SLOT(address, channel), t0);
     return (result == RESULT_SUCCESS) ? THERMO_SUCCESS : THERMO_ERROR;
 }
 
-/* Wait for readings to stabilize after setting TC type */
-void thermo_wait_for_readings(void) {
-    // TODO: Check if this is necessary
-    // usleep(1100000); /* 1.1 seconds - MCC134 updates every 1 second */
+/* Read voltage once and linearize in software against a CJC value the caller
+ * already read (board must be open, tc_type set). Inputs at the ADC rails are
+ * faults; the library's t_in value carries their status code, so only that
+ * case pays for a second conversion. */
+int thermo_linearize_reading(uint8_t address, uint8_t channel, uint8_t tc_type, double cjc,
+                             double *temp, double *adc) {
+    if (temp == NULL || adc == NULL || channel > 3) {
+        return THERMO_INVALID_PARAM;
+    }
+    
+    trace_begin("a_in_read");
+    uint64_t t0 = stats_start();
+    int read_result = mcc134_a_in_read(address, channel, OPTS_DEFAULT, adc);
+    stats_record(STAT_A_IN_READ, STATS_SLOT(address, channel), t0);
+    trace_end("a_in_read");
+    if (read_result != RESULT_SUCCESS) {
+        return THERMO_ERROR;
+    }
+    
+    if (fabs(*adc) >= MCC134_FULL_SCALE_V * 0.9999) {
+        t0 = stats_start();
+        int result = mcc134_t_in_read(address, channel, temp);
+        stats_record(STAT_T_IN_READ, STATS_SLOT(address, channel), t0);
+        return (result == RESULT_SUCCESS) ? THERMO_SUCCESS : THERMO_ERROR;
+    }
+    
+    *temp = tc_linearize(tc_type, *adc, cjc);
+    return THERMO_SUCCESS;
+}
+
+/* Read voltage and the channel's own CJC, then linearize (board must be open, tc_type set) */
+int thermo_read_linearized(uint8_t address, uint8_t channel, uint8_t tc_type,
+                           double *temp, double *adc, double *cjc) {
+    if (cjc == NULL) {
+        return THERMO_INVALID_PARAM;
+    }
+    if (thermo_read_cjc(address, channel, cjc) != THERMO_SUCCESS) {
+        return THERMO_ERROR;
+    }
+    return thermo_linearize_reading(address, channel, tc_type, *cjc, temp, adc);
+}
+
+/* Classify a temperature reading by its sentinel value */
+ReadingStatus thermo_classify_temp(double temp) {
+    if (isnan(temp)) return READING_READ_ERROR;
+    if (temp == OPEN_TC_VALUE) return READING_OPEN;
+    if (temp == OVERRANGE_TC_VALUE) return READING_OVERRANGE;
+    if (temp == COMMON_MODE_TC_VALUE) return READING_COMMON_MODE;
+    return READING_OK;
+}
+
+/* Name of a status as emitted in JSON */
+const char* thermo_status_name(ReadingStatus status) {
+    switch (status) {
+        case READING_OK: return "OK";
+        case READING_OPEN: return "OPEN";
+        case READING_OVERRANGE: return "OVERRANGE";
+        case READING_COMMON_MODE: return "COMMON_MODE";
+        case READING_READ_ERROR: return "READ_ERROR";
+    }
+    return "UNKNOWN";
+}
+
+/* Sentinel value carried in place of a temperature for a fault status */
+double thermo_status_value(ReadingStatus status) {
+    switch (status) {
+        case READING_OPEN: return OPEN_TC_VALUE;
+        case READING_OVERRANGE: return OVERRANGE_TC_VALUE;
+        case READING_COMMON_MODE: return COMMON_MODE_TC_VALUE;
+        default: return NAN;
+    }
 }
@@ -0,0 +1,113 @@
+/*
+ * Log-linear histogram implementation.
+ * Buckets are exact below 128 and then split every power of two into 64
+ * sub-buckets, so any value is known to within 1.6% up to 2^40 (~18
+ * minutes in nanoseconds). The writer updates fields with relaxed loads and
+ * stores (no read-modify-write), which is enough with a single writer.
+ */
+
+#include <stdlib.h>
+
+#include "histogram.h"
+
+/* ============================================================================
+ * Buckets
+ * ============================================================================ */
+
+static int bucket_index(uint64_t value) {
+    if (value < HISTOGRAM_LINEAR_LIMIT) return (int)value;
+    
+    int msb = 63 - __builtin_clzll(value);
+    if (msb > HISTOGRAM_MAX_MSB) {
+        msb = HISTOGRAM_MAX_MSB;
+        value = (1ull << (HISTOGRAM_MAX_MSB + 1)) - 1;
+    }
+    int shift = msb - HISTOGRAM_SUB_BITS;
+    return HISTOGRAM_LINEAR_LIMIT + (msb - HISTOGRAM_SUB_BITS - 1) * HISTOGRAM_SUB_COUNT +
+           (int)((value >> shift) - HISTOGRAM_SUB_COUNT);
+}
+
+/* Middle of a bucket's value range */
+static double bucket_value(int index) {
+    if (index < HISTOGRAM_LINEAR_LIMIT) return index;
+    
+    int group = (index - HISTOGRAM_LINEAR_LIMIT) / HISTOGRAM_SUB_COUNT;
+    int shift = group + 1;
+    uint64_t low = (uint64_t)((index - HISTOGRAM_LINEAR_LIMIT) % HISTOGRAM_SUB_COUNT +
+                              HISTOGRAM_SUB_COUNT) << shift;
+    return (double)low + (double)(1ull << shift) / 2.0;
+}
+
+static void relaxed_add(_Atomic uint64_t *field, uint64_t value) {
+    atomic_store_explicit(field, atomic_load_explicit(field, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+}
+
+/* ============================================================================
+ * Recording
+ * ============================================================================ */
+
+Histogram* histogram_create(void) {
+    Histogram *hist = calloc(1, sizeof(Histogram));
+    if (hist) {
+        atomic_init(&hist->min, UINT64_MAX);
+    }
+    return hist;
+}
+
+void histogram_record(Histogram *hist, uint64_t value) {
+    _Atomic uint32_t *bucket = &hist->buckets[bucket_index(value)];
+    atomic_store_explicit(bucket, atomic_load_explicit(bucket, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    relaxed_add(&hist->sum, value);
+    if (value < atomic_load_explicit(&hist->min, memory_order_relaxed)) {
+        atomic_store_explicit(&hist->min, value, memory_order_relaxed);
+    }
+    if (value > atomic_load_explicit(&hist->max, memory_order_relaxed)) {
+        atomic_store_explicit(&hist->max, value, memory_order_relaxed);
+    }
+    relaxed_add(&hist->count, 1);
+}
+
+void histogram_reset(Histogram *hist) {
+    atomic_store_explicit(&hist->count, 0, memory_order_relaxed);
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++) {
+        atomic_store_explicit(&hist->buckets[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&hist->sum, 0, memory_order_relaxed);
+    atomic_store_explicit(&hist->min, UINT64_MAX, memory_order_relaxed);
+    atomic_store_explicit(&hist->max, 0, memory_order_relaxed);
+}
+
+/* ============================================================================
+ * Snapshots
+ * ============================================================================ */
+
+int histogram_summarize(const Histogram *hist, const double *percentiles, int count,
+                        HistogramSummary *sum) {
+    static uint32_t counts[HISTOGRAM_BUCKET_COUNT];  /* Reporting runs on one thread at a time */
+    uint64_t total = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++) {
+        counts[i] = atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) return 0;
+    if (count > HISTOGRAM_MAX_PERCENTILES) count = HISTOGRAM_MAX_PERCENTILES;
+    
+    sum->count = total;
+    sum->min = (double)atomic_load_explicit(&hist->min, memory_order_relaxed);
+    sum->max = (double)atomic_load_explicit(&hist->max, memory_order_relaxed);
+    sum->mean = (double)atomic_load_explicit(&hist->sum, memory_order_relaxed) / (double)total;
+    
+    int p = 0;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT && p < count; i++) {
+        seen += counts[i];
+        while (p < count && (double)seen >= percentiles[p] / 100.0 * (double)total) {
+            /* The bucket midpoint can lie just outside the observed range */
+            double value = bucket_value(i);
+            sum->pct[p++] = value < sum->min ? sum->min : value > sum->max ? sum->max : value;
+        }
+    }
+    return 1;
+}
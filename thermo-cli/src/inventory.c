@@ -0,0 +1,323 @@
+/*
+ * Board inventory cache implementation.
+ * hat_list() reads the EEPROM images daqhats_read_eeproms leaves in
+ * /etc/mcc/hats, so stat()ing those images tells whether a rescan could give
+ * a different answer. Serial numbers and calibration dates need the board
+ * open; they are read once per EEPROM image and cached with it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "inventory.h"
+#include "hardware.h"
+#include "utils.h"
+
+#include "cJSON.h"
+
+#define INVENTORY_CACHE_VERSION 1
+
+/* ============================================================================
+ * Probe
+ * ============================================================================ */
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* Fingerprint one address's EEPROM image (identity, size and mtime) */
+static uint64_t probe_address(uint8_t address) {
+    char path[64];
+    snprintf(path, sizeof(path), "%s/hat%d_eeprom.bin", INVENTORY_EEPROM_DIR, address);
+    
+    uint64_t hash = fnv1a(0xcbf29ce484222325ULL, &address, sizeof(address));
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return hash;  /* Absent */
+    }
+    uint64_t fields[4] = {
+        (uint64_t)st.st_ino, (uint64_t)st.st_size,
+        (uint64_t)st.st_mtim.tv_sec, (uint64_t)st.st_mtim.tv_nsec
+    };
+    return fnv1a(hash, fields, sizeof(fields));
+}
+
+static int probe_available(void) {
+    struct stat st;
+    return stat(INVENTORY_EEPROM_DIR, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static uint64_t probe_all(uint64_t probes[INVENTORY_MAX_BOARDS]) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < INVENTORY_MAX_BOARDS; i++) {
+        probes[i] = probe_address((uint8_t)i);
+        hash = fnv1a(hash, &probes[i], sizeof(probes[i]));
+    }
+    return hash;
+}
+
+/* ============================================================================
+ * Cache file
+ * ============================================================================ */
+
+static int cache_path(char *path, size_t len) {
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && xdg[0] != '\0') {
+        snprintf(path, len, "%s/%s", xdg, INVENTORY_CACHE_NAME);
+    } else if (home && home[0] != '\0') {
+        snprintf(path, len, "%s/.cache/%s", home, INVENTORY_CACHE_NAME);
+    } else {
+        return THERMO_NOT_FOUND;
+    }
+    return THERMO_SUCCESS;
+}
+
+/* Hex string so the full 64 bits survive cJSON's doubles */
+static void probe_to_string(uint64_t probe, char *buf, size_t len) {
+    snprintf(buf, len, "%016llx", (unsigned long long)probe);
+}
+
+static uint64_t probe_from_json(const cJSON *obj, const char *name) {
+    const cJSON *item = cJSON_GetObjectItem(obj, name);
+    return cJSON_IsString(item) ? strtoull(item->valuestring, NULL, 16) : 0;
+}
+
+static int int_from_json(const cJSON *obj, const char *name) {
+    const cJSON *item = cJSON_GetObjectItem(obj, name);
+    return cJSON_IsNumber(item) ? item->valueint : 0;
+}
+
+static void copy_json_string(const cJSON *obj, const char *name, char *dst, size_t len) {
+    const cJSON *item = cJSON_GetObjectItem(obj, name);
+    snprintf(dst, len, "%s", cJSON_IsString(item) ? item->valuestring : "");
+}
+
+static int read_cache(Inventory *inv) {
+    char path[512];
+    if (cache_path(path, sizeof(path)) != THERMO_SUCCESS) {
+        return THERMO_NOT_FOUND;
+    }
+    
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return THERMO_NOT_FOUND;
+    }
+    char content[16384];
+    size_t n = fread(content, 1, sizeof(content) - 1, fp);
+    fclose(fp);
+    content[n] = '\0';
+    
+    cJSON *root = cJSON_Parse(content);
+    const cJSON *version = cJSON_GetObjectItem(root, "version");
+    const cJSON *boards = cJSON_GetObjectItem(root, "boards");
+    if (!cJSON_IsNumber(version) || version->valueint != INVENTORY_CACHE_VERSION || !cJSON_IsArray(boards)) {
+        cJSON_Delete(root);
+        return THERMO_ERROR;
+    }
+    
+    memset(inv, 0, sizeof(*inv));
+    inv->probe = probe_from_json(root, "probe");
+    const cJSON *board;
+    cJSON_ArrayForEach(board, boards) {
+        if (inv->count >= INVENTORY_MAX_BOARDS) break;
+        InventoryBoard *entry = &inv->boards[inv->count++];
+        entry->address = (uint8_t)int_from_json(board, "address");
+        entry->id = (uint16_t)int_from_json(board, "id");
+        entry->version = (uint16_t)int_from_json(board, "version");
+        copy_json_string(board, "name", entry->product_name, sizeof(entry->product_name));
+        copy_json_string(board, "serial", entry->serial, sizeof(entry->serial));
+        copy_json_string(board, "cal_date", entry->cal_date, sizeof(entry->cal_date));
+        entry->probe = probe_from_json(board, "probe");
+    }
+    cJSON_Delete(root);
+    return THERMO_SUCCESS;
+}
+
+static int make_parent_dirs(char *path) {
+    for (char *p = strchr(path + 1, '/'); p; p = strchr(p + 1, '/')) {
+        *p = '\0';
+        int failed = mkdir(path, 0755) != 0 && errno != EEXIST;
+        *p = '/';
+        if (failed) return THERMO_IO_ERROR;
+    }
+    return THERMO_SUCCESS;
+}
+
+/* Best effort: written to a temporary file and renamed, so concurrent
+ * readers never see a partial cache */
+static void save_cache(const Inventory *inv) {
+    char path[512], tmp[544];
+    if (!probe_available() || cache_path(path, sizeof(path)) != THERMO_SUCCESS ||
+        make_parent_dirs(path) != THERMO_SUCCESS) {
+        return;
+    }
+    
+    char hex[20];
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "version", INVENTORY_CACHE_VERSION);
+    probe_to_string(inv->probe, hex, sizeof(hex));
+    cJSON_AddStringToObject(root, "probe", hex);
+    cJSON *boards = cJSON_AddArrayToObject(root, "boards");
+    for (int i = 0; i < inv->count; i++) {
+        const InventoryBoard *entry = &inv->boards[i];
+        cJSON *board = cJSON_CreateObject();
+        cJSON_AddNumberToObject(board, "address", entry->address);
+        cJSON_AddNumberToObject(board, "id", entry->id);
+        cJSON_AddNumberToObject(board, "version", entry->version);
+        cJSON_AddStringToObject(board, "name", entry->product_name);
+        cJSON_AddStringToObject(board, "serial", entry->serial);
+        cJSON_AddStringToObject(board, "cal_date", entry->cal_date);
+        probe_to_string(entry->probe, hex, sizeof(hex));
+        cJSON_AddStringToObject(board, "probe", hex);
+        cJSON_AddItemToArray(boards, board);
+    }
+    char *text = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!text) return;
+    
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    FILE *fp = fopen(tmp, "w");
+    if (fp) {
+        int ok = fputs(text, fp) >= 0;
+        ok = (fclose(fp) == 0) && ok;
+        if (!ok || rename(tmp, path) != 0) {
+            unlink(tmp);
+        }
+    }
+    free(text);
+}
+
+/* ============================================================================
+ * Inventory
+ * ============================================================================ */
+
+static int rescan(Inventory *inv, const Inventory *cached, const uint64_t probes[INVENTORY_MAX_BOARDS],
+                  uint64_t probe) {
+    struct HatInfo *boards = NULL;
+    int count = 0;
+    if (thermo_list_boards(&boards, &count) != THERMO_SUCCESS) {
+        return THERMO_ERROR;
+    }
+    
+    memset(inv, 0, sizeof(*inv));
+    inv->probe = probe;
+    inv->scanned = 1;
+    for (int i = 0; i < count && inv->count < INVENTORY_MAX_BOARDS; i++) {
+        if (boards[i].address >= INVENTORY_MAX_BOARDS) continue;
+    
+        InventoryBoard *entry = &inv->boards[inv->count++];
+        entry->address = boards[i].address;
+        entry->id = boards[i].id;
+        entry->version = boards[i].version;
+        snprintf(entry->product_name, sizeof(entry->product_name), "%s", boards[i].product_name);
+        entry->probe = probes[entry->address];
+    
+        /* Same EEPROM image at the same address: same board */
+        for (int j = 0; cached && j < cached->count; j++) {
+            const InventoryBoard *old = &cached->boards[j];
+            if (old->address == entry->address && old->id == entry->id && old->probe == entry->probe) {
+                memcpy(entry->serial, old->serial, sizeof(entry->serial));
+                memcpy(entry->cal_date, old->cal_date, sizeof(entry->cal_date));
+            }
+        }
+    }
+    free(boards);
+    
+    DEBUG_PRINT("Inventory rescanned: %d board(s)", inv->count);
+    save_cache(inv);
+    return THERMO_SUCCESS;
+}
+
+int inventory_load(Inventory *inv, int refresh) {
+    uint64_t probes[INVENTORY_MAX_BOARDS];
+    uint64_t probe = probe_all(probes);
+    
+    Inventory cached;
+    int have_cache = probe_available() && read_cache(&cached) == THERMO_SUCCESS;
+    if (have_cache && !refresh && cached.probe == probe) {
+        *inv = cached;
+        return THERMO_SUCCESS;
+    }
+    return rescan(inv, have_cache ? &cached : NULL, probes, probe);
+}
+
+InventoryBoard* inventory_find(Inventory *inv, uint8_t address) {
+    for (int i = 0; i < inv->count; i++) {
+        if (inv->boards[i].address == address) {
+            return &inv->boards[i];
+        }
+    }
+    return NULL;
+}
+
+/* Read serial and calibration date together (one open) and cache them */
+static int fill_eeprom_info(Inventory *inv, InventoryBoard *entry) {
+    if (entry->serial[0] != '\0' && entry->cal_date[0] != '\0') {
+        return THERMO_SUCCESS;
+    }
+    
+    int was_open = thermo_is_open(entry->address);
+    if (!was_open && thermo_open(entry->address) != THERMO_SUCCESS) {
+        return THERMO_ERROR;
+    }
+    int result = thermo_get_serial(entry->address, entry->serial, sizeof(entry->serial));
+    if (thermo_get_calibration_date(entry->address, entry->cal_date, sizeof(entry->cal_date)) != THERMO_SUCCESS) {
+        result = THERMO_ERROR;
+    }
+    if (!was_open) {
+        thermo_close(entry->address);
+    }
+    
+    if (result != THERMO_SUCCESS) {
+        entry->serial[0] = '\0';
+        entry->cal_date[0] = '\0';
+        return THERMO_ERROR;
+    }
+    save_cache(inv);
+    return THERMO_SUCCESS;
+}
+
+int inventory_get_serial(Inventory *inv, uint8_t address, char *buffer, size_t len) {
+    InventoryBoard *entry = inventory_find(inv, address);
+    if (!entry) return THERMO_NOT_FOUND;
+    if (fill_eeprom_info(inv, entry) != THERMO_SUCCESS) return THERMO_ERROR;
+    snprintf(buffer, len, "%s", entry->serial);
+    return THERMO_SUCCESS;
+}
+
+int inventory_get_cal_date(Inventory *inv, uint8_t address, char *buffer, size_t len) {
+    InventoryBoard *entry = inventory_find(inv, address);
+    if (!entry) return THERMO_NOT_FOUND;
+    if (fill_eeprom_info(inv, entry) != THERMO_SUCCESS) return THERMO_ERROR;
+    snprintf(buffer, len, "%s", entry->cal_date);
+    return THERMO_SUCCESS;
+}
+
+int inventory_validate_sources(Inventory *inv, const ThermalSource *sources, int count) {
+    for (int i = 0; i < count; i++) {
+        const ThermalSource *src = &sources[i];
+        if (!validate_address(src->address) || !validate_channel(src->channel)) {
+            fprintf(stderr, "Error: Source %s: address must be 0-7 and channel 0-3\n", src->key);
+            return THERMO_INVALID_PARAM;
+        }
+    
+        if (!inventory_find(inv, src->address) && !inv->scanned) {
+            inventory_load(inv, 1);
+        }
+        if (!inventory_find(inv, src->address)) {
+            fprintf(stderr, "Error: Source %s: no MCC 134 at address %d\n", src->key, src->address);
+            return THERMO_NOT_FOUND;
+        }
+    }
+    return THERMO_SUCCESS;
+}
@@ -0,0 +1,293 @@
+/*
+ * Sample-period jitter analyzer implementation.
+ * Two histograms: the raw intervals, and their absolute deviation from the
+ * nominal period (kept separately so deviations of a few microseconds stay
+ * resolvable on a period of seconds). Without a nominal period the median
+ * of the latest intervals stands in for it, re-estimated whenever a run of
+ * intervals disagrees with it (a backlog drained at startup, a producer
+ * changing rate). The stream's own thread records and reports; the exit
+ * summary runs after it has stopped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <stdatomic.h>
+
+#include "jitter.h"
+#include "histogram.h"
+#include "common.h"
+#include "cJSON.h"
+
+/* Intervals used to estimate the period when none is given, and the run of
+ * intervals off by more than half of it that triggers a new estimate */
+#define ESTIMATE_SAMPLES 16
+
+/* Coarse histogram: bands of |interval - period|, upper limits in microseconds */
+static const uint64_t BAND_LIMITS_US[] = {10, 100, 1000, 10000, 100000};
+static const char *BAND_LABELS[] = {"<=10us", "<=100us", "<=1ms", "<=10ms", "<=100ms", ">100ms"};
+#define BAND_COUNT ((int)(sizeof(BAND_LABELS) / sizeof(BAND_LABELS[0])))
+
+static const double PERCENTILES[] = {50.0, 99.0};
+#define PERCENTILE_COUNT ((int)(sizeof(PERCENTILES) / sizeof(PERCENTILES[0])))
+
+volatile int g_jitter_enabled = 0;
+
+static Histogram *g_intervals = NULL;
+static Histogram *g_deviations = NULL;
+static _Atomic uint64_t g_bands[BAND_COUNT];
+static _Atomic uint64_t g_missed = 0;
+static _Atomic uint64_t g_period_ns = 0;    /* 0 until known */
+static int g_period_estimated = 0;
+static uint64_t g_recent[ESTIMATE_SAMPLES];     /* Latest intervals, oldest overwritten */
+static int g_recent_count = 0;
+static int g_mismatched = 0;                    /* Consecutive intervals far off the estimate */
+static uint64_t g_last_ns = 0;
+static double g_interval_s = 0;
+static uint64_t g_start_ns = 0;
+static uint64_t g_next_report_ns = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* ============================================================================
+ * Recording
+ * ============================================================================ */
+
+static void relaxed_increment(_Atomic uint64_t *field) {
+    atomic_store_explicit(field, atomic_load_explicit(field, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+/* Score one interval against the known period */
+static void record_deviation(uint64_t interval, uint64_t period) {
+    uint64_t deviation = interval > period ? interval - period : period - interval;
+    histogram_record(g_deviations, deviation);
+    
+    int band = 0;
+    while (band < BAND_COUNT - 1 && deviation > BAND_LIMITS_US[band] * 1000) {
+        band++;
+    }
+    relaxed_increment(&g_bands[band]);
+    if ((double)interval > JITTER_MISSED_FACTOR * (double)period) {
+        relaxed_increment(&g_missed);
+    }
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* Take the median of the latest intervals as the period and restart the
+ * deviation statistics from them */
+static void estimate_period(void) {
+    uint64_t sorted[ESTIMATE_SAMPLES];
+    memcpy(sorted, g_recent, sizeof(sorted));
+    qsort(sorted, ESTIMATE_SAMPLES, sizeof(sorted[0]), compare_u64);
+    uint64_t period = sorted[ESTIMATE_SAMPLES / 2];
+    
+    histogram_reset(g_deviations);
+    for (int b = 0; b < BAND_COUNT; b++) {
+        atomic_store_explicit(&g_bands[b], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&g_missed, 0, memory_order_relaxed);
+    for (int i = 0; i < ESTIMATE_SAMPLES; i++) {
+        record_deviation(g_recent[i], period);
+    }
+    atomic_store_explicit(&g_period_ns, period, memory_order_release);
+    g_mismatched = 0;
+}
+
+void jitter_mark_now(void) {
+    uint64_t now = now_ns();
+    uint64_t last = g_last_ns;
+    g_last_ns = now;
+    if (last == 0) return;
+    
+    uint64_t interval = now - last;
+    histogram_record(g_intervals, interval);
+    
+    uint64_t period = atomic_load_explicit(&g_period_ns, memory_order_relaxed);
+    if (!g_period_estimated) {
+        record_deviation(interval, period);
+        return;
+    }
+    
+    g_recent[g_recent_count++ % ESTIMATE_SAMPLES] = interval;
+    if (!period) {
+        if (g_recent_count >= ESTIMATE_SAMPLES) estimate_period();
+        return;
+    }
+    record_deviation(interval, period);
+    if (interval < period / 2 || interval > period + period / 2) {
+        if (++g_mismatched >= ESTIMATE_SAMPLES) estimate_period();
+    } else {
+        g_mismatched = 0;
+    }
+}
+
+/* ============================================================================
+ * Reporting
+ * ============================================================================ */
+
+typedef struct {
+    uint64_t period_ns;             /* 0 while still estimating */
+    uint64_t missed;
+    uint64_t bands[BAND_COUNT];
+    HistogramSummary interval;      /* ns */
+    HistogramSummary deviation;     /* ns; count 0 while still estimating */
+} JitterSnapshot;
+
+static int jitter_snapshot(JitterSnapshot *snap) {
+    memset(snap, 0, sizeof(*snap));
+    if (!histogram_summarize(g_intervals, PERCENTILES, PERCENTILE_COUNT, &snap->interval)) {
+        return 0;
+    }
+    snap->period_ns = atomic_load_explicit(&g_period_ns, memory_order_acquire);
+    histogram_summarize(g_deviations, PERCENTILES, PERCENTILE_COUNT, &snap->deviation);
+    snap->missed = atomic_load_explicit(&g_missed, memory_order_relaxed);
+    for (int b = 0; b < BAND_COUNT; b++) {
+        snap->bands[b] = atomic_load_explicit(&g_bands[b], memory_order_relaxed);
+    }
+    return 1;
+}
+
+/* Nanoseconds to microseconds, rounded to whole nanoseconds */
+static double to_us(double ns) {
+    return round(ns) / 1000.0;
+}
+
+static void add_summary(cJSON *parent, const char *name, const HistogramSummary *sum) {
+    cJSON *obj = cJSON_AddObjectToObject(parent, name);
+    cJSON_AddNumberToObject(obj, "MIN", to_us(sum->min));
+    cJSON_AddNumberToObject(obj, "MEAN", to_us(sum->mean));
+    cJSON_AddNumberToObject(obj, "P50", to_us(sum->pct[0]));
+    cJSON_AddNumberToObject(obj, "P99", to_us(sum->pct[1]));
+    cJSON_AddNumberToObject(obj, "MAX", to_us(sum->max));
+}
+
+/* {"JITTER":{"UPTIME":s,"PERIOD_US":..,"ESTIMATED":b,"COUNT":n,"MISSED":n,
+ *            "INTERVAL_US":{..},"DEVIATION_US":{..},"HISTOGRAM":{"<=10us":n,..}}} */
+static cJSON* jitter_to_json(const JitterSnapshot *snap) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON *jitter = cJSON_AddObjectToObject(root, "JITTER");
+    cJSON_AddNumberToObject(jitter, "UPTIME", round((double)(now_ns() - g_start_ns) / 1e6) / 1e3);
+    if (snap->period_ns) {
+        cJSON_AddNumberToObject(jitter, "PERIOD_US", to_us((double)snap->period_ns));
+    } else {
+        cJSON_AddNullToObject(jitter, "PERIOD_US");
+    }
+    cJSON_AddBoolToObject(jitter, "ESTIMATED", g_period_estimated);
+    cJSON_AddNumberToObject(jitter, "COUNT", (double)snap->interval.count);
+    cJSON_AddNumberToObject(jitter, "MISSED", (double)snap->missed);
+    add_summary(jitter, "INTERVAL_US", &snap->interval);
+    if (snap->deviation.count) {
+        add_summary(jitter, "DEVIATION_US", &snap->deviation);
+        cJSON *bands = cJSON_AddObjectToObject(jitter, "HISTOGRAM");
+        for (int b = 0; b < BAND_COUNT; b++) {
+            cJSON_AddNumberToObject(bands, BAND_LABELS[b], (double)snap->bands[b]);
+        }
+    }
+    return root;
+}
+
+void jitter_report_due(void) {
+    if (!g_jitter_enabled || g_interval_s <= 0) return;
+    
+    uint64_t now = now_ns();
+    if (now < g_next_report_ns) return;
+    g_next_report_ns = now + (uint64_t)(g_interval_s * 1e9);
+    
+    JitterSnapshot snap;
+    if (!jitter_snapshot(&snap)) return;
+    
+    cJSON *root = jitter_to_json(&snap);
+    char *str = cJSON_PrintUnformatted(root);
+    if (str) {
+        fprintf(stderr, "%s\n", str);
+        free(str);
+    }
+    cJSON_Delete(root);
+}
+
+static void print_row(FILE *fp, const char *name, const HistogramSummary *sum) {
+    fprintf(fp, "%-16s %12.3f %12.3f %12.3f %12.3f %12.3f\n", name,
+            sum->min / 1000.0, sum->mean / 1000.0, sum->pct[0] / 1000.0,
+            sum->pct[1] / 1000.0, sum->max / 1000.0);
+}
+
+void jitter_print_summary(FILE *fp) {
+    JitterSnapshot snap;
+    if (!jitter_snapshot(&snap)) return;
+    
+    if (snap.period_ns) {
+        fprintf(fp, "Sample period: %.3f ms%s, %llu intervals, %llu missed (> %.1fx period)\n",
+                (double)snap.period_ns / 1e6, g_period_estimated ? " (median)" : "",
+                (unsigned long long)snap.interval.count, (unsigned long long)snap.missed,
+                JITTER_MISSED_FACTOR);
+    } else {
+        fprintf(fp, "Sample period: not estimated (%llu intervals)\n",
+                (unsigned long long)snap.interval.count);
+    }
+    fprintf(fp, "%-16s %12s %12s %12s %12s %12s\n", "Jitter (us)", "min", "mean", "p50", "p99", "max");
+    print_row(fp, "interval", &snap.interval);
+    if (!snap.deviation.count) return;
+    print_row(fp, "|deviation|", &snap.deviation);
+    
+    fprintf(fp, "%-16s", "|deviation| hist");
+    for (int b = 0; b < BAND_COUNT; b++) {
+        fprintf(fp, " %s:%llu", BAND_LABELS[b], (unsigned long long)snap.bands[b]);
+    }
+    fprintf(fp, "\n");
+}
+
+/* ============================================================================
+ * Setup
+ * ============================================================================ */
+
+int jitter_parse_interval(const char *str, double *interval_s) {
+    if (!str) {
+        *interval_s = JITTER_DEFAULT_INTERVAL_S;
+        return THERMO_SUCCESS;
+    }
+    char *end = NULL;
+    double value = strtod(str, &end);
+    if (*str == '\0' || *end != '\0' || value < 0) {
+        fprintf(stderr, "Error: --jitter interval must be a number of seconds (0 = on exit only)\n");
+        return THERMO_INVALID_PARAM;
+    }
+    *interval_s = value;
+    return THERMO_SUCCESS;
+}
+
+static void jitter_atexit(void) {
+    if (!g_jitter_enabled) return;
+    g_jitter_enabled = 0;
+    jitter_print_summary(stderr);
+}
+
+void jitter_enable(double interval_s, long period_ns) {
+    static int atexit_registered = 0;
+    if (!g_intervals) g_intervals = histogram_create();
+    if (!g_deviations) g_deviations = histogram_create();
+    if (!g_intervals || !g_deviations) {
+        fprintf(stderr, "Warning: Not enough memory for --jitter, disabled\n");
+        return;
+    }
+    if (!atexit_registered) {
+        atexit(jitter_atexit);
+        atexit_registered = 1;
+    }
+    g_interval_s = interval_s;
+    g_period_estimated = period_ns <= 0;
+    atomic_store_explicit(&g_period_ns, period_ns > 0 ? (uint64_t)period_ns : 0, memory_order_relaxed);
+    g_start_ns = now_ns();
+    g_next_report_ns = g_start_ns + (uint64_t)(interval_s * 1e9);
+    g_jitter_enabled = 1;
+}
@@ -14,8 +14,20 @@
  * ============================================================================ */
 
 void reading_add_to_json(cJSON *obj, const ChannelReading *reading) {
+    /* Deadband: the consumer keeps the last values it was sent */
+    if (reading->unchanged) {
+        cJSON_AddTrueToObject(obj, "UNCHANGED");
+        return;
+    }
+    
+    /* Faulted channels report null with the reason instead of a sentinel number */
     if (reading->has_temp) {
-        cJSON_AddNumberToObject(obj, "TEMPERATURE", reading->temperature);
+        if (reading->status == READING_OK) {
+            cJSON_AddNumberToObject(obj, "TEMPERATURE", reading->temperature);
+        } else {
+            cJSON_AddNullToObject(obj, "TEMPERATURE");
+        }
+        cJSON_AddStringToObject(obj, "STATUS", thermo_status_name(reading->status));
     }
     if (reading->has_adc) {
         cJSON_AddNumberToObject(obj, "ADC", reading->adc_voltage);
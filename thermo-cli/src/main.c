@@ -13,6 +13,10 @@
 #include "commands/set.h"
 #include "commands/fuse.h"
 #include "commands/init_config.h"
+#include "commands/linearize.h"
+#include "commands/replay.h"
+#include "commands/query.h"
+#include "commands/calibrate.h"
 
 const char *argp_program_version = "thermo-cli 1.0.0";
 const char *argp_program_bug_address = "<support@example.com>";
@@ -25,7 +29,11 @@ static char doc[] =
     "  get              Read data from single or multiple channels\n"
     "  set              Configure channel parameters\n"
     "  fuse             Fuse thermal data into cmg-cli output\n"
-    "  init-config      Generate an example configuration file\n";
+    "  init-config      Generate an example configuration file\n"
+    "  linearize        Recompute temperatures from recorded ADC/CJC columns\n"
+    "  replay           Replay recordings through the filter/fusion/output stages\n"
+    "  query            Aggregate recorded values over a time range\n"
+    "  calibrate        Fit calibration coefficients from reference temperatures\n";
 
 /* Argument documentation */
 static char args_doc[] = "COMMAND [ARGS...]";
@@ -47,6 +55,10 @@ static Command commands[] = {
     {"set", "Configure channel parameters", cmd_set},
     {"fuse", "Fuse thermal data into cmg-cli output", cmd_fuse},
     {"init-config", "Generate example configuration file", cmd_init_config},
+    {"linearize", "Recompute temperatures from recorded ADC/CJC columns", cmd_linearize},
+    {"replay", "Replay recordings through the filter/fusion/output stages", cmd_replay},
+    {"query", "Aggregate recorded values over a time range", cmd_query},
+    {"calibrate", "Fit calibration coefficients from reference temperatures", cmd_calibrate},
     {NULL, NULL, NULL}
 };
 
@@ -77,6 +89,7 @@ static void print_command_help(const char *cmd_name) {
         printf("List all connected MCC 134 boards.\n\n");
         printf("Options:\n");
         printf("  -j, --json          Output as JSON\n");
+        printf("  -r, --refresh       Rescan boards instead of using the inventory cache\n");
     } else if (strcmp(cmd_name, "get") == 0) {
         printf("Usage: thermo-cli get [OPTIONS]\n\n");
         printf("Read data from a single channel or multiple channels.\n\n");
@@ -98,7 +111,35 @@ static void print_command_help(const char *cmd_name) {
         printf("  -i, --update-interval    Get update interval\n");
         printf("  -S, --stream HZ          Stream readings at specified frequency (Hz)\n");
         printf("  -l, --clean              Simple output without alignment/formatting\n");
-        printf("  -j, --json               Output as JSON\n\n");
+        printf("  -j, --json               Output as JSON\n");
+        printf("      --output-policy P    Streamed JSON when stdout falls behind:\n");
+        printf("                           block, drop-oldest, coalesce [default: block]\n");
+        printf("      --queue-depth N      Records buffered ahead of stdout [default: 64]\n");
+        printf("      --sink SPEC          Also record the stream (repeatable, needs --stream):\n");
+        printf("                           KIND[:TARGET][,format=json|csv|binary|compressed]\n");
+        printf("                           [,rotate-size=N[K|M|G]][,rotate-time=N[s|m|h|d]]\n");
+        printf("                           [,fsync=N|Tms|Ts|never][,index=N[K|M|G]|off][,block=N]\n");
+        printf("                           [,rollup=W[:W...]|off]\n");
+        printf("                           KIND: stdout, file, unix, tcp\n");
+        printf("      --oversample N       Read N times per streamed record (1-256) [default: 1]\n");
+        printf("      --filter SPEC        Temperature filter for sources without one in the config\n");
+        printf("                           (needs --stream): boxcar:N, ema:ALPHA, median:N,\n");
+        printf("                           cic[:ORDER] (last), comma-chained [default: period mean]\n");
+        printf("      --deadband SPEC      Change-only records for sources without one in the config\n");
+        printf("                           (needs --stream): BAND (degC) or BAND%% of the last value,\n");
+        printf("                           /HEARTBEAT seconds [default: 60]; table output unaffected\n");
+        printf("      --realtime[=PRIO]    Sample under SCHED_FIFO (1-99) [default: 80] with locked,\n");
+        printf("                           pre-faulted memory, pinned to one CPU (needs --stream)\n");
+        printf("      --cpu N              CPU for --realtime [default: first isolated, else last]\n");
+        printf("      --trace FILE         Record where time goes into a Chrome/Perfetto trace\n");
+        printf("      --stats[=SECS]       Latency histograms of board reads, serialization and writes:\n");
+        printf("                           a JSON stats record on stderr every SECS [default: 10]\n");
+        printf("                           (0 = none) and a summary table on exit\n");
+        printf("      --metrics ADDR       Serve Prometheus metrics on unix:PATH or tcp:[HOST:]PORT\n");
+        printf("                           (HOST defaults to 127.0.0.1)\n");
+        printf("      --jitter[=SECS]      Measure the actual sample intervals against the period\n");
+        printf("                           (needs --stream): JSON record on stderr every SECS\n");
+        printf("                           [default: 10] (0 = none) and a summary table on exit\n\n");
         printf("Notes:\n");
         printf("  - Cannot specify both --config and --address/--channel\n");
         printf("  - In multi-channel mode, all data flags apply to ALL channels\n");
@@ -108,18 +149,30 @@ static void print_command_help(const char *cmd_name) {
         printf("  thermo-cli get -a 0 -c 1 -T -A --json              # Single channel with JSON output\n");
         printf("  thermo-cli get --config sensors.yaml --temp        # Multiple channels from config\n");
         printf("  thermo-cli get -C sensors.yaml -T -A --stream 5    # Stream multiple channels at 5 Hz\n");
+        printf("  thermo-cli get -C sensors.yaml -S 5 --sink file:run.csv,rotate-time=1h\n");
+        printf("  thermo-cli get -C sensors.yaml -S 2 --oversample 8 --filter median:3,cic\n");
+        printf("  sudo thermo-cli get -C sensors.yaml -S 100 --realtime --cpu 3 -j\n");
     } else if (strcmp(cmd_name, "set") == 0) {
         printf("Usage: thermo-cli set [OPTIONS]\n\n");
         printf("Configure channel parameters.\n\n");
         printf("Options:\n");
+        printf("  -C, --config FILE           Apply TC types, calibration and update intervals of\n");
+        printf("                              every source in a YAML/JSON config (one session per\n");
+        printf("                              board, verified by read-back). TC types and\n");
+        printf("                              calibration last until a board is opened again;\n");
+        printf("                              get and fuse apply them from the config\n");
+        printf("  -n, --dry-run               With --config: show the changes, write nothing\n");
         printf("  -a, --address NUM           Board address (0-7) [default: 0]\n");
         printf("  -c, --channel NUM           Channel index (0-3) [default: 0]\n");
         printf("  -S, --cali-slope VALUE      Set calibration slope\n");
         printf("  -O, --cali-offset VALUE     Set calibration offset\n");
-        printf("  -i, --update-interval NUM   Set update interval in seconds\n");
+        printf("  -i, --update-interval NUM   Set update interval in seconds\n\n");
+        printf("Examples:\n");
+        printf("  thermo-cli set -C rig.yaml --dry-run    # Diff the rig against the config\n");
+        printf("  thermo-cli set -C rig.yaml              # Check the boards accept it\n");
     } else if (strcmp(cmd_name, "fuse") == 0) {
-        printf("Usage: thermo-cli fuse [OPTIONS] -- [cmg-cli arguments...]\n\n");
-        printf("Fuse thermal data into 'cmg-cli get' command output.\n\n");
+        printf("Usage: thermo-cli fuse [OPTIONS] -- [producer arguments...]\n\n");
+        printf("Fuse thermal data into 'cmg-cli get' (or any NDJSON producer) output.\n\n");
         printf("Options:\n");
         printf("  -C, --config FILE      Path to YAML/JSON config file\n");
         printf("  -a, --address NUM      Single mode: Board address\n");
@@ -128,14 +181,136 @@ static void print_command_help(const char *cmd_name) {
         printf("  -t, --tc-type TYPE     Thermocouple type (default: K)\n");
         printf("  -T, --time-format FMT  Timestamp format (default: %%Y-%%m-%%dT%%H:%%M:%%S.%%f)\n");
         printf("                         Use %%f for 6-digit microseconds\n");
+        printf("  -x, --command CMD      Producer command, split on whitespace; '...' or \"...\" keep\n");
+        printf("                         spaces in a word (at most 32 words, 255 characters)\n");
+        printf("                         [default: 'cmg-cli get']\n");
+        printf("  -p, --pipe             Read producer over a plain pipe instead of a pty\n");
+        printf("                         (producer must flush each line itself)\n");
+        printf("  -s, --stdin            Fuse NDJSON read from stdin (no producer is spawned)\n");
+        printf("  -i, --input PATH       Fuse NDJSON read from a FIFO, file or Unix socket\n");
+        printf("      --output-policy P  When stdout falls behind: block, drop-oldest, coalesce\n");
+        printf("                         [default: block]\n");
+        printf("      --queue-depth N    Records buffered ahead of stdout [default: 64]\n");
+        printf("      --sink SPEC        Output destination, repeatable [default: stdout]\n");
+        printf("                         KIND[:TARGET][,format=json|csv|binary|compressed]\n");
+        printf("                         [,rotate-size=N[K|M|G]][,rotate-time=N[s|m|h|d]]\n");
+        printf("                         [,fsync=N|Tms|Ts|never][,index=N[K|M|G]|off][,block=N]\n");
+        printf("                         [,rollup=W[:W...]|off]\n");
+        printf("                         KIND: stdout, file, unix, tcp\n");
+        printf("      --filter SPEC      Temperature filter for sources without one in the config,\n");
+        printf("                         applied per record: boxcar:N, ema:ALPHA, median:N\n");
+        printf("      --deadband SPEC    Mark a source UNCHANGED until TEMP moves by more than\n");
+        printf("                         BAND (degC) or BAND%%, or /HEARTBEAT seconds pass [default: 60]\n");
+        printf("      --trace FILE       Record where time goes into a Chrome/Perfetto trace\n");
+        printf("      --stats[=SECS]     Latency histograms, JSON record on stderr every SECS, summary on exit\n");
+        printf("      --metrics ADDR     Serve Prometheus metrics on unix:PATH or tcp:[HOST:]PORT\n");
+        printf("      --jitter[=SECS]    Producer line intervals against their median, JSON record on\n");
+        printf("                         stderr every SECS, summary on exit\n\n");
         printf("Examples:\n");
         printf("  thermo-cli fuse --address 0 --channel 1 --key MY_TEMP -- --power --json\n");
         printf("  thermo-cli fuse --config config.yaml -- --actuator --stream 5 --json\n");
+        printf("  thermo-cli fuse --config config.yaml --command 'imu-logger --ndjson'\n");
+        printf("  cmg-cli get --power --json | thermo-cli fuse --config config.yaml --stdin\n");
+        printf("  thermo-cli fuse -C config.yaml --sink stdout --sink file:run.tcr -- --power\n");
     } else if (strcmp(cmd_name, "init-config") == 0) {
         printf("Usage: thermo-cli init-config [OPTIONS]\n\n");
         printf("Generate an example configuration file.\n\n");
         printf("Options:\n");
         printf("  -o, --output FILE      Output file path [default: thermo_config.yaml]\n");
+    } else if (strcmp(cmd_name, "linearize") == 0) {
+        printf("Usage: thermo-cli linearize [OPTIONS] [FILE]\n\n");
+        printf("Recompute <NAME>_TEMP from <NAME>_ADC and <NAME>_CJC columns of a CSV or\n");
+        printf("binary recording (stdin if FILE is omitted) with NIST ITS-90 polynomials.\n");
+        printf("An existing <NAME>_TEMPERATURE column (from 'get') is rewritten in place.\n");
+        printf("Output is written to stdout in the input's format.\n");
+        printf("Recorded fault codes (-9999, -8888, -7777) are kept.\n\n");
+        printf("Options:\n");
+        printf("  -C, --config FILE      Take each column's TC type from the source with a matching key\n");
+        printf("  -t, --tc-type TYPE     TC type for columns not in the config [default: K]\n\n");
+        printf("Examples:\n");
+        printf("  thermo-cli linearize -t J run.csv > run_j.csv\n");
+        printf("  thermo-cli linearize -C sensors.yaml < run.csv > fixed.csv\n");
+        printf("  thermo-cli linearize -C sensors.yaml run.tcr > fixed.tcr\n");
+    } else if (strcmp(cmd_name, "replay") == 0) {
+        printf("Usage: thermo-cli replay [OPTIONS] FILE...\n\n");
+        printf("Feed CSV or binary recordings (several files are rotated segments, replayed\n");
+        printf("in order) through the same filter, deadband, fusion and output stages as a\n");
+        printf("live stream, paced by the recorded timestamps. Records keep their recorded\n");
+        printf("time. Without --fuse each record is output like 'get --stream'; with --fuse\n");
+        printf("each line of a recorded cmg-cli stream is fused like 'fuse', taking the\n");
+        printf("thermal values recorded at or before its TIMESTAMP.\n\n");
+        printf("Options:\n");
+        printf("  -C, --config FILE      Sources to replay, matched to columns by key\n");
+        printf("                         [default: every source in the recording]\n");
+        printf("  -T, --time-format FMT  TIMESTAMP format of --fuse lines and output\n");
+        printf("                         (default: %%Y-%%m-%%dT%%H:%%M:%%S.%%f)\n");
+        printf("  -j, --json             Also write records to stdout when --sink is given\n");
+        printf("      --speed X|max      Recorded seconds per second: 1 = real time, 10 = ten times\n");
+        printf("                         faster, max = as fast as the sinks accept [default: 1]\n");
+        printf("      --fuse FILE        Recorded cmg-cli NDJSON to fuse into ('-' = stdin)\n");
+        printf("      --output-policy P  When the sinks fall behind: block, drop-oldest, coalesce\n");
+        printf("                         [default: block]\n");
+        printf("      --queue-depth N    Records buffered ahead of the sinks [default: 64]\n");
+        printf("      --sink SPEC        Output destination, repeatable (see 'get') [default: stdout]\n");
+        printf("      --filter SPEC      Temperature filter for sources without one in the config\n");
+        printf("      --deadband SPEC    Deadband for sources without one in the config\n");
+        printf("      --trace FILE       Record where time goes into a Chrome/Perfetto trace\n");
+        printf("      --stats[=SECS]     Serialization and sink write latency histograms\n\n");
+        printf("A summary (records, recorded span, wall time, records/s) is printed to stderr.\n\n");
+        printf("Examples:\n");
+        printf("  thermo-cli replay run.tcr\n");
+        printf("  thermo-cli replay --speed 10 --filter median:5 run.csv.1 run.csv\n");
+        printf("  thermo-cli replay --speed max --sink file:out.tcr,format=binary run.tcr\n");
+        printf("  thermo-cli replay -C sensors.yaml --fuse cmg.ndjson --speed max run.csv\n");
+    } else if (strcmp(cmd_name, "query") == 0) {
+        printf("Usage: thermo-cli query [OPTIONS] FILE...\n\n");
+        printf("Aggregate the values of CSV or binary recordings (several files are rotated\n");
+        printf("segments, in order) over a time range, per interval. The time index a file\n");
+        printf("sink keeps beside each recording (FILE.idx) points the query at the part of\n");
+        printf("the files that holds the range, which worker threads read in parallel;\n");
+        printf("files without an index are read whole. When a rollup level the sink keeps\n");
+        printf("(FILE.rollup-W) divides --every and --from/--to, its rows are read instead of\n");
+        printf("the records, up to each file's last (possibly still open) interval, which is\n");
+        printf("read from the records. Temperature fault codes are skipped.\n\n");
+        printf("Options:\n");
+        printf("      --from TIME        Start of the range, inclusive: epoch seconds or local\n");
+        printf("                         YYYY-MM-DDTHH:MM:SS[.ffffff] [default: first record]\n");
+        printf("      --to TIME          End of the range, exclusive [default: last record]\n");
+        printf("      --every DURATION   Interval per output row: N[us|ms|s|m|h|d], aligned to\n");
+        printf("                         --from (else to the epoch) [default: the whole range]\n");
+        printf("      --agg LIST         Aggregates: mean, min, max, count [default: mean,min,max]\n");
+        printf("      --columns LIST     Columns, or prefixes of columns (MOTOR_TEMP selects\n");
+        printf("                         MOTOR_TEMP_*) [default: every numeric value column]\n");
+        printf("      --threads N        Worker threads [default: one per CPU]\n");
+        printf("      --raw              Read the records even when a rollup level fits\n");
+        printf("  -j, --json             One JSON object per interval instead of CSV\n\n");
+        printf("Output is CSV on stdout: TIME (interval start), RECORDS, then <COLUMN>_<AGG>;\n");
+        printf("intervals without records are left out. A summary (records, chunks and bytes\n");
+        printf("or rollup rows read, time) is printed to stderr.\n\n");
+        printf("Examples:\n");
+        printf("  thermo-cli query --every 10s run.tcr\n");
+        printf("  thermo-cli query --from 2026-10-16T08:00:00 --to 2026-10-16T09:00:00 \\\n");
+        printf("      --every 1m --agg mean,max --columns MOTOR_TEMP run.csv.1 run.csv\n");
+    } else if (strcmp(cmd_name, "calibrate") == 0) {
+        printf("Usage: thermo-cli calibrate [OPTIONS]\n\n");
+        printf("Fit calibration slope/offset for several channels at once. For each reference\n");
+        printf("point, hold every thermocouple at a known temperature (ice bath, dry-block\n");
+        printf("calibrator, ...) and type it in degC; a blank line ends the run and fits each\n");
+        printf("channel by least squares against the NIST reference voltage. Two or more\n");
+        printf("distinct temperatures fit slope and offset, one fits the offset only.\n\n");
+        printf("Options:\n");
+        printf("  -C, --config FILE      Calibrate every source of a config file\n");
+        printf("  -a, --address NUM      Board address (0-7) [default: 0]\n");
+        printf("  -c, --channel LIST     Channels, e.g. 0,1,2,3 [default: 0]\n");
+        printf("  -t, --tc-type TYPE     Thermocouple type without a config [default: K]\n");
+        printf("  -n, --samples NUM      Samples per reference point, one per update interval\n");
+        printf("                         [default: 10]\n");
+        printf("  -w, --write            Write the fitted coefficients to the boards (kept until\n");
+        printf("                         a board is opened again)\n");
+        printf("  -u, --update-config    Store them as cal_slope/cal_offset in the config file\n\n");
+        printf("Examples:\n");
+        printf("  thermo-cli calibrate -a 0 -c 0,1,2,3 -t K\n");
+        printf("  thermo-cli calibrate -C rig.yaml -n 30 --update-config\n");
     } else {
         printf("Unknown command: %s\n", cmd_name);
         printf("Run 'thermo-cli --help' for available commands.\n");
@@ -0,0 +1,365 @@
+/*
+ * Metrics exporter implementation.
+ * Counters are relaxed atomics: a scrape may see one source a sample ahead
+ * of another, never a torn value. Each connection gets one response and is
+ * closed, which is all Prometheus and curl need.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "metrics.h"
+#include "serialize.h"
+#include "utils.h"
+
+#define METRICS_POLL_MS 200
+#define METRICS_REQUEST_MAX 4096
+
+typedef struct {
+    _Atomic uint64_t reads;
+    _Atomic uint64_t faults[READING_READ_ERROR + 1];  /* Indexed by ReadingStatus */
+    _Atomic uint64_t temp_bits;                       /* Latest good temperature (double) */
+    atomic_int has_temp;                              /* temp_bits holds a reading */
+    _Atomic uint64_t last_read_us;                    /* Wall clock of the latest read */
+} SourceMetrics;
+
+volatile int g_metrics_enabled = 0;
+
+static _Atomic uint64_t g_counters[METRIC_COUNTER_COUNT];
+static SourceMetrics *g_source_metrics = NULL;
+static const ThermalSource *g_sources = NULL;
+static int g_source_count = 0;
+static time_t g_start_time = 0;
+
+static int g_listen_fd = -1;
+static char g_unix_path[108];
+static pthread_t g_server;
+static atomic_int g_stop = 0;
+
+/* ============================================================================
+ * Updates
+ * ============================================================================ */
+
+void metrics_add_counter(MetricCounter counter, uint64_t n) {
+    atomic_fetch_add_explicit(&g_counters[counter], n, memory_order_relaxed);
+}
+
+void metrics_source_read(int index, double temp, ReadingStatus status) {
+    if (index < 0 || index >= g_source_count) return;
+    SourceMetrics *m = &g_source_metrics[index];
+    
+    atomic_fetch_add_explicit(&m->reads, 1, memory_order_relaxed);
+    if (status != READING_OK) {
+        atomic_fetch_add_explicit(&m->faults[status], 1, memory_order_relaxed);
+    } else if (!isnan(temp)) {
+        uint64_t bits;
+        memcpy(&bits, &temp, sizeof(bits));
+        atomic_store_explicit(&m->temp_bits, bits, memory_order_relaxed);
+        atomic_store_explicit(&m->has_temp, 1, memory_order_release);
+    }
+    atomic_store_explicit(&m->last_read_us, (uint64_t)time_now_us(), memory_order_relaxed);
+}
+
+/* ============================================================================
+ * Exposition
+ * ============================================================================ */
+
+/* Label value with \, " and newline escaped */
+static void append_label(ByteBuffer *out, const char *value) {
+    for (const char *p = value; *p; p++) {
+        if (*p == '\\' || *p == '"') {
+            byte_buffer_printf(out, "\\%c", *p);
+        } else if (*p == '\n') {
+            byte_buffer_append(out, "\\n", 2);
+        } else {
+            byte_buffer_append(out, p, 1);
+        }
+    }
+}
+
+static void append_source_labels(ByteBuffer *out, const ThermalSource *src) {
+    byte_buffer_append(out, "{source=\"", 9);
+    append_label(out, src->key);
+    byte_buffer_printf(out, "\",address=\"%d\",channel=\"%d\"", src->address, src->channel);
+}
+
+static void append_header(ByteBuffer *out, const char *name, const char *type, const char *help) {
+    byte_buffer_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void append_counter(ByteBuffer *out, const char *name, const char *help, MetricCounter counter) {
+    append_header(out, name, "counter", help);
+    byte_buffer_printf(out, "%s %llu\n", name,
+                       (unsigned long long)atomic_load_explicit(&g_counters[counter], memory_order_relaxed));
+}
+
+static void metrics_render(ByteBuffer *out) {
+    append_header(out, "thermo_start_time_seconds", "gauge", "Unix time the exporter started");
+    byte_buffer_printf(out, "thermo_start_time_seconds %lld\n", (long long)g_start_time);
+    
+    append_counter(out, "thermo_ticks_total", "Acquisition periods run", METRIC_TICKS);
+    append_counter(out, "thermo_loop_overruns_total", "Acquisition periods that missed their deadline",
+                   METRIC_OVERRUNS);
+    append_counter(out, "thermo_records_in_total", "Producer lines read", METRIC_RECORDS_IN);
+    append_counter(out, "thermo_records_written_total", "Records written to the sinks",
+                   METRIC_RECORDS_WRITTEN);
+    append_counter(out, "thermo_records_dropped_total", "Records dropped by the output policy",
+                   METRIC_RECORDS_DROPPED);
+    
+    append_header(out, "thermo_reads_total", "counter", "Channel reads");
+    for (int i = 0; i < g_source_count; i++) {
+        byte_buffer_append(out, "thermo_reads_total", 18);
+        append_source_labels(out, &g_sources[i]);
+        byte_buffer_printf(out, "} %llu\n",
+                           (unsigned long long)atomic_load_explicit(&g_source_metrics[i].reads,
+                                                                    memory_order_relaxed));
+    }
+    
+    append_header(out, "thermo_read_faults_total", "counter", "Channel reads that returned a fault, by status");
+    for (int i = 0; i < g_source_count; i++) {
+        for (int s = READING_OPEN; s <= READING_READ_ERROR; s++) {
+            byte_buffer_append(out, "thermo_read_faults_total", 24);
+            append_source_labels(out, &g_sources[i]);
+            byte_buffer_printf(out, ",status=\"%s\"} %llu\n", thermo_status_name((ReadingStatus)s),
+                               (unsigned long long)atomic_load_explicit(&g_source_metrics[i].faults[s],
+                                                                        memory_order_relaxed));
+        }
+    }
+    
+    append_header(out, "thermo_temperature_celsius", "gauge", "Latest good temperature reading");
+    for (int i = 0; i < g_source_count; i++) {
+        if (!atomic_load_explicit(&g_source_metrics[i].has_temp, memory_order_acquire)) continue;
+        uint64_t bits = atomic_load_explicit(&g_source_metrics[i].temp_bits, memory_order_relaxed);
+        double temp;
+        memcpy(&temp, &bits, sizeof(temp));
+        byte_buffer_append(out, "thermo_temperature_celsius", 26);
+        append_source_labels(out, &g_sources[i]);
+        byte_buffer_printf(out, "} %.6f\n", temp);
+    }
+    
+    append_header(out, "thermo_last_read_timestamp_seconds", "gauge", "Unix time of the latest channel read");
+    for (int i = 0; i < g_source_count; i++) {
+        uint64_t us = atomic_load_explicit(&g_source_metrics[i].last_read_us, memory_order_relaxed);
+        if (us == 0) continue;
+        byte_buffer_append(out, "thermo_last_read_timestamp_seconds", 34);
+        append_source_labels(out, &g_sources[i]);
+        byte_buffer_printf(out, "} %.3f\n", (double)us / 1e6);
+    }
+}
+
+/* ============================================================================
+ * Server
+ * ============================================================================ */
+
+static void send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+/* Read the request head and answer it; any path but /metrics (or /) is 404 */
+static void metrics_serve(int fd, ByteBuffer *body, ByteBuffer *response) {
+    char request[METRICS_REQUEST_MAX];
+    size_t len = 0;
+    struct timeval timeout = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    
+    while (len < sizeof(request) - 1) {
+        ssize_t n = recv(fd, request + len, sizeof(request) - 1 - len, 0);
+        if (n <= 0) break;
+        len += (size_t)n;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) break;
+    }
+    request[len] = '\0';
+    
+    char method[16] = "", path[256] = "";
+    sscanf(request, "%15s %255s", method, path);
+    char *query = strchr(path, '?');
+    if (query) *query = '\0';
+    
+    byte_buffer_reset(body);
+    byte_buffer_reset(response);
+    if (strcmp(path, "/metrics") != 0 && strcmp(path, "/") != 0) {
+        byte_buffer_printf(response, "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\n"
+                                     "Content-Length: 10\r\nConnection: close\r\n\r\nNot Found\n");
+    } else {
+        metrics_render(body);
+        byte_buffer_printf(response, "HTTP/1.0 200 OK\r\n"
+                                     "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                     "Content-Length: %zu\r\nConnection: close\r\n\r\n", body->len);
+        if (strcmp(method, "HEAD") != 0) {
+            byte_buffer_append(response, body->data, body->len);
+        }
+    }
+    send_all(fd, (const char*)response->data, response->len);
+}
+
+static void* metrics_server_main(void *arg) {
+    (void)arg;
+    ByteBuffer body = {0}, response = {0};
+    struct pollfd pfd = {.fd = g_listen_fd, .events = POLLIN};
+    
+    while (!atomic_load(&g_stop)) {
+        if (poll(&pfd, 1, METRICS_POLL_MS) <= 0) continue;
+        int fd = accept(g_listen_fd, NULL, NULL);
+        if (fd == -1) continue;
+        metrics_serve(fd, &body, &response);
+        close(fd);
+    }
+    
+    byte_buffer_free(&body);
+    byte_buffer_free(&response);
+    return NULL;
+}
+
+/* Bind and listen on the endpoint; returns the socket or -1 */
+static int metrics_listen(const char *endpoint) {
+    int fd = -1;
+    
+    if (strncmp(endpoint, "unix:", 5) == 0) {
+        const char *path = endpoint + 5;
+        struct sockaddr_un addr;
+        if (*path == '\0' || strlen(path) >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "Error: Invalid metrics socket path '%s'\n", path);
+            return -1;
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+    
+        /* A socket left by a previous run would make bind fail; one a
+         * running exporter still answers on is not ours to take over */
+        struct stat st;
+        if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+            int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            int live = probe != -1 && connect(probe, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+            if (probe != -1) close(probe);
+            if (live) {
+                fprintf(stderr, "Error: Metrics socket '%s' is in use by another process\n", path);
+                return -1;
+            }
+            unlink(path);
+        }
+    
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd != -1 && (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(fd, 8) == -1)) {
+            close(fd);
+            fd = -1;
+        }
+        if (fd != -1) {
+            snprintf(g_unix_path, sizeof(g_unix_path), "%s", path);
+        }
+    } else if (strncmp(endpoint, "tcp:", 4) == 0) {
+        char host[256];
+        snprintf(host, sizeof(host), "%s", endpoint + 4);
+        char *port = strrchr(host, ':');
+        const char *node = "127.0.0.1";
+        if (port) {
+            *port++ = '\0';
+            node = host;
+        } else {
+            port = host;
+        }
+    
+        struct addrinfo hints = {0}, *res = NULL;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(node, port, &hints, &res) != 0) {
+            fprintf(stderr, "Error: Cannot resolve metrics address '%s'\n", endpoint + 4);
+            return -1;
+        }
+        for (struct addrinfo *ai = res; ai && fd == -1; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd == -1) continue;
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) == -1 || listen(fd, 8) == -1) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(res);
+    } else {
+        fprintf(stderr, "Error: --metrics must be unix:PATH or tcp:[HOST:]PORT\n");
+        return -1;
+    }
+    
+    if (fd == -1) {
+        fprintf(stderr, "Error: Cannot listen for metrics on %s: %s\n", endpoint, strerror(errno));
+    }
+    return fd;
+}
+
+int metrics_start(const char *endpoint, const ThermalSource *sources, int source_count) {
+    g_source_metrics = calloc(source_count > 0 ? source_count : 1, sizeof(SourceMetrics));
+    if (!g_source_metrics) {
+        fprintf(stderr, "Error: Failed to allocate memory\n");
+        return THERMO_ERROR;
+    }
+    g_sources = sources;
+    g_source_count = source_count;
+    g_start_time = time(NULL);
+    
+    g_listen_fd = metrics_listen(endpoint);
+    if (g_listen_fd == -1) {
+        free(g_source_metrics);
+        g_source_metrics = NULL;
+        return THERMO_IO_ERROR;
+    }
+    
+    /* Signals stay with the acquisition thread, as for the output writer */
+    sigset_t block_all, old_mask;
+    sigfillset(&block_all);
+    pthread_sigmask(SIG_BLOCK, &block_all, &old_mask);
+    int rc = pthread_create(&g_server, NULL, metrics_server_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    
+    if (rc != 0) {
+        fprintf(stderr, "Error: Failed to start metrics thread\n");
+        metrics_stop();
+        return THERMO_ERROR;
+    }
+    
+    DEBUG_PRINT("Serving metrics on %s", endpoint);
+    g_metrics_enabled = 1;
+    return THERMO_SUCCESS;
+}
+
+void metrics_stop(void) {
+    if (g_metrics_enabled) {
+        g_metrics_enabled = 0;
+        atomic_store(&g_stop, 1);
+        pthread_join(g_server, NULL);
+    }
+    if (g_listen_fd != -1) {
+        close(g_listen_fd);
+        g_listen_fd = -1;
+    }
+    if (g_unix_path[0]) {
+        unlink(g_unix_path);
+        g_unix_path[0] = '\0';
+    }
+    free(g_source_metrics);
+    g_source_metrics = NULL;
+    g_source_count = 0;
+}
@@ -0,0 +1,295 @@
+/*
+ * Output queue implementation.
+ * Ring buffer of pending records guarded by a mutex; a dedicated writer
+ * thread serializes and writes them so acquisition timing never depends
+ * on consumer speed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "output_queue.h"
+#include "signals.h"
+#include "hardware.h"
+#include "metrics.h"
+#include "utils.h"
+
+/* One pending record: either a JSON object or a raw text line */
+typedef struct {
+    cJSON *json;
+    char *line;
+    int64_t timestamp_us;
+} OutputItem;
+
+struct OutputQueue {
+    OutputItem *items;
+    int depth;
+    int head;
+    int count;
+    OutputPolicy policy;
+    SinkSet *sinks;
+    
+    uint64_t written;
+    uint64_t dropped;
+    uint64_t reported;      /* Writer: drops last sent as a {"DROPPED":n} line */
+    int closed;
+    
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    pthread_t writer;
+};
+
+static const char *POLICY_NAMES[] = {"block", "drop-oldest", "coalesce"};
+
+int output_policy_from_string(const char *str, OutputPolicy *policy) {
+    for (int i = 0; i < (int)(sizeof(POLICY_NAMES) / sizeof(POLICY_NAMES[0])); i++) {
+        if (strcmp(str, POLICY_NAMES[i]) == 0) {
+            *policy = (OutputPolicy)i;
+            return THERMO_SUCCESS;
+        }
+    }
+    return THERMO_INVALID_PARAM;
+}
+
+const char* output_policy_to_string(OutputPolicy policy) {
+    return POLICY_NAMES[policy];
+}
+
+static void output_item_free(OutputItem *item) {
+    cJSON_Delete(item->json);
+    free(item->line);
+    item->json = NULL;
+    item->line = NULL;
+}
+
+/* Serialize and write one item (writer thread, queue unlocked) */
+static void output_item_write(OutputQueue *queue, OutputItem *item, uint64_t dropped) {
+    /* Expose drop counter in object records once anything was lost; array
+     * records (several sources) are preceded by it as a record of its own
+     * whenever it has grown */
+    if (item->json && cJSON_IsObject(item->json)) {
+        if (dropped > 0) {
+            cJSON_AddNumberToObject(item->json, "DROPPED", (double)dropped);
+        }
+    } else if (item->json && dropped > queue->reported) {
+        char line[48];
+        snprintf(line, sizeof(line), "{\"DROPPED\":%llu}", (unsigned long long)dropped);
+        sink_set_write_line(queue->sinks, line);
+        queue->reported = dropped;
+    }
+    
+    if (item->json) {
+        sink_set_write_json(queue->sinks, item->json, item->timestamp_us);
+    } else if (item->line) {
+        sink_set_write_line(queue->sinks, item->line);
+    }
+}
+
+/* Writer thread: pop records in order until closed and drained */
+static void* output_writer_main(void *arg) {
+    OutputQueue *queue = (OutputQueue*)arg;
+    trace_thread_register("writer");
+    
+    /* Sinks have deadlines of their own (fsync age, rollup intervals) that
+     * must not wait for the next record */
+    int64_t tick_us = -1;
+    
+    pthread_mutex_lock(&queue->lock);
+    for (;;) {
+        while (queue->count == 0 && !queue->closed) {
+            if (tick_us < 0) {
+                pthread_cond_wait(&queue->not_empty, &queue->lock);
+            } else if (time_mono_us() >= tick_us) {
+                pthread_mutex_unlock(&queue->lock);
+                tick_us = sink_set_tick(queue->sinks);
+                pthread_mutex_lock(&queue->lock);
+            } else {
+                struct timespec deadline = { (time_t)(tick_us / 1000000), (long)(tick_us % 1000000) * 1000 };
+                pthread_cond_timedwait(&queue->not_empty, &queue->lock, &deadline);
+            }
+        }
+        if (queue->count == 0 && queue->closed) {
+            break;
+        }
+        
+        OutputItem item = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->depth;
+        queue->count--;
+        uint64_t dropped = queue->dropped;
+        pthread_cond_signal(&queue->not_full);
+        pthread_mutex_unlock(&queue->lock);
+        
+        output_item_write(queue, &item, dropped);
+        output_item_free(&item);
+        tick_us = sink_set_tick(queue->sinks);
+        
+        pthread_mutex_lock(&queue->lock);
+        queue->written++;
+        metrics_add(METRIC_RECORDS_WRITTEN, 1);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    
+    return NULL;
+}
+
+/* Create queue and start its writer thread */
+OutputQueue* output_queue_create(int depth, OutputPolicy policy, SinkSet *sinks) {
+    if (depth < 1) {
+        depth = OUTPUT_QUEUE_DEFAULT_DEPTH;
+    }
+    
+    OutputQueue *queue = (OutputQueue*)calloc(1, sizeof(OutputQueue));
+    if (!queue) {
+        return NULL;
+    }
+    queue->items = (OutputItem*)calloc(depth, sizeof(OutputItem));
+    if (!queue->items) {
+        free(queue);
+        return NULL;
+    }
+    queue->depth = depth;
+    queue->policy = policy;
+    queue->sinks = sinks;
+    
+    /* The writer's timed waits are against time_mono_us() deadlines */
+    pthread_condattr_t mono;
+    pthread_condattr_init(&mono);
+    pthread_condattr_setclock(&mono, CLOCK_MONOTONIC);
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, &mono);
+    pthread_cond_init(&queue->not_full, NULL);
+    pthread_condattr_destroy(&mono);
+    
+    /* Keep SIGINT/SIGTERM on the acquisition thread so its blocking reads are interrupted */
+    sigset_t block_all, old_mask;
+    sigfillset(&block_all);
+    pthread_sigmask(SIG_BLOCK, &block_all, &old_mask);
+    int rc = pthread_create(&queue->writer, NULL, output_writer_main, queue);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    
+    if (rc != 0) {
+        fprintf(stderr, "Error: Failed to start output writer thread\n");
+        pthread_mutex_destroy(&queue->lock);
+        pthread_cond_destroy(&queue->not_empty);
+        pthread_cond_destroy(&queue->not_full);
+        free(queue->items);
+        free(queue);
+        return NULL;
+    }
+    
+    DEBUG_PRINT("Output queue started (depth %d, policy %s)", depth, output_policy_to_string(policy));
+    return queue;
+}
+
+/* Make room for one item according to policy (queue locked). Returns 0 if item must be dropped. */
+static int output_queue_make_room(OutputQueue *queue) {
+    if (queue->count < queue->depth) {
+        return 1;
+    }
+    
+    switch (queue->policy) {
+        case OUTPUT_POLICY_BLOCK:
+            while (queue->count == queue->depth && g_running) {
+                /* Timed wait so a shutdown request is noticed while the consumer is stalled */
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_nsec += 100000000L;
+                if (deadline.tv_nsec >= 1000000000L) {
+                    deadline.tv_sec++;
+                    deadline.tv_nsec -= 1000000000L;
+                }
+                pthread_cond_timedwait(&queue->not_full, &queue->lock, &deadline);
+            }
+            return queue->count < queue->depth;
+            
+        case OUTPUT_POLICY_DROP_OLDEST:
+            output_item_free(&queue->items[queue->head]);
+            queue->head = (queue->head + 1) % queue->depth;
+            queue->count--;
+            queue->dropped++;
+            metrics_add(METRIC_RECORDS_DROPPED, 1);
+            return 1;
+            
+        case OUTPUT_POLICY_COALESCE:
+            while (queue->count > 0) {
+                output_item_free(&queue->items[queue->head]);
+                queue->head = (queue->head + 1) % queue->depth;
+                queue->count--;
+                queue->dropped++;
+                metrics_add(METRIC_RECORDS_DROPPED, 1);
+            }
+            return 1;
+    }
+    return 1;
+}
+
+static void output_queue_push(OutputQueue *queue, OutputItem *item) {
+    pthread_mutex_lock(&queue->lock);
+    
+    if (!output_queue_make_room(queue)) {
+        queue->dropped++;
+        metrics_add(METRIC_RECORDS_DROPPED, 1);
+        pthread_mutex_unlock(&queue->lock);
+        output_item_free(item);
+        return;
+    }
+    
+    int tail = (queue->head + queue->count) % queue->depth;
+    queue->items[tail] = *item;
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+void output_queue_push_json(OutputQueue *queue, cJSON *json, int64_t timestamp_us) {
+    OutputItem item = {.json = json, .line = NULL, .timestamp_us = timestamp_us};
+    output_queue_push(queue, &item);
+}
+
+void output_queue_push_line(OutputQueue *queue, const char *line) {
+    OutputItem item = {.json = NULL, .line = strdup(line), .timestamp_us = 0};
+    output_queue_push(queue, &item);
+}
+
+uint64_t output_queue_written(OutputQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    uint64_t written = queue->written;
+    pthread_mutex_unlock(&queue->lock);
+    return written;
+}
+
+uint64_t output_queue_dropped(OutputQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    uint64_t dropped = queue->dropped;
+    pthread_mutex_unlock(&queue->lock);
+    return dropped;
+}
+
+/* Drain pending records, stop the writer thread and free the queue */
+void output_queue_close(OutputQueue *queue) {
+    if (!queue) return;
+    
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = 1;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    
+    pthread_join(queue->writer, NULL);
+    
+    if (queue->dropped > 0) {
+        fprintf(stderr, "Output: %llu record%s dropped (policy: %s)\n",
+                (unsigned long long)queue->dropped, queue->dropped == 1 ? "" : "s",
+                output_policy_to_string(queue->policy));
+    }
+    
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->items);
+    free(queue);
+}
@@ -0,0 +1,397 @@
+/*
+ * Recorder implementation.
+ * The active file keeps its configured name; on rotation it is renamed to
+ * <stem>.<YYYYmmdd-HHMMSS><ext> (its open time) and a fresh file is started.
+ *
+ * Durability: sync_file_range() only starts writeback and never persists the
+ * file size, so it is used to push data out early as it accumulates; the
+ * policy cadence then ends with fdatasync(), which has little left to write.
+ *
+ * The time index and any sidecars are renamed along with their file. A
+ * file that already has records but no index (written without one) is
+ * left unindexed rather than indexed from the middle.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <libgen.h>
+
+#include "recorder.h"
+#include "hardware.h"
+#include "timeindex.h"
+#include "utils.h"
+
+/* Start writeback once this much unsynced data has accumulated */
+#define RECORDER_WRITEBACK_BYTES (256 * 1024)
+
+struct Recorder {
+    char path[256];
+    RecorderPolicy policy;
+    int fd;
+    long long size;             /* Bytes in the active file */
+    time_t opened_at;           /* Wall-clock open time of the active file */
+    int pending_flags;          /* RECORDER_* flags to report on the next begin */
+    
+    /* Sync state */
+    long long synced_size;      /* Bytes known durable */
+    long long writeback_size;   /* Bytes handed to writeback */
+    int unsynced_records;
+    int64_t first_unsynced_us;  /* time_mono_us() of the oldest unsynced record */
+    
+    /* Time index state */
+    int index_fd;               /* Opened with the file's first entry (-1 = not yet) */
+    int index_off;              /* No index for this file */
+    long long indexed_offset;   /* Last indexed record (-1 = none yet) */
+    long long header_offset;    /* Last header written */
+    
+    char sidecars[RECORDER_MAX_SIDECARS][32];   /* Suffixes renamed on rotation */
+    int sidecar_count;
+};
+
+static int recorder_syncs(const Recorder *rec) {
+    return rec->policy.fsync_records > 0 || rec->policy.fsync_ms > 0;
+}
+
+/* Make everything written so far durable */
+static void recorder_sync(Recorder *rec) {
+    if (rec->fd == -1 || rec->synced_size == rec->size) {
+        rec->unsynced_records = 0;
+        return;
+    }
+    
+    if (fdatasync(rec->fd) != 0) {
+        fprintf(stderr, "Warning: Failed to sync '%s': %s\n", rec->path, strerror(errno));
+    }
+    rec->synced_size = rec->size;
+    rec->writeback_size = rec->size;
+    rec->unsynced_records = 0;
+}
+
+/* Persist a rename by syncing the containing directory */
+static void recorder_sync_dir(const char *path) {
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s", path);
+    
+    int fd = open(dirname(dir), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd != -1) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+/* Pick up the index of a reopened file, cut back to what survived recovery */
+static void recorder_index_resume(Recorder *rec) {
+    if (rec->policy.index_chunk <= 0) {
+        rec->index_off = 1;
+        return;
+    }
+    
+    TimeIndexEntry last;
+    int kept = time_index_trim(rec->path, rec->size, &last);
+    if (kept == 1) {
+        rec->indexed_offset = last.offset;
+        rec->header_offset = last.header_offset;
+    } else if (rec->size > 0) {
+        DEBUG_PRINT("'%s' has no usable time index; appending without one", rec->path);
+        rec->index_off = 1;
+    }
+}
+
+/* Open the active file in append mode */
+static int recorder_open_active(Recorder *rec) {
+    rec->index_fd = -1;
+    rec->index_off = 0;
+    rec->indexed_offset = -1;
+    rec->header_offset = 0;
+    
+    rec->fd = open(rec->path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (rec->fd == -1) {
+        fprintf(stderr, "Error: Cannot open '%s': %s\n", rec->path, strerror(errno));
+        return THERMO_IO_ERROR;
+    }
+    
+    struct stat st;
+    rec->size = (fstat(rec->fd, &st) == 0) ? (long long)st.st_size : 0;
+    rec->synced_size = rec->size;
+    rec->writeback_size = rec->size;
+    rec->unsynced_records = 0;
+    rec->opened_at = time(NULL);
+    rec->pending_flags = RECORDER_SEGMENT_START | (rec->size == 0 ? RECORDER_SEGMENT_EMPTY : 0);
+    recorder_index_resume(rec);
+    return THERMO_SUCCESS;
+}
+
+/* Build <stem>.<stamp>[-N]<ext> for a rotated segment */
+static void recorder_segment_name(const Recorder *rec, char *out, size_t out_len, int attempt) {
+    char stamp[32];
+    struct tm tm_info;
+    localtime_r(&rec->opened_at, &tm_info);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm_info);
+    
+    const char *slash = strrchr(rec->path, '/');
+    const char *ext = strrchr(rec->path, '.');
+    if (ext && slash && ext < slash) ext = NULL;
+    int stem_len = ext ? (int)(ext - rec->path) : (int)strlen(rec->path);
+    
+    if (attempt == 0) {
+        snprintf(out, out_len, "%.*s.%s%s", stem_len, rec->path, stamp, ext ? ext : "");
+    } else {
+        snprintf(out, out_len, "%.*s.%s-%d%s", stem_len, rec->path, stamp, attempt, ext ? ext : "");
+    }
+}
+
+/* Rename <path><suffix> to <segment><suffix>, if there is one */
+static void recorder_rotate_sidecar(const Recorder *rec, const char *segment, const char *suffix) {
+    char from[300], to[340];
+    snprintf(from, sizeof(from), "%s%s", rec->path, suffix);
+    snprintf(to, sizeof(to), "%s%s", segment, suffix);
+    if (rename(from, to) != 0 && errno != ENOENT) {
+        fprintf(stderr, "Warning: Failed to rotate '%s': %s\n", from, strerror(errno));
+    }
+}
+
+/* Close and rename the active file, then start a new one */
+static int recorder_rotate(Recorder *rec) {
+    if (recorder_syncs(rec)) {
+        recorder_sync(rec);
+    }
+    close(rec->fd);
+    rec->fd = -1;
+    if (rec->index_fd != -1) {
+        close(rec->index_fd);
+        rec->index_fd = -1;
+    }
+    
+    char segment[300];
+    for (int attempt = 0; attempt < 100; attempt++) {
+        recorder_segment_name(rec, segment, sizeof(segment), attempt);
+        if (access(segment, F_OK) != 0) break;
+    }
+    
+    int rotated = (rename(rec->path, segment) == 0);
+    if (!rotated) {
+        fprintf(stderr, "Warning: Failed to rotate '%s': %s\n", rec->path, strerror(errno));
+    } else {
+        DEBUG_PRINT("Rotated %s -> %s", rec->path, segment);
+        recorder_rotate_sidecar(rec, segment, TIME_INDEX_SUFFIX);
+        for (int i = 0; i < rec->sidecar_count; i++) {
+            recorder_rotate_sidecar(rec, segment, rec->sidecars[i]);
+        }
+        if (recorder_syncs(rec)) {
+            recorder_sync_dir(rec->path);
+        }
+    }
+    
+    int result = recorder_open_active(rec);
+    if (rotated) {
+        rec->pending_flags |= RECORDER_SEGMENT_ROTATED;
+    }
+    return result;
+}
+
+/* Truncate an existing file to its intact prefix */
+static int recorder_recover(const char *path, RecorderScanFn scan) {
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd == -1) {
+        return errno == ENOENT ? THERMO_SUCCESS : THERMO_IO_ERROR;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return THERMO_SUCCESS;
+    }
+    
+    long long valid = scan(fd, (long long)st.st_size);
+    if (valid < 0) {
+        fprintf(stderr, "Error: Cannot append to '%s': not an intact recording of this format\n", path);
+        close(fd);
+        return THERMO_INVALID_PARAM;
+    }
+    
+    int result = THERMO_SUCCESS;
+    if (valid < (long long)st.st_size) {
+        if (ftruncate(fd, (off_t)valid) != 0 || fsync(fd) != 0) {
+            fprintf(stderr, "Error: Cannot truncate '%s': %s\n", path, strerror(errno));
+            result = THERMO_IO_ERROR;
+        } else {
+            fprintf(stderr, "Recovered '%s': discarded %lld byte%s of a torn record\n",
+                    path, (long long)st.st_size - valid, (long long)st.st_size - valid == 1 ? "" : "s");
+        }
+    }
+    
+    close(fd);
+    return result;
+}
+
+long long recorder_scan_lines(int fd, long long size) {
+    /* Everything after the last newline is a torn record */
+    char buf[4096];
+    long long end = size;
+    
+    while (end > 0) {
+        long long start = end > (long long)sizeof(buf) ? end - (long long)sizeof(buf) : 0;
+        ssize_t n = pread(fd, buf, (size_t)(end - start), (off_t)start);
+        if (n <= 0) return 0;
+        for (ssize_t i = n - 1; i >= 0; i--) {
+            if (buf[i] == '\n') return start + i + 1;
+        }
+        end = start;
+    }
+    return 0;
+}
+
+Recorder* recorder_open(const char *path, const RecorderPolicy *policy, RecorderScanFn scan) {
+    if (scan && recorder_recover(path, scan) != THERMO_SUCCESS) {
+        return NULL;
+    }
+    
+    Recorder *rec = (Recorder*)calloc(1, sizeof(Recorder));
+    if (!rec) return NULL;
+    
+    snprintf(rec->path, sizeof(rec->path), "%s", path);
+    if (policy) rec->policy = *policy;
+    
+    if (recorder_open_active(rec) != THERMO_SUCCESS) {
+        free(rec);
+        return NULL;
+    }
+    return rec;
+}
+
+int recorder_add_sidecar(Recorder *rec, const char *suffix) {
+    if (rec->sidecar_count >= RECORDER_MAX_SIDECARS || strlen(suffix) >= sizeof(rec->sidecars[0])) {
+        return THERMO_INVALID_PARAM;
+    }
+    snprintf(rec->sidecars[rec->sidecar_count++], sizeof(rec->sidecars[0]), "%s", suffix);
+    return THERMO_SUCCESS;
+}
+
+int recorder_begin(Recorder *rec, size_t len) {
+    if (rec->fd == -1 && recorder_open_active(rec) != THERMO_SUCCESS) {
+        return -1;
+    }
+    
+    /* Only rotate non-empty files so an oversized record can't rotate forever */
+    int too_big = rec->policy.rotate_bytes > 0 &&
+                  rec->size + (long long)len > rec->policy.rotate_bytes;
+    int too_old = rec->policy.rotate_seconds > 0 &&
+                  time(NULL) - rec->opened_at >= rec->policy.rotate_seconds;
+    if (rec->size > 0 && (too_big || too_old)) {
+        if (recorder_rotate(rec) != THERMO_SUCCESS) {
+            return -1;
+        }
+    }
+    
+    int flags = rec->pending_flags;
+    rec->pending_flags = 0;
+    return flags;
+}
+
+int recorder_write(Recorder *rec, const void *data, size_t len) {
+    const char *p = (const char*)data;
+    while (len > 0) {
+        ssize_t n = write(rec->fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return THERMO_IO_ERROR;
+        }
+        p += n;
+        len -= (size_t)n;
+        rec->size += n;
+    }
+    return THERMO_SUCCESS;
+}
+
+void recorder_mark_header(Recorder *rec) {
+    rec->header_offset = rec->size;
+}
+
+void recorder_index(Recorder *rec, int64_t timestamp_us) {
+    if (rec->index_off || rec->fd == -1) return;
+    if (rec->indexed_offset >= 0 && rec->size - rec->indexed_offset < rec->policy.index_chunk) return;
+    
+    if (rec->index_fd == -1) {
+        char path[300];
+        time_index_path(path, sizeof(path), rec->path);
+        rec->index_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        struct stat st;
+        if (rec->index_fd != -1 && fstat(rec->index_fd, &st) == 0 && st.st_size == 0 &&
+            write(rec->index_fd, TIME_INDEX_MAGIC, TIME_INDEX_MAGIC_LEN) != TIME_INDEX_MAGIC_LEN) {
+            close(rec->index_fd);
+            rec->index_fd = -1;
+        }
+        if (rec->index_fd == -1) {
+            fprintf(stderr, "Warning: Cannot write time index '%s': %s\n", path, strerror(errno));
+            rec->index_off = 1;
+            return;
+        }
+    }
+    
+    /* A short write leaves a torn entry that readers ignore; stop appending after it */
+    TimeIndexEntry entry = { timestamp_us, rec->size, rec->header_offset };
+    if (write(rec->index_fd, &entry, sizeof(entry)) != (ssize_t)sizeof(entry)) {
+        fprintf(stderr, "Warning: Failed to write time index of '%s'\n", rec->path);
+        rec->index_off = 1;
+        return;
+    }
+    rec->indexed_offset = rec->size;
+}
+
+void recorder_commit(Recorder *rec) {
+    if (rec->fd == -1 || !recorder_syncs(rec)) return;
+    
+    int64_t now_us = time_mono_us();
+    if (rec->unsynced_records++ == 0) {
+        rec->first_unsynced_us = now_us;
+    }
+    
+    int due = rec->policy.fsync_records > 0 && rec->unsynced_records >= rec->policy.fsync_records;
+    if (!due && rec->policy.fsync_ms > 0) {
+        due = now_us - rec->first_unsynced_us >= rec->policy.fsync_ms * 1000LL;
+    }
+    
+    if (due) {
+        recorder_sync(rec);
+        return;
+    }
+    
+#ifdef SYNC_FILE_RANGE_WRITE
+    /* Start writeback without waiting so the next sync is short */
+    if (rec->size - rec->writeback_size >= RECORDER_WRITEBACK_BYTES) {
+        sync_file_range(rec->fd, rec->writeback_size, rec->size - rec->writeback_size,
+                        SYNC_FILE_RANGE_WRITE);
+        rec->writeback_size = rec->size;
+    }
+#endif
+}
+
+/* The age limit also runs out while no record commits */
+int64_t recorder_sync_due(Recorder *rec, int64_t now_us) {
+    if (rec->fd == -1 || rec->unsynced_records == 0 || rec->policy.fsync_ms <= 0) return -1;
+    
+    int64_t due_us = rec->first_unsynced_us + rec->policy.fsync_ms * 1000LL;
+    if (now_us < due_us) return due_us;
+    recorder_sync(rec);
+    return -1;
+}
+
+void recorder_close(Recorder *rec) {
+    if (!rec) return;
+    if (rec->fd != -1) {
+        if (recorder_syncs(rec)) {
+            recorder_sync(rec);
+        }
+        close(rec->fd);
+    }
+    if (rec->index_fd != -1) {
+        close(rec->index_fd);
+    }
+    free(rec);
+}
@@ -0,0 +1,231 @@
+/*
+ * Recording reader implementation.
+ * Binary recordings start with the magic; anything else is read as CSV,
+ * whose header row must start with TIME. CSV cells are parsed in place:
+ * quoted cells become strings, empty cells are absent.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "recording.h"
+#include "hardware.h"
+
+/* Split a CSV line in place; quoted fields are unquoted. Returns field count. */
+static int csv_split_in_place(char *line, char **fields, uint8_t *quoted, int max_fields) {
+    int count = 0;
+    char *p = line;
+    
+    while (count < max_fields) {
+        char *out = p;
+        fields[count] = p;
+        quoted[count] = (*p == '"');
+        if (quoted[count]) {
+            for (p++; *p; ) {
+                if (*p == '"' && p[1] == '"') {
+                    *out++ = '"';
+                    p += 2;
+                } else if (*p == '"') {
+                    p++;
+                    break;
+                } else {
+                    *out++ = *p++;
+                }
+            }
+            while (*p && *p != ',') p++;
+        } else {
+            while (*p && *p != ',') *out++ = *p++;
+        }
+        char separator = *p;
+        *out = '\0';
+        count++;
+        if (separator != ',') break;
+        p++;
+    }
+    return count;
+}
+
+/* "SECONDS.MICROS" as written by the CSV sink, without a round trip through a double */
+static int parse_time_us(const char *str, int64_t *timestamp_us) {
+    char *end = NULL;
+    long long sec = strtoll(str, &end, 10);
+    if (end == str) return THERMO_INVALID_PARAM;
+    
+    int64_t usec = 0;
+    if (*end == '.') {
+        int digits = 0;
+        for (end++; *end >= '0' && *end <= '9'; end++) {
+            if (digits++ < 6) usec = usec * 10 + (*end - '0');
+        }
+        for (; digits < 6; digits++) usec *= 10;
+    }
+    if (*end != '\0') return THERMO_INVALID_PARAM;
+    
+    *timestamp_us = (int64_t)sec * 1000000 + usec;
+    return THERMO_SUCCESS;
+}
+
+/* Read a line, dropping its line ending. Returns its length, or -1 at end of file. */
+static ssize_t read_line(RecordingReader *rd) {
+    ssize_t len = getline(&rd->line, &rd->line_cap, rd->fp);
+    if (len <= 0) return -1;
+    rd->csv_offset += len;
+    while (len > 0 && (rd->line[len - 1] == '\n' || rd->line[len - 1] == '\r')) {
+        rd->line[--len] = '\0';
+    }
+    return len;
+}
+
+static void reader_close_file(RecordingReader *rd) {
+    if (!rd->fp) return;
+    if (rd->binary) {
+        tcr_reader_close(&rd->tcr);
+    }
+    fclose(rd->fp);
+    rd->fp = NULL;
+}
+
+static int reader_open_file(RecordingReader *rd, const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open '%s'\n", path);
+        return THERMO_IO_ERROR;
+    }
+    rd->path = path;
+    rd->fp = fp;
+    rd->schema_changed = 1;
+    
+    rd->binary = (tcr_reader_open(&rd->tcr, fp) == THERMO_SUCCESS);
+    if (rd->binary) {
+        rd->schema = &rd->tcr.schema;
+        rd->record = &rd->tcr.record;
+        return THERMO_SUCCESS;
+    }
+    
+    rewind(fp);
+    rd->csv_offset = 0;
+    ssize_t len = read_line(rd);
+    int count = len > 0 ? csv_split_in_place(rd->line, rd->csv_fields, rd->csv_quoted, TCR_MAX_COLUMNS + 1) : 0;
+    if (count < 1 || strcmp(rd->csv_fields[0], "TIME") != 0) {
+        fprintf(stderr, "Error: '%s' is not a recording (CSV with a TIME column, or binary)\n", path);
+        reader_close_file(rd);
+        return THERMO_INVALID_PARAM;
+    }
+    
+    flat_record_free(&rd->csv_record);
+    record_schema_free(&rd->csv_schema);
+    for (int i = 1; i < count; i++) {
+        rd->csv_columns[i - 1] = record_schema_add(&rd->csv_schema, rd->csv_fields[i], 0);
+    }
+    rd->csv_field_count = count - 1;
+    if (flat_record_init(&rd->csv_record, &rd->csv_schema) != THERMO_SUCCESS) {
+        fprintf(stderr, "Error: Failed to allocate memory\n");
+        reader_close_file(rd);
+        return THERMO_ERROR;
+    }
+    rd->schema = &rd->csv_schema;
+    rd->record = &rd->csv_record;
+    return THERMO_SUCCESS;
+}
+
+/* Next CSV row into csv_record. Returns 1, or 0 at end of file. */
+static int reader_next_csv(RecordingReader *rd) {
+    FlatRecord *rec = &rd->csv_record;
+    
+    for (;;) {
+        long long offset = rd->csv_offset;
+        ssize_t len = read_line(rd);
+        if (len < 0) return 0;
+    
+        int count = csv_split_in_place(rd->line, rd->csv_fields, rd->csv_quoted, TCR_MAX_COLUMNS + 1);
+        if (len == 0 || parse_time_us(rd->csv_fields[0], &rec->timestamp_us) != THERMO_SUCCESS) {
+            continue;   /* Blank line or a torn final row */
+        }
+    
+        memset(rec->present, 0, rec->count);
+        for (int i = 0; i < rec->count; i++) {
+            rec->strings[i] = NULL;
+        }
+        for (int f = 1; f < count && f - 1 < rd->csv_field_count; f++) {
+            int column = rd->csv_columns[f - 1];
+            const char *cell = rd->csv_fields[f];
+            if (column < 0 || (cell[0] == '\0' && !rd->csv_quoted[f])) continue;
+            if (rd->csv_quoted[f]) {
+                rec->strings[column] = cell;
+                rec->present[column] = 1;
+                continue;
+            }
+            char *end = NULL;
+            double value = strtod(cell, &end);
+            if (*end == '\0') {
+                rec->values[column] = value;
+                rec->present[column] = 1;
+            }
+        }
+        rd->record_offset = offset;
+        return 1;
+    }
+}
+
+void recording_reader_init(RecordingReader *rd, char **paths, int path_count) {
+    memset(rd, 0, sizeof(*rd));
+    rd->paths = paths;
+    rd->path_count = path_count;
+}
+
+int recording_reader_next(RecordingReader *rd) {
+    for (;;) {
+        if (!rd->fp) {
+            if (rd->path_index >= rd->path_count) return 0;
+            int result = reader_open_file(rd, rd->paths[rd->path_index++]);
+            if (result != THERMO_SUCCESS) return result;
+        }
+    
+        int result;
+        if (rd->binary) {
+            result = tcr_reader_next(&rd->tcr);
+            if (result == 1) {
+                rd->schema_changed |= rd->tcr.schema_changed;
+                rd->record_offset = rd->tcr.record_offset;
+            } else if (result < 0) {
+                fprintf(stderr, "Error: Damaged frame in '%s'\n", rd->path);
+            }
+        } else {
+            result = reader_next_csv(rd);
+        }
+        if (result != 0) return result;
+        reader_close_file(rd);
+    }
+}
+
+int recording_reader_seek(RecordingReader *rd, long long header_offset, long long offset) {
+    if (!rd->fp) {
+        if (rd->path_index >= rd->path_count) return THERMO_INVALID_PARAM;
+        int result = reader_open_file(rd, rd->paths[rd->path_index++]);
+        if (result != THERMO_SUCCESS) return result;
+    }
+    
+    /* A CSV file has one header, read on open; a binary session's schema
+     * frame is decoded along with the record after it */
+    if (rd->binary && header_offset >= TCR_MAGIC_LEN) {
+        if (tcr_reader_seek(&rd->tcr, header_offset) != THERMO_SUCCESS ||
+            tcr_reader_next(&rd->tcr) < 0 || !rd->tcr.schema_ready) {
+            fprintf(stderr, "Error: No schema at offset %lld of '%s'\n", header_offset, rd->path);
+            return THERMO_IO_ERROR;
+        }
+        rd->schema_changed = 1;
+    }
+    
+    int result = rd->binary ? tcr_reader_seek(&rd->tcr, offset)
+                            : (fseeko(rd->fp, (off_t)offset, SEEK_SET) == 0 ? THERMO_SUCCESS : THERMO_IO_ERROR);
+    rd->csv_offset = offset;
+    return result;
+}
+
+void recording_reader_free(RecordingReader *rd) {
+    reader_close_file(rd);
+    flat_record_free(&rd->csv_record);
+    record_schema_free(&rd->csv_schema);
+    free(rd->line);
+}
@@ -0,0 +1,339 @@
+/*
+ * Rollup implementation.
+ * Each level holds the one interval it is filling. A record for a later
+ * interval closes the finest level's interval: its row is written and
+ * merged into the next level, which closes its own interval the same way
+ * when the merged one lies past it.
+ *
+ * While no record arrives, the records' clock is taken to run on from the
+ * last one at the monotonic clock's pace, and an interval it has passed
+ * is closed by the tick; a late record of it just starts another row.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "rollup.h"
+#include "hardware.h"
+#include "utils.h"
+
+typedef struct {
+    double sum;
+    double min;
+    double max;
+    long long count;
+} RollupAgg;
+
+typedef struct {
+    int64_t width_us;
+    int64_t start_us;           /* Interval being filled */
+    long long records;          /* Records in it (0 = none yet) */
+    RollupAgg *aggs;            /* Per rolled-up column */
+    Recorder *recorder;         /* Level file, opened with its first row */
+    int failed;                 /* Level file can't be opened: rows are dropped */
+    char path[320];
+} RollupLevel;
+
+struct Rollup {
+    RecorderPolicy policy;      /* Sync cadence of the level files */
+    RollupLevel levels[ROLLUP_MAX_LEVELS];
+    int level_count;
+    
+    /* Columns, chosen from the first record's schema */
+    int ready;
+    int *columns;               /* Schema column of each rolled-up column */
+    uint8_t *temperature;       /* Column holds temperatures: fault codes are skipped */
+    int column_count;
+    ByteBuffer header;
+    ByteBuffer row;
+    
+    /* Clock of the last record, for closing intervals while none arrive */
+    int64_t last_record_us;
+    int64_t last_add_mono_us;
+};
+
+/* ============================================================================
+ * Levels
+ * ============================================================================ */
+
+static const struct {
+    const char *suffix;
+    int64_t us;
+} width_units[] = {
+    {"d", 86400000000LL}, {"h", 3600000000LL}, {"m", 60000000LL}, {"s", 1000000LL}, {"ms", 1000LL}
+};
+
+#define WIDTH_UNIT_COUNT (int)(sizeof(width_units) / sizeof(width_units[0]))
+
+int rollup_parse_width(const char *str, int64_t *width_us) {
+    char *end = NULL;
+    long long n = strtoll(str, &end, 10);
+    if (end == str || n <= 0 || str[0] == '+') return THERMO_INVALID_PARAM;
+    
+    for (int u = 0; u < WIDTH_UNIT_COUNT; u++) {
+        if (strcmp(end, width_units[u].suffix) == 0 && n <= INT64_MAX / width_units[u].us) {
+            *width_us = n * width_units[u].us;
+            return THERMO_SUCCESS;
+        }
+    }
+    return THERMO_INVALID_PARAM;
+}
+
+/* Largest unit the width is a whole number of */
+void rollup_format_width(int64_t width_us, char *out, size_t out_len) {
+    for (int u = 0; u < WIDTH_UNIT_COUNT; u++) {
+        if (width_us % width_units[u].us == 0) {
+            snprintf(out, out_len, "%lld%s", (long long)(width_us / width_units[u].us), width_units[u].suffix);
+            return;
+        }
+    }
+    snprintf(out, out_len, "%lldus", (long long)width_us);
+}
+
+int rollup_levels_parse(const char *str, RollupLevels *levels) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s", str);
+    memset(levels, 0, sizeof(*levels));
+    if (strcmp(buf, "off") == 0) return THERMO_SUCCESS;
+    
+    char *saveptr = NULL;
+    for (char *tok = strtok_r(buf, ":", &saveptr); tok; tok = strtok_r(NULL, ":", &saveptr)) {
+        int64_t width_us;
+        if (levels->count >= ROLLUP_MAX_LEVELS || rollup_parse_width(tok, &width_us) != THERMO_SUCCESS) {
+            return THERMO_INVALID_PARAM;
+        }
+        if (levels->count > 0) {
+            int64_t finer_us = levels->width_us[levels->count - 1];
+            if (width_us <= finer_us || width_us % finer_us != 0) return THERMO_INVALID_PARAM;
+        }
+        levels->width_us[levels->count++] = width_us;
+    }
+    return levels->count > 0 ? THERMO_SUCCESS : THERMO_INVALID_PARAM;
+}
+
+void rollup_suffix(char *out, size_t out_len, int64_t width_us) {
+    char width[32];
+    rollup_format_width(width_us, width, sizeof(width));
+    snprintf(out, out_len, "%s%s", ROLLUP_SUFFIX, width);
+}
+
+void rollup_path(char *out, size_t out_len, const char *path, int64_t width_us) {
+    char suffix[64];
+    rollup_suffix(suffix, sizeof(suffix), width_us);
+    snprintf(out, out_len, "%s%s", path, suffix);
+}
+
+static int64_t floor_div(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+/* ============================================================================
+ * Rows
+ * ============================================================================ */
+
+/* Numeric value columns of the schema */
+static int rollup_choose_columns(Rollup *rollup, const RecordSchema *schema) {
+    int n = schema->count > 0 ? schema->count : 1;
+    rollup->columns = (int*)calloc((size_t)n, sizeof(int));
+    rollup->temperature = (uint8_t*)calloc((size_t)n, 1);
+    if (!rollup->columns || !rollup->temperature) return THERMO_ERROR;
+    
+    byte_buffer_append(&rollup->header, "TIME,RECORDS", 12);
+    for (int s = 0; s < schema->count; s++) {
+        const char *name = schema->names[s];
+        if (schema->is_string[s] || !record_column_is_value(name)) continue;
+        rollup->columns[rollup->column_count] = s;
+        rollup->temperature[rollup->column_count] = record_column_is_temperature(name);
+        rollup->column_count++;
+        byte_buffer_printf(&rollup->header, ",%s_MEAN,%s_MIN,%s_MAX,%s_COUNT", name, name, name, name);
+    }
+    byte_buffer_append(&rollup->header, "\n", 1);
+    
+    for (int l = 0; l < rollup->level_count; l++) {
+        RollupLevel *level = &rollup->levels[l];
+        level->aggs = (RollupAgg*)calloc((size_t)(rollup->column_count > 0 ? rollup->column_count : 1),
+                                         sizeof(RollupAgg));
+        if (!level->aggs) return THERMO_ERROR;
+    }
+    return THERMO_SUCCESS;
+}
+
+/* Append the level's interval to its file, with the header if the file is new */
+static void level_write(Rollup *rollup, RollupLevel *level) {
+    if (level->failed) return;
+    if (!level->recorder) {
+        level->recorder = recorder_open(level->path, &rollup->policy, recorder_scan_lines);
+        if (!level->recorder) {
+            level->failed = 1;
+            return;
+        }
+    }
+    
+    ByteBuffer *row = &rollup->row;
+    byte_buffer_reset(row);
+    int64_t sec = floor_div(level->start_us, 1000000);
+    byte_buffer_printf(row, "%lld.%06lld,%lld", (long long)sec, (long long)(level->start_us - sec * 1000000),
+                       level->records);
+    for (int c = 0; c < rollup->column_count; c++) {
+        const RollupAgg *agg = &level->aggs[c];
+        if (agg->count == 0) {
+            byte_buffer_append(row, ",,,,0", 5);
+        } else {
+            byte_buffer_printf(row, ",%.15g,%.15g,%.15g,%lld", agg->sum / agg->count, agg->min, agg->max, agg->count);
+        }
+    }
+    byte_buffer_append(row, "\n", 1);
+    
+    int flags = recorder_begin(level->recorder, row->len);
+    if (flags < 0) return;
+    if (flags & RECORDER_SEGMENT_EMPTY) {
+        recorder_write(level->recorder, rollup->header.data, rollup->header.len);
+    }
+    recorder_write(level->recorder, row->data, row->len);
+    recorder_commit(level->recorder);
+}
+
+static void level_merge(Rollup *rollup, int l, int64_t start_us, long long records, const RollupAgg *aggs);
+
+/* Write level l's interval and pass it up to the next level */
+static void level_close(Rollup *rollup, int l) {
+    RollupLevel *level = &rollup->levels[l];
+    if (level->records == 0) return;
+    
+    level_write(rollup, level);
+    if (l + 1 < rollup->level_count) {
+        level_merge(rollup, l + 1, level->start_us, level->records, level->aggs);
+    }
+    level->records = 0;
+    memset(level->aggs, 0, (size_t)rollup->column_count * sizeof(RollupAgg));
+}
+
+/* Add a closed interval of the level below to level l */
+static void level_merge(Rollup *rollup, int l, int64_t start_us, long long records, const RollupAgg *aggs) {
+    RollupLevel *level = &rollup->levels[l];
+    int64_t interval_us = floor_div(start_us, level->width_us) * level->width_us;
+    if (level->records > 0 && interval_us != level->start_us) {
+        level_close(rollup, l);
+    }
+    
+    level->start_us = interval_us;
+    level->records += records;
+    for (int c = 0; c < rollup->column_count; c++) {
+        const RollupAgg *from = &aggs[c];
+        RollupAgg *agg = &level->aggs[c];
+        if (from->count == 0) continue;
+        if (agg->count == 0 || from->min < agg->min) agg->min = from->min;
+        if (agg->count == 0 || from->max > agg->max) agg->max = from->max;
+        agg->sum += from->sum;
+        agg->count += from->count;
+    }
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+Rollup* rollup_open(const char *path, const RollupLevels *levels, const RecorderPolicy *policy) {
+    Rollup *rollup = (Rollup*)calloc(1, sizeof(Rollup));
+    if (!rollup) return NULL;
+    
+    /* Level files sync like the recording but never rotate on their own */
+    if (policy) {
+        rollup->policy.fsync_records = policy->fsync_records;
+        rollup->policy.fsync_ms = policy->fsync_ms;
+    }
+    rollup->level_count = levels->count;
+    for (int l = 0; l < levels->count; l++) {
+        rollup->levels[l].width_us = levels->width_us[l];
+        rollup_path(rollup->levels[l].path, sizeof(rollup->levels[l].path), path, levels->width_us[l]);
+    }
+    return rollup;
+}
+
+void rollup_add(Rollup *rollup, const RecordSchema *schema, const FlatRecord *rec) {
+    if (!rollup->ready) {
+        if (rollup_choose_columns(rollup, schema) != THERMO_SUCCESS) {
+            fprintf(stderr, "Error: Failed to allocate memory\n");
+            rollup->level_count = 0;
+        }
+        rollup->ready = 1;
+    }
+    if (rollup->level_count == 0) return;
+    
+    rollup->last_record_us = rec->timestamp_us;
+    rollup->last_add_mono_us = time_mono_us();
+    
+    RollupLevel *level = &rollup->levels[0];
+    int64_t interval_us = floor_div(rec->timestamp_us, level->width_us) * level->width_us;
+    if (level->records > 0 && interval_us != level->start_us) {
+        level_close(rollup, 0);
+    }
+    
+    level->start_us = interval_us;
+    level->records++;
+    for (int c = 0; c < rollup->column_count; c++) {
+        int s = rollup->columns[c];
+        if (s >= rec->count || !rec->present[s] || rec->strings[s]) continue;
+        double value = rec->values[s];
+        if (isnan(value) || (rollup->temperature[c] && thermo_classify_temp(value) != READING_OK)) continue;
+    
+        RollupAgg *agg = &level->aggs[c];
+        if (agg->count == 0 || value < agg->min) agg->min = value;
+        if (agg->count == 0 || value > agg->max) agg->max = value;
+        agg->sum += value;
+        agg->count++;
+    }
+}
+
+int64_t rollup_tick(Rollup *rollup, int64_t now_us) {
+    if (!rollup) return -1;
+    
+    /* Finest first, as a close may merge into the next level */
+    int64_t record_now_us = rollup->last_record_us + (now_us - rollup->last_add_mono_us);
+    int64_t next_us = -1;
+    for (int l = 0; l < rollup->level_count; l++) {
+        RollupLevel *level = &rollup->levels[l];
+        if (level->records > 0 && level->start_us + level->width_us <= record_now_us) {
+            level_close(rollup, l);
+        }
+        if (level->records > 0) {
+            int64_t due_us = rollup->last_add_mono_us + (level->start_us + level->width_us - rollup->last_record_us);
+            if (next_us < 0 || due_us < next_us) next_us = due_us;
+        }
+        if (level->recorder) {
+            int64_t sync_us = recorder_sync_due(level->recorder, now_us);
+            if (sync_us >= 0 && (next_us < 0 || sync_us < next_us)) next_us = sync_us;
+        }
+    }
+    return next_us;
+}
+
+void rollup_flush(Rollup *rollup) {
+    if (!rollup) return;
+    
+    /* Finest first: each close passes its interval up before that level closes */
+    for (int l = 0; l < rollup->level_count; l++) {
+        level_close(rollup, l);
+    }
+    for (int l = 0; l < rollup->level_count; l++) {
+        recorder_close(rollup->levels[l].recorder);
+        rollup->levels[l].recorder = NULL;
+    }
+}
+
+void rollup_close(Rollup *rollup) {
+    if (!rollup) return;
+    
+    rollup_flush(rollup);
+    for (int l = 0; l < ROLLUP_MAX_LEVELS; l++) {
+        free(rollup->levels[l].aggs);
+    }
+    free(rollup->columns);
+    free(rollup->temperature);
+    byte_buffer_free(&rollup->header);
+    byte_buffer_free(&rollup->row);
+    free(rollup);
+}
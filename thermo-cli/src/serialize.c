@@ -0,0 +1,947 @@
+/*
+ * Record serialization.
+ * Flattens JSON records once per schema and encodes CSV rows and
+ * binary recording frames from the flattened values.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "serialize.h"
+#include "hardware.h"
+
+/* ============================================================================
+ * Byte buffer
+ * ============================================================================ */
+
+void byte_buffer_reserve(ByteBuffer *buf, size_t extra) {
+    if (buf->len + extra <= buf->cap) return;
+    size_t cap = buf->cap ? buf->cap : 256;
+    while (cap < buf->len + extra) cap *= 2;
+    buf->data = (char*)realloc(buf->data, cap);
+    buf->cap = cap;
+}
+
+void byte_buffer_reset(ByteBuffer *buf) {
+    buf->len = 0;
+}
+
+void byte_buffer_append(ByteBuffer *buf, const void *data, size_t len) {
+    byte_buffer_reserve(buf, len);
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+}
+
+void byte_buffer_printf(ByteBuffer *buf, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int needed = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (needed < 0) return;
+    
+    byte_buffer_reserve(buf, (size_t)needed + 1);
+    va_start(args, fmt);
+    vsnprintf(buf->data + buf->len, (size_t)needed + 1, fmt, args);
+    va_end(args);
+    buf->len += (size_t)needed;
+}
+
+void byte_buffer_free(ByteBuffer *buf) {
+    free(buf->data);
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+}
+
+/* ============================================================================
+ * Flattening
+ * ============================================================================ */
+
+/* Leaf visitor: path is the joined column name */
+typedef void (*leaf_visitor)(void *ctx, const char *path, const cJSON *leaf);
+
+/* Walk all leaves of item, building '_'-joined paths.
+ * keyed: item is an array element already named by its "KEY" field (skip that field). */
+static void walk_leaves(const cJSON *item, int keyed, char *path, size_t path_len, size_t path_cap,
+                        leaf_visitor visit, void *ctx) {
+    if (cJSON_IsObject(item) || cJSON_IsArray(item)) {
+        int index = 0;
+        for (const cJSON *child = item->child; child; child = child->next, index++) {
+            char segment[96];
+            int child_keyed = 0;
+            
+            if (cJSON_IsArray(item)) {
+                /* Array elements named by their "KEY" field (e.g. get multi-source output) */
+                const cJSON *key_item = cJSON_GetObjectItemCaseSensitive(child, "KEY");
+                if (cJSON_IsString(key_item)) {
+                    snprintf(segment, sizeof(segment), "%s", key_item->valuestring);
+                    child_keyed = 1;
+                } else {
+                    snprintf(segment, sizeof(segment), "%d", index);
+                }
+            } else {
+                if (keyed && strcmp(child->string, "KEY") == 0) continue;
+                snprintf(segment, sizeof(segment), "%s", child->string);
+            }
+            
+            size_t seg_len = strlen(segment);
+            size_t new_len = path_len + (path_len ? 1 : 0) + seg_len;
+            if (new_len + 1 > path_cap) continue;
+            if (path_len) path[path_len] = '_';
+            memcpy(path + path_len + (path_len ? 1 : 0), segment, seg_len + 1);
+            
+            walk_leaves(child, child_keyed, path, new_len, path_cap, visit, ctx);
+            path[path_len] = '\0';
+        }
+        return;
+    }
+    
+    if (path_len > 0) {
+        visit(ctx, path, item);
+    }
+}
+
+int record_schema_add(RecordSchema *schema, const char *name, int is_string) {
+    for (int i = 0; i < schema->count; i++) {
+        if (strcmp(schema->names[i], name) == 0) return i;
+    }
+    if (schema->count >= TCR_MAX_COLUMNS) return -1;
+    
+    schema->names = (char**)realloc(schema->names, (schema->count + 1) * sizeof(char*));
+    schema->is_string = (uint8_t*)realloc(schema->is_string, schema->count + 1);
+    schema->names[schema->count] = strdup(name);
+    schema->is_string[schema->count] = is_string ? 1 : 0;
+    return schema->count++;
+}
+
+static void schema_add_leaf(void *ctx, const char *path, const cJSON *leaf) {
+    record_schema_add((RecordSchema*)ctx, path, cJSON_IsString(leaf));
+}
+
+int record_schema_build(RecordSchema *schema, const cJSON *json) {
+    schema->names = NULL;
+    schema->is_string = NULL;
+    schema->count = 0;
+    
+    char path[512] = {0};
+    walk_leaves(json, 0, path, 0, sizeof(path), schema_add_leaf, schema);
+    return THERMO_SUCCESS;
+}
+
+int record_schema_extend(RecordSchema *schema, const cJSON *json) {
+    int count = schema->count;
+    char path[512] = {0};
+    walk_leaves(json, 0, path, 0, sizeof(path), schema_add_leaf, schema);
+    return schema->count - count;
+}
+
+void record_schema_free(RecordSchema *schema) {
+    for (int i = 0; i < schema->count; i++) {
+        free(schema->names[i]);
+    }
+    free(schema->names);
+    free(schema->is_string);
+    schema->names = NULL;
+    schema->is_string = NULL;
+    schema->count = 0;
+}
+
+/* NAME is the whole name or its last '_' part */
+static int column_has_suffix(const char *name, const char *suffix) {
+    size_t len = strlen(name);
+    size_t suffix_len = strlen(suffix);
+    return len >= suffix_len && strcmp(name + len - suffix_len, suffix) == 0 &&
+           (len == suffix_len || name[len - suffix_len - 1] == '_');
+}
+
+int record_column_is_value(const char *name) {
+    return !column_has_suffix(name, "ADDRESS") && !column_has_suffix(name, "CHANNEL") &&
+           !column_has_suffix(name, "UNCHANGED");
+}
+
+int record_column_is_temperature(const char *name) {
+    return column_has_suffix(name, "TEMPERATURE") || column_has_suffix(name, "TEMP");
+}
+
+int flat_record_init(FlatRecord *rec, const RecordSchema *schema) {
+    int n = schema->count > 0 ? schema->count : 1;
+    rec->values = (double*)calloc(n, sizeof(double));
+    rec->strings = (const char**)calloc(n, sizeof(char*));
+    rec->present = (uint8_t*)calloc(n, 1);
+    rec->count = schema->count;
+    rec->timestamp_us = 0;
+    if (!rec->values || !rec->strings || !rec->present) {
+        flat_record_free(rec);
+        return THERMO_ERROR;
+    }
+    return THERMO_SUCCESS;
+}
+
+void flat_record_free(FlatRecord *rec) {
+    free(rec->values);
+    free((void*)rec->strings);
+    free(rec->present);
+    rec->values = NULL;
+    rec->strings = NULL;
+    rec->present = NULL;
+}
+
+typedef struct {
+    const RecordSchema *schema;
+    FlatRecord *rec;
+    int cursor;     /* Leaves usually arrive in schema order */
+    int unknown;    /* Leaves not in the schema */
+} FillContext;
+
+static void fill_leaf(void *ctx, const char *path, const cJSON *leaf) {
+    FillContext *fc = (FillContext*)ctx;
+    const RecordSchema *schema = fc->schema;
+    
+    int index = -1;
+    if (fc->cursor < schema->count && strcmp(schema->names[fc->cursor], path) == 0) {
+        index = fc->cursor;
+    } else {
+        for (int i = 0; i < schema->count; i++) {
+            if (strcmp(schema->names[i], path) == 0) {
+                index = i;
+                break;
+            }
+        }
+    }
+    if (index < 0) {
+        fc->unknown++;
+        return;
+    }
+    fc->cursor = index + 1;
+    
+    FlatRecord *rec = fc->rec;
+    if (schema->is_string[index]) {
+        if (cJSON_IsString(leaf)) {
+            rec->strings[index] = leaf->valuestring;
+            rec->present[index] = 1;
+        }
+    } else if (cJSON_IsNumber(leaf)) {
+        rec->values[index] = leaf->valuedouble;
+        rec->present[index] = 1;
+    } else if (cJSON_IsBool(leaf)) {
+        rec->values[index] = cJSON_IsTrue(leaf) ? 1.0 : 0.0;
+        rec->present[index] = 1;
+    }
+}
+
+int flat_record_fill(FlatRecord *rec, const RecordSchema *schema, const cJSON *json, int64_t timestamp_us) {
+    memset(rec->present, 0, schema->count);
+    rec->timestamp_us = timestamp_us;
+    
+    FillContext fc = {.schema = schema, .rec = rec, .cursor = 0, .unknown = 0};
+    char path[512] = {0};
+    walk_leaves(json, 0, path, 0, sizeof(path), fill_leaf, &fc);
+    return fc.unknown;
+}
+
+/* ============================================================================
+ * CSV encoding
+ * ============================================================================ */
+
+static void csv_append_string(ByteBuffer *out, const char *str) {
+    byte_buffer_append(out, "\"", 1);
+    for (const char *p = str; *p; p++) {
+        if (*p == '"') byte_buffer_append(out, "\"", 1);
+        byte_buffer_append(out, p, 1);
+    }
+    byte_buffer_append(out, "\"", 1);
+}
+
+void csv_encode_header(ByteBuffer *out, const RecordSchema *schema) {
+    byte_buffer_append(out, "TIME", 4);
+    for (int i = 0; i < schema->count; i++) {
+        byte_buffer_append(out, ",", 1);
+        byte_buffer_append(out, schema->names[i], strlen(schema->names[i]));
+    }
+    byte_buffer_append(out, "\n", 1);
+}
+
+int csv_format_number(char *out, size_t out_len, double value) {
+    int len = snprintf(out, out_len, "%.15g", value);
+    if (strtod(out, NULL) != value) {
+        len = snprintf(out, out_len, "%.17g", value);
+    }
+    return len;
+}
+
+/* Absent fields are empty cells */
+void csv_encode_row(ByteBuffer *out, const FlatRecord *rec) {
+    byte_buffer_printf(out, "%lld.%06lld",
+                       (long long)(rec->timestamp_us / 1000000),
+                       (long long)(rec->timestamp_us % 1000000));
+    for (int i = 0; i < rec->count; i++) {
+        byte_buffer_append(out, ",", 1);
+        if (!rec->present[i]) continue;
+        if (rec->strings[i]) {
+            csv_append_string(out, rec->strings[i]);
+        } else if (isnan(rec->values[i])) {
+            byte_buffer_append(out, "nan", 3);
+        } else {
+            char number[32];
+            byte_buffer_append(out, number, (size_t)csv_format_number(number, sizeof(number), rec->values[i]));
+        }
+    }
+    byte_buffer_append(out, "\n", 1);
+}
+
+/* ============================================================================
+ * Binary recording encoding
+ * ============================================================================ */
+
+/* CRC-32 (IEEE, reflected polynomial 0xEDB88320), one entry per byte value */
+static const uint32_t crc_table[256] = {
+    0x00000000u, 0x77073096u, 0xee0e612cu, 0x990951bau, 0x076dc419u, 0x706af48fu,
+    0xe963a535u, 0x9e6495a3u, 0x0edb8832u, 0x79dcb8a4u, 0xe0d5e91eu, 0x97d2d988u,
+    0x09b64c2bu, 0x7eb17cbdu, 0xe7b82d07u, 0x90bf1d91u, 0x1db71064u, 0x6ab020f2u,
+    0xf3b97148u, 0x84be41deu, 0x1adad47du, 0x6ddde4ebu, 0xf4d4b551u, 0x83d385c7u,
+    0x136c9856u, 0x646ba8c0u, 0xfd62f97au, 0x8a65c9ecu, 0x14015c4fu, 0x63066cd9u,
+    0xfa0f3d63u, 0x8d080df5u, 0x3b6e20c8u, 0x4c69105eu, 0xd56041e4u, 0xa2677172u,
+    0x3c03e4d1u, 0x4b04d447u, 0xd20d85fdu, 0xa50ab56bu, 0x35b5a8fau, 0x42b2986cu,
+    0xdbbbc9d6u, 0xacbcf940u, 0x32d86ce3u, 0x45df5c75u, 0xdcd60dcfu, 0xabd13d59u,
+    0x26d930acu, 0x51de003au, 0xc8d75180u, 0xbfd06116u, 0x21b4f4b5u, 0x56b3c423u,
+    0xcfba9599u, 0xb8bda50fu, 0x2802b89eu, 0x5f058808u, 0xc60cd9b2u, 0xb10be924u,
+    0x2f6f7c87u, 0x58684c11u, 0xc1611dabu, 0xb6662d3du, 0x76dc4190u, 0x01db7106u,
+    0x98d220bcu, 0xefd5102au, 0x71b18589u, 0x06b6b51fu, 0x9fbfe4a5u, 0xe8b8d433u,
+    0x7807c9a2u, 0x0f00f934u, 0x9609a88eu, 0xe10e9818u, 0x7f6a0dbbu, 0x086d3d2du,
+    0x91646c97u, 0xe6635c01u, 0x6b6b51f4u, 0x1c6c6162u, 0x856530d8u, 0xf262004eu,
+    0x6c0695edu, 0x1b01a57bu, 0x8208f4c1u, 0xf50fc457u, 0x65b0d9c6u, 0x12b7e950u,
+    0x8bbeb8eau, 0xfcb9887cu, 0x62dd1ddfu, 0x15da2d49u, 0x8cd37cf3u, 0xfbd44c65u,
+    0x4db26158u, 0x3ab551ceu, 0xa3bc0074u, 0xd4bb30e2u, 0x4adfa541u, 0x3dd895d7u,
+    0xa4d1c46du, 0xd3d6f4fbu, 0x4369e96au, 0x346ed9fcu, 0xad678846u, 0xda60b8d0u,
+    0x44042d73u, 0x33031de5u, 0xaa0a4c5fu, 0xdd0d7cc9u, 0x5005713cu, 0x270241aau,
+    0xbe0b1010u, 0xc90c2086u, 0x5768b525u, 0x206f85b3u, 0xb966d409u, 0xce61e49fu,
+    0x5edef90eu, 0x29d9c998u, 0xb0d09822u, 0xc7d7a8b4u, 0x59b33d17u, 0x2eb40d81u,
+    0xb7bd5c3bu, 0xc0ba6cadu, 0xedb88320u, 0x9abfb3b6u, 0x03b6e20cu, 0x74b1d29au,
+    0xead54739u, 0x9dd277afu, 0x04db2615u, 0x73dc1683u, 0xe3630b12u, 0x94643b84u,
+    0x0d6d6a3eu, 0x7a6a5aa8u, 0xe40ecf0bu, 0x9309ff9du, 0x0a00ae27u, 0x7d079eb1u,
+    0xf00f9344u, 0x8708a3d2u, 0x1e01f268u, 0x6906c2feu, 0xf762575du, 0x806567cbu,
+    0x196c3671u, 0x6e6b06e7u, 0xfed41b76u, 0x89d32be0u, 0x10da7a5au, 0x67dd4accu,
+    0xf9b9df6fu, 0x8ebeeff9u, 0x17b7be43u, 0x60b08ed5u, 0xd6d6a3e8u, 0xa1d1937eu,
+    0x38d8c2c4u, 0x4fdff252u, 0xd1bb67f1u, 0xa6bc5767u, 0x3fb506ddu, 0x48b2364bu,
+    0xd80d2bdau, 0xaf0a1b4cu, 0x36034af6u, 0x41047a60u, 0xdf60efc3u, 0xa867df55u,
+    0x316e8eefu, 0x4669be79u, 0xcb61b38cu, 0xbc66831au, 0x256fd2a0u, 0x5268e236u,
+    0xcc0c7795u, 0xbb0b4703u, 0x220216b9u, 0x5505262fu, 0xc5ba3bbeu, 0xb2bd0b28u,
+    0x2bb45a92u, 0x5cb36a04u, 0xc2d7ffa7u, 0xb5d0cf31u, 0x2cd99e8bu, 0x5bdeae1du,
+    0x9b64c2b0u, 0xec63f226u, 0x756aa39cu, 0x026d930au, 0x9c0906a9u, 0xeb0e363fu,
+    0x72076785u, 0x05005713u, 0x95bf4a82u, 0xe2b87a14u, 0x7bb12baeu, 0x0cb61b38u,
+    0x92d28e9bu, 0xe5d5be0du, 0x7cdcefb7u, 0x0bdbdf21u, 0x86d3d2d4u, 0xf1d4e242u,
+    0x68ddb3f8u, 0x1fda836eu, 0x81be16cdu, 0xf6b9265bu, 0x6fb077e1u, 0x18b74777u,
+    0x88085ae6u, 0xff0f6a70u, 0x66063bcau, 0x11010b5cu, 0x8f659effu, 0xf862ae69u,
+    0x616bffd3u, 0x166ccf45u, 0xa00ae278u, 0xd70dd2eeu, 0x4e048354u, 0x3903b3c2u,
+    0xa7672661u, 0xd06016f7u, 0x4969474du, 0x3e6e77dbu, 0xaed16a4au, 0xd9d65adcu,
+    0x40df0b66u, 0x37d83bf0u, 0xa9bcae53u, 0xdebb9ec5u, 0x47b2cf7fu, 0x30b5ffe9u,
+    0xbdbdf21cu, 0xcabac28au, 0x53b39330u, 0x24b4a3a6u, 0xbad03605u, 0xcdd70693u,
+    0x54de5729u, 0x23d967bfu, 0xb3667a2eu, 0xc4614ab8u, 0x5d681b02u, 0x2a6f2b94u,
+    0xb40bbe37u, 0xc30c8ea1u, 0x5a05df1bu, 0x2d02ef8du
+};
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t*)data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = crc_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/* Start a frame: reserve type + length, return offset of frame start */
+static size_t tcr_frame_begin(ByteBuffer *out, uint8_t type) {
+    size_t start = out->len;
+    uint32_t placeholder = 0;
+    byte_buffer_append(out, &type, 1);
+    byte_buffer_append(out, &placeholder, 4);
+    return start;
+}
+
+/* Finish a frame: patch length and append crc */
+static void tcr_frame_end(ByteBuffer *out, size_t start) {
+    uint32_t payload_len = (uint32_t)(out->len - start - 5);
+    memcpy(out->data + start + 1, &payload_len, 4);
+    uint32_t crc = crc32_update(0, out->data + start, out->len - start);
+    byte_buffer_append(out, &crc, 4);
+}
+
+void tcr_encode_schema(ByteBuffer *out, const RecordSchema *schema) {
+    size_t start = tcr_frame_begin(out, TCR_FRAME_SCHEMA);
+    
+    /* String columns are not stored in binary recordings */
+    uint16_t ncols = 0;
+    for (int i = 0; i < schema->count; i++) {
+        if (!schema->is_string[i]) ncols++;
+    }
+    byte_buffer_append(out, &ncols, 2);
+    
+    for (int i = 0; i < schema->count; i++) {
+        if (schema->is_string[i]) continue;
+        size_t len = strlen(schema->names[i]);
+        uint8_t name_len = len > 255 ? 255 : (uint8_t)len;
+        byte_buffer_append(out, &name_len, 1);
+        byte_buffer_append(out, schema->names[i], name_len);
+    }
+    
+    tcr_frame_end(out, start);
+}
+
+void tcr_encode_data(ByteBuffer *out, const RecordSchema *schema, const FlatRecord *rec) {
+    size_t start = tcr_frame_begin(out, TCR_FRAME_DATA);
+    
+    int64_t ts = rec->timestamp_us;
+    byte_buffer_append(out, &ts, 8);
+    
+    uint16_t ncols = 0;
+    for (int i = 0; i < schema->count; i++) {
+        if (!schema->is_string[i]) ncols++;
+    }
+    byte_buffer_append(out, &ncols, 2);
+    
+    uint8_t bitmap[TCR_MAX_COLUMNS / 8] = {0};
+    int col = 0;
+    for (int i = 0; i < schema->count; i++) {
+        if (schema->is_string[i]) continue;
+        if (rec->present[i]) bitmap[col / 8] |= (uint8_t)(1u << (col % 8));
+        col++;
+    }
+    byte_buffer_append(out, bitmap, (ncols + 7) / 8);
+    
+    for (int i = 0; i < schema->count; i++) {
+        if (!schema->is_string[i] && rec->present[i]) {
+            byte_buffer_append(out, &rec->values[i], 8);
+        }
+    }
+    
+    tcr_frame_end(out, start);
+}
+
+/* ============================================================================
+ * Compressed blocks
+ * ============================================================================ */
+
+#define TCR_BLOCK_HEADER_LEN 4      /* ncols + nrecords */
+
+/* Longest possible record: an escaped timestamp and a new window per column */
+static size_t tcr_block_record_max_bytes(int columns) {
+    return (4 + 64 + (size_t)columns * (3 + 5 + 6 + 64)) / 8 + 1;
+}
+
+/* Append the low n bits of value (n <= 64) */
+static void bits_put(TcrBlockEncoder *enc, uint64_t value, int n) {
+    if (n > 32) {
+        bits_put(enc, value >> 32, n - 32);
+        value &= 0xFFFFFFFFu;
+        n = 32;
+    }
+    enc->acc = (enc->acc << n) | (value & ((1ULL << n) - 1));
+    enc->acc_bits += n;
+    byte_buffer_reserve(&enc->bits, 5);
+    while (enc->acc_bits >= 8) {
+        enc->acc_bits -= 8;
+        enc->bits.data[enc->bits.len++] = (char)(uint8_t)(enc->acc >> enc->acc_bits);
+    }
+    enc->acc &= (1ULL << enc->acc_bits) - 1;
+}
+
+static void tcr_block_encoder_reset(TcrBlockEncoder *enc) {
+    byte_buffer_reset(&enc->bits);
+    enc->acc = 0;
+    enc->acc_bits = 0;
+    enc->records = 0;
+    memset(enc->prev, 0, (size_t)enc->columns * sizeof(uint64_t));
+    memset(enc->leading, 0, (size_t)enc->columns);
+    memset(enc->length, 0, (size_t)enc->columns);
+}
+
+int tcr_block_encoder_init(TcrBlockEncoder *enc, const RecordSchema *schema) {
+    memset(enc, 0, sizeof(*enc));
+    for (int i = 0; i < schema->count; i++) {
+        if (!schema->is_string[i]) enc->columns++;
+    }
+    
+    enc->prev = (uint64_t*)calloc((size_t)enc->columns + 1, sizeof(uint64_t));
+    enc->leading = (uint8_t*)calloc((size_t)enc->columns + 1, 1);
+    enc->length = (uint8_t*)calloc((size_t)enc->columns + 1, 1);
+    if (!enc->prev || !enc->leading || !enc->length) {
+        tcr_block_encoder_free(enc);
+        return THERMO_ERROR;
+    }
+    return THERMO_SUCCESS;
+}
+
+void tcr_block_encoder_add(TcrBlockEncoder *enc, const RecordSchema *schema, const FlatRecord *rec) {
+    int64_t ts = rec->timestamp_us;
+    
+    /* Steady sampling makes the delta-of-delta mostly a few bits of jitter */
+    if (enc->records == 0) {
+        bits_put(enc, (uint64_t)ts, 64);
+        enc->first_timestamp_us = ts;
+        enc->prev_delta_us = 0;
+    } else {
+        int64_t delta = (int64_t)((uint64_t)ts - (uint64_t)enc->prev_timestamp_us);
+        int64_t dod = (int64_t)((uint64_t)delta - (uint64_t)enc->prev_delta_us);
+        if (dod == 0) {
+            bits_put(enc, 0x0, 1);
+        } else if (dod >= -64 && dod < 64) {
+            bits_put(enc, 0x2, 2);
+            bits_put(enc, (uint64_t)dod, 7);
+        } else if (dod >= -2048 && dod < 2048) {
+            bits_put(enc, 0x6, 3);
+            bits_put(enc, (uint64_t)dod, 12);
+        } else if (dod >= -524288 && dod < 524288) {
+            bits_put(enc, 0xE, 4);
+            bits_put(enc, (uint64_t)dod, 20);
+        } else {
+            bits_put(enc, 0xF, 4);
+            bits_put(enc, (uint64_t)dod, 64);
+        }
+        enc->prev_delta_us = delta;
+    }
+    enc->prev_timestamp_us = ts;
+    
+    /* Slowly changing values share sign, exponent and high mantissa bits with
+     * the previous one, so their XOR is a short run of meaningful bits */
+    int col = 0;
+    for (int i = 0; i < schema->count; i++) {
+        if (schema->is_string[i]) continue;
+        if (!rec->present[i]) {
+            bits_put(enc, 0x7, 3);
+            col++;
+            continue;
+        }
+    
+        uint64_t value;
+        memcpy(&value, &rec->values[i], 8);
+        uint64_t x = value ^ enc->prev[col];
+        enc->prev[col] = value;
+        if (x == 0) {
+            bits_put(enc, 0x0, 1);
+            col++;
+            continue;
+        }
+    
+        int leading = __builtin_clzll(x);
+        int trailing = __builtin_ctzll(x);
+        if (leading > 31) leading = 31;
+        int window_lead = enc->leading[col];
+        int window_len = enc->length[col];
+        if (window_len > 0 && leading >= window_lead && trailing >= 64 - window_lead - window_len) {
+            bits_put(enc, 0x2, 2);
+            bits_put(enc, x >> (64 - window_lead - window_len), window_len);
+        } else {
+            int len = 64 - leading - trailing;
+            bits_put(enc, 0x6, 3);
+            bits_put(enc, (uint64_t)leading, 5);
+            bits_put(enc, (uint64_t)(len & 63), 6);
+            bits_put(enc, x >> trailing, len);
+            enc->leading[col] = (uint8_t)leading;
+            enc->length[col] = (uint8_t)len;
+        }
+        col++;
+    }
+    enc->records++;
+}
+
+int tcr_block_encoder_has_room(const TcrBlockEncoder *enc) {
+    return enc->records < TCR_BLOCK_MAX_RECORDS &&
+           TCR_BLOCK_HEADER_LEN + enc->bits.len + 1 + tcr_block_record_max_bytes(enc->columns) <= TCR_MAX_PAYLOAD;
+}
+
+void tcr_block_encoder_finish(TcrBlockEncoder *enc, ByteBuffer *out) {
+    if (enc->records == 0) return;
+    if (enc->acc_bits > 0) {
+        bits_put(enc, 0, 8 - enc->acc_bits);
+    }
+    
+    size_t start = tcr_frame_begin(out, TCR_FRAME_COMPRESSED);
+    uint16_t ncols = (uint16_t)enc->columns;
+    uint16_t nrecords = (uint16_t)enc->records;
+    byte_buffer_append(out, &ncols, 2);
+    byte_buffer_append(out, &nrecords, 2);
+    byte_buffer_append(out, enc->bits.data, enc->bits.len);
+    tcr_frame_end(out, start);
+    
+    tcr_block_encoder_reset(enc);
+}
+
+void tcr_block_encoder_free(TcrBlockEncoder *enc) {
+    byte_buffer_free(&enc->bits);
+    free(enc->prev);
+    free(enc->leading);
+    free(enc->length);
+    enc->prev = NULL;
+    enc->leading = NULL;
+    enc->length = NULL;
+}
+
+static int bits_get(TcrBlockDecoder *dec, int n, uint64_t *value) {
+    if (dec->bit_pos + (size_t)n > dec->bit_len) return THERMO_IO_ERROR;
+    
+    uint64_t v = 0;
+    while (n > 0) {
+        uint8_t byte = dec->data[dec->bit_pos >> 3];
+        int avail = 8 - (int)(dec->bit_pos & 7);
+        int take = n < avail ? n : avail;
+        v = (v << take) | ((uint64_t)(byte >> (avail - take)) & ((1u << take) - 1));
+        dec->bit_pos += (size_t)take;
+        n -= take;
+    }
+    *value = v;
+    return THERMO_SUCCESS;
+}
+
+/* Control code: count of '1' bits up to the first '0' (consumed) or max */
+static int bits_code(TcrBlockDecoder *dec, int max, int *code) {
+    *code = 0;
+    while (*code < max) {
+        uint64_t bit;
+        if (bits_get(dec, 1, &bit) != THERMO_SUCCESS) return THERMO_IO_ERROR;
+        if (!bit) break;
+        (*code)++;
+    }
+    return THERMO_SUCCESS;
+}
+
+static int64_t sign_extend(uint64_t value, int bits) {
+    if (bits < 64 && ((value >> (bits - 1)) & 1)) {
+        value |= ~0ULL << bits;
+    }
+    return (int64_t)value;
+}
+
+int tcr_block_decoder_start(TcrBlockDecoder *dec, const uint8_t *payload, uint32_t len, int columns) {
+    uint16_t ncols, nrecords;
+    if (len < TCR_BLOCK_HEADER_LEN) return THERMO_IO_ERROR;
+    memcpy(&ncols, payload, 2);
+    memcpy(&nrecords, payload + 2, 2);
+    if (ncols != columns) return THERMO_IO_ERROR;
+    
+    if (columns > dec->capacity) {
+        uint64_t *prev = (uint64_t*)realloc(dec->prev, (size_t)columns * sizeof(uint64_t));
+        if (prev) dec->prev = prev;
+        uint8_t *leading = (uint8_t*)realloc(dec->leading, (size_t)columns);
+        if (leading) dec->leading = leading;
+        uint8_t *length = (uint8_t*)realloc(dec->length, (size_t)columns);
+        if (length) dec->length = length;
+        if (!prev || !leading || !length) return THERMO_ERROR;
+        dec->capacity = columns;
+    }
+    if (columns > 0) {
+        memset(dec->prev, 0, (size_t)columns * sizeof(uint64_t));
+        memset(dec->leading, 0, (size_t)columns);
+        memset(dec->length, 0, (size_t)columns);
+    }
+    
+    dec->data = payload + TCR_BLOCK_HEADER_LEN;
+    dec->bit_len = (size_t)(len - TCR_BLOCK_HEADER_LEN) * 8;
+    dec->bit_pos = 0;
+    dec->columns = columns;
+    dec->remaining = nrecords;
+    dec->started = 0;
+    return THERMO_SUCCESS;
+}
+
+int tcr_block_decoder_next(TcrBlockDecoder *dec, FlatRecord *rec) {
+    static const int dod_bits[] = {0, 7, 12, 20, 64};
+    uint64_t bits;
+    int code;
+    
+    if (dec->remaining <= 0) return THERMO_IO_ERROR;
+    
+    if (!dec->started) {
+        if (bits_get(dec, 64, &bits) != THERMO_SUCCESS) return THERMO_IO_ERROR;
+        dec->prev_timestamp_us = (int64_t)bits;
+        dec->prev_delta_us = 0;
+        dec->started = 1;
+    } else {
+        if (bits_code(dec, 4, &code) != THERMO_SUCCESS) return THERMO_IO_ERROR;
+        int64_t dod = 0;
+        if (code > 0) {
+            if (bits_get(dec, dod_bits[code], &bits) != THERMO_SUCCESS) return THERMO_IO_ERROR;
+            dod = sign_extend(bits, dod_bits[code]);
+        }
+        dec->prev_delta_us = (int64_t)((uint64_t)dec->prev_delta_us + (uint64_t)dod);
+        dec->prev_timestamp_us = (int64_t)((uint64_t)dec->prev_timestamp_us + (uint64_t)dec->prev_delta_us);
+    }
+    rec->timestamp_us = dec->prev_timestamp_us;
+    
+    for (int c = 0; c < dec->columns; c++) {
+        if (bits_code(dec, 3, &code) != THERMO_SUCCESS) return THERMO_IO_ERROR;
+        if (code == 3) {
+            rec->present[c] = 0;
+            continue;
+        }
+    
+        uint64_t x = 0;
+        if (code == 1) {
+            if (dec->length[c] == 0 || bits_get(dec, dec->length[c], &bits) != THERMO_SUCCESS) {
+                return THERMO_IO_ERROR;
+            }
+            x = bits << (64 - dec->leading[c] - dec->length[c]);
+        } else if (code == 2) {
+            uint64_t leading, len;
+            if (bits_get(dec, 5, &leading) != THERMO_SUCCESS || bits_get(dec, 6, &len) != THERMO_SUCCESS) {
+                return THERMO_IO_ERROR;
+            }
+            if (len == 0) len = 64;
+            if (leading + len > 64 || bits_get(dec, (int)len, &bits) != THERMO_SUCCESS) {
+                return THERMO_IO_ERROR;
+            }
+            x = bits << (64 - leading - len);
+            dec->leading[c] = (uint8_t)leading;
+            dec->length[c] = (uint8_t)len;
+        }
+        dec->prev[c] ^= x;
+        memcpy(&rec->values[c], &dec->prev[c], 8);
+        rec->present[c] = 1;
+    }
+    
+    dec->remaining--;
+    return THERMO_SUCCESS;
+}
+
+void tcr_block_decoder_free(TcrBlockDecoder *dec) {
+    free(dec->prev);
+    free(dec->leading);
+    free(dec->length);
+    memset(dec, 0, sizeof(*dec));
+}
+
+/* ============================================================================
+ * Binary recording recovery
+ * ============================================================================ */
+
+/* Buffered window over a file for forward scanning */
+typedef struct {
+    int fd;
+    long long size;
+    char *buf;
+    size_t cap;
+    long long base;         /* File offset of buf[0] */
+    size_t len;             /* Valid bytes in buf */
+} ScanWindow;
+
+/* Make [pos, pos+n) available; returns pointer or NULL past EOF / on error */
+static const char* scan_window_get(ScanWindow *win, long long pos, size_t n) {
+    if (pos >= win->base && pos + (long long)n <= win->base + (long long)win->len) {
+        return win->buf + (pos - win->base);
+    }
+    if (n > win->cap || pos + (long long)n > win->size) return NULL;
+    
+    win->base = pos;
+    win->len = 0;
+    while (win->len < win->cap && win->base + (long long)win->len < win->size) {
+        ssize_t r = pread(win->fd, win->buf + win->len, win->cap - win->len,
+                          (off_t)(win->base + (long long)win->len));
+        if (r <= 0) break;
+        win->len += (size_t)r;
+    }
+    return win->len >= n ? win->buf : NULL;
+}
+
+static int tcr_frame_type_known(uint8_t type) {
+    return type == TCR_FRAME_SCHEMA || type == TCR_FRAME_DATA || type == TCR_FRAME_COMPRESSED;
+}
+
+long long tcr_scan_valid_length(int fd, long long size) {
+    char magic[TCR_MAGIC_LEN];
+    ssize_t got = pread(fd, magic, sizeof(magic), 0);
+    if (got < 0) return -1;
+    if (memcmp(magic, TCR_MAGIC, (size_t)got) != 0) return -1;
+    if (got < TCR_MAGIC_LEN) return 0;  /* Torn magic */
+    
+    ScanWindow win = {
+        .fd = fd,
+        .size = size,
+        .cap = 2 * (TCR_MAX_PAYLOAD + TCR_FRAME_OVERHEAD),
+    };
+    win.buf = (char*)malloc(win.cap);
+    if (!win.buf) return -1;
+    
+    long long pos = TCR_MAGIC_LEN;
+    while (pos < size) {
+        const char *hdr = scan_window_get(&win, pos, 5);
+        if (!hdr) break;
+        
+        uint32_t payload_len;
+        memcpy(&payload_len, hdr + 1, 4);
+        if (!tcr_frame_type_known((uint8_t)hdr[0]) || payload_len > TCR_MAX_PAYLOAD) {
+            break;
+        }
+        
+        size_t frame_len = 5 + payload_len + 4;
+        const char *frame = scan_window_get(&win, pos, frame_len);
+        if (!frame) break;
+        
+        uint32_t crc;
+        memcpy(&crc, frame + 5 + payload_len, 4);
+        if (crc32_update(0, frame, 5 + payload_len) != crc) break;
+        
+        pos += (long long)frame_len;
+    }
+    
+    free(win.buf);
+    
+    /* A crash can only tear the final frame; damage further back is not ours to cut */
+    if (size - pos > TCR_MAX_PAYLOAD + TCR_FRAME_OVERHEAD) {
+        fprintf(stderr, "Error: Damaged frame at offset %lld of %lld\n", pos, size);
+        return -1;
+    }
+    return pos;
+}
+
+/* ============================================================================
+ * Binary recording reader
+ * ============================================================================ */
+
+int tcr_reader_open(TcrReader *reader, FILE *fp) {
+    memset(reader, 0, sizeof(*reader));
+    reader->fp = fp;
+    
+    char magic[TCR_MAGIC_LEN];
+    if (fread(magic, 1, TCR_MAGIC_LEN, fp) != TCR_MAGIC_LEN || memcmp(magic, TCR_MAGIC, TCR_MAGIC_LEN) != 0) {
+        return THERMO_INVALID_PARAM;
+    }
+    reader->offset = TCR_MAGIC_LEN;
+    return THERMO_SUCCESS;
+}
+
+int tcr_reader_seek(TcrReader *reader, long long offset) {
+    if (fseeko(reader->fp, (off_t)offset, SEEK_SET) != 0) {
+        return THERMO_IO_ERROR;
+    }
+    reader->offset = offset;
+    reader->block.remaining = 0;
+    return THERMO_SUCCESS;
+}
+
+/* Replace the current schema from an 'S' payload */
+static int tcr_reader_load_schema(TcrReader *reader, const uint8_t *p, uint32_t len) {
+    if (reader->schema_ready) {
+        flat_record_free(&reader->record);
+        record_schema_free(&reader->schema);
+        reader->schema_ready = 0;
+    }
+    if (len < 2) return THERMO_IO_ERROR;
+    
+    uint16_t ncols;
+    memcpy(&ncols, p, 2);
+    uint32_t pos = 2;
+    for (int i = 0; i < ncols; i++) {
+        if (pos >= len || pos + 1 + p[pos] > len) {
+            record_schema_free(&reader->schema);
+            return THERMO_IO_ERROR;
+        }
+        char name[256];
+        memcpy(name, p + pos + 1, p[pos]);
+        name[p[pos]] = '\0';
+        pos += 1 + p[pos];
+        
+        /* Names are unique within a schema; keep positions even if a file disagrees */
+        reader->schema.names = (char**)realloc(reader->schema.names, (reader->schema.count + 1) * sizeof(char*));
+        reader->schema.is_string = (uint8_t*)realloc(reader->schema.is_string, reader->schema.count + 1);
+        reader->schema.names[reader->schema.count] = strdup(name);
+        reader->schema.is_string[reader->schema.count] = 0;
+        reader->schema.count++;
+    }
+    
+    if (flat_record_init(&reader->record, &reader->schema) != THERMO_SUCCESS) {
+        record_schema_free(&reader->schema);
+        return THERMO_ERROR;
+    }
+    reader->schema_ready = 1;
+    reader->schema_changed = 1;
+    return THERMO_SUCCESS;
+}
+
+/* Decode a 'D' payload into reader->record */
+static int tcr_reader_load_data(TcrReader *reader, const uint8_t *p, uint32_t len) {
+    uint16_t ncols;
+    if (!reader->schema_ready || len < 10) return THERMO_IO_ERROR;
+    memcpy(&reader->record.timestamp_us, p, 8);
+    memcpy(&ncols, p + 8, 2);
+    if (ncols != reader->schema.count) return THERMO_IO_ERROR;
+    
+    const uint8_t *bitmap = p + 10;
+    uint32_t pos = 10 + (ncols + 7) / 8;
+    for (int i = 0; i < ncols; i++) {
+        reader->record.present[i] = (bitmap[i / 8] >> (i % 8)) & 1;
+        if (reader->record.present[i]) {
+            if (pos + 8 > len) return THERMO_IO_ERROR;
+            memcpy(&reader->record.values[i], p + pos, 8);
+            pos += 8;
+        }
+    }
+    return THERMO_SUCCESS;
+}
+
+int tcr_reader_next(TcrReader *reader) {
+    reader->schema_changed = 0;
+    
+    /* The rest of a compressed frame comes first; its records share its offset */
+    if (reader->block.remaining > 0) {
+        return tcr_block_decoder_next(&reader->block, &reader->record) == THERMO_SUCCESS ? 1 : THERMO_IO_ERROR;
+    }
+    
+    for (;;) {
+        reader->record_offset = reader->offset;
+        uint8_t header[5];
+        size_t got = fread(header, 1, sizeof(header), reader->fp);
+        if (got < sizeof(header)) {
+            return 0;  /* End of file (or torn final frame) */
+        }
+        
+        uint32_t payload_len;
+        memcpy(&payload_len, header + 1, 4);
+        if (!tcr_frame_type_known(header[0]) || payload_len > TCR_MAX_PAYLOAD) {
+            return THERMO_IO_ERROR;
+        }
+        
+        byte_buffer_reset(&reader->frame);
+        byte_buffer_append(&reader->frame, header, sizeof(header));
+        byte_buffer_reserve(&reader->frame, payload_len + 4);
+        if (fread(reader->frame.data + 5, 1, payload_len + 4, reader->fp) != payload_len + 4) {
+            return 0;
+        }
+        
+        uint32_t crc;
+        memcpy(&crc, reader->frame.data + 5 + payload_len, 4);
+        if (crc32_update(0, reader->frame.data, 5 + payload_len) != crc) {
+            return THERMO_IO_ERROR;
+        }
+        reader->offset += 5 + payload_len + 4;
+        
+        const uint8_t *payload = (const uint8_t*)reader->frame.data + 5;
+        if (header[0] == TCR_FRAME_SCHEMA) {
+            int result = tcr_reader_load_schema(reader, payload, payload_len);
+            if (result != THERMO_SUCCESS) return result;
+            continue;
+        }
+        if (header[0] == TCR_FRAME_COMPRESSED) {
+            if (!reader->schema_ready) return THERMO_IO_ERROR;
+            int result = tcr_block_decoder_start(&reader->block, payload, payload_len, reader->schema.count);
+            if (result != THERMO_SUCCESS) return result;
+            if (reader->block.remaining == 0) continue;
+            return tcr_block_decoder_next(&reader->block, &reader->record) == THERMO_SUCCESS ? 1 : THERMO_IO_ERROR;
+        }
+        
+        int result = tcr_reader_load_data(reader, payload, payload_len);
+        return result == THERMO_SUCCESS ? 1 : result;
+    }
+}
+
+void tcr_reader_close(TcrReader *reader) {
+    if (reader->schema_ready) {
+        flat_record_free(&reader->record);
+        record_schema_free(&reader->schema);
+        reader->schema_ready = 0;
+    }
+    byte_buffer_free(&reader->frame);
+    tcr_block_decoder_free(&reader->block);
+}
@@ -0,0 +1,778 @@
+/*
+ * Output sinks implementation.
+ * Each record is serialized at most once per format (JSON text, CSV row,
+ * binary frame) and the shared bytes are written to every sink of that format.
+ * Compressed sinks are the exception: each encodes its own blocks, which
+ * start and end with the sink's files. File sinks' rollups are fed the
+ * same flattened record.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "sink.h"
+#include "serialize.h"
+#include "hardware.h"
+#include "stats.h"
+#include "timeindex.h"
+#include "utils.h"
+
+#define SINK_RECONNECT_SECONDS 2
+#define SINK_BLOCK_MAX_SPAN_US (60LL * 1000000)    /* Longest a record waits in a block */
+
+/* --stats serialize slots: one per SinkFormat, then the shared column fill */
+#define SINK_FORMAT_COUNT 4
+#define STATS_SLOT_COLUMNS SINK_FORMAT_COUNT
+static const char *FORMAT_NAMES[] = {"json", "csv", "binary", "compressed"};
+
+typedef struct {
+    SinkSpec spec;
+    Recorder *recorder;         /* SINK_FILE */
+    int fd;                     /* SINK_UNIX / SINK_TCP (-1 = disconnected) */
+    time_t last_connect_attempt;
+    ByteBuffer pending;         /* Unsent tail of a partially sent record */
+    int needs_header;           /* Stream/socket sinks: header not yet sent */
+    int needs_schema;           /* Binary: columns were added since the schema was sent */
+    uint64_t dropped;
+    TcrBlockEncoder block;      /* SINK_FORMAT_COMPRESSED: records not yet written */
+    int block_ready;
+    int block_records;          /* Records per block */
+    int64_t block_span_us;      /* Record time a block may span */
+    int64_t block_started_us;   /* time_mono_us() of the block's first record */
+    Rollup *rollup;             /* SINK_FILE with rollup levels */
+} Sink;
+
+struct SinkSet {
+    Sink sinks[MAX_SINKS];
+    int count;
+    int uses_format[SINK_FORMAT_COUNT];
+    
+    /* Shared serialization state */
+    RecordSchema schema;
+    int schema_ready;
+    int schema_full;            /* No more columns can be added */
+    int csv_columns;            /* CSV keeps the first record's columns */
+    int told_columns;           /* Columns left out of CSV/rollups were reported */
+    FlatRecord flat;
+    ByteBuffer json_buf;
+    ByteBuffer csv_buf;
+    ByteBuffer bin_buf;
+    ByteBuffer block_buf;
+    ByteBuffer header_buf;
+};
+
+/* ============================================================================
+ * Spec parsing
+ * ============================================================================ */
+
+static long long parse_scaled(const char *str, const char *suffixes, const long long *scales) {
+    char *end = NULL;
+    double value = strtod(str, &end);
+    if (end == str || value < 0) return -1;
+    if (*end == '\0') return (long long)value;
+    
+    const char *pos = strchr(suffixes, *end);
+    if (!pos || end[1] != '\0') return -1;
+    return (long long)(value * scales[pos - suffixes]);
+}
+
+/* fsync=N (records), Tms / Ts (age of oldest unsynced record) or never; may be repeated */
+static int parse_fsync(const char *value, RecorderPolicy *policy) {
+    if (strcmp(value, "never") == 0) {
+        policy->fsync_records = 0;
+        policy->fsync_ms = 0;
+        return THERMO_SUCCESS;
+    }
+    
+    char *end = NULL;
+    long n = strtol(value, &end, 10);
+    if (end == value || n <= 0 || n > 86400000L) return THERMO_INVALID_PARAM;
+    
+    if (*end == '\0') {
+        policy->fsync_records = (int)n;
+    } else if (strcmp(end, "ms") == 0) {
+        policy->fsync_ms = (int)n;
+    } else if (strcmp(end, "s") == 0 && n <= 86400) {
+        policy->fsync_ms = (int)n * 1000;
+    } else {
+        return THERMO_INVALID_PARAM;
+    }
+    return THERMO_SUCCESS;
+}
+
+static SinkFormat format_from_extension(const char *path) {
+    const char *ext = strrchr(path, '.');
+    if (ext && strcmp(ext, ".csv") == 0) return SINK_FORMAT_CSV;
+    if (ext && (strcmp(ext, ".tcr") == 0 || strcmp(ext, ".bin") == 0)) return SINK_FORMAT_BINARY;
+    if (ext && strcmp(ext, ".tcz") == 0) return SINK_FORMAT_COMPRESSED;
+    return SINK_FORMAT_JSON;
+}
+
+void sink_spec_default(SinkSpec *spec) {
+    memset(spec, 0, sizeof(*spec));
+    spec->kind = SINK_STDOUT;
+    spec->format = SINK_FORMAT_JSON;
+}
+
+int sink_spec_parse(const char *str, SinkSpec *spec) {
+    static const long long size_scales[] = {1024LL, 1024LL * 1024, 1024LL * 1024 * 1024};
+    static const long long time_scales[] = {1, 60, 3600, 86400};
+    
+    char buf[512];
+    snprintf(buf, sizeof(buf), "%s", str);
+    sink_spec_default(spec);
+    long long index_chunk = -1;     /* -1 = default for the format */
+    int block_records = 0;
+    const char *rollup = NULL;      /* NULL = default for the format */
+    
+    /* Split "KIND[:TARGET]" from ",key=value" options */
+    char *saveptr = NULL;
+    char *head = strtok_r(buf, ",", &saveptr);
+    if (!head) return THERMO_INVALID_PARAM;
+    
+    char *target = strchr(head, ':');
+    if (target) *target++ = '\0';
+    
+    if (strcmp(head, "stdout") == 0) {
+        spec->kind = SINK_STDOUT;
+    } else if (strcmp(head, "file") == 0) {
+        spec->kind = SINK_FILE;
+    } else if (strcmp(head, "unix") == 0) {
+        spec->kind = SINK_UNIX;
+    } else if (strcmp(head, "tcp") == 0) {
+        spec->kind = SINK_TCP;
+    } else {
+        fprintf(stderr, "Error: Unknown sink type '%s' (stdout, file, unix, tcp)\n", head);
+        return THERMO_INVALID_PARAM;
+    }
+    
+    if (spec->kind != SINK_STDOUT) {
+        if (!target || *target == '\0') {
+            fprintf(stderr, "Error: Sink '%s' needs a target (e.g. %s:PATH)\n", head, head);
+            return THERMO_INVALID_PARAM;
+        }
+        snprintf(spec->target, sizeof(spec->target), "%s", target);
+        spec->format = format_from_extension(spec->target);
+    }
+    
+    if (spec->kind == SINK_UNIX && strlen(spec->target) >= sizeof(((struct sockaddr_un*)0)->sun_path)) {
+        fprintf(stderr, "Error: Socket path too long: %s\n", spec->target);
+        return THERMO_INVALID_PARAM;
+    }
+    
+    for (char *opt = strtok_r(NULL, ",", &saveptr); opt; opt = strtok_r(NULL, ",", &saveptr)) {
+        char *value = strchr(opt, '=');
+        if (!value) {
+            fprintf(stderr, "Error: Sink option '%s' must be key=value\n", opt);
+            return THERMO_INVALID_PARAM;
+        }
+        *value++ = '\0';
+        
+        if (strcmp(opt, "format") == 0) {
+            if (strcmp(value, "json") == 0) spec->format = SINK_FORMAT_JSON;
+            else if (strcmp(value, "csv") == 0) spec->format = SINK_FORMAT_CSV;
+            else if (strcmp(value, "binary") == 0) spec->format = SINK_FORMAT_BINARY;
+            else if (strcmp(value, "compressed") == 0) spec->format = SINK_FORMAT_COMPRESSED;
+            else {
+                fprintf(stderr, "Error: Unknown sink format '%s' (json, csv, binary, compressed)\n", value);
+                return THERMO_INVALID_PARAM;
+            }
+        } else if (strcmp(opt, "rotate-size") == 0) {
+            spec->rotate.rotate_bytes = parse_scaled(value, "KMG", size_scales);
+            if (spec->rotate.rotate_bytes <= 0) {
+                fprintf(stderr, "Error: Invalid rotate-size '%s'\n", value);
+                return THERMO_INVALID_PARAM;
+            }
+        } else if (strcmp(opt, "rotate-time") == 0) {
+            spec->rotate.rotate_seconds = (int)parse_scaled(value, "smhd", time_scales);
+            if (spec->rotate.rotate_seconds <= 0) {
+                fprintf(stderr, "Error: Invalid rotate-time '%s'\n", value);
+                return THERMO_INVALID_PARAM;
+            }
+        } else if (strcmp(opt, "fsync") == 0) {
+            if (parse_fsync(value, &spec->rotate) != THERMO_SUCCESS) {
+                fprintf(stderr, "Error: Invalid fsync '%s' (N records, Tms, Ts or never)\n", value);
+                return THERMO_INVALID_PARAM;
+            }
+        } else if (strcmp(opt, "index") == 0) {
+            index_chunk = strcmp(value, "off") == 0 ? 0 : parse_scaled(value, "KMG", size_scales);
+            if (index_chunk < 0 || (index_chunk == 0 && strcmp(value, "off") != 0)) {
+                fprintf(stderr, "Error: Invalid index '%s' (chunk size or off)\n", value);
+                return THERMO_INVALID_PARAM;
+            }
+        } else if (strcmp(opt, "block") == 0) {
+            char *end = NULL;
+            long n = strtol(value, &end, 10);
+            if (end == value || *end != '\0' || n < 1 || n > TCR_BLOCK_MAX_RECORDS) {
+                fprintf(stderr, "Error: Invalid block '%s' (1 to %d records)\n", value, TCR_BLOCK_MAX_RECORDS);
+                return THERMO_INVALID_PARAM;
+            }
+            block_records = (int)n;
+        } else if (strcmp(opt, "rollup") == 0) {
+            if (rollup_levels_parse(value, &spec->rollup) != THERMO_SUCCESS) {
+                fprintf(stderr, "Error: Invalid rollup '%s' (widths such as 1s:10s:1m:10m, each a multiple "
+                        "of the one before, or off)\n", value);
+                return THERMO_INVALID_PARAM;
+            }
+            rollup = value;
+        } else {
+            fprintf(stderr, "Error: Unknown sink option '%s'\n", opt);
+            return THERMO_INVALID_PARAM;
+        }
+    }
+    
+    if (spec->kind != SINK_FILE && (spec->rotate.rotate_bytes || spec->rotate.rotate_seconds ||
+                                    spec->rotate.fsync_records || spec->rotate.fsync_ms)) {
+        fprintf(stderr, "Error: Rotation and fsync are only supported for file sinks\n");
+        return THERMO_INVALID_PARAM;
+    }
+    
+    if (spec->format == SINK_FORMAT_COMPRESSED && spec->kind != SINK_FILE) {
+        fprintf(stderr, "Error: The compressed format is only supported for file sinks\n");
+        return THERMO_INVALID_PARAM;
+    }
+    if (block_records > 0 && spec->format != SINK_FORMAT_COMPRESSED) {
+        fprintf(stderr, "Error: block is only supported for the compressed format\n");
+        return THERMO_INVALID_PARAM;
+    }
+    if (spec->format == SINK_FORMAT_COMPRESSED) {
+        spec->block_records = block_records > 0 ? block_records : SINK_DEFAULT_BLOCK_RECORDS;
+    }
+    
+    /* CSV and binary recordings are time-indexed unless told otherwise; JSON has no record times */
+    int indexable = spec->kind == SINK_FILE && spec->format != SINK_FORMAT_JSON;
+    if (index_chunk > 0 && !indexable) {
+        fprintf(stderr, "Error: A time index is only kept for csv, binary and compressed file sinks\n");
+        return THERMO_INVALID_PARAM;
+    }
+    spec->rotate.index_chunk = index_chunk >= 0 ? index_chunk : (indexable ? TIME_INDEX_DEFAULT_CHUNK : 0);
+    
+    /* Likewise rolled up */
+    if (spec->rollup.count > 0 && !indexable) {
+        fprintf(stderr, "Error: Rollups are only kept for csv, binary and compressed file sinks\n");
+        return THERMO_INVALID_PARAM;
+    }
+    if (!rollup && indexable) {
+        rollup_levels_parse(ROLLUP_DEFAULT_LEVELS, &spec->rollup);
+    }
+    
+    return THERMO_SUCCESS;
+}
+
+/* ============================================================================
+ * Socket sinks
+ * ============================================================================ */
+
+static int sink_connect(Sink *sink) {
+    int fd = -1;
+    
+    if (sink->spec.kind == SINK_UNIX) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, sink->spec.target);  /* Length checked in sink_spec_parse */
+        
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd != -1 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+            close(fd);
+            fd = -1;
+        }
+    } else {
+        char host[256];
+        snprintf(host, sizeof(host), "%s", sink->spec.target);
+        char *port = strrchr(host, ':');
+        if (!port) return -1;
+        *port++ = '\0';
+        
+        struct addrinfo hints = {0}, *res = NULL;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host, port, &hints, &res) != 0) return -1;
+        
+        for (struct addrinfo *ai = res; ai && fd == -1; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd != -1 && connect(fd, ai->ai_addr, ai->ai_addrlen) == -1) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(res);
+    }
+    
+    if (fd != -1) {
+        DEBUG_PRINT("Sink connected to %s", sink->spec.target);
+        sink->needs_header = 1;
+        byte_buffer_reset(&sink->pending);
+    }
+    return fd;
+}
+
+/* Non-blocking send; keeps any unsent tail in pending. Returns 0 if fully sent. */
+static int sink_socket_send(Sink *sink, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(sink->fd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            close(sink->fd);
+            sink->fd = -1;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    if (len > 0) {
+        byte_buffer_append(&sink->pending, data, len);
+        return -1;
+    }
+    return 0;
+}
+
+static void sink_set_build_header(SinkSet *set, SinkFormat format, int with_magic);
+
+/* Deliver one record to a socket sink; a slow or absent peer drops records instead of blocking */
+static void sink_socket_emit(SinkSet *set, Sink *sink, const ByteBuffer *data) {
+    if (sink->fd == -1) {
+        time_t now = time(NULL);
+        if (now - sink->last_connect_attempt < SINK_RECONNECT_SECONDS) {
+            sink->dropped++;
+            return;
+        }
+        sink->last_connect_attempt = now;
+        sink->fd = sink_connect(sink);
+        if (sink->fd == -1) {
+            sink->dropped++;
+            return;
+        }
+    }
+    
+    /* Finish the previous record first to keep framing intact */
+    if (sink->pending.len > 0) {
+        ByteBuffer tail = sink->pending;
+        sink->pending = (ByteBuffer){0};
+        int rc = sink_socket_send(sink, tail.data, tail.len);
+        byte_buffer_free(&tail);
+        if (rc != 0) {
+            sink->dropped++;
+            return;
+        }
+    }
+    
+    if ((sink->needs_header || sink->needs_schema) && sink->spec.format != SINK_FORMAT_JSON) {
+        sink_set_build_header(set, sink->spec.format, sink->needs_header);
+        sink->needs_header = 0;
+        sink->needs_schema = 0;
+        if (sink_socket_send(sink, set->header_buf.data, set->header_buf.len) != 0) {
+            sink->dropped++;
+            return;
+        }
+    }
+    sink->needs_header = 0;
+    sink->needs_schema = 0;
+    
+    if (sink_socket_send(sink, data->data, data->len) != 0 && sink->fd == -1) {
+        sink->dropped++;
+    }
+}
+
+/* ============================================================================
+ * Sink set
+ * ============================================================================ */
+
+SinkSet* sink_set_open(const SinkSpec *specs, int count) {
+    if (count < 1 || count > MAX_SINKS) {
+        fprintf(stderr, "Error: Between 1 and %d sinks are supported\n", MAX_SINKS);
+        return NULL;
+    }
+    
+    SinkSet *set = (SinkSet*)calloc(1, sizeof(SinkSet));
+    if (!set) return NULL;
+    
+    for (int i = 0; i < count; i++) {
+        Sink *sink = &set->sinks[i];
+        sink->spec = specs[i];
+        sink->fd = -1;
+        sink->needs_header = 1;
+        set->uses_format[specs[i].format] = 1;
+        set->count++;
+        stats_label(STAT_SINK_WRITE, i, specs[i].kind == SINK_STDOUT ? "stdout" : specs[i].target);
+        
+        if (specs[i].kind == SINK_FILE) {
+            /* Existing files lose a record torn by a crash before we append */
+            int binary = specs[i].format == SINK_FORMAT_BINARY || specs[i].format == SINK_FORMAT_COMPRESSED;
+            RecorderScanFn scan = binary ? tcr_scan_valid_length : recorder_scan_lines;
+            sink->recorder = recorder_open(specs[i].target, &specs[i].rotate, scan);
+            if (!sink->recorder) {
+                sink_set_close(set);
+                return NULL;
+            }
+            
+            /* A block never holds records longer than fsync would leave them unsynced */
+            const RecorderPolicy *policy = &specs[i].rotate;
+            sink->block_records = specs[i].block_records;
+            if (policy->fsync_records > 0 && policy->fsync_records < sink->block_records) {
+                sink->block_records = policy->fsync_records;
+            }
+            sink->block_span_us = SINK_BLOCK_MAX_SPAN_US;
+            if (policy->fsync_ms > 0 && policy->fsync_ms * 1000LL < sink->block_span_us) {
+                sink->block_span_us = policy->fsync_ms * 1000LL;
+            }
+            
+            /* Level files are renamed with the recording when it rotates */
+            if (specs[i].rollup.count > 0) {
+                sink->rollup = rollup_open(specs[i].target, &specs[i].rollup, policy);
+                if (!sink->rollup) {
+                    fprintf(stderr, "Error: Failed to allocate memory\n");
+                    sink_set_close(set);
+                    return NULL;
+                }
+                for (int l = 0; l < specs[i].rollup.count; l++) {
+                    char suffix[64];
+                    rollup_suffix(suffix, sizeof(suffix), specs[i].rollup.width_us[l]);
+                    recorder_add_sidecar(sink->recorder, suffix);
+                }
+            }
+        } else if (specs[i].kind == SINK_UNIX || specs[i].kind == SINK_TCP) {
+            sink->last_connect_attempt = time(NULL);
+            sink->fd = sink_connect(sink);
+            if (sink->fd == -1) {
+                fprintf(stderr, "Warning: Sink %s not reachable yet, will retry\n", specs[i].target);
+            }
+        }
+    }
+    
+    for (int f = 0; f < SINK_FORMAT_COUNT; f++) {
+        stats_label(STAT_SERIALIZE, f, FORMAT_NAMES[f]);
+    }
+    stats_label(STAT_SERIALIZE, STATS_SLOT_COLUMNS, "columns");
+    return set;
+}
+
+int sink_set_uses_stdout(const SinkSet *set) {
+    for (int i = 0; i < set->count; i++) {
+        if (set->sinks[i].spec.kind == SINK_STDOUT) return 1;
+    }
+    return 0;
+}
+
+/* Per-file/per-connection header for a format (CSV header row, TCR magic + schema) */
+static void sink_set_build_header(SinkSet *set, SinkFormat format, int with_magic) {
+    byte_buffer_reset(&set->header_buf);
+    if (!set->schema_ready) return;
+    
+    if (format == SINK_FORMAT_CSV) {
+        RecordSchema columns = set->schema;
+        columns.count = set->csv_columns;
+        csv_encode_header(&set->header_buf, &columns);
+    } else if (format == SINK_FORMAT_BINARY || format == SINK_FORMAT_COMPRESSED) {
+        if (with_magic) {
+            byte_buffer_append(&set->header_buf, TCR_MAGIC, TCR_MAGIC_LEN);
+        }
+        tcr_encode_schema(&set->header_buf, &set->schema);
+    }
+}
+
+/* Write pre-serialized bytes for one record to a sink */
+static void sink_emit(SinkSet *set, Sink *sink, const ByteBuffer *data, int64_t timestamp_us) {
+    SinkFormat format = sink->spec.format;
+    
+    switch (sink->spec.kind) {
+        case SINK_STDOUT:
+            if ((sink->needs_header || sink->needs_schema) && format != SINK_FORMAT_JSON) {
+                sink_set_build_header(set, format, sink->needs_header);
+                fwrite(set->header_buf.data, 1, set->header_buf.len, stdout);
+            }
+            sink->needs_header = 0;
+            sink->needs_schema = 0;
+            fwrite(data->data, 1, data->len, stdout);
+            fflush(stdout);
+            break;
+            
+        case SINK_FILE: {
+            int flags = recorder_begin(sink->recorder, data->len);
+            if (flags < 0) {
+                sink->dropped++;
+                return;
+            }
+            /* Rollup intervals don't span files: a rotated file's rollups end with it */
+            if (flags & RECORDER_SEGMENT_ROTATED) {
+                rollup_flush(sink->rollup);
+            }
+            /* CSV header and TCR magic once per file; TCR schema once per session
+             * and again when columns are added */
+            if (format == SINK_FORMAT_CSV && (flags & RECORDER_SEGMENT_EMPTY)) {
+                sink_set_build_header(set, format, 0);
+                recorder_mark_header(sink->recorder);
+                recorder_write(sink->recorder, set->header_buf.data, set->header_buf.len);
+            } else if (format != SINK_FORMAT_JSON && format != SINK_FORMAT_CSV &&
+                       ((flags & RECORDER_SEGMENT_START) || sink->needs_schema)) {
+                if (flags & RECORDER_SEGMENT_EMPTY) {
+                    recorder_write(sink->recorder, TCR_MAGIC, TCR_MAGIC_LEN);
+                }
+                sink_set_build_header(set, format, 0);
+                recorder_mark_header(sink->recorder);
+                recorder_write(sink->recorder, set->header_buf.data, set->header_buf.len);
+            }
+            sink->needs_schema = 0;
+            if (format != SINK_FORMAT_JSON) {
+                recorder_index(sink->recorder, timestamp_us);
+            }
+            if (recorder_write(sink->recorder, data->data, data->len) != THERMO_SUCCESS) {
+                sink->dropped++;
+            }
+            recorder_commit(sink->recorder);
+            break;
+        }
+        
+        case SINK_UNIX:
+        case SINK_TCP:
+            sink_socket_emit(set, sink, data);
+            break;
+    }
+}
+
+/* Write a compressed sink's block as one frame, indexed by its first record */
+static void sink_block_flush(SinkSet *set, Sink *sink) {
+    if (!sink->block_ready || sink->block.records == 0) return;
+    
+    int records = sink->block.records;
+    int64_t first_us = sink->block.first_timestamp_us;
+    uint64_t dropped = sink->dropped;
+    byte_buffer_reset(&set->block_buf);
+    tcr_block_encoder_finish(&sink->block, &set->block_buf);
+    sink_emit(set, sink, &set->block_buf, first_us);
+    if (sink->dropped > dropped) {
+        sink->dropped += (uint64_t)records - 1;
+    }
+}
+
+/* Add the flattened record to a compressed sink's block; a block is written
+ * when it is full or spans block_span_us, so records reach the file steadily
+ * (sink_set_tick() writes it once it is that old when no record follows) */
+static void sink_block_add(SinkSet *set, Sink *sink, int64_t timestamp_us) {
+    if (!sink->block_ready) {
+        if (tcr_block_encoder_init(&sink->block, &set->schema) != THERMO_SUCCESS) {
+            sink->dropped++;
+            return;
+        }
+        sink->block_ready = 1;
+    }
+    
+    if (sink->block.records > 0 && (!tcr_block_encoder_has_room(&sink->block) ||
+                                    timestamp_us - sink->block.first_timestamp_us >= sink->block_span_us)) {
+        sink_block_flush(set, sink);
+    }
+    if (sink->block.records == 0) {
+        sink->block_started_us = time_mono_us();
+    }
+    uint64_t t0 = stats_start();
+    tcr_block_encoder_add(&sink->block, &set->schema, &set->flat);
+    stats_record(STAT_SERIALIZE, SINK_FORMAT_COMPRESSED, t0);
+    if (sink->block.records >= sink->block_records) {
+        sink_block_flush(set, sink);
+    }
+}
+
+/* Add the record's new leaves as columns. Binary sinks send a schema frame
+ * with them before their next record, as a reopened file does, and compressed
+ * sinks first write out the blocks encoded with the old columns. CSV headers
+ * and rollup columns can't change mid-file, so those keep theirs and say so once. */
+static void sink_set_extend_schema(SinkSet *set, const cJSON *json) {
+    for (int i = 0; i < set->count; i++) {
+        Sink *sink = &set->sinks[i];
+        sink_block_flush(set, sink);
+        if (sink->block_ready) {
+            tcr_block_encoder_free(&sink->block);
+            sink->block_ready = 0;
+        }
+    }
+    
+    int count = set->schema.count;
+    FlatRecord flat;
+    if (record_schema_extend(&set->schema, json) == 0 ||
+        flat_record_init(&flat, &set->schema) != THERMO_SUCCESS) {
+        /* Out of columns (or memory): later leaves are left out */
+        for (int c = count; c < set->schema.count; c++) {
+            free(set->schema.names[c]);
+        }
+        set->schema.count = count;
+        set->schema_full = 1;
+        fprintf(stderr, "Warning: No more columns can be added, new record fields are left out\n");
+        return;
+    }
+    flat_record_free(&set->flat);
+    set->flat = flat;
+    
+    int keeps_columns = set->uses_format[SINK_FORMAT_CSV];
+    for (int i = 0; i < set->count; i++) {
+        Sink *sink = &set->sinks[i];
+        if (sink->spec.format == SINK_FORMAT_BINARY || sink->spec.format == SINK_FORMAT_COMPRESSED) {
+            sink->needs_schema = 1;
+        }
+        if (sink->rollup) keeps_columns = 1;
+    }
+    if (keeps_columns && !set->told_columns) {
+        int added = set->schema.count - count;
+        fprintf(stderr, "Warning: Records gained field%s (%s%s) after the first; "
+                "CSV output and rollups keep the first record's columns\n",
+                added == 1 ? "" : "s", set->schema.names[count], added == 1 ? "" : ", ...");
+        set->told_columns = 1;
+    }
+}
+
+void sink_set_write_json(SinkSet *set, const cJSON *json, int64_t timestamp_us) {
+    TRACE_SCOPE("sink_write");
+    /* Serialize once per format in use */
+    if (set->uses_format[SINK_FORMAT_JSON]) {
+        uint64_t t0 = stats_start();
+        byte_buffer_reset(&set->json_buf);
+        char *str = cJSON_PrintUnformatted(json);
+        if (str) {
+            byte_buffer_append(&set->json_buf, str, strlen(str));
+            free(str);
+        }
+        byte_buffer_append(&set->json_buf, "\n", 1);
+        stats_record(STAT_SERIALIZE, SINK_FORMAT_JSON, t0);
+    }
+    
+    if (set->uses_format[SINK_FORMAT_CSV] || set->uses_format[SINK_FORMAT_BINARY] ||
+        set->uses_format[SINK_FORMAT_COMPRESSED]) {
+        uint64_t t0 = stats_start();
+        /* Column layout starts with the first record's; later leaves are appended */
+        if (!set->schema_ready) {
+            record_schema_build(&set->schema, json);
+            if (flat_record_init(&set->flat, &set->schema) != THERMO_SUCCESS) {
+                record_schema_free(&set->schema);
+                return;
+            }
+            set->schema_ready = 1;
+            set->csv_columns = set->schema.count;
+        }
+        if (flat_record_fill(&set->flat, &set->schema, json, timestamp_us) > 0 && !set->schema_full) {
+            sink_set_extend_schema(set, json);
+            flat_record_fill(&set->flat, &set->schema, json, timestamp_us);
+        }
+        stats_record(STAT_SERIALIZE, STATS_SLOT_COLUMNS, t0);
+        
+        if (set->uses_format[SINK_FORMAT_CSV]) {
+            t0 = stats_start();
+            FlatRecord row = set->flat;
+            row.count = set->csv_columns;
+            byte_buffer_reset(&set->csv_buf);
+            csv_encode_row(&set->csv_buf, &row);
+            stats_record(STAT_SERIALIZE, SINK_FORMAT_CSV, t0);
+        }
+        if (set->uses_format[SINK_FORMAT_BINARY]) {
+            t0 = stats_start();
+            byte_buffer_reset(&set->bin_buf);
+            tcr_encode_data(&set->bin_buf, &set->schema, &set->flat);
+            stats_record(STAT_SERIALIZE, SINK_FORMAT_BINARY, t0);
+        }
+    }
+    
+    for (int i = 0; i < set->count; i++) {
+        Sink *sink = &set->sinks[i];
+        if (sink->spec.format == SINK_FORMAT_COMPRESSED) {
+            if (set->schema_ready) {
+                uint64_t t0 = stats_start();
+                sink_block_add(set, sink, timestamp_us);
+                if (sink->rollup) {
+                    rollup_add(sink->rollup, &set->schema, &set->flat);
+                }
+                stats_record(STAT_SINK_WRITE, i, t0);
+            }
+            continue;
+        }
+        const ByteBuffer *data = sink->spec.format == SINK_FORMAT_JSON ? &set->json_buf :
+                                 sink->spec.format == SINK_FORMAT_CSV ? &set->csv_buf : &set->bin_buf;
+        uint64_t t0 = stats_start();
+        sink_emit(set, sink, data, timestamp_us);
+        if (sink->rollup && set->schema_ready) {
+            rollup_add(sink->rollup, &set->schema, &set->flat);
+        }
+        stats_record(STAT_SINK_WRITE, i, t0);
+    }
+}
+
+void sink_set_write_line(SinkSet *set, const char *line) {
+    if (!set->uses_format[SINK_FORMAT_JSON]) return;
+    
+    byte_buffer_reset(&set->json_buf);
+    byte_buffer_append(&set->json_buf, line, strlen(line));
+    byte_buffer_append(&set->json_buf, "\n", 1);
+    
+    for (int i = 0; i < set->count; i++) {
+        if (set->sinks[i].spec.format == SINK_FORMAT_JSON) {
+            sink_emit(set, &set->sinks[i], &set->json_buf, 0);
+        }
+    }
+}
+
+/* Earlier of two deadlines (-1 = none) */
+static int64_t deadline_min(int64_t a, int64_t b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    return a < b ? a : b;
+}
+
+int64_t sink_set_tick(SinkSet *set) {
+    int64_t now_us = time_mono_us();
+    int64_t next_us = -1;
+    
+    for (int i = 0; i < set->count; i++) {
+        Sink *sink = &set->sinks[i];
+        if (!sink->recorder) continue;
+        
+        /* A block is written before its records are synced */
+        if (sink->block_ready && sink->block.records > 0) {
+            int64_t due_us = sink->block_started_us + sink->block_span_us;
+            if (now_us >= due_us) {
+                sink_block_flush(set, sink);
+            } else {
+                next_us = deadline_min(next_us, due_us);
+            }
+        }
+        next_us = deadline_min(next_us, recorder_sync_due(sink->recorder, now_us));
+        next_us = deadline_min(next_us, rollup_tick(sink->rollup, now_us));
+    }
+    return next_us;
+}
+
+void sink_set_close(SinkSet *set) {
+    if (!set) return;
+    
+    for (int i = 0; i < set->count; i++) {
+        Sink *sink = &set->sinks[i];
+        sink_block_flush(set, sink);
+        rollup_close(sink->rollup);
+        if (sink->dropped > 0) {
+            fprintf(stderr, "Sink %s: %llu record%s dropped\n",
+                    sink->spec.kind == SINK_STDOUT ? "stdout" : sink->spec.target,
+                    (unsigned long long)sink->dropped, sink->dropped == 1 ? "" : "s");
+        }
+        recorder_close(sink->recorder);
+        if (sink->fd != -1) close(sink->fd);
+        byte_buffer_free(&sink->pending);
+        if (sink->block_ready) {
+            tcr_block_encoder_free(&sink->block);
+        }
+    }
+    
+    if (set->schema_ready) {
+        flat_record_free(&set->flat);
+        record_schema_free(&set->schema);
+    }
+    byte_buffer_free(&set->json_buf);
+    byte_buffer_free(&set->csv_buf);
+    byte_buffer_free(&set->bin_buf);
+    byte_buffer_free(&set->block_buf);
+    byte_buffer_free(&set->header_buf);
+    free(set);
+}
@@ -0,0 +1,219 @@
+/*
+ * Latency statistics implementation.
+ * One histogram per operation and slot, allocated by the thread that
+ * records into it on first use and only ever written by that thread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <stdatomic.h>
+
+#include "stats.h"
+#include "histogram.h"
+#include "hardware.h"
+#include "cJSON.h"
+
+static const char *OP_NAMES[STAT_OP_COUNT] = {
+    "t_in_read", "a_in_read", "cjc_read", "serialize", "sink_write"
+};
+
+volatile int g_stats_enabled = 0;
+
+/* Allocated by the writing thread on its first record */
+static _Atomic(Histogram*) g_hists[STAT_OP_COUNT][STATS_MAX_SLOTS];
+static char g_labels[STAT_OP_COUNT][STATS_MAX_SLOTS][64];
+static double g_interval_s = 0;
+static uint64_t g_start_ns = 0;
+static _Atomic uint64_t g_next_report_ns = 0;
+
+uint64_t stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void stats_record_since(StatOp op, int slot, uint64_t start_ns) {
+    if (slot < 0 || slot >= STATS_MAX_SLOTS) return;
+    uint64_t elapsed = stats_now_ns() - start_ns;
+    
+    Histogram *hist = atomic_load_explicit(&g_hists[op][slot], memory_order_relaxed);
+    if (!hist) {
+        hist = histogram_create();
+        if (!hist) return;
+        atomic_store_explicit(&g_hists[op][slot], hist, memory_order_release);
+    }
+    histogram_record(hist, elapsed);
+}
+
+/* ============================================================================
+ * Snapshots
+ * ============================================================================ */
+
+/* Percentiles reported, and their names in the table and JSON */
+static const double PERCENTILES[] = {50.0, 90.0, 99.0, 99.9};
+static const char *PERCENTILE_LABELS[] = {"p50", "p90", "p99", "p99.9"};
+static const char *PERCENTILE_KEYS[] = {"P50", "P90", "P99", "P999"};
+#define PERCENTILE_COUNT ((int)(sizeof(PERCENTILES) / sizeof(PERCENTILES[0])))
+
+/* Summary of one histogram, in microseconds */
+static int latency_summarize(const Histogram *hist, HistogramSummary *sum) {
+    if (!histogram_summarize(hist, PERCENTILES, PERCENTILE_COUNT, sum)) return 0;
+    sum->min /= 1000.0;
+    sum->mean /= 1000.0;
+    sum->max /= 1000.0;
+    for (int p = 0; p < PERCENTILE_COUNT; p++) {
+        sum->pct[p] /= 1000.0;
+    }
+    return 1;
+}
+
+/* Name a slot: the label given for it, else address/channel */
+static void slot_name(StatOp op, int slot, char *buf, size_t len) {
+    if (g_labels[op][slot][0]) {
+        snprintf(buf, len, "%s", g_labels[op][slot]);
+    } else {
+        snprintf(buf, len, "%d/%d", slot / 4, slot % 4);
+    }
+}
+
+static int op_is_hardware(StatOp op) {
+    return op == STAT_T_IN_READ || op == STAT_A_IN_READ || op == STAT_CJC_READ;
+}
+
+/* ============================================================================
+ * Reporting
+ * ============================================================================ */
+
+void stats_print_summary(FILE *fp) {
+    int header = 0;
+    for (int op = 0; op < STAT_OP_COUNT; op++) {
+        for (int slot = 0; slot < STATS_MAX_SLOTS; slot++) {
+            Histogram *hist = atomic_load_explicit(&g_hists[op][slot], memory_order_acquire);
+            HistogramSummary sum;
+            if (!hist || !latency_summarize(hist, &sum)) continue;
+    
+            if (!header) {
+                fprintf(fp, "%-32s %10s %9s %9s", "Latency (us)", "count", "min", "mean");
+                for (int p = 0; p < PERCENTILE_COUNT; p++) {
+                    fprintf(fp, " %9s", PERCENTILE_LABELS[p]);
+                }
+                fprintf(fp, " %9s\n", "max");
+                header = 1;
+            }
+    
+            char name[80];
+            char label[64];
+            slot_name(op, slot, label, sizeof(label));
+            snprintf(name, sizeof(name), "%s %s", OP_NAMES[op], label);
+            fprintf(fp, "%-32s %10llu %9.2f %9.2f", name, (unsigned long long)sum.count, sum.min, sum.mean);
+            for (int p = 0; p < PERCENTILE_COUNT; p++) {
+                fprintf(fp, " %9.2f", sum.pct[p]);
+            }
+            fprintf(fp, " %9.2f\n", sum.max);
+        }
+    }
+}
+
+/* Microseconds to whole nanoseconds */
+static double round_ns(double us) {
+    return round(us * 1000.0) / 1000.0;
+}
+
+/* {"STATS":{"UPTIME":s,"LATENCY_US":[{"OP":..,"ADDRESS":..,"CHANNEL":..,"COUNT":..,...}]}} */
+static cJSON* stats_to_json(void) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON *stats = cJSON_AddObjectToObject(root, "STATS");
+    cJSON_AddNumberToObject(stats, "UPTIME", round((double)(stats_now_ns() - g_start_ns) / 1e6) / 1e3);
+    cJSON *list = cJSON_AddArrayToObject(stats, "LATENCY_US");
+    
+    for (int op = 0; op < STAT_OP_COUNT; op++) {
+        for (int slot = 0; slot < STATS_MAX_SLOTS; slot++) {
+            Histogram *hist = atomic_load_explicit(&g_hists[op][slot], memory_order_acquire);
+            HistogramSummary sum;
+            if (!hist || !latency_summarize(hist, &sum)) continue;
+    
+            cJSON *item = cJSON_CreateObject();
+            cJSON_AddStringToObject(item, "OP", OP_NAMES[op]);
+            if (op_is_hardware((StatOp)op)) {
+                cJSON_AddNumberToObject(item, "ADDRESS", slot / 4);
+                cJSON_AddNumberToObject(item, "CHANNEL", slot % 4);
+            } else {
+                char label[64];
+                slot_name((StatOp)op, slot, label, sizeof(label));
+                cJSON_AddStringToObject(item, "TARGET", label);
+            }
+            cJSON_AddNumberToObject(item, "COUNT", (double)sum.count);
+            cJSON_AddNumberToObject(item, "MIN", round_ns(sum.min));
+            cJSON_AddNumberToObject(item, "MEAN", round_ns(sum.mean));
+            for (int p = 0; p < PERCENTILE_COUNT; p++) {
+                cJSON_AddNumberToObject(item, PERCENTILE_KEYS[p], round_ns(sum.pct[p]));
+            }
+            cJSON_AddNumberToObject(item, "MAX", round_ns(sum.max));
+            cJSON_AddItemToArray(list, item);
+        }
+    }
+    return root;
+}
+
+void stats_report_due(void) {
+    if (!g_stats_enabled || g_interval_s <= 0) return;
+    
+    uint64_t now = stats_now_ns();
+    uint64_t next = atomic_load_explicit(&g_next_report_ns, memory_order_relaxed);
+    if (now < next) return;
+    atomic_store_explicit(&g_next_report_ns, now + (uint64_t)(g_interval_s * 1e9), memory_order_relaxed);
+    
+    cJSON *root = stats_to_json();
+    char *str = cJSON_PrintUnformatted(root);
+    if (str) {
+        fprintf(stderr, "%s\n", str);
+        free(str);
+    }
+    cJSON_Delete(root);
+}
+
+/* ============================================================================
+ * Setup
+ * ============================================================================ */
+
+int stats_parse_interval(const char *str, double *interval_s) {
+    if (!str) {
+        *interval_s = STATS_DEFAULT_INTERVAL_S;
+        return THERMO_SUCCESS;
+    }
+    char *end = NULL;
+    double value = strtod(str, &end);
+    if (*str == '\0' || *end != '\0' || value < 0) {
+        fprintf(stderr, "Error: --stats interval must be a number of seconds (0 = on exit only)\n");
+        return THERMO_INVALID_PARAM;
+    }
+    *interval_s = value;
+    return THERMO_SUCCESS;
+}
+
+static void stats_atexit(void) {
+    if (!g_stats_enabled) return;
+    g_stats_enabled = 0;
+    stats_print_summary(stderr);
+}
+
+void stats_enable(double interval_s) {
+    static int atexit_registered = 0;
+    if (!atexit_registered) {
+        atexit(stats_atexit);
+        atexit_registered = 1;
+    }
+    g_interval_s = interval_s;
+    g_start_ns = stats_now_ns();
+    atomic_store_explicit(&g_next_report_ns, g_start_ns + (uint64_t)(interval_s * 1e9),
+                          memory_order_relaxed);
+    g_stats_enabled = 1;
+}
+
+void stats_label(StatOp op, int slot, const char *label) {
+    if (slot < 0 || slot >= STATS_MAX_SLOTS) return;
+    snprintf(g_labels[op][slot], sizeof(g_labels[op][slot]), "%s", label);
+}
@@ -0,0 +1,108 @@
+/*
+ * Time index implementation.
+ * The file is the magic followed by entries in write order; readers keep
+ * the leading entries that lie within the recording and increase, so a
+ * torn or stale tail is ignored.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "timeindex.h"
+#include "hardware.h"
+
+void time_index_path(char *out, size_t out_len, const char *path) {
+    snprintf(out, out_len, "%s%s", path, TIME_INDEX_SUFFIX);
+}
+
+/* Read an index and count its usable leading entries. Returns them (NULL
+ * with *count 0 if there are none or fd is not an index, *count -1 if out
+ * of memory). */
+static TimeIndexEntry* index_read(int fd, long long data_size, int *count) {
+    struct stat st;
+    char magic[TIME_INDEX_MAGIC_LEN];
+    *count = 0;
+    
+    if (fstat(fd, &st) != 0 || st.st_size < TIME_INDEX_MAGIC_LEN ||
+        pread(fd, magic, sizeof(magic), 0) != (ssize_t)sizeof(magic) ||
+        memcmp(magic, TIME_INDEX_MAGIC, TIME_INDEX_MAGIC_LEN) != 0) {
+        return NULL;
+    }
+    
+    long long total = ((long long)st.st_size - TIME_INDEX_MAGIC_LEN) / (long long)sizeof(TimeIndexEntry);
+    if (total == 0 || total > 0x7fffffff) return NULL;
+    
+    size_t bytes = (size_t)total * sizeof(TimeIndexEntry);
+    TimeIndexEntry *entries = (TimeIndexEntry*)malloc(bytes);
+    if (!entries) {
+        *count = -1;
+        return NULL;
+    }
+    if (pread(fd, entries, bytes, TIME_INDEX_MAGIC_LEN) != (ssize_t)bytes) {
+        free(entries);
+        return NULL;
+    }
+    
+    int n = 0;
+    while (n < total && entries[n].offset < data_size && entries[n].header_offset <= entries[n].offset &&
+           (n == 0 || entries[n].offset > entries[n - 1].offset)) {
+        n++;
+    }
+    if (n == 0) {
+        free(entries);
+        return NULL;
+    }
+    *count = n;
+    return entries;
+}
+
+int time_index_load(const char *path, long long data_size, TimeIndexEntry **entries) {
+    char index_path[300];
+    time_index_path(index_path, sizeof(index_path), path);
+    *entries = NULL;
+    
+    int fd = open(index_path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return 0;
+    
+    int count;
+    *entries = index_read(fd, data_size, &count);
+    close(fd);
+    return count;
+}
+
+int time_index_trim(const char *path, long long data_size, TimeIndexEntry *last) {
+    char index_path[300];
+    time_index_path(index_path, sizeof(index_path), path);
+    
+    int fd = open(index_path, O_RDWR | O_CLOEXEC);
+    if (fd == -1) return 0;
+    
+    int count;
+    TimeIndexEntry *entries = index_read(fd, data_size, &count);
+    if (count < 0) {
+        close(fd);
+        return THERMO_ERROR;
+    }
+    
+    /* An index with nothing usable would only mislead readers */
+    if (count == 0) {
+        close(fd);
+        unlink(index_path);
+        return 0;
+    }
+    
+    int result = 1;
+    off_t length = (off_t)(TIME_INDEX_MAGIC_LEN + (size_t)count * sizeof(TimeIndexEntry));
+    if (ftruncate(fd, length) != 0) {
+        result = THERMO_IO_ERROR;
+    } else {
+        *last = entries[count - 1];
+    }
+    free(entries);
+    close(fd);
+    return result;
+}
@@ -0,0 +1,157 @@
+/*
+ * Hot-path tracing implementation.
+ * A ring has a single writer (its thread), which publishes each event by
+ * advancing the ring's head with a release store. Rings are pushed onto a
+ * global list with compare-and-swap and are only read once recording has
+ * stopped and the writing threads have finished.
+ */
+
+#define _GNU_SOURCE  /* syscall(SYS_gettid) */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+#include "hardware.h"
+
+typedef struct {
+    uint64_t ts_ns;             /* CLOCK_MONOTONIC */
+    const char *name;
+    char phase;                 /* 'B' or 'E' */
+} TraceEvent;
+
+typedef struct TraceRing {
+    struct TraceRing *next;
+    int tid;
+    const char *thread_name;
+    _Atomic uint64_t head;      /* Events ever written */
+    TraceEvent events[TRACE_RING_EVENTS];
+} TraceRing;
+
+volatile int g_trace_enabled = 0;
+
+static _Atomic(TraceRing*) g_rings = NULL;
+static __thread TraceRing *t_ring = NULL;
+static char *g_trace_path = NULL;
+static uint64_t g_trace_start_ns = 0;
+
+static uint64_t trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static TraceRing* ring_for_thread(void) {
+    if (t_ring) return t_ring;
+    
+    TraceRing *ring = calloc(1, sizeof(TraceRing));
+    if (!ring) return NULL;
+    ring->tid = (int)syscall(SYS_gettid);
+    ring->thread_name = "thread";
+    
+    TraceRing *head = atomic_load_explicit(&g_rings, memory_order_relaxed);
+    do {
+        ring->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&g_rings, &head, ring,
+                                                    memory_order_release, memory_order_relaxed));
+    t_ring = ring;
+    return ring;
+}
+
+void trace_event(const char *name, char phase) {
+    TraceRing *ring = ring_for_thread();
+    if (!ring) return;
+    
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    TraceEvent *ev = &ring->events[head % TRACE_RING_EVENTS];
+    ev->ts_ns = trace_now_ns();
+    ev->name = name;
+    ev->phase = phase;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void trace_thread_register(const char *name) {
+    if (!g_trace_enabled) return;
+    TraceRing *ring = ring_for_thread();
+    if (ring) ring->thread_name = name;
+}
+
+static void trace_atexit(void) {
+    trace_stop();
+}
+
+int trace_start(const char *path) {
+    free(g_trace_path);
+    g_trace_path = strdup(path);
+    if (!g_trace_path) return THERMO_ERROR;
+    
+    /* Fail now rather than after a long run */
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot write trace file '%s': %s\n", path, strerror(errno));
+        free(g_trace_path);
+        g_trace_path = NULL;
+        return THERMO_IO_ERROR;
+    }
+    fclose(fp);
+    
+    static int atexit_registered = 0;
+    if (!atexit_registered) {
+        atexit(trace_atexit);
+        atexit_registered = 1;
+    }
+    g_trace_start_ns = trace_now_ns();
+    g_trace_enabled = 1;
+    trace_thread_register("main");
+    return THERMO_SUCCESS;
+}
+
+static void write_ring(FILE *fp, const TraceRing *ring, int pid, int *first) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t start = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+    
+    fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            *first ? "" : ",", pid, ring->tid, ring->thread_name);
+    *first = 0;
+    
+    for (uint64_t i = start; i < head; i++) {
+        const TraceEvent *ev = &ring->events[i % TRACE_RING_EVENTS];
+        uint64_t rel = ev->ts_ns > g_trace_start_ns ? ev->ts_ns - g_trace_start_ns : 0;
+        fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":%d,\"tid\":%d}",
+                ev->name, ev->phase, (unsigned long long)(rel / 1000),
+                (unsigned long long)(rel % 1000), pid, ring->tid);
+    }
+    if (start > 0) {
+        fprintf(stderr, "Trace: %s kept the last %d of %llu events\n", ring->thread_name,
+                TRACE_RING_EVENTS, (unsigned long long)head);
+    }
+}
+
+void trace_stop(void) {
+    if (!g_trace_enabled) return;
+    g_trace_enabled = 0;
+    
+    FILE *fp = fopen(g_trace_path, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot write trace file '%s': %s\n", g_trace_path, strerror(errno));
+        return;
+    }
+    
+    int pid = (int)getpid();
+    int first = 1;
+    uint64_t total = 0;
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (TraceRing *ring = atomic_load_explicit(&g_rings, memory_order_acquire); ring; ring = ring->next) {
+        write_ring(fp, ring, pid, &first);
+        total += atomic_load_explicit(&ring->head, memory_order_relaxed);
+    }
+    fprintf(fp, "\n]}\n");
+    if (fclose(fp) == 0) {
+        fprintf(stderr, "Trace: %llu events written to %s\n", (unsigned long long)total, g_trace_path);
+    }
+}
@@ -183,7 +183,9 @@ void reading_format_calculate_max_width(const ChannelReading *readings, const Bo
         const BoardInfo *info = board_infos ? &board_infos[reading->address] : NULL;
         
         if (reading->has_temp) {
-            max_digits = MAX(max_digits, count_digits_before_decimal(reading->temperature));
+            if (reading->status == READING_OK) {
+                max_digits = MAX(max_digits, count_digits_before_decimal(reading->temperature));
+            }
             *max_key_len = MAX(*max_key_len, (int)strlen(DATA_FORMATS[TEMP_FORMAT].key));
             *max_unit_len = MAX(*max_unit_len, (int)strlen(DATA_FORMATS[TEMP_FORMAT].unit));
         }
@@ -251,8 +253,11 @@ void reading_format_output(const ChannelReading *reading, const BoardInfo *info,
         }
     }
     
-    /* Output dynamic readings */
-    if (reading->has_temp) {
+    /* Output dynamic readings; a faulted temperature shows its status instead */
+    if (reading->has_temp && reading->status != READING_OK) {
+        printf("%s%-*s: %*s\n", indent_str, key_width, DATA_FORMATS[TEMP_FORMAT].key,
+               value_width, thermo_status_name((ReadingStatus)reading->status));
+    } else if (reading->has_temp) {
         data_format_print_value(DATA_FORMATS[TEMP_FORMAT].key,
                                reading->temperature,
                                DATA_FORMATS[TEMP_FORMAT].unit,
@@ -276,6 +281,19 @@ void reading_format_output(const ChannelReading *reading, const BoardInfo *info,
     free(indent_str);
 }
 
+/* Wall-clock time in microseconds since the epoch */
+int64_t time_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t time_mono_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 /* Format temperature value for display */
 char* format_temperature(double temp) {
     static char buffer[64];